@@ -0,0 +1,80 @@
+#include "AllocationCounter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace vibe::bench {
+namespace {
+
+// Constant-initialized, so counting works from the first allocation of every thread. Memory
+// freed on another thread than the one that allocated it makes |live| drift, hence signed.
+struct HeapCounters {
+  uint64_t count;
+  int64_t live;
+  int64_t peak;
+};
+
+thread_local HeapCounters t_heap = {};
+
+// Each block carries its size in front, keeping the default new alignment.
+constexpr size_t kHeaderBytes = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+void* CountedAllocate(size_t size) {
+  if (size > SIZE_MAX - kHeaderBytes) return nullptr;
+  auto* block = static_cast<unsigned char*>(std::malloc(size + kHeaderBytes));
+  if (!block) return nullptr;
+  *reinterpret_cast<size_t*>(block) = size;
+  ++t_heap.count;
+  t_heap.live += static_cast<int64_t>(size);
+  t_heap.peak = std::max(t_heap.peak, t_heap.live);
+  return block + kHeaderBytes;
+}
+
+void CountedFree(void* memory) {
+  if (!memory) return;
+  auto* block = static_cast<unsigned char*>(memory) - kHeaderBytes;
+  t_heap.live -= static_cast<int64_t>(*reinterpret_cast<size_t*>(block));
+  std::free(block);
+}
+
+void* CountedAllocateOrThrow(size_t size) {
+  void* memory = CountedAllocate(size);
+  if (!memory) throw std::bad_alloc();
+  return memory;
+}
+
+}  // namespace
+
+AllocationCounter::AllocationCounter() : start_count_(t_heap.count), start_live_(t_heap.live) {
+  t_heap.peak = t_heap.live;
+}
+
+AllocationStats AllocationCounter::stats() const {
+  AllocationStats stats;
+  stats.allocations = t_heap.count - start_count_;
+  stats.peak_bytes = static_cast<size_t>(std::max<int64_t>(t_heap.peak - start_live_, 0));
+  return stats;
+}
+
+}  // namespace vibe::bench
+
+void* operator new(size_t size) { return vibe::bench::CountedAllocateOrThrow(size); }
+void* operator new[](size_t size) { return vibe::bench::CountedAllocateOrThrow(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return vibe::bench::CountedAllocate(size);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return vibe::bench::CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept { vibe::bench::CountedFree(memory); }
+void operator delete[](void* memory) noexcept { vibe::bench::CountedFree(memory); }
+void operator delete(void* memory, size_t) noexcept { vibe::bench::CountedFree(memory); }
+void operator delete[](void* memory, size_t) noexcept { vibe::bench::CountedFree(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+  vibe::bench::CountedFree(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+  vibe::bench::CountedFree(memory);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vibe::bench {
+
+struct AllocationStats {
+  uint64_t allocations = 0;
+  // Most heap bytes live at once, above what was live when counting started.
+  size_t peak_bytes = 0;
+};
+
+// Counts the calling thread's operator new calls while it is alive. The bench binary replaces the
+// global allocation functions to do so; over-aligned new is left alone and not counted. Counters
+// must not nest, since each one restarts the thread's peak.
+class AllocationCounter {
+ public:
+  AllocationCounter();
+
+  AllocationCounter(const AllocationCounter&) = delete;
+  AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+  AllocationStats stats() const;
+
+ private:
+  uint64_t start_count_;
+  int64_t start_live_;
+};
+
+}  // namespace vibe::bench
@@ -0,0 +1,302 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "CpuFeatures.h"
+#include "ImageDecoder.h"
+#include "JpegEncoder.h"
+#include "PngEncoder.h"
+#include "ReferenceBase64.h"
+#include "Scaler.h"
+#include "ThumbnailPipeline.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr SimdLevel kLevels[] = {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kSse41,
+                                 SimdLevel::kAvx2};
+constexpr uint32_t kTileSizes[] = {256, 1024};
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+// Straight-alpha BGRA with smooth gradients and some noise, every alpha 255.
+std::vector<uint8_t> OpaqueImage(uint32_t width, uint32_t height, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+      pixel[0] = static_cast<uint8_t>(x * 255 / width + (rng() & 7));
+      pixel[1] = static_cast<uint8_t>(y * 255 / height);
+      pixel[2] = static_cast<uint8_t>((x + y) * 127 / (width + height) + (rng() & 31));
+      pixel[3] = 255;
+    }
+  }
+  return pixels;
+}
+
+// |png| with a tRNS color key inserted after IHDR, which makes an RGB image translucent.
+std::vector<uint8_t> WithColorKey(const std::vector<uint8_t>& png) {
+  std::vector<uint8_t> chunk = {0, 0, 0, 6, 't', 'R', 'N', 'S', 0, 0, 0, 0, 0, 0};
+  uint32_t crc = ~0u;
+  for (size_t i = 4; i < chunk.size(); ++i) {
+    crc ^= chunk[i];
+    for (int bit = 0; bit < 8; ++bit) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+  }
+  for (int shift = 24; shift >= 0; shift -= 8) chunk.push_back(static_cast<uint8_t>(~crc >> shift));
+  constexpr size_t kAfterHeader = 8 + 25;
+  std::vector<uint8_t> out(png);
+  out.insert(out.begin() + kAfterHeader, chunk.begin(), chunk.end());
+  return out;
+}
+
+// The scan must agree with a plain loop at every level, for every row width around the vector
+// sizes, whichever single pixel is translucent, and must not look at the padding between rows.
+bool VerifyScan() {
+  bool ok = true;
+  for (SimdLevel level : kLevels) {
+    SetSimdLevelCap(level);
+    for (uint32_t width = 1; width <= 40 && ok; ++width) {
+      for (uint32_t height = 1; height <= 3 && ok; ++height) {
+        const size_t stride = static_cast<size_t>(width) * 4 + 12;
+        // Padding bytes are zero, so a scan that strays into them sees alpha 0.
+        std::vector<uint8_t> pixels(stride * height, 0);
+        for (uint32_t y = 0; y < height; ++y) {
+          std::fill_n(pixels.data() + y * stride, static_cast<size_t>(width) * 4, 255);
+        }
+        const std::string name = std::string(SimdLevelName(level)) + " " +
+                                 std::to_string(width) + "x" + std::to_string(height);
+        ok &= Expect(IsOpaqueBgra(pixels.data(), width, height, stride), name + ": not opaque");
+        for (uint32_t y = 0; y < height; ++y) {
+          for (uint32_t x = 0; x < width; ++x) {
+            for (uint8_t alpha : {uint8_t{0}, uint8_t{254}, uint8_t{127}}) {
+              uint8_t* pixel_alpha = pixels.data() + y * stride + x * 4 + 3;
+              *pixel_alpha = alpha;
+              ok &= Expect(!IsOpaqueBgra(pixels.data(), width, height, stride),
+                           name + ": alpha " + std::to_string(alpha) + " at " +
+                               std::to_string(x) + "," + std::to_string(y) + " missed");
+              *pixel_alpha = 255;
+            }
+          }
+        }
+        // Colour bytes, however low, are not alpha.
+        std::vector<uint8_t> dark(pixels);
+        for (uint32_t y = 0; y < height; ++y) {
+          for (uint32_t x = 0; x < width; ++x) {
+            std::fill_n(dark.data() + y * stride + x * 4, 3, 0);
+          }
+        }
+        ok &= Expect(IsOpaqueBgra(dark.data(), width, height, stride), name + ": dark pixels");
+      }
+    }
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+  return ok;
+}
+
+std::vector<uint8_t> Scale(const std::vector<uint8_t>& image, uint32_t width, uint32_t height,
+                           ImageSize size, ScaleFilter filter, bool opaque) {
+  std::vector<uint8_t> out(static_cast<size_t>(size.width) * size.height * 4);
+  BgraScaler scaler;
+  if (!scaler.Init(width, height, out.data(), size.width, size.height, size.width * 4, filter,
+                   opaque)) {
+    return {};
+  }
+  for (uint32_t y = 0; y < height; ++y) scaler.PushRow(image.data() + y * width * 4);
+  return out;
+}
+
+// Leaving premultiplication out of opaque rows changes no output byte, at any level or filter.
+bool VerifyScaler() {
+  bool ok = true;
+  const struct {
+    uint32_t width, height, cx;
+  } kCases[] = {{640, 480, 256}, {333, 517, 96}, {300, 200, 256}, {17, 9, 5}, {1, 64, 16}};
+  for (SimdLevel level : kLevels) {
+    SetSimdLevelCap(level);
+    for (const auto& c : kCases) {
+      const std::vector<uint8_t> image = OpaqueImage(c.width, c.height, c.width);
+      const ImageSize size = ComputeThumbnailSize(c.width, c.height, c.cx);
+      for (ScaleFilter filter : {ScaleFilter::kAuto, ScaleFilter::kBilinear}) {
+        const std::vector<uint8_t> blended =
+            Scale(image, c.width, c.height, size, filter, false);
+        const std::vector<uint8_t> opaque = Scale(image, c.width, c.height, size, filter, true);
+        ok &= Expect(!blended.empty() && blended == opaque,
+                     std::string(SimdLevelName(level)) + " " + std::to_string(c.width) + "x" +
+                         std::to_string(c.height) + ": opaque scaling differs");
+      }
+    }
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+  return ok;
+}
+
+// Records what the decoder announced and stops there.
+class LayoutSink final : public ImageRowSink {
+ public:
+  DecodeStatus Begin(const ImageLayout& announced) override {
+    layout = announced;
+    return DecodeStatus::kUnsupported;
+  }
+  void PushRow(const uint8_t* row) override { (void)row; }
+
+  ImageLayout layout;
+};
+
+// Decoders announce opacity only for formats that cannot be translucent.
+bool VerifyDecoders(ImageDecoder& decoder) {
+  const uint32_t width = 48;
+  const uint32_t height = 32;
+  const std::vector<uint8_t> image = OpaqueImage(width, height, 7);
+  const std::vector<uint8_t> rgb = EncodePng(image.data(), width, height, width * 4, false);
+  const struct {
+    const char* name;
+    std::vector<uint8_t> bytes;
+    bool opaque;
+  } kCases[] = {
+      {"jpeg", EncodeJpeg(image.data(), width, height, width * 4, 90), true},
+      {"rgb png", rgb, true},
+      {"interlaced rgb png", EncodePng(image.data(), width, height, width * 4, false, true),
+       true},
+      {"rgba png", EncodePng(image.data(), width, height, width * 4, true), false},
+      {"keyed rgb png", WithColorKey(rgb), false},
+  };
+  bool ok = true;
+  for (const auto& c : kCases) {
+    LayoutSink sink;
+    decoder.DecodeRows(c.bytes, ImageFormat::kUnknown, 0, &sink);
+    ok &= Expect(sink.layout.width == width && sink.layout.opaque == c.opaque,
+                 std::string(c.name) + ": opaque " + (sink.layout.opaque ? "set" : "not set"));
+  }
+  return ok;
+}
+
+// Forwards to |inner| but hides that the image is opaque, so the scaler premultiplies as it did
+// before decoders reported it.
+class AlphaBlindDecoder final : public ImageDecoder {
+ public:
+  explicit AlphaBlindDecoder(ImageDecoder& inner) : inner_(inner) {}
+
+  const char* name() const override { return "alpha blind"; }
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override {
+    Sink blind(sink);
+    return inner_.DecodeRows(data, format, min_long_edge, &blind);
+  }
+
+ private:
+  class Sink final : public ImageRowSink {
+   public:
+    explicit Sink(ImageRowSink* inner) : inner_(inner) {}
+    DecodeStatus Begin(const ImageLayout& layout) override {
+      ImageLayout blind = layout;
+      blind.opaque = false;
+      return inner_->Begin(blind);
+    }
+    void PushRow(const uint8_t* row) override { inner_->PushRow(row); }
+
+   private:
+    ImageRowSink* inner_;
+  };
+
+  ImageDecoder& inner_;
+};
+
+struct Tile {
+  ThumbnailStatus status = ThumbnailStatus::kOk;
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+};
+
+Tile Render(const std::string& json, uint32_t cx, ImageDecoder& decoder) {
+  Tile tile;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    tile.size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    tile.pixels.resize(*stride * height);
+    return tile.pixels.data();
+  };
+  MemoryByteSource source(json);
+  tile.status = RenderThumbnail(source, cx, decoder, allocate);
+  return tile;
+}
+
+}  // namespace
+
+int RunAlphaBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  AlphaBlindDecoder blind(*decoder);
+  int failures = 0;
+  if (!VerifyScan()) ++failures;
+  if (!VerifyScaler()) ++failures;
+  if (!VerifyDecoders(*decoder)) ++failures;
+
+  const uint32_t width = 2048;
+  const uint32_t height = 1536;
+  const std::vector<uint8_t> image = OpaqueImage(width, height, 24);
+  const struct {
+    const char* name;
+    std::vector<uint8_t> bytes;
+  } kPayloads[] = {
+      {"jpeg", EncodeJpeg(image.data(), width, height, width * 4, 90)},
+      {"rgb png", EncodePng(image.data(), width, height, width * 4, false)},
+  };
+
+  PrintBenchHeader("alpha");
+  for (const uint32_t cx : kTileSizes) {
+    const ImageSize size = ComputeThumbnailSize(width, height, cx);
+    const std::string name = "scale to " + std::to_string(cx) + " px";
+    PrintBenchRow(name + " premultiplied", MeasureBench(image.size(), options.iterations, [&] {
+                    DoNotOptimize(Scale(image, width, height, size, ScaleFilter::kAuto, false));
+                  }));
+    PrintBenchRow(name + " opaque", MeasureBench(image.size(), options.iterations, [&] {
+                    DoNotOptimize(Scale(image, width, height, size, ScaleFilter::kAuto, true));
+                  }));
+  }
+  for (const auto& payload : kPayloads) {
+    const std::string json =
+        "{\"image\":\"" + reference::EncodeBase64(payload.bytes) + "\"}";
+    for (const uint32_t cx : kTileSizes) {
+      const std::string name = std::string(payload.name) + " " + std::to_string(cx) + " px";
+      const Tile opaque = Render(json, cx, *decoder);
+      const Tile blended = Render(json, cx, blind);
+      const size_t stride = static_cast<size_t>(opaque.size.width) * 4;
+      if (!Expect(opaque.status == ThumbnailStatus::kOk && opaque.pixels == blended.pixels &&
+                      IsOpaqueBgra(opaque.pixels.data(), opaque.size.width, opaque.size.height,
+                                   stride),
+                  name + ": opaque render differs or is not opaque")) {
+        ++failures;
+        continue;
+      }
+      PrintBenchRow(name + " premultiplied", MeasureBench(json.size(), options.iterations, [&] {
+                      DoNotOptimize(Render(json, cx, blind));
+                    }));
+      PrintBenchRow(name + " opaque", MeasureBench(json.size(), options.iterations, [&] {
+                      DoNotOptimize(Render(json, cx, *decoder));
+                    }));
+      PrintBenchRow(name + " opacity scan",
+                    MeasureBench(opaque.pixels.size(), options.iterations, [&] {
+                      DoNotOptimize(IsOpaqueBgra(opaque.pixels.data(), opaque.size.width,
+                                                 opaque.size.height, stride));
+                    }));
+    }
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d alpha checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,200 @@
+#include "Bench.h"
+
+#include "Base64.h"
+#include "Base64Reader.h"
+#include "BenchUtil.h"
+#include "CpuFeatures.h"
+#include "ReferenceBase64.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr SimdLevel kLevels[] = {SimdLevel::kScalar, SimdLevel::kSsse3, SimdLevel::kAvx2};
+std::vector<uint8_t> RandomBytes(std::mt19937& rng, size_t size) {
+  std::vector<uint8_t> bytes(size);
+  for (uint8_t& byte : bytes) byte = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+// Valid encodings with assorted wrapping and padding, then a random mutation so that invalid
+// characters, misplaced padding and truncation land at every offset within a SIMD block.
+std::string MakeCase(std::mt19937& rng) {
+  const size_t line_lengths[] = {0, 0, 64, 76, 17};
+  std::string text = reference::EncodeBase64(RandomBytes(rng, rng() % 160),
+                                  line_lengths[rng() % std::size(line_lengths)]);
+  switch (rng() % 6) {
+    case 0:
+      while (!text.empty() && text.back() == '=') text.pop_back();
+      break;
+    case 1:
+      if (!text.empty()) text[rng() % text.size()] = "=\n -!\x80"[rng() % 6];
+      break;
+    case 2:
+      if (!text.empty()) text.erase(rng() % text.size(), 1);
+      break;
+    case 3:
+      text.append(rng() % 3, "= \n"[rng() % 3]);
+      break;
+    default:
+      break;
+  }
+  return text;
+}
+
+int VerifyAgainstReference() {
+  std::mt19937 rng(0xba5e64);
+  int mismatches = 0;
+  std::vector<uint8_t> expected;
+  for (int i = 0; i < 200000; ++i) {
+    const std::string text = MakeCase(rng);
+    const Base64Result want = reference::DecodeBase64(text, &expected);
+
+    for (SimdLevel level : kLevels) {
+      SetSimdLevelCap(level);
+      std::vector<uint8_t> actual(Base64DecodedSizeUpperBound(text.size()));
+      const Base64Result got = DecodeBase64(text, actual.data(), actual.size());
+      bool same = got.status == want.status;
+      if (same && got.status == Base64Status::kOk) {
+        same = got.written == want.written &&
+               std::memcmp(actual.data(), expected.data(), got.written) == 0;
+      } else if (same) {
+        same = got.error_offset == want.error_offset;
+      }
+      if (!same && mismatches++ < 5) {
+        std::printf("mismatch at %s (%s vs %s): %s\n", SimdLevelName(level),
+                    Base64StatusName(got.status), Base64StatusName(want.status), text.c_str());
+      }
+    }
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+  return mismatches;
+}
+
+// Reads |text| through a Base64Reader with random read sizes and seeks, comparing every byte with
+// a bulk decode. Invalid text only has to fail somewhere before the end.
+bool VerifyReaderCase(std::mt19937& rng, const std::string& text) {
+  std::vector<uint8_t> expected;
+  const bool valid = reference::DecodeBase64(text, &expected).status == Base64Status::kOk;
+  const auto reader = std::make_unique<Base64Reader>(text);
+  if (valid && reader->size() != expected.size()) return false;
+
+  std::vector<uint8_t> buffer(3 * Base64Reader::kBlockBytes);
+  const size_t read_sizes[] = {1, 7, 4096, Base64Reader::kBlockBytes, buffer.size()};
+  bool reached_end = false;
+  for (int step = 0; step < 64 && !reached_end; ++step) {
+    if (valid && rng() % 4 == 0) reader->Seek(rng() % (expected.size() + 16));
+    const uint64_t position = reader->position();
+    size_t read = 0;
+    const size_t capacity = 1 + rng() % read_sizes[rng() % std::size(read_sizes)];
+    if (!reader->Read(buffer.data(), capacity, &read)) return !valid;
+    if (!valid) {
+      reached_end = read == 0;
+      continue;
+    }
+    const size_t available = position < expected.size() ? expected.size() - position : 0;
+    if (read != std::min(capacity, available) || reader->position() != position + read ||
+        std::memcmp(buffer.data(), expected.data() + std::min(position, expected.size()), read) !=
+            0) {
+      return false;
+    }
+  }
+  if (valid) return true;
+
+  // Invalid text must fail on the way through.
+  for (size_t read = 1; read != 0;) {
+    if (!reader->Read(buffer.data(), buffer.size(), &read)) return true;
+  }
+  return false;
+}
+
+int VerifyReader() {
+  std::mt19937 rng(0x5ea7);
+  int failures = 0;
+  const size_t line_lengths[] = {0, 76, 64, 17};
+  for (int i = 0; i < 2000; ++i) {
+    const size_t size = i % 100 == 0 ? rng() % (6 << 20) : rng() % 100000;
+    const size_t line_length = line_lengths[rng() % std::size(line_lengths)];
+    std::string text = reference::EncodeBase64(RandomBytes(rng, size), line_length);
+    switch (rng() % 4) {
+      case 0:
+        while (!text.empty() && text.back() == '=') text.pop_back();
+        break;
+      case 1:
+        if (!text.empty()) text[rng() % text.size()] = "=-!\x80"[rng() % 4];
+        break;
+      default:
+        break;
+    }
+    if (!VerifyReaderCase(rng, text) && failures++ < 5) {
+      std::printf("reader mismatch on %zu characters\n", text.size());
+    }
+  }
+  return failures;
+}
+
+void BenchCase(std::string_view label, const std::string& text, int iterations) {
+  std::vector<uint8_t> scratch;
+  std::string name = std::string(label) + " reference";
+  PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+    reference::DecodeBase64(text, &scratch);
+    DoNotOptimize(scratch);
+  }));
+
+  std::vector<uint8_t> output(Base64DecodedSizeUpperBound(text.size()));
+  const SimdLevel detected = ActiveSimdLevel();
+  for (SimdLevel level : kLevels) {
+    if (level > detected) continue;
+    SetSimdLevelCap(level);
+    name = std::string(label) + " " + SimdLevelName(level);
+    PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+      const Base64Result result = DecodeBase64(text, output.data(), output.size());
+      DoNotOptimize(result);
+    }));
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+
+  // Small sequential reads, the way WIC pulls from a Base64Stream.
+  const auto reader = std::make_unique<Base64Reader>(text);
+  name = std::string(label) + " reader 4KB reads";
+  PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+    reader->Seek(0);
+    size_t read = 0;
+    do {
+      reader->Read(output.data(), 4096, &read);
+    } while (read != 0);
+    DoNotOptimize(output);
+  }));
+}
+
+}  // namespace
+
+int RunBase64Bench(const BenchOptions& options) {
+  PrintBenchHeader("base64");
+
+  const int mismatches = VerifyAgainstReference();
+  if (mismatches != 0) {
+    std::printf("FAILED: %d mismatches against the reference decoder\n", mismatches);
+    return 1;
+  }
+  const int reader_failures = VerifyReader();
+  if (reader_failures != 0) {
+    std::printf("FAILED: %d Base64Reader cases\n", reader_failures);
+    return 1;
+  }
+
+  std::mt19937 rng(1);
+  const std::vector<uint8_t> payload = RandomBytes(rng, 6 << 20);
+  BenchCase("8MB unwrapped", reference::EncodeBase64(payload, 0), options.iterations);
+  BenchCase("8MB CRLF every 76", reference::EncodeBase64(payload, 76), options.iterations);
+  return 0;
+}
+
+}  // namespace vibe::bench
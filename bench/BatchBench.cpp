@@ -0,0 +1,128 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ThumbnailPipeline.h"
+#include "VibeCorpus.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr uint32_t kCx = 256;
+
+struct Job {
+  std::string name;
+  std::string contents;
+  std::vector<uint8_t> expected;
+  std::vector<uint8_t> got;
+};
+
+ThumbnailStatus Render(const std::string& contents, ImageDecoder& decoder,
+                       std::vector<uint8_t>* pixels) {
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    pixels->assign(*stride * height, 0);
+    return pixels->data();
+  };
+  MemoryByteSource source(contents);
+  return RenderThumbnail(source, kCx, decoder, allocate);
+}
+
+ImageDecoder& ThreadDecoder() {
+  thread_local std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  return *decoder;
+}
+
+// Renders every job on |pool| the way naiv4vibe_thumbs schedules them: dealt smallest first, so
+// each worker starts on its largest.
+void RenderAll(WorkStealingPool& pool, std::vector<Job>& jobs, std::atomic<int>* failures) {
+  for (Job& job : jobs) {
+    pool.Submit([&job, failures] {
+      if (Render(job.contents, ThreadDecoder(), &job.got) != ThumbnailStatus::kOk) {
+        failures->fetch_add(1);
+      }
+    });
+  }
+  pool.Wait();
+}
+
+// Tasks that submit tasks, several levels deep: every one must run exactly once and Wait() must
+// not return before the last of them.
+bool VerifyNested(WorkStealingPool& pool) {
+  std::atomic<int> ran{0};
+  std::function<void(int)> spawn = [&](int depth) {
+    ran.fetch_add(1);
+    if (depth == 0) return;
+    for (int i = 0; i < 4; ++i) pool.Submit([&spawn, depth] { spawn(depth - 1); });
+  };
+  for (int i = 0; i < 8; ++i) pool.Submit([&spawn] { spawn(4); });
+  pool.Wait();
+  // 8 roots, each a full 4-ary tree of depth 4: 1 + 4 + 16 + 64 + 256 tasks.
+  const int expected = 8 * 341;
+  if (ran.load() != expected) {
+    std::printf("FAILED: nested tasks ran %d times, expected %d\n", ran.load(), expected);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int RunBatchBench(const BenchOptions& options) {
+  std::vector<Job> jobs;
+  size_t total_bytes = 0;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    Job job{std::string(spec.name), GenerateCorpusFile(spec).contents, {}, {}};
+    if (Render(job.contents, ThreadDecoder(), &job.expected) != ThumbnailStatus::kOk) {
+      std::printf("FAILED: %s: sequential render\n", job.name.c_str());
+      return 1;
+    }
+    total_bytes += job.contents.size();
+    jobs.push_back(std::move(job));
+  }
+  std::sort(jobs.begin(), jobs.end(),
+            [](const Job& a, const Job& b) { return a.contents.size() < b.contents.size(); });
+
+  const unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+  WorkStealingPool pool(threads);
+  int failures = 0;
+  std::atomic<int> render_failures{0};
+  RenderAll(pool, jobs, &render_failures);
+  for (const Job& job : jobs) {
+    if (job.got != job.expected) {
+      std::printf("FAILED: %s: pool render differs from the sequential one\n", job.name.c_str());
+      ++failures;
+    }
+  }
+  if (render_failures.load() != 0) ++failures;
+  if (!VerifyNested(pool)) ++failures;
+
+  PrintBenchHeader("batch");
+  PrintBenchRow("corpus sequential", MeasureBench(total_bytes, options.iterations, [&] {
+                  for (Job& job : jobs) Render(job.contents, ThreadDecoder(), &job.got);
+                }));
+  PrintBenchRow("corpus pool x" + std::to_string(threads),
+                MeasureBench(total_bytes, options.iterations,
+                             [&] { RenderAll(pool, jobs, &render_failures); }));
+  std::printf("%zu files per run, %llu steals\n", jobs.size(),
+              static_cast<unsigned long long>(pool.steals()));
+
+  if (failures != 0) {
+    std::printf("FAILED: %d batch checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
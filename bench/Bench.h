@@ -0,0 +1,28 @@
+#pragma once
+
+namespace vibe::bench {
+
+struct BenchOptions {
+  int iterations = 20;
+};
+
+// Each suite verifies its kernels against a reference before timing them and returns non-zero
+// when the verification fails.
+int RunJsonStringBench(const BenchOptions& options);
+int RunBase64Bench(const BenchOptions& options);
+int RunScaleBench(const BenchOptions& options);
+int RunPipelineBench(const BenchOptions& options);
+int RunMemoryBench(const BenchOptions& options);
+int RunCacheBench(const BenchOptions& options);
+int RunStoreBench(const BenchOptions& options);
+int RunBatchBench(const BenchOptions& options);
+int RunParallelBench(const BenchOptions& options);
+int RunHostileBench(const BenchOptions& options);
+int RunSkipBench(const BenchOptions& options);
+int RunContainerBench(const BenchOptions& options);
+int RunLayoutBench(const BenchOptions& options);
+int RunFormatBench(const BenchOptions& options);
+int RunAlphaBench(const BenchOptions& options);
+int RunDeadlineBench(const BenchOptions& options);
+
+}  // namespace vibe::bench
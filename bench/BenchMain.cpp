@@ -0,0 +1,85 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <string_view>
+
+namespace vibe::bench {
+
+const void* volatile g_bench_sink = nullptr;
+
+}  // namespace vibe::bench
+
+namespace {
+
+struct Suite {
+  std::string_view name;
+  int (*run)(const vibe::bench::BenchOptions&);
+};
+
+constexpr Suite kSuites[] = {
+    {"json-string", vibe::bench::RunJsonStringBench},
+    {"base64", vibe::bench::RunBase64Bench},
+    {"scale", vibe::bench::RunScaleBench},
+    {"pipeline", vibe::bench::RunPipelineBench},
+    {"memory", vibe::bench::RunMemoryBench},
+    {"cache", vibe::bench::RunCacheBench},
+    {"store", vibe::bench::RunStoreBench},
+    {"batch", vibe::bench::RunBatchBench},
+    {"parallel", vibe::bench::RunParallelBench},
+    {"hostile", vibe::bench::RunHostileBench},
+    {"skip", vibe::bench::RunSkipBench},
+    {"container", vibe::bench::RunContainerBench},
+    {"layout", vibe::bench::RunLayoutBench},
+    {"format", vibe::bench::RunFormatBench},
+    {"alpha", vibe::bench::RunAlphaBench},
+    {"deadline", vibe::bench::RunDeadlineBench},
+};
+
+void PrintUsage() {
+  std::printf("usage: naiv4vibe_bench [--iterations N] [suite...]\nsuites:");
+  for (const Suite& suite : kSuites) {
+    std::printf(" %.*s", static_cast<int>(suite.name.size()), suite.name.data());
+  }
+  std::printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  vibe::bench::BenchOptions options;
+  bool selected[std::size(kSuites)] = {};
+  bool any_selected = false;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--iterations" && i + 1 < argc) {
+      options.iterations = std::max(1, std::atoi(argv[++i]));
+      continue;
+    }
+
+    bool matched = false;
+    for (size_t s = 0; s < std::size(kSuites); ++s) {
+      if (kSuites[s].name == arg) {
+        selected[s] = true;
+        any_selected = true;
+        matched = true;
+      }
+    }
+    if (!matched) {
+      PrintUsage();
+      return 2;
+    }
+  }
+
+  int failures = 0;
+  for (size_t s = 0; s < std::size(kSuites); ++s) {
+    if (any_selected && !selected[s]) continue;
+    if (kSuites[s].run(options) != 0) ++failures;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+namespace vibe::bench {
+
+struct BenchStats {
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+  double mb_per_s = 0.0;
+};
+
+// Runs |fn| |iterations| times after one warm-up call and summarizes the per-call latency.
+// |bytes| is the amount of input one call processes and drives the throughput column.
+template <typename Fn>
+BenchStats MeasureBench(size_t bytes, int iterations, Fn&& fn) {
+  fn();
+
+  std::vector<double> samples;
+  samples.reserve(static_cast<size_t>(iterations));
+  for (int i = 0; i < iterations; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const auto stop = std::chrono::steady_clock::now();
+    samples.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+
+  BenchStats stats;
+  if (samples.empty()) return stats;
+  stats.p50_ms = samples[samples.size() / 2];
+  stats.p99_ms = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+  if (stats.p50_ms > 0.0) {
+    stats.mb_per_s = (static_cast<double>(bytes) / (1024.0 * 1024.0)) / (stats.p50_ms / 1000.0);
+  }
+  return stats;
+}
+
+inline void PrintBenchHeader(std::string_view suite) {
+  std::printf("\n== %.*s ==\n", static_cast<int>(suite.size()), suite.data());
+  std::printf("%-44s %12s %12s %12s\n", "case", "p50 ms", "p99 ms", "MB/s");
+}
+
+inline void PrintBenchRow(std::string_view name, const BenchStats& stats) {
+  std::printf("%-44.*s %12.3f %12.3f %12.1f\n", static_cast<int>(name.size()), name.data(),
+              stats.p50_ms, stats.p99_ms, stats.mb_per_s);
+}
+
+extern const void* volatile g_bench_sink;
+
+// Keeps the optimizer from discarding a result that is otherwise unused.
+template <typename T>
+void DoNotOptimize(const T& value) {
+  g_bench_sink = &value;
+}
+
+}  // namespace vibe::bench
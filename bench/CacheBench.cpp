@@ -0,0 +1,203 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailPipeline.h"
+#include "VibeCorpus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr std::string_view kFiles[] = {"thumb-64k", "thumb-image-1m", "jpeg-thumb-image-4m",
+                                       "big-thumb-image-4m", "small-thumb-image-1m"};
+constexpr uint32_t kSizes[] = {96, 256, 1024};
+// Sizes derived from a larger cached thumbnail are resampled twice; fresh renders once.
+constexpr double kMaxDerivedError = 2.0;
+
+struct Thumbnail {
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+};
+
+ThumbnailStatus Render(const std::string& contents, uint32_t cx, ImageDecoder& decoder,
+                       ThumbnailCache* cache, Thumbnail* thumbnail) {
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    thumbnail->size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    thumbnail->pixels.assign(*stride * height, 0);
+    return thumbnail->pixels.data();
+  };
+  MemoryByteSource source(contents);
+  return RenderThumbnail(source, cx, decoder, allocate, DecodeLimits(), cache);
+}
+
+// Mean absolute difference per channel, or a large value when the sizes differ.
+double MeanError(const Thumbnail& a, const Thumbnail& b) {
+  if (a.size.width != b.size.width || a.size.height != b.size.height) return 1e9;
+  uint64_t total = 0;
+  for (size_t i = 0; i < a.pixels.size(); ++i) {
+    total += static_cast<uint64_t>(std::abs(a.pixels[i] - b.pixels[i]));
+  }
+  return a.pixels.empty() ? 0.0 : static_cast<double>(total) / a.pixels.size();
+}
+
+struct Case {
+  std::string name;
+  std::string contents;
+  uint32_t cx = 0;
+  Thumbnail expected;
+};
+
+// One uncached render per file and size: what every cached answer is compared to.
+std::vector<Case> BuildCases(ImageDecoder& decoder) {
+  std::vector<Case> cases;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    if (std::find(std::begin(kFiles), std::end(kFiles), spec.name) == std::end(kFiles)) continue;
+    const CorpusFile file = GenerateCorpusFile(spec);
+    for (const uint32_t cx : kSizes) {
+      Case c{std::string(spec.name) + " cx" + std::to_string(cx), file.contents, cx, {}};
+      if (Render(c.contents, cx, decoder, nullptr, &c.expected) != ThumbnailStatus::kOk) {
+        std::printf("FAILED: %s: uncached render\n", c.name.c_str());
+        return {};
+      }
+      cases.push_back(std::move(c));
+    }
+  }
+  return cases;
+}
+
+bool Expect(bool condition, const char* what) {
+  if (!condition) std::printf("FAILED: %s\n", what);
+  return condition;
+}
+
+// Walks one payload through a miss, an exact hit, a derived size and a hit on the derived size,
+// and checks that a file differing only outside the payload shares its entries.
+bool VerifySequence(const std::vector<Case>& cases, ImageDecoder& decoder) {
+  const auto find = [&](std::string_view name) -> const Case* {
+    for (const Case& c : cases) {
+      if (c.name == name) return &c;
+    }
+    return nullptr;
+  };
+  const Case* large = find("big-thumb-image-4m cx1024");
+  const Case* small = find("big-thumb-image-4m cx256");
+  if (!Expect(large && small, "sequence cases missing")) return false;
+
+  ThumbnailCache cache(size_t{64} << 20);
+  Thumbnail got;
+  bool ok = true;
+  ok &= Expect(Render(large->contents, 1024, decoder, &cache, &got) == ThumbnailStatus::kOk &&
+                   MeanError(got, large->expected) == 0.0,
+               "first render differs from the uncached one");
+  ok &= Expect(Render(large->contents, 1024, decoder, &cache, &got) == ThumbnailStatus::kOk &&
+                   MeanError(got, large->expected) == 0.0,
+               "cache hit differs from the render it cached");
+  ok &= Expect(Render(small->contents, 256, decoder, &cache, &got) == ThumbnailStatus::kOk &&
+                   MeanError(got, small->expected) <= kMaxDerivedError,
+               "derived size too far from a fresh render");
+  const Thumbnail derived = got;
+  // Whitespace ahead of the first key moves every byte of the file but not the payload.
+  const std::string moved = "{ " + large->contents.substr(1);
+  ok &= Expect(Render(moved, 256, decoder, &cache, &got) == ThumbnailStatus::kOk &&
+                   MeanError(got, derived) == 0.0,
+               "same payload in another file missed the derived size");
+
+  const ThumbnailCacheStats stats = cache.stats();
+  ok &= Expect(stats.misses == 1 && stats.hits == 2 && stats.derived == 1 &&
+                   stats.insertions == 2 && stats.entries == 1,
+               "sequence counters");
+  return ok;
+}
+
+// |threads| threads render random cases through one cache of |budget| bytes, each with its own
+// decoder, and check every answer against the uncached render.
+bool StressCache(const std::vector<Case>& cases, size_t budget, unsigned threads, int renders) {
+  ThumbnailCache cache(budget);
+  std::atomic<int> failures{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+      std::mt19937 rng(1234 + t);
+      Thumbnail got;
+      for (int i = 0; i < renders; ++i) {
+        const Case& c = cases[rng() % cases.size()];
+        const ThumbnailStatus status = Render(c.contents, c.cx, *decoder, &cache, &got);
+        const double error = MeanError(got, c.expected);
+        if (status != ThumbnailStatus::kOk || error > kMaxDerivedError) {
+          if (failures.fetch_add(1) < 5) {
+            std::printf("FAILED: %s: %s, error %.2f\n", c.name.c_str(),
+                        ThumbnailStatusName(status), error);
+          }
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  const ThumbnailCacheStats stats = cache.stats();
+  const uint64_t lookups = stats.hits + stats.derived + stats.misses;
+  const uint64_t expected = static_cast<uint64_t>(threads) * renders;
+  std::printf("%-44s %12.1f %12.1f %12llu\n",
+              ("stress " + std::to_string(budget >> 20) + " MB x" + std::to_string(threads))
+                  .c_str(),
+              100.0 * stats.hits / std::max<uint64_t>(lookups, 1),
+              100.0 * stats.derived / std::max<uint64_t>(lookups, 1),
+              static_cast<unsigned long long>(stats.evictions));
+  bool ok = Expect(failures.load() == 0, "stress renders");
+  ok &= Expect(lookups == expected, "every render looked the cache up once");
+  ok &= Expect(stats.bytes <= budget, "cache over budget");
+  ok &= Expect(stats.hits + stats.derived > 0, "stress saw no hits");
+  return ok;
+}
+
+}  // namespace
+
+int RunCacheBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  const std::vector<Case> cases = BuildCases(*decoder);
+  if (cases.empty()) return 1;
+
+  int failures = 0;
+  std::printf("\n== cache ==\n");
+  std::printf("%-44s %12s %12s %12s\n", "case", "hit %", "derived %", "evictions");
+  if (!VerifySequence(cases, *decoder)) ++failures;
+  const unsigned threads = std::max(4u, std::thread::hardware_concurrency());
+  // Roomy enough to keep everything, then small enough that shards keep evicting.
+  if (!StressCache(cases, size_t{64} << 20, threads, 60)) ++failures;
+  if (!StressCache(cases, size_t{2} << 20, threads, 60)) ++failures;
+
+  PrintBenchHeader("cache timing");
+  for (const Case& c : cases) {
+    if (c.cx != 256) continue;
+    Thumbnail got;
+    PrintBenchRow(c.name + " uncached", MeasureBench(c.contents.size(), options.iterations, [&] {
+                    Render(c.contents, c.cx, *decoder, nullptr, &got);
+                  }));
+    ThumbnailCache cache(size_t{64} << 20);
+    PrintBenchRow(c.name + " hit", MeasureBench(c.contents.size(), options.iterations, [&] {
+                    Render(c.contents, c.cx, *decoder, &cache, &got);
+                  }));
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d cache checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,185 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailPipeline.h"
+#include "VibeContainer.h"
+#include "VibeCorpus.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr size_t kStreamChunk = 64 * 1024;
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+struct Thumbnail {
+  ThumbnailStatus status = ThumbnailStatus::kOk;
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+
+  bool operator==(const Thumbnail& other) const {
+    return status == other.status && size.width == other.size.width &&
+           size.height == other.size.height && pixels == other.pixels;
+  }
+};
+
+Thumbnail Render(ByteSource& source, uint32_t cx, ImageDecoder& decoder,
+                 ThumbnailCache* cache = nullptr) {
+  Thumbnail thumbnail;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    thumbnail.size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    thumbnail.pixels.assign(*stride * height, 0);
+    return thumbnail.pixels.data();
+  };
+  thumbnail.status = RenderThumbnail(source, cx, decoder, allocate, DecodeLimits(), cache);
+  return thumbnail;
+}
+
+Thumbnail RenderInPlace(const std::string& contents, uint32_t cx, ImageDecoder& decoder,
+                        ThumbnailCache* cache = nullptr) {
+  MemoryByteSource source(contents);
+  return Render(source, cx, decoder, cache);
+}
+
+Thumbnail RenderStreamed(const std::string& contents, uint32_t cx, ImageDecoder& decoder,
+                         bool report_size) {
+  ChunkedMemorySource source(contents, kStreamChunk, report_size);
+  return Render(source, cx, decoder);
+}
+
+// Both directions give back their input byte for byte, and the container renders exactly what
+// the JSON does, in place, streamed with and without a size, and out of the cache.
+bool VerifyFile(const CorpusSpec& spec, ImageDecoder& decoder, std::string* container) {
+  const std::string name(spec.name);
+  const std::string json = GenerateCorpusFile(spec).contents;
+  // Escaped payloads cannot be moved out as raw bytes and come back the same.
+  if (!ConvertJsonToContainer(json, container)) {
+    return Expect(spec.escape_slashes, name + ": not converted");
+  }
+  bool ok = Expect(!spec.escape_slashes, name + ": escaped payload converted");
+  std::string restored;
+  ok &= Expect(ConvertContainerToJson(*container, &restored) && restored == json,
+               name + ": JSON round trip differs");
+  std::string again;
+  ok &= Expect(ConvertJsonToContainer(restored, &again) && again == *container,
+               name + ": container round trip differs");
+  std::printf("%-28s %10zu -> %10zu bytes  %5.1f%%\n", spec.name.data(), json.size(),
+              container->size(), 100.0 * container->size() / json.size());
+
+  const Thumbnail expected = RenderInPlace(json, spec.cx, decoder);
+  ok &= Expect(expected.status == ThumbnailStatus::kOk, name + ": JSON render failed");
+  ok &= Expect(RenderInPlace(*container, spec.cx, decoder) == expected,
+               name + ": container render in place differs");
+  ok &= Expect(RenderStreamed(*container, spec.cx, decoder, true) == expected,
+               name + ": container render streamed differs");
+  ok &= Expect(RenderStreamed(*container, spec.cx, decoder, false) == expected,
+               name + ": container render without a size differs");
+  // JSON read through the magic-byte peek still renders the same.
+  ok &= Expect(RenderStreamed(json, spec.cx, decoder, false) == expected,
+               name + ": JSON render streamed differs");
+  // Each shard must hold a 1024 px thumbnail.
+  ThumbnailCache cache(size_t{64} << 20);
+  RenderInPlace(*container, spec.cx, decoder, &cache);
+  ok &= Expect(RenderInPlace(*container, spec.cx, decoder, &cache) == expected &&
+                   cache.stats().hits == 1,
+               name + ": container render from the cache differs");
+  return ok;
+}
+
+// Cut short or damaged anywhere, a container is refused or decoded like any other bad payload;
+// it never reads out of bounds.
+bool VerifyDamaged(const std::string& container, ImageDecoder& decoder) {
+  bool ok = true;
+  for (size_t size = 0; size < container.size(); size += size < 256 ? 1 : container.size() / 16) {
+    const std::string truncated = container.substr(0, size);
+    ok &= Expect(RenderInPlace(truncated, 256, decoder).status != ThumbnailStatus::kOk &&
+                     RenderStreamed(truncated, 256, decoder, true).status != ThumbnailStatus::kOk,
+                 "container cut at " + std::to_string(size) + " rendered");
+  }
+  // Damage to the magic, the version or the blob count is refused outright; elsewhere in the
+  // header and table it may still leave a payload that decodes.
+  for (size_t at = 0; at < kVibeContainerHeaderSize + 2 * kVibeContainerEntrySize; ++at) {
+    std::string damaged = container;
+    damaged[at] = static_cast<char>(damaged[at] ^ 0x80);
+    const ThumbnailStatus in_place = RenderInPlace(damaged, 256, decoder).status;
+    const ThumbnailStatus streamed = RenderStreamed(damaged, 256, decoder, false).status;
+    if (at >= 16) continue;
+    ok &= Expect(in_place != ThumbnailStatus::kOk && streamed != ThumbnailStatus::kOk,
+                 "damaged byte " + std::to_string(at) + " rendered");
+  }
+  // A length far past the file is only caught against the limits when streaming without a size,
+  // and must be refused before anything is allocated for it.
+  std::string damaged = container;
+  const uint64_t length = uint64_t{512} << 30;
+  for (size_t blob = 0; blob < 2; ++blob) {
+    std::memcpy(&damaged[kVibeContainerHeaderSize + blob * kVibeContainerEntrySize + 24], &length,
+                sizeof(length));
+  }
+  const ThumbnailStatus streamed = RenderStreamed(damaged, 256, decoder, false).status;
+  ok &= Expect(streamed == ThumbnailStatus::kTooLarge,
+               std::string("entries of 512 GiB streamed: ") + ThumbnailStatusName(streamed));
+  ok &= Expect(RenderInPlace(damaged, 256, decoder).status != ThumbnailStatus::kOk,
+               "entries of 512 GiB rendered in place");
+  std::string json;
+  ok &= Expect(!ConvertContainerToJson(container.substr(0, container.size() - 1), &json),
+               "truncated container converted");
+  return ok;
+}
+
+}  // namespace
+
+int RunContainerBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  int failures = 0;
+  std::printf("\n== container sizes ==\n");
+  struct Timed {
+    const CorpusSpec* spec;
+    std::string json;
+    std::string container;
+  };
+  std::vector<Timed> timed;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    std::string container;
+    if (!VerifyFile(spec, *decoder, &container)) ++failures;
+    if (container.empty()) continue;
+    if (timed.empty() && !VerifyDamaged(container, *decoder)) ++failures;
+    timed.push_back({&spec, GenerateCorpusFile(spec).contents, std::move(container)});
+  }
+
+  PrintBenchHeader("container");
+  for (const Timed& t : timed) {
+    const std::string name(t.spec->name);
+    const uint32_t cx = t.spec->cx;
+    PrintBenchRow(name + " json", MeasureBench(t.json.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderInPlace(t.json, cx, *decoder));
+                  }));
+    PrintBenchRow(name + " binary", MeasureBench(t.container.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderInPlace(t.container, cx, *decoder));
+                  }));
+    PrintBenchRow(name + " binary streamed",
+                  MeasureBench(t.container.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderStreamed(t.container, cx, *decoder, true));
+                  }));
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d container checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
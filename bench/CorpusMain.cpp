@@ -0,0 +1,55 @@
+#include "VibeCorpus.h"
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+namespace {
+
+void PrintUsage() {
+  std::printf("usage: naiv4vibe_corpus <output-dir> [name...]\nfiles:");
+  for (const vibe::bench::CorpusSpec& spec : vibe::bench::DefaultCorpus()) {
+    std::printf(" %.*s", static_cast<int>(spec.name.size()), spec.name.data());
+  }
+  std::printf("\n");
+}
+
+bool WriteFile(const std::string& path, std::string_view contents) {
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+  if (!file) return false;
+  const bool written = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+  return std::fclose(file) == 0 && written;
+}
+
+}  // namespace
+
+// Writes <output-dir>/<name>.naiv4vibe for every built-in corpus file, or only the named ones.
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage();
+    return 2;
+  }
+
+  const std::string directory = argv[1];
+  int written = 0;
+  for (const vibe::bench::CorpusSpec& spec : vibe::bench::DefaultCorpus()) {
+    bool selected = argc == 2;
+    for (int i = 2; i < argc; ++i) selected |= spec.name == argv[i];
+    if (!selected) continue;
+
+    const vibe::bench::CorpusFile file = vibe::bench::GenerateCorpusFile(spec);
+    const std::string path = directory + "/" + std::string(spec.name) + ".naiv4vibe";
+    if (!WriteFile(path, file.contents)) {
+      std::printf("cannot write %s\n", path.c_str());
+      return 1;
+    }
+    std::printf("%-44s %10zu bytes  cx %4u -> %ux%u\n", path.c_str(), file.contents.size(),
+                spec.cx, file.expected.width, file.expected.height);
+    ++written;
+  }
+  if (written == 0) {
+    PrintUsage();
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,426 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "RenderDeadline.h"
+#include "Scaler.h"
+#include "ThumbnailPipeline.h"
+#include "VibeContainer.h"
+#include "VibeCorpus.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+using std::chrono::milliseconds;
+
+constexpr uint32_t kCx = 1024;
+// Reads of a slow stream, and the wait before each.
+constexpr size_t kSlowChunk = 16 * 1024;
+constexpr auto kSlowDelay = milliseconds(2);
+// What a render may run past its deadline: the clock is only looked at between steps.
+constexpr auto kSlack = milliseconds(30);
+// Bounds the JSON scan, as GetThumbnail does; roomy enough for the slowest stream here.
+constexpr auto kScanTimeout = milliseconds(2000);
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+// A stream that waits before every read, like a file on a slow network share.
+class SlowSource final : public ByteSource {
+ public:
+  SlowSource(std::string_view data, std::chrono::steady_clock::duration delay)
+      : inner_(data, kSlowChunk), delay_(delay) {}
+
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override {
+    std::this_thread::sleep_for(delay_);
+    return inner_.Read(buffer, capacity, bytes_read);
+  }
+  bool SizeHint(uint64_t* size) override { return inner_.SizeHint(size); }
+
+ private:
+  ChunkedMemorySource inner_;
+  std::chrono::steady_clock::duration delay_;
+};
+
+// Pins the cost |costs| predicts for one format, decode scale and filter.
+void Pin(DecodeCostModel& costs, ImageFormat format, uint32_t scale, bool fast,
+         double ns_per_pixel) {
+  constexpr uint32_t kEdge = 1000;
+  for (int i = 0; i < 200; ++i) {
+    costs.Record(format, kEdge, kEdge, scale, fast,
+                 std::chrono::nanoseconds(static_cast<int64_t>(ns_per_pixel * kEdge * kEdge)));
+  }
+}
+
+// Makes every decode of |format| look as slow as |ns_per_pixel|; by default too slow for any
+// deadline here.
+void PinAll(DecodeCostModel& costs, ImageFormat format, double ns_per_pixel = 1000.0) {
+  for (const uint32_t scale : {1u, 2u, 4u, 8u}) {
+    for (const bool fast : {false, true}) Pin(costs, format, scale, fast, ns_per_pixel);
+  }
+}
+
+struct Render {
+  ThumbnailStatus status = ThumbnailStatus::kOk;
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+  std::chrono::steady_clock::duration elapsed{};
+  // The tier counted for the render; kCount when none was.
+  RenderTier tier = RenderTier::kCount;
+};
+
+// Renders |source| with |budget| to spare, when there are |costs| to plan by.
+Render RenderTimed(ByteSource& source, ImageDecoder& decoder, milliseconds budget,
+                   milliseconds reserve, DecodeCostModel* costs) {
+  Render render;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    render.size = {width, height};
+    render.pixels.assign(*stride * height, 0);
+    return render.pixels.data();
+  };
+  uint64_t before[kRenderTierCount];
+  SnapshotRenderTierCounters(before);
+  const auto start = std::chrono::steady_clock::now();
+  RenderDeadline deadline;
+  if (costs) {
+    deadline.deadline = start + budget;
+    deadline.decode_reserve = reserve;
+    deadline.costs = costs;
+  }
+  JsonScanBudget scan;
+  scan.deadline = start + kScanTimeout;
+  render.status = RenderThumbnail(source, kCx, decoder, allocate, DecodeLimits(), nullptr,
+                                  ParallelOptions(), scan, deadline);
+  render.elapsed = std::chrono::steady_clock::now() - start;
+  uint64_t after[kRenderTierCount];
+  SnapshotRenderTierCounters(after);
+  for (size_t i = 0; i < kRenderTierCount; ++i) {
+    if (after[i] != before[i]) render.tier = static_cast<RenderTier>(i);
+  }
+  return render;
+}
+
+Render RenderMapped(std::string_view file, ImageDecoder& decoder, milliseconds budget,
+                    DecodeCostModel* costs) {
+  MemoryByteSource source(file);
+  return RenderTimed(source, decoder, budget, milliseconds(10), costs);
+}
+
+std::string TierName(RenderTier tier) {
+  return tier == RenderTier::kCount ? "none" : RenderTierName(tier);
+}
+
+// Checks how |render| settled and that it kept to |budget|.
+bool ExpectRender(const Render& render, const std::string& name, ThumbnailStatus status,
+                  RenderTier tier, milliseconds budget) {
+  bool ok = Expect(render.status == status,
+                   name + ": " + ThumbnailStatusName(render.status) + ", expected " +
+                       ThumbnailStatusName(status));
+  ok &= Expect(render.tier == tier,
+               name + ": settled as " + TierName(render.tier) + ", expected " + TierName(tier));
+  const auto took = std::chrono::duration_cast<milliseconds>(render.elapsed);
+  ok &= Expect(render.elapsed <= budget + kSlack,
+               name + ": took " + std::to_string(took.count()) + " ms of " +
+                   std::to_string(budget.count()));
+  return ok;
+}
+
+struct Files {
+  // A small PNG "thumbnail" and a large PNG "image", in the usual order.
+  CorpusFile png_pair;
+  // The same, with the large "image" first.
+  CorpusFile png_pair_image_first;
+  // A small PNG "thumbnail" behind 3 MB of "encodings".
+  CorpusFile metadata_first;
+  CorpusFile jpeg_image;
+  CorpusFile png_image;
+  CorpusFile small_png_image;
+};
+
+Files MakeFiles() {
+  const CorpusSpec pair{.name = "deadline-png-pair", .thumbnail = {256, 192},
+                        .image = {2048, 1536}, .cx = kCx};
+  CorpusSpec image_first = pair;
+  image_first.image_first = true;
+  const CorpusSpec jpeg{.name = "deadline-jpeg", .image = {2048, 1536},
+                        .format = CorpusImageFormat::kJpeg, .cx = kCx};
+  const CorpusSpec metadata_first{.name = "deadline-metadata-first", .target_bytes = 3 << 20,
+                                  .thumbnail = {256, 192}, .metadata_first = true, .cx = kCx};
+  const CorpusSpec png{.name = "deadline-png", .image = {2048, 1536}, .cx = kCx};
+  const CorpusSpec small_png{.name = "deadline-small-png", .image = {256, 192}, .cx = kCx};
+  return {GenerateCorpusFile(pair),           GenerateCorpusFile(image_first),
+          GenerateCorpusFile(metadata_first), GenerateCorpusFile(jpeg),
+          GenerateCorpusFile(png),            GenerateCorpusFile(small_png)};
+}
+
+// With time to spare a timed render is the untimed one; short of it, the planner steps down one
+// tier at a time as the pinned costs rule each out, and still renders when nothing fits.
+bool VerifyPlans(const Files& files, ImageDecoder& decoder) {
+  bool ok = true;
+  const milliseconds budget(150);
+
+  for (const CorpusFile* file : {&files.png_pair, &files.jpeg_image}) {
+    DecodeCostModel costs;
+    const Render untimed = RenderMapped(file->contents, decoder, budget, nullptr);
+    const Render timed = RenderMapped(file->contents, decoder, milliseconds(10000), &costs);
+    ok &= Expect(untimed.status == ThumbnailStatus::kOk && untimed.tier == RenderTier::kCount,
+                 "untimed render failed or was counted");
+    ok &= ExpectRender(timed, "generous deadline", ThumbnailStatus::kOk, RenderTier::kFull,
+                       milliseconds(10000));
+    ok &= Expect(timed.pixels == untimed.pixels, "generous deadline: render differs");
+  }
+
+  const ImageSize full = ComputeThumbnailSize(2048, 1536, kCx);
+  {
+    DecodeCostModel costs;
+    Pin(costs, ImageFormat::kPng, 1, false, 1000.0);
+    const Render render = RenderMapped(files.png_pair.contents, decoder, budget, &costs);
+    ok &= ExpectRender(render, "slow image", ThumbnailStatus::kOk, RenderTier::kSmallerSource,
+                       budget);
+    const ImageSize expected = ComputeThumbnailSize(256, 192, kCx);
+    ok &= Expect(render.size.width == expected.width && render.size.height == expected.height,
+                 "slow image: thumbnail not rendered from the smaller payload");
+
+    std::string container;
+    ok &= Expect(ConvertJsonToContainer(files.png_pair.contents, &container),
+                 "container conversion failed");
+    const Render boxed = RenderMapped(container, decoder, budget, &costs);
+    ok &= ExpectRender(boxed, "slow image, container", ThumbnailStatus::kOk,
+                       RenderTier::kSmallerSource, budget);
+    ok &= Expect(boxed.pixels == render.pixels, "slow image, container: render differs");
+  }
+  {
+    DecodeCostModel costs;
+    for (const uint32_t scale : {1u, 2u, 4u}) Pin(costs, ImageFormat::kJpeg, scale, false, 1000.0);
+    Pin(costs, ImageFormat::kJpeg, 8, false, 5.0);
+    const Render render = RenderMapped(files.jpeg_image.contents, decoder, budget, &costs);
+    ok &= ExpectRender(render, "slow JPEG decode", ThumbnailStatus::kOk,
+                       RenderTier::kReducedDecode, budget);
+    ok &= Expect(render.size.width == full.width && render.size.height == full.height,
+                 "slow JPEG decode: thumbnail not at the requested size");
+  }
+  {
+    DecodeCostModel costs;
+    PinAll(costs, ImageFormat::kJpeg);
+    Pin(costs, ImageFormat::kJpeg, 8, true, 5.0);
+    const Render render = RenderMapped(files.jpeg_image.contents, decoder, budget, &costs);
+    ok &= ExpectRender(render, "slow JPEG scale", ThumbnailStatus::kOk, RenderTier::kFastScale,
+                       budget);
+    ok &= Expect(render.size.width == full.width && render.size.height == full.height,
+                 "slow JPEG scale: thumbnail not at the requested size");
+  }
+  {
+    DecodeCostModel costs;
+    PinAll(costs, ImageFormat::kPng);
+    const Render render = RenderMapped(files.png_image.contents, decoder, budget, &costs);
+    // The cheapest render has no deadline left to keep, only the scan's.
+    ok &= ExpectRender(render, "slow PNG only", ThumbnailStatus::kOk, RenderTier::kOverrun,
+                       kScanTimeout);
+    ok &= Expect(render.size.width == full.width && render.size.height == full.height,
+                 "slow PNG only: thumbnail not at the requested size");
+  }
+  return ok;
+}
+
+// Estimates that rule every tier out still get corrected: the cheapest render that runs instead
+// teaches the model what it costs, until the fast filter fits, and the full render is tried every
+// kProbeInterval degraded plans when it is estimated within the probe's bound. No render, probe
+// or not, runs past kProbeOverrun times the budget.
+bool VerifyRecovery(const Files& files, ImageDecoder& decoder) {
+  bool ok = true;
+  const milliseconds budget(20);
+  // 256x192 pixels at 700 ns each is estimated at 1.7 times the budget, within the probe's
+  // bound; at 1000 ns, 2.5 times, past it.
+  const struct {
+    double ns_per_pixel;
+    bool probed;
+  } kCases[] = {{700.0, true}, {1000.0, false}};
+  for (const auto& c : kCases) {
+    const std::string name = "recovery at " + std::to_string(static_cast<int>(c.ns_per_pixel)) +
+                             " ns/px: ";
+    DecodeCostModel costs;
+    PinAll(costs, ImageFormat::kPng, c.ns_per_pixel);
+    uint32_t counts[kRenderTierCount] = {};
+    std::chrono::steady_clock::duration slowest{};
+    for (uint32_t i = 1; i <= 2 * DecodeCostModel::kProbeInterval; ++i) {
+      const Render render = RenderMapped(files.small_png_image.contents, decoder, budget, &costs);
+      ok &= Expect(render.status == ThumbnailStatus::kOk,
+                   name + "render " + std::to_string(i) + " failed");
+      slowest = std::max(slowest, render.elapsed);
+      if (render.tier == RenderTier::kCount) continue;
+      ++counts[static_cast<size_t>(render.tier)];
+      if (i == 1) ok &= Expect(render.tier == RenderTier::kOverrun, name + "first render fit");
+      if (c.probed && i == DecodeCostModel::kProbeInterval) {
+        ok &= Expect(render.tier == RenderTier::kFull, name + "full render not probed");
+      }
+    }
+    // Past the bound, no number of degraded renders lets a probe through.
+    const uint32_t full = counts[static_cast<size_t>(RenderTier::kFull)];
+    ok &= Expect(c.probed ? full != 0 : full == 0,
+                 name + std::to_string(full) + " full renders");
+    ok &= Expect(counts[static_cast<size_t>(RenderTier::kFastScale)] != 0,
+                 name + "the fast filter never came to fit");
+    ok &= Expect(slowest <= budget * DecodeCostModel::kProbeOverrun + kSlack,
+                 name + "a render took " +
+                     std::to_string(std::chrono::duration_cast<milliseconds>(slowest).count()) +
+                     " ms");
+  }
+  return ok;
+}
+
+// A stream too slow to read to the end: reading stops short of the deadline, and a thumbnail
+// read by then stands in for the image still arriving. When no field has arrived by then,
+// reading goes on within the scan budget and the first field to arrive is rendered the cheapest
+// way.
+bool VerifyStreams(const Files& files, ImageDecoder& decoder) {
+  bool ok = true;
+  const milliseconds budget(200);
+  const milliseconds reserve(50);
+  DecodeCostModel costs;
+
+  SlowSource pair(files.png_pair.contents, kSlowDelay);
+  const Render render = RenderTimed(pair, decoder, budget, reserve, &costs);
+  ok &= ExpectRender(render, "slow stream", ThumbnailStatus::kOk, RenderTier::kSmallerSource,
+                     budget);
+
+  const struct {
+    const char* name;
+    const CorpusFile* file;
+  } kLate[] = {
+      {"slow stream, metadata first", &files.metadata_first},
+      {"slow stream, image first", &files.png_pair_image_first},
+  };
+  for (const auto& [name, file] : kLate) {
+    SlowSource late(file->contents, kSlowDelay);
+    const Render render = RenderTimed(late, decoder, budget, reserve, &costs);
+    ok &= ExpectRender(render, name, ThumbnailStatus::kOk, RenderTier::kOverrun, kScanTimeout);
+  }
+  return ok;
+}
+
+// Straight-alpha BGRA with a gradient across and down.
+std::vector<uint8_t> Gradient(uint32_t width, uint32_t height) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+      pixel[0] = static_cast<uint8_t>(x * 255 / width);
+      pixel[1] = static_cast<uint8_t>(y * 255 / height);
+      pixel[2] = static_cast<uint8_t>((x + y) * 255 / (width + height));
+      pixel[3] = static_cast<uint8_t>(128 + (x & 127));
+    }
+  }
+  return pixels;
+}
+
+std::vector<uint8_t> Scale(const std::vector<uint8_t>& source, ImageSize from, ImageSize to,
+                           ScaleFilter filter) {
+  std::vector<uint8_t> dest(static_cast<size_t>(to.width) * to.height * 4);
+  ScaleToPremultipliedBgra(source.data(), from.width, from.height,
+                           static_cast<size_t>(from.width) * 4, dest.data(), to.width, to.height,
+                           static_cast<size_t>(to.width) * 4, filter);
+  return dest;
+}
+
+// The fast filter is bilinear where that already takes two taps, enlarging or at the same size,
+// and keeps a flat image flat however far it reduces it.
+bool VerifyFastFilter() {
+  bool ok = true;
+  const ImageSize source{64, 48};
+  const std::vector<uint8_t> gradient = Gradient(source.width, source.height);
+  for (const ImageSize dest : {ImageSize{64, 48}, ImageSize{96, 72}, ImageSize{200, 50}}) {
+    ok &= Expect(Scale(gradient, source, dest, ScaleFilter::kFast) ==
+                     Scale(gradient, source, dest, ScaleFilter::kBilinear),
+                 "fast filter differs from bilinear at " + std::to_string(dest.width) + "x" +
+                     std::to_string(dest.height));
+  }
+
+  const ImageSize large{2048, 1536};
+  std::vector<uint8_t> flat(static_cast<size_t>(large.width) * large.height * 4);
+  for (size_t i = 0; i < flat.size(); i += 4) {
+    flat[i] = 40;
+    flat[i + 1] = 120;
+    flat[i + 2] = 200;
+    flat[i + 3] = 255;
+  }
+  const std::vector<uint8_t> reduced = Scale(flat, large, {256, 192}, ScaleFilter::kFast);
+  bool uniform = true;
+  for (size_t i = 0; i < reduced.size(); i += 4) {
+    uniform &= reduced[i] == 40 && reduced[i + 1] == 120 && reduced[i + 2] == 200 &&
+               reduced[i + 3] == 255;
+  }
+  ok &= Expect(uniform, "fast filter does not keep a flat image flat");
+  return ok;
+}
+
+}  // namespace
+
+int RunDeadlineBench(const BenchOptions& options) {
+  int failures = 0;
+  if (!VerifyFastFilter()) ++failures;
+  const Files files = MakeFiles();
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  if (!VerifyPlans(files, *decoder)) ++failures;
+  if (!VerifyRecovery(files, *decoder)) ++failures;
+  if (!VerifyStreams(files, *decoder)) ++failures;
+
+  PrintBenchHeader("deadline");
+  const ImageSize large{2048, 1536};
+  const std::vector<uint8_t> gradient = Gradient(large.width, large.height);
+  const size_t gradient_bytes = gradient.size();
+  for (const ScaleFilter filter : {ScaleFilter::kAuto, ScaleFilter::kFast}) {
+    PrintBenchRow(std::string("scale 2048x1536 -> 256 ") +
+                      (filter == ScaleFilter::kFast ? "fast" : "auto"),
+                  MeasureBench(gradient_bytes, options.iterations, [&] {
+                    DoNotOptimize(Scale(gradient, large, {256, 192}, filter));
+                  }));
+  }
+
+  // Each timed row keeps its cost model across iterations, as a process would.
+  const struct {
+    const char* name;
+    const CorpusFile* file;
+    int budget_ms;
+  } kRows[] = {
+      {"png pair", &files.png_pair, 0},
+      {"png pair, 50 ms", &files.png_pair, 50},
+      {"jpeg image", &files.jpeg_image, 0},
+      {"jpeg image, 20 ms", &files.jpeg_image, 20},
+      {"png image, 50 ms", &files.png_image, 50},
+  };
+  for (const auto& row : kRows) {
+    DecodeCostModel costs;
+    DecodeCostModel* model = row.budget_ms != 0 ? &costs : nullptr;
+    PrintBenchRow(row.name, MeasureBench(row.file->contents.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderMapped(row.file->contents, *decoder,
+                                               milliseconds(row.budget_ms), model));
+                  }));
+  }
+  PrintBenchRow("slow stream png pair, 200 ms",
+                MeasureBench(files.png_pair.contents.size(), options.iterations, [&] {
+                  DecodeCostModel costs;
+                  SlowSource source(files.png_pair.contents, kSlowDelay);
+                  DoNotOptimize(RenderTimed(source, *decoder, milliseconds(200), milliseconds(50),
+                                            &costs));
+                }));
+
+  if (failures != 0) {
+    std::printf("FAILED: %d deadline checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,327 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ImageFormat.h"
+#include "JpegEncoder.h"
+#include "PngEncoder.h"
+#include "ReferenceBase64.h"
+#include "ThumbnailPipeline.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr uint32_t kWidth = 640;
+constexpr uint32_t kHeight = 480;
+constexpr uint32_t kCx = 96;
+// Decoder setups per timed call; one alone is too quick to time.
+constexpr int kRepeats = 1000;
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+// The bytes of a literal, embedded zeros included.
+template <size_t N>
+std::vector<uint8_t> Bytes(const char (&text)[N]) {
+  return std::vector<uint8_t>(text, text + N - 1);
+}
+
+// Stops the decode as soon as the header is parsed: what opening the first frame costs.
+class FirstFrameSink final : public ImageRowSink {
+ public:
+  DecodeStatus Begin(const ImageLayout& layout) override {
+    width = layout.source_width;
+    return DecodeStatus::kUnsupported;
+  }
+  void PushRow(const uint8_t* row) override { (void)row; }
+
+  uint32_t width = 0;
+};
+
+// Notes the format the pipeline asks for before handing the payload on, in place or still
+// encoded.
+class RecordingDecoder final : public ImageDecoder {
+ public:
+  RecordingDecoder(ImageDecoder& inner, bool base64) : inner_(inner), base64_(base64) {}
+
+  const char* name() const override { return "recording"; }
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override {
+    requested = format;
+    return inner_.DecodeRows(data, format, min_long_edge, sink);
+  }
+
+  bool decodes_base64() const override { return base64_; }
+  DecodeStatus DecodeBase64Rows(std::string_view encoded, ImageFormat format,
+                                uint32_t min_long_edge, ImageRowSink* sink) override {
+    requested = format;
+    std::vector<uint8_t> data;
+    reference::DecodeBase64(encoded, &data);
+    return inner_.DecodeRows(data, format, min_long_edge, sink);
+  }
+
+  ImageFormat requested = ImageFormat::kUnknown;
+
+ private:
+  ImageDecoder& inner_;
+  bool base64_;
+};
+
+// Asked for a reduced frame, hands over the full one instead: what the WIC decoder does when the
+// codec's transform fails after a reduced size was chosen.
+class TransformFailingDecoder final : public ImageDecoder {
+ public:
+  explicit TransformFailingDecoder(ImageDecoder& inner) : inner_(inner) {}
+
+  const char* name() const override { return "transform-failing"; }
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override {
+    if (min_long_edge != 0) ++failed_transforms;
+    return inner_.DecodeRows(data, format, 0, sink);
+  }
+
+  int failed_transforms = 0;
+
+ private:
+  ImageDecoder& inner_;
+};
+
+struct Sample {
+  ImageFormat format;
+  std::vector<uint8_t> bytes;
+};
+
+std::vector<Sample> EncodeSamples() {
+  std::mt19937 rng(23);
+  std::vector<uint8_t> pixels(static_cast<size_t>(kWidth) * kHeight * 4);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = static_cast<uint8_t>((i / 4 % kWidth) + (rng() & 15));
+  }
+  std::vector<Sample> samples;
+  samples.push_back({ImageFormat::kPng, EncodePng(pixels.data(), kWidth, kHeight, kWidth * 4)});
+  samples.push_back(
+      {ImageFormat::kJpeg, EncodeJpeg(pixels.data(), kWidth, kHeight, kWidth * 4, 90)});
+  return samples;
+}
+
+// Every signature is told apart from the others, short or damaged headers are not taken for
+// anything, and data URL types are read case-insensitively.
+bool VerifyDetection() {
+  bool ok = true;
+  const struct {
+    std::vector<uint8_t> header;
+    ImageFormat format;
+  } kHeaders[] = {
+      {{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13}, ImageFormat::kPng},
+      {{0xFF, 0xD8, 0xFF, 0xE0, 0, 16, 'J', 'F', 'I', 'F', 0, 1}, ImageFormat::kJpeg},
+      {Bytes("RIFF\x24\0\0\0WEBPVP8 "), ImageFormat::kWebp},
+      {Bytes("GIF89a\x01\0\x01\0\0\0"), ImageFormat::kGif},
+      {Bytes("GIF87a\x01\0\x01\0\0\0"), ImageFormat::kGif},
+      {Bytes("BM\x3A\0\0\0\0\0\0\0\x36\0"), ImageFormat::kBmp},
+      {Bytes("BM\x3A\0\0\0\x01\0\0\0\x36\0"), ImageFormat::kUnknown},
+      {Bytes("RIFF\x24\0\0\0WAVEfmt "), ImageFormat::kUnknown},
+      {{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A}, ImageFormat::kUnknown},
+      {Bytes("{\"identifier\""), ImageFormat::kUnknown},
+      {{}, ImageFormat::kUnknown},
+  };
+  for (const auto& header : kHeaders) {
+    const ImageFormat sniffed = SniffImageFormat(header.header);
+    ok &= Expect(sniffed == header.format,
+                 std::string("sniffed ") + ImageFormatName(sniffed) + ", expected " +
+                     ImageFormatName(header.format));
+  }
+
+  const struct {
+    std::string_view payload;
+    ImageFormat format;
+  } kUrls[] = {
+      {"data:image/png;base64,iVBO", ImageFormat::kPng},
+      {"data:image/jpeg;base64,/9j/", ImageFormat::kJpeg},
+      {"data:image/jpg;base64,/9j/", ImageFormat::kJpeg},
+      {"data:image/webp;base64,UklG", ImageFormat::kWebp},
+      {"data:image/gif;base64,R0lG", ImageFormat::kGif},
+      {"data:image/bmp;base64,Qk0", ImageFormat::kBmp},
+      {"DATA:Image/PNG;base64,iVBO", ImageFormat::kPng},
+      {"data:image/png,iVBO", ImageFormat::kPng},
+      {"data:image/tiff;base64,SUkq", ImageFormat::kUnknown},
+      {"data:image/pngx;base64,iVBO", ImageFormat::kUnknown},
+      {"data:image/png", ImageFormat::kUnknown},
+      {"iVBORw0KGgo", ImageFormat::kUnknown},
+  };
+  for (const auto& url : kUrls) {
+    const ImageFormat format = ImageFormatFromDataUrl(url.payload);
+    ok &= Expect(format == url.format, std::string(url.payload) + ": " + ImageFormatName(format));
+  }
+
+  for (size_t i = 1; i < kImageFormatCount; ++i) {
+    const ImageFormat format = static_cast<ImageFormat>(i);
+    const char* mime = ImageFormatMimeType(format);
+    ok &= Expect(mime && ImageFormatFromDataUrl(std::string("data:") + mime + ";base64,") ==
+                             format,
+                 std::string(ImageFormatName(format)) + ": MIME type does not round-trip");
+  }
+  ok &= Expect(!ImageFormatMimeType(ImageFormat::kUnknown), "unknown format has a MIME type");
+  return ok;
+}
+
+struct Render {
+  ThumbnailStatus status = ThumbnailStatus::kOk;
+  std::vector<uint8_t> pixels;
+};
+
+Render RenderJson(const std::string& json, bool streamed, ImageDecoder& decoder) {
+  Render render;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    render.pixels.assign(*stride * height, 0);
+    return render.pixels.data();
+  };
+  if (streamed) {
+    ChunkedMemorySource source(json, 4096);
+    render.status = RenderThumbnail(source, kCx, decoder, allocate);
+  } else {
+    MemoryByteSource source(json);
+    render.status = RenderThumbnail(source, kCx, decoder, allocate);
+  }
+  return render;
+}
+
+// A data URL that names the wrong type must not steer the decoder wrong: the payload's own
+// signature wins, on the in-place path and on the one that hands the payload over encoded.
+bool VerifyPipeline(const std::vector<Sample>& samples, ImageDecoder& portable) {
+  bool ok = true;
+  for (const Sample& sample : samples) {
+    const std::string base64 = reference::EncodeBase64(sample.bytes);
+    const std::string name = ImageFormatName(sample.format);
+    const std::string truthful = std::string("data:") + ImageFormatMimeType(sample.format);
+    const std::string lying =
+        sample.format == ImageFormat::kPng ? "data:image/jpeg" : "data:image/png";
+    const std::string expected_json = "{\"thumbnail\":\"" + truthful + ";base64," + base64 + "\"}";
+    const Render expected = RenderJson(expected_json, false, portable);
+    ok &= Expect(expected.status == ThumbnailStatus::kOk, name + ": truthful render failed");
+
+    for (const std::string* prefix : {&lying, &truthful}) {
+      const std::string json = "{\"thumbnail\":\"" + *prefix + ";base64," + base64 + "\"}";
+      for (const bool base64_path : {false, true}) {
+        for (const bool streamed : {false, true}) {
+          RecordingDecoder decoder(portable, base64_path);
+          const Render render = RenderJson(json, streamed, decoder);
+          const std::string what = name + " labelled " + *prefix +
+                                    (base64_path ? ", encoded" : ", in place") +
+                                    (streamed ? ", streamed" : ", mapped");
+          ok &= Expect(decoder.requested == sample.format,
+                       what + ": decoder asked for " + ImageFormatName(decoder.requested));
+          ok &= Expect(render.status == expected.status && render.pixels == expected.pixels,
+                       what + ": render differs");
+        }
+      }
+    }
+
+    // Without a signature to go on, the data URL's type is what the decoder hears.
+    RecordingDecoder decoder(portable, false);
+    const std::string garbage = "{\"thumbnail\":\"" + truthful + ";base64,AAAAAAAAAAAAAAAA\"}";
+    RenderJson(garbage, false, decoder);
+    ok &= Expect(decoder.requested == sample.format,
+                 name + ": unsigned payload decoded as " + ImageFormatName(decoder.requested));
+  }
+  return ok;
+}
+
+// A reduced decode that fails falls back to the full frame, and the thumbnail scaled from it
+// matches the one scaled from the reduced frame to within rounding.
+bool VerifyReducedFallback(const std::vector<Sample>& samples, ImageDecoder& portable) {
+  bool ok = true;
+  for (const Sample& sample : samples) {
+    const std::string name = ImageFormatName(sample.format);
+    const std::string json = "{\"thumbnail\":\"data:" +
+                             std::string(ImageFormatMimeType(sample.format)) + ";base64," +
+                             reference::EncodeBase64(sample.bytes) + "\"}";
+    const Render expected = RenderJson(json, false, portable);
+    TransformFailingDecoder decoder(portable);
+    const Render render = RenderJson(json, false, decoder);
+    ok &= Expect(decoder.failed_transforms != 0, name + ": no reduced frame was asked for");
+    ok &= Expect(render.status == ThumbnailStatus::kOk,
+                 name + ": fallback render " + ThumbnailStatusName(render.status));
+    if (render.pixels.size() != expected.pixels.size()) {
+      ok &= Expect(false, name + ": fallback thumbnail has another size");
+      continue;
+    }
+    uint64_t difference = 0;
+    for (size_t i = 0; i < render.pixels.size(); ++i) {
+      difference += static_cast<uint64_t>(std::abs(render.pixels[i] - expected.pixels[i]));
+    }
+    const double mean = render.pixels.empty() ? 0.0 : static_cast<double>(difference) /
+                                                          static_cast<double>(render.pixels.size());
+    ok &= Expect(mean <= 4.0, name + ": fallback thumbnail differs by " + std::to_string(mean));
+  }
+  return ok;
+}
+
+}  // namespace
+
+int RunFormatBench(const BenchOptions& options) {
+  int failures = 0;
+  if (!VerifyDetection()) ++failures;
+
+  const std::vector<Sample> samples = EncodeSamples();
+  std::unique_ptr<ImageDecoder> cached = CreatePortableImageDecoder();
+  if (!VerifyPipeline(samples, *cached)) ++failures;
+  if (!VerifyReducedFallback(samples, *cached)) ++failures;
+
+  PrintBenchHeader("format");
+  for (const Sample& sample : samples) {
+    const std::string name = ImageFormatName(sample.format);
+    FirstFrameSink sink;
+    cached->DecodeRows(sample.bytes, sample.format, 0, &sink);
+    if (!Expect(sink.width == kWidth, name + ": first frame not reached")) ++failures;
+
+    // Only the headers are read, so there is no meaningful throughput for the setup rows.
+    const size_t bytes = 0;
+    PrintBenchRow(name + " sniff", MeasureBench(kImageSignatureBytes * kRepeats,
+                                                options.iterations, [&] {
+                    for (int i = 0; i < kRepeats; ++i) {
+                      DoNotOptimize(SniffImageFormat({sample.bytes.data(), kImageSignatureBytes}));
+                    }
+                  }));
+    PrintBenchRow(name + " new decoder, first frame",
+                  MeasureBench(bytes, options.iterations, [&] {
+                    for (int i = 0; i < kRepeats; ++i) {
+                      std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+                      DoNotOptimize(decoder->DecodeRows(sample.bytes, ImageFormat::kUnknown, 0,
+                                                        &sink));
+                    }
+                  }));
+    PrintBenchRow(name + " reused decoder, first frame",
+                  MeasureBench(bytes, options.iterations, [&] {
+                    for (int i = 0; i < kRepeats; ++i) {
+                      DoNotOptimize(cached->DecodeRows(sample.bytes, ImageFormat::kUnknown, 0,
+                                                       &sink));
+                    }
+                  }));
+    PrintBenchRow(name + " reused decoder, hinted",
+                  MeasureBench(bytes, options.iterations, [&] {
+                    for (int i = 0; i < kRepeats; ++i) {
+                      DoNotOptimize(cached->DecodeRows(sample.bytes, sample.format, 0, &sink));
+                    }
+                  }));
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d format checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,255 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+#include "PngEncoder.h"
+#include "ReferenceBase64.h"
+#include "ThumbnailPipeline.h"
+#include "VibeCorpus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr uint32_t kCx = 256;
+constexpr std::chrono::milliseconds kDeadline(20);
+// What a budgeted scan may take past its deadline: one check interval of tokens plus scheduling
+// noise.
+constexpr double kDeadlineSlackMs = 30.0;
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+std::string SmallImageField() {
+  std::vector<uint8_t> pixels(64 * 64 * 4);
+  for (size_t i = 0; i < pixels.size(); ++i) pixels[i] = static_cast<uint8_t>(i * 7);
+  return "\"image\":\"" + reference::EncodeBase64(EncodePng(pixels.data(), 64, 64, 64 * 4)) +
+         "\"";
+}
+
+std::string Repeat(std::string_view piece, size_t count) {
+  std::string out;
+  out.reserve(piece.size() * count);
+  for (size_t i = 0; i < count; ++i) out += piece;
+  return out;
+}
+
+struct HostileCase {
+  const char* name;
+  std::string contents;
+  // Fed in 64KB chunks, so truncated containers are rescanned as they grow.
+  bool streamed = false;
+  JsonScanBudget budget;
+  ThumbnailStatus expected = ThumbnailStatus::kBudgetExceeded;
+  // Upper bound for the p99.9 latency; deadline cases are bounded by the deadline instead.
+  double bound_ms = 0.0;
+};
+
+ThumbnailStatus Render(const HostileCase& c, ImageDecoder& decoder, const JsonScanBudget& budget) {
+  std::vector<uint8_t> pixels;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    pixels.assign(*stride * height, 0);
+    return pixels.data();
+  };
+  if (c.streamed) {
+    ChunkedMemorySource source(c.contents, JsonFieldReader::kReadChunk);
+    return RenderThumbnail(source, kCx, decoder, allocate, DecodeLimits(), nullptr,
+                           ParallelOptions(), budget);
+  }
+  MemoryByteSource source(c.contents);
+  return RenderThumbnail(source, kCx, decoder, allocate, DecodeLimits(), nullptr,
+                         ParallelOptions(), budget);
+}
+
+// The deadline is relative, so every call gets a fresh one.
+JsonScanBudget Armed(const JsonScanBudget& budget, bool deadline) {
+  JsonScanBudget armed = budget;
+  if (deadline) armed.deadline = std::chrono::steady_clock::now() + kDeadline;
+  return armed;
+}
+
+std::vector<HostileCase> HostileCases() {
+  const std::string image = SmallImageField();
+  JsonScanBudget unbounded;
+  unbounded.max_tokens = ~uint64_t{0};
+  JsonScanBudget few_bytes;
+  few_bytes.max_bytes = 64 * 1024;
+
+  std::vector<HostileCase> cases;
+  // Nesting past kMaxJsonNestingDepth is refused where it crosses the limit, a million brackets
+  // deep or not.
+  cases.push_back({"deep arrays", "{\"a\":" + Repeat("[", 1 << 20) + "," + image + "}", false,
+                   JsonScanBudget(), ThumbnailStatus::kNoImageField, 50.0});
+  cases.push_back({"deep objects", "{\"a\":" + Repeat("{\"a\":", 1 << 18) + "," + image + "}",
+                   false, JsonScanBudget(), ThumbnailStatus::kNoImageField, 50.0});
+  // Exactly at the limit is still a valid document.
+  const std::string limit = Repeat("[", kMaxJsonNestingDepth) + Repeat("]", kMaxJsonNestingDepth);
+  cases.push_back({"nesting at the limit", "{\"a\":" + limit + "," + image + "}", false,
+                   JsonScanBudget(), ThumbnailStatus::kOk, 50.0});
+  // Numbers are not tokenized when an array is skipped, so a flood of them costs only its bytes.
+  const std::string zeros = "{\"a\":[" + Repeat("0,", 8 << 20) + "0]," + image + "}";
+  cases.push_back({"8M-number array", zeros, false, JsonScanBudget(), ThumbnailStatus::kOk,
+                   250.0});
+  cases.push_back({"8M-number array streamed", zeros, true, JsonScanBudget(),
+                   ThumbnailStatus::kOk, 250.0});
+  const std::string objects = "{\"a\":[" + Repeat("{},", 8 << 20) + "{}]," + image + "}";
+  cases.push_back({"8M empty objects", objects, false, JsonScanBudget(),
+                   ThumbnailStatus::kBudgetExceeded, 500.0});
+  cases.push_back({"8M empty objects streamed", objects, true, JsonScanBudget(),
+                   ThumbnailStatus::kBudgetExceeded, 500.0});
+  cases.push_back({"3M members", "{" + Repeat("\"k\":0,", 3 << 20) + image + "}", false,
+                   JsonScanBudget(), ThumbnailStatus::kBudgetExceeded, 500.0});
+  cases.push_back({"empty objects, deadline", objects, false, unbounded,
+                   ThumbnailStatus::kBudgetExceeded, 0.0});
+  cases.push_back({"streamed, deadline", objects, true, unbounded,
+                   ThumbnailStatus::kBudgetExceeded, 0.0});
+  cases.push_back({"byte budget", "{\"a\":\"" + std::string(1 << 20, 'x') + "\"," + image + "}",
+                   false, few_bytes, ThumbnailStatus::kBudgetExceeded, 50.0});
+  return cases;
+}
+
+// The token walker must accept and refuse exactly what the recursive skipper did; the structural
+// skip only refuses what breaks bracket pairing.
+bool VerifySkipper() {
+  constexpr std::string_view kKeys[] = {"image"};
+  struct Document {
+    std::string_view json;
+    bool valid;
+    bool balanced;
+  };
+  const Document documents[] = {
+      {R"({"a":{"b":[1,-2.5e+3,true,false,null,"s\"\\"],"c":{}},"image":"x"})", true, true},
+      {R"({"a":[[],[[]],{"x":[{}]}],"image":"x"})", true, true},
+      {R"({"a" : [ 1 , { "b" : "]" } ] , "image" : "x" })", true, true},
+      {R"({"a":["]}[\"{",{"k":"\\"}],"image":"x"})", true, true},
+      {R"({"a":[1,],"image":"x"})", false, true},
+      {R"({"a":{"b"},"image":"x"})", false, true},
+      {R"({"a":{"b":1,},"image":"x"})", false, true},
+      {R"({"a":[1 2],"image":"x"})", false, true},
+      {R"({"a":{1:2},"image":"x"})", false, true},
+      {R"({"a":[01],"image":"x"})", false, true},
+      {R"({"a":[tru],"image":"x"})", false, true},
+      {R"({"a":[1}],"image":"x"})", false, false},
+      {R"({"a":{"b":[}},"image":"x"})", false, false},
+      {R"({"a":["\"],"image":"x"})", false, false},
+  };
+  bool ok = true;
+  for (const bool structural : {false, true}) {
+    JsonScanBudget budget;
+    budget.structural_skip = structural;
+    for (const Document& document : documents) {
+      JsonStringSpan span;
+      const size_t found =
+          LocateJsonStringFields(document.json, kKeys, std::span(&span, 1), budget);
+      ok &= Expect((found == 1) == (structural ? document.balanced : document.valid),
+                   std::string(structural ? "structural" : "token") + " skip disagrees on " +
+                       std::string(document.json));
+    }
+  }
+  return ok;
+}
+
+// A cancellation raised from another thread mid-scan ends it within one check interval.
+bool VerifyCancellation(ImageDecoder& decoder) {
+  const HostileCase flood{"flood", "{\"a\":[" + Repeat("0,", 16 << 20) + "0]}", false};
+  std::atomic<bool> cancel{true};
+  JsonScanBudget budget;
+  budget.max_tokens = ~uint64_t{0};
+  budget.cancel = &cancel;
+  bool ok = Expect(Render(flood, decoder, budget) == ThumbnailStatus::kCancelled,
+                   "a cancelled scan ran");
+
+  cancel.store(false);
+  std::thread canceller([&cancel] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    cancel.store(true);
+  });
+  const auto start = std::chrono::steady_clock::now();
+  const ThumbnailStatus status = Render(flood, decoder, budget);
+  const auto stop = std::chrono::steady_clock::now();
+  canceller.join();
+  // Either the scan finished first or the flag stopped it.
+  ok &= Expect(status == ThumbnailStatus::kCancelled || status == ThumbnailStatus::kNoImageField,
+               std::string("cancelled mid-scan: ") + ThumbnailStatusName(status));
+  std::printf("cancelled after %.1f ms\n",
+              std::chrono::duration<double, std::milli>(stop - start).count());
+  return ok;
+}
+
+// Real files must never come near the default budget.
+bool VerifyCorpus(ImageDecoder& decoder) {
+  bool ok = true;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    const HostileCase c{spec.name.data(), GenerateCorpusFile(spec).contents, true};
+    ok &= Expect(Render(c, decoder, JsonScanBudget()) == ThumbnailStatus::kOk,
+                 std::string(spec.name) + ": over the default budget");
+  }
+  return ok;
+}
+
+}  // namespace
+
+int RunHostileBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  int failures = 0;
+  if (!VerifySkipper()) ++failures;
+  if (!VerifyCancellation(*decoder)) ++failures;
+  if (!VerifyCorpus(*decoder)) ++failures;
+
+  // p99.9 needs a thousand samples to mean anything; fewer still bound the worst case seen.
+  const int runs = std::max(options.iterations, 20);
+  std::printf("\n== hostile ==\n");
+  std::printf("%-28s %10s %10s %10s %10s  %s\n", "case", "MB", "p50 ms", "p99 ms", "p99.9 ms",
+              "status");
+  for (const HostileCase& c : HostileCases()) {
+    const bool deadline = c.bound_ms == 0.0;
+    std::vector<double> samples;
+    ThumbnailStatus status = ThumbnailStatus::kOk;
+    for (int i = 0; i < runs; ++i) {
+      const JsonScanBudget budget = Armed(c.budget, deadline);
+      const auto start = std::chrono::steady_clock::now();
+      status = Render(c, *decoder, budget);
+      const auto stop = std::chrono::steady_clock::now();
+      samples.push_back(std::chrono::duration<double, std::milli>(stop - start).count());
+      if (status != c.expected) break;
+    }
+    std::sort(samples.begin(), samples.end());
+    const auto percentile = [&](size_t per_mille) {
+      return samples[std::min(samples.size() - 1, samples.size() * per_mille / 1000)];
+    };
+    std::printf("%-28s %10.1f %10.2f %10.2f %10.2f  %s\n", c.name,
+                c.contents.size() / (1024.0 * 1024.0), percentile(500), percentile(990),
+                percentile(999), ThumbnailStatusName(status));
+
+    const double bound = deadline ? kDeadline.count() + kDeadlineSlackMs : c.bound_ms;
+    if (!Expect(status == c.expected, std::string(c.name) + ": expected " +
+                                          ThumbnailStatusName(c.expected))) {
+      ++failures;
+    } else if (!Expect(percentile(999) <= bound, std::string(c.name) + ": p99.9 over " +
+                                                     std::to_string(bound) + " ms")) {
+      ++failures;
+    }
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d hostile checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,305 @@
+#include "JpegEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace vibe::bench {
+namespace {
+
+constexpr uint8_t kZigzag[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Annex K.1 quantization tables in natural order.
+constexpr uint8_t kLumaQuant[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+constexpr uint8_t kChromaQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99,
+    99, 99, 47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Annex K.3 Huffman tables.
+constexpr uint8_t kDcLumaBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+constexpr uint8_t kDcChromaBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+constexpr uint8_t kDcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+
+constexpr uint8_t kAcLumaBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+constexpr uint8_t kAcLumaValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61,
+    0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52,
+    0xd1, 0xf0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25,
+    0x26, 0x27, 0x28, 0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45,
+    0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64,
+    0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83,
+    0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99,
+    0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6,
+    0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3,
+    0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8,
+    0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+constexpr uint8_t kAcChromaBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+constexpr uint8_t kAcChromaValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61,
+    0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33,
+    0x52, 0xf0, 0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18,
+    0x19, 0x1a, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44,
+    0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63,
+    0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a,
+    0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4,
+    0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca,
+    0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7,
+    0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa};
+
+struct HuffmanCode {
+  uint16_t code[256] = {};
+  uint8_t size[256] = {};
+
+  HuffmanCode(const uint8_t* bits, const uint8_t* values) {
+    uint16_t next = 0;
+    size_t k = 0;
+    for (int length = 1; length <= 16; ++length) {
+      for (int i = 0; i < bits[length - 1]; ++i, ++k) {
+        code[values[k]] = next++;
+        size[values[k]] = static_cast<uint8_t>(length);
+      }
+      next <<= 1;
+    }
+  }
+};
+
+class EntropyWriter {
+ public:
+  explicit EntropyWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Put(uint32_t value, int bits) {
+    buffer_ = (buffer_ << bits) | (value & ((1u << bits) - 1));
+    count_ += bits;
+    while (count_ >= 8) {
+      const uint8_t byte = static_cast<uint8_t>(buffer_ >> (count_ - 8));
+      out_->push_back(byte);
+      if (byte == 0xFF) out_->push_back(0);
+      count_ -= 8;
+    }
+  }
+
+  void PutSymbol(const HuffmanCode& table, int symbol) {
+    Put(table.code[symbol], table.size[symbol]);
+  }
+
+  // Pads the last byte with one bits.
+  void Flush() {
+    if (count_ > 0) Put(0x7F, 8 - count_);
+  }
+
+ private:
+  std::vector<uint8_t>* out_;
+  uint64_t buffer_ = 0;
+  int count_ = 0;
+};
+
+int Category(int value) {
+  int magnitude = value < 0 ? -value : value;
+  int bits = 0;
+  while (magnitude) {
+    ++bits;
+    magnitude >>= 1;
+  }
+  return bits;
+}
+
+void PutValue(EntropyWriter& writer, int value, int bits) {
+  if (bits) writer.Put(static_cast<uint32_t>(value < 0 ? value - 1 : value), bits);
+}
+
+struct Plane {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<float> samples;
+
+  float at(uint32_t x, uint32_t y) const { return samples[static_cast<size_t>(y) * width + x]; }
+};
+
+class BlockEncoder {
+ public:
+  explicit BlockEncoder(int quality) {
+    const int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; ++i) {
+      luma_quant_[i] =
+          static_cast<uint8_t>(std::clamp((kLumaQuant[i] * scale + 50) / 100, 1, 255));
+      chroma_quant_[i] =
+          static_cast<uint8_t>(std::clamp((kChromaQuant[i] * scale + 50) / 100, 1, 255));
+    }
+    for (int u = 0; u < 8; ++u) {
+      const double c = u == 0 ? std::numbers::sqrt2 / 4.0 : 0.5;
+      for (int x = 0; x < 8; ++x) {
+        cosine_[u][x] = static_cast<float>(c * std::cos((2 * x + 1) * u * std::numbers::pi / 16));
+      }
+    }
+  }
+
+  const uint8_t* quant(bool chroma) const { return chroma ? chroma_quant_ : luma_quant_; }
+
+  // Transforms, quantizes and entropy-codes the 8x8 block of |plane| at (|bx|, |by|).
+  void Encode(const Plane& plane, uint32_t bx, uint32_t by, bool chroma, int* dc_pred,
+              const HuffmanCode& dc, const HuffmanCode& ac, EntropyWriter& writer) const {
+    float rows[8][8];
+    for (int y = 0; y < 8; ++y) {
+      for (int u = 0; u < 8; ++u) {
+        float sum = 0.0f;
+        for (int x = 0; x < 8; ++x) sum += cosine_[u][x] * (plane.at(bx + x, by + y) - 128.0f);
+        rows[y][u] = sum;
+      }
+    }
+
+    const uint8_t* table = quant(chroma);
+    int coefficients[64];
+    for (int v = 0; v < 8; ++v) {
+      for (int u = 0; u < 8; ++u) {
+        float sum = 0.0f;
+        for (int y = 0; y < 8; ++y) sum += cosine_[v][y] * rows[y][u];
+        coefficients[v * 8 + u] =
+            std::clamp(static_cast<int>(std::lround(sum / table[v * 8 + u])), -1023, 1023);
+      }
+    }
+
+    const int diff = coefficients[0] - *dc_pred;
+    *dc_pred = coefficients[0];
+    const int dc_bits = Category(diff);
+    writer.PutSymbol(dc, dc_bits);
+    PutValue(writer, diff, dc_bits);
+
+    int run = 0;
+    for (int k = 1; k < 64; ++k) {
+      const int value = coefficients[kZigzag[k]];
+      if (value == 0) {
+        ++run;
+        continue;
+      }
+      for (; run >= 16; run -= 16) writer.PutSymbol(ac, 0xF0);
+      const int bits = Category(value);
+      writer.PutSymbol(ac, (run << 4) | bits);
+      PutValue(writer, value, bits);
+      run = 0;
+    }
+    if (run) writer.PutSymbol(ac, 0x00);
+  }
+
+ private:
+  uint8_t luma_quant_[64];
+  uint8_t chroma_quant_[64];
+  float cosine_[8][8];
+};
+
+void AppendMarker(std::vector<uint8_t>* out, uint8_t marker, size_t length) {
+  out->push_back(0xFF);
+  out->push_back(marker);
+  out->push_back(static_cast<uint8_t>(length >> 8));
+  out->push_back(static_cast<uint8_t>(length));
+}
+
+void AppendHuffmanTable(std::vector<uint8_t>* out, uint8_t id, const uint8_t* bits,
+                        const uint8_t* values) {
+  size_t count = 0;
+  for (int i = 0; i < 16; ++i) count += bits[i];
+  AppendMarker(out, 0xC4, 2 + 1 + 16 + count);
+  out->push_back(id);
+  out->insert(out->end(), bits, bits + 16);
+  out->insert(out->end(), values, values + count);
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodeJpeg(const uint8_t* bgra, uint32_t width, uint32_t height,
+                                size_t stride, int quality) {
+  quality = std::clamp(quality, 1, 100);
+  const uint32_t padded_width = (width + 15) / 16 * 16;
+  const uint32_t padded_height = (height + 15) / 16 * 16;
+
+  // Full-resolution planes padded to whole MCUs by edge replication, then 2x2-averaged chroma.
+  Plane luma{padded_width, padded_height, {}};
+  Plane cb_full = luma;
+  Plane cr_full = luma;
+  const size_t plane_size = static_cast<size_t>(padded_width) * padded_height;
+  luma.samples.resize(plane_size);
+  cb_full.samples.resize(plane_size);
+  cr_full.samples.resize(plane_size);
+  for (uint32_t y = 0; y < padded_height; ++y) {
+    const uint8_t* row = bgra + std::min(y, height - 1) * stride;
+    for (uint32_t x = 0; x < padded_width; ++x) {
+      const uint8_t* pixel = row + std::min(x, width - 1) * 4;
+      const float b = pixel[0];
+      const float g = pixel[1];
+      const float r = pixel[2];
+      const size_t i = static_cast<size_t>(y) * padded_width + x;
+      luma.samples[i] = 0.299f * r + 0.587f * g + 0.114f * b;
+      cb_full.samples[i] = -0.168736f * r - 0.331264f * g + 0.5f * b + 128.0f;
+      cr_full.samples[i] = 0.5f * r - 0.418688f * g - 0.081312f * b + 128.0f;
+    }
+  }
+  Plane cb{padded_width / 2, padded_height / 2, {}};
+  Plane cr = cb;
+  cb.samples.resize(plane_size / 4);
+  cr.samples.resize(plane_size / 4);
+  for (uint32_t y = 0; y < cb.height; ++y) {
+    for (uint32_t x = 0; x < cb.width; ++x) {
+      const size_t i = static_cast<size_t>(y) * cb.width + x;
+      cb.samples[i] = (cb_full.at(2 * x, 2 * y) + cb_full.at(2 * x + 1, 2 * y) +
+                       cb_full.at(2 * x, 2 * y + 1) + cb_full.at(2 * x + 1, 2 * y + 1)) * 0.25f;
+      cr.samples[i] = (cr_full.at(2 * x, 2 * y) + cr_full.at(2 * x + 1, 2 * y) +
+                       cr_full.at(2 * x, 2 * y + 1) + cr_full.at(2 * x + 1, 2 * y + 1)) * 0.25f;
+    }
+  }
+
+  const BlockEncoder blocks(quality);
+  std::vector<uint8_t> out = {0xFF, 0xD8};
+  AppendMarker(&out, 0xE0, 16);
+  out.insert(out.end(), {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0});
+
+  AppendMarker(&out, 0xDB, 2 + 2 * 65);
+  for (int table = 0; table < 2; ++table) {
+    out.push_back(static_cast<uint8_t>(table));
+    for (int k = 0; k < 64; ++k) out.push_back(blocks.quant(table == 1)[kZigzag[k]]);
+  }
+
+  AppendMarker(&out, 0xC0, 17);
+  out.insert(out.end(), {8, static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+                         static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width), 3, 1,
+                         0x22, 0, 2, 0x11, 1, 3, 0x11, 1});
+
+  AppendHuffmanTable(&out, 0x00, kDcLumaBits, kDcValues);
+  AppendHuffmanTable(&out, 0x10, kAcLumaBits, kAcLumaValues);
+  AppendHuffmanTable(&out, 0x01, kDcChromaBits, kDcValues);
+  AppendHuffmanTable(&out, 0x11, kAcChromaBits, kAcChromaValues);
+
+  AppendMarker(&out, 0xDA, 12);
+  out.insert(out.end(), {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0});
+
+  static const HuffmanCode dc_luma(kDcLumaBits, kDcValues);
+  static const HuffmanCode ac_luma(kAcLumaBits, kAcLumaValues);
+  static const HuffmanCode dc_chroma(kDcChromaBits, kDcValues);
+  static const HuffmanCode ac_chroma(kAcChromaBits, kAcChromaValues);
+  EntropyWriter writer(&out);
+  int dc_pred[3] = {};
+  for (uint32_t my = 0; my < padded_height; my += 16) {
+    for (uint32_t mx = 0; mx < padded_width; mx += 16) {
+      for (uint32_t block = 0; block < 4; ++block) {
+        blocks.Encode(luma, mx + (block & 1) * 8, my + (block >> 1) * 8, false, &dc_pred[0],
+                      dc_luma, ac_luma, writer);
+      }
+      blocks.Encode(cb, mx / 2, my / 2, true, &dc_pred[1], dc_chroma, ac_chroma, writer);
+      blocks.Encode(cr, mx / 2, my / 2, true, &dc_pred[2], dc_chroma, ac_chroma, writer);
+    }
+  }
+  writer.Flush();
+  out.push_back(0xFF);
+  out.push_back(0xD9);
+  return out;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vibe::bench {
+
+// Encodes BGRA rows (alpha ignored) as a baseline 4:2:0 JFIF using the Annex K tables scaled to
+// |quality| (1-100), the same scaling libjpeg applies. Only meant to give the corpus and the
+// decode stages realistic JPEG payloads; the float DCT favours brevity over speed.
+std::vector<uint8_t> EncodeJpeg(const uint8_t* bgra, uint32_t width, uint32_t height,
+                                size_t stride, int quality);
+
+}  // namespace vibe::bench
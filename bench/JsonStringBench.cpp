@@ -0,0 +1,137 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "CpuFeatures.h"
+#include "JsonFieldLocator.h"
+#include "ReferenceJsonString.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr SimdLevel kLevels[] = {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2};
+
+// Escape fragments mixed into generated strings, including every \u shape the decoder treats
+// specially: ASCII, two- and three-byte code points, surrogate pairs and their broken forms.
+constexpr std::string_view kFragments[] = {
+    "\\\"",          "\\\\",          "\\/",           "\\b",           "\\f",
+    "\\n",           "\\r",           "\\t",           "\\u0041",       "\\u00e9",
+    "\\u20AC",       "\\uFFFF",       "\\u0000",       "\\ud83d\\ude00", "\\uDBFF\\uDFFF",
+    "\\ud83d",       "\\ude00",       "\\ud83d\\u0041", "\\ud83d\\n",    "\\u12",
+    "\\u12G4",       "\\x",           "\\",            "\xC3\xA9",      "AbC+/=",
+};
+
+std::string MakeCase(std::mt19937& rng) {
+  std::string text = "\"";
+  const size_t pieces = rng() % 12;
+  for (size_t i = 0; i < pieces; ++i) {
+    if (rng() % 2) {
+      text.append(rng() % 80, static_cast<char>('a' + rng() % 26));
+    } else {
+      text.append(kFragments[rng() % std::size(kFragments)]);
+    }
+  }
+  if (rng() % 8) text.push_back('"');
+  text.append(rng() % 40, 'z');
+  return text;
+}
+
+int VerifyAgainstReference() {
+  std::mt19937 rng(0x5eed);
+  int mismatches = 0;
+  for (int i = 0; i < 200000; ++i) {
+    const std::string text = MakeCase(rng);
+
+    std::string expected;
+    size_t expected_end = 0;
+    const bool expected_ok =
+        reference::DecodeJsonString(text, 0, &expected, &expected_end);
+
+    for (SimdLevel level : kLevels) {
+      SetSimdLevelCap(level);
+      std::string actual;
+      size_t actual_end = 0;
+      const bool actual_ok = DecodeJsonString(text, 0, &actual, &actual_end);
+      if (actual_ok != expected_ok ||
+          (expected_ok && (actual != expected || actual_end != expected_end))) {
+        if (mismatches++ < 5) {
+          std::printf("mismatch at %s: %s\n", SimdLevelName(level), text.c_str());
+        }
+      }
+    }
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+  return mismatches;
+}
+
+std::string MakeBase64Like(size_t size) {
+  static constexpr char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  std::mt19937 rng(42);
+  std::string text = "\"";
+  for (size_t i = 0; i < size; ++i) text.push_back(kAlphabet[rng() % 64]);
+  text.push_back('"');
+  return text;
+}
+
+std::string MakeEscapedText(size_t size) {
+  std::mt19937 rng(7);
+  std::string text = "\"";
+  while (text.size() < size) {
+    text.append(48 + rng() % 32, 'x');
+    text.append(kFragments[rng() % 15]);
+  }
+  text.push_back('"');
+  return text;
+}
+
+void BenchCase(std::string_view label, const std::string& text, int iterations) {
+  std::string out;
+  size_t end = 0;
+  std::string name = std::string(label) + " reference";
+  PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+    reference::DecodeJsonString(text, 0, &out, &end);
+    DoNotOptimize(out);
+  }));
+
+  const SimdLevel detected = ActiveSimdLevel();
+  for (SimdLevel level : kLevels) {
+    if (level > detected) continue;
+    SetSimdLevelCap(level);
+    name = std::string(label) + " decode " + SimdLevelName(level);
+    PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+      DecodeJsonString(text, 0, &out, &end);
+      DoNotOptimize(out);
+    }));
+
+    bool has_escapes = false;
+    name = std::string(label) + " scan " + SimdLevelName(level);
+    PrintBenchRow(name, MeasureBench(text.size(), iterations, [&] {
+      ScanJsonString(text, 0, &end, &has_escapes);
+      DoNotOptimize(end);
+    }));
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+}
+
+}  // namespace
+
+int RunJsonStringBench(const BenchOptions& options) {
+  PrintBenchHeader("json-string");
+
+  const int mismatches = VerifyAgainstReference();
+  if (mismatches != 0) {
+    std::printf("FAILED: %d mismatches against the reference decoder\n", mismatches);
+    return 1;
+  }
+
+  BenchCase("4MB base64", MakeBase64Like(4 << 20), options.iterations);
+  BenchCase("1MB escaped", MakeEscapedText(1 << 20), options.iterations);
+  return 0;
+}
+
+}  // namespace vibe::bench
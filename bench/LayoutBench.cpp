@@ -0,0 +1,187 @@
+#include "Bench.h"
+
+#include "AllocationCounter.h"
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+#include "ThumbnailPipeline.h"
+#include "VibeCorpus.h"
+#include "VibeLayout.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr uint32_t kGenerateCx = 256;
+// What rewriting a file may hold on the heap, whatever its size: the member list and a decoded
+// thumbnail header.
+constexpr size_t kMaxRewriteHeap = 64 * 1024;
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+struct Thumbnail {
+  ThumbnailStatus status = ThumbnailStatus::kOk;
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+  // What a stream had handed out when the render finished.
+  size_t bytes_read = 0;
+
+  bool same_image(const Thumbnail& other) const {
+    return status == other.status && size.width == other.size.width &&
+           size.height == other.size.height && pixels == other.pixels;
+  }
+};
+
+Thumbnail RenderStreamed(const std::string& contents, uint32_t cx, ImageDecoder& decoder) {
+  Thumbnail thumbnail;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    thumbnail.size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    thumbnail.pixels.assign(*stride * height, 0);
+    return thumbnail.pixels.data();
+  };
+  ChunkedMemorySource source(contents, JsonFieldReader::kReadChunk);
+  thumbnail.status = RenderThumbnail(source, cx, decoder, allocate);
+  thumbnail.bytes_read = source.bytes_served();
+  return thumbnail;
+}
+
+LayoutStatus Rewrite(const std::string& json, ImageDecoder& decoder, std::string* out) {
+  LayoutOptions options;
+  options.generate_cx = kGenerateCx;
+  options.decoder = &decoder;
+  out->clear();
+  return RewriteVibeLayout(json, options, [out](std::string_view piece) {
+    out->append(piece);
+    return true;
+  });
+}
+
+// Member texts, key through value, in document order, without the ones the rewrite moves.
+std::vector<std::string_view> KeptMembers(std::string_view json) {
+  std::vector<JsonMember> members;
+  ListJsonMembers(json, &members);
+  std::vector<std::string_view> kept;
+  bool thumbnail_seen = false;
+  for (const JsonMember& member : members) {
+    if (member.key == kThumbnailInfoKey) continue;
+    if (member.key == "thumbnail" && json[member.value_begin] == '"' && !thumbnail_seen) {
+      thumbnail_seen = true;
+      continue;
+    }
+    kept.push_back(json.substr(member.begin, member.end - member.begin));
+  }
+  return kept;
+}
+
+// The rewrite keeps every other member byte for byte, puts the two thumbnail members first,
+// comes back unchanged when run again, and takes no more heap for 32 MB than for 64 KB. The
+// result renders the same thumbnail as the original, from a fraction of the file.
+bool VerifyFile(const CorpusSpec& spec, ImageDecoder& decoder, std::string* rewritten) {
+  const std::string name(spec.name);
+  const std::string json = GenerateCorpusFile(spec).contents;
+  const bool has_thumbnail = spec.thumbnail.width != 0;
+
+  bool ok = true;
+  if (has_thumbnail) {
+    AllocationCounter counter;
+    const LayoutStatus status = RewriteVibeLayout(json, LayoutOptions(), [](std::string_view) {
+      return true;
+    });
+    const size_t peak = counter.stats().peak_bytes;
+    ok &= Expect(status == LayoutStatus::kOk && peak <= kMaxRewriteHeap,
+                 name + ": rewrite " + LayoutStatusName(status) + ", heap peak " +
+                     std::to_string(peak));
+  } else {
+    ok &= Expect(RewriteVibeLayout(json, LayoutOptions(), [](std::string_view) { return true; }) ==
+                     LayoutStatus::kNoThumbnail,
+                 name + ": rewritten without a thumbnail");
+  }
+
+  const LayoutStatus status = Rewrite(json, decoder, rewritten);
+  if (!Expect(status == LayoutStatus::kOk, name + ": " + LayoutStatusName(status))) return false;
+  std::vector<JsonMember> members;
+  ok &= Expect(ListJsonMembers(*rewritten, &members) && members.size() >= 2 &&
+                   members[0].key == kThumbnailInfoKey && members[1].key == "thumbnail",
+               name + ": thumbnail members not in front");
+  ok &= Expect(HasThumbnailFirstLayout(std::string_view(*rewritten).substr(0, kLayoutPeekBytes)),
+               name + ": layout not recognized");
+  ok &= Expect(KeptMembers(*rewritten) == KeptMembers(json), name + ": other members changed");
+  std::string again;
+  ok &= Expect(Rewrite(*rewritten, decoder, &again) == LayoutStatus::kOk && again == *rewritten,
+               name + ": second rewrite differs");
+
+  const uint32_t cx = has_thumbnail ? spec.cx : kGenerateCx;
+  const Thumbnail before = RenderStreamed(json, cx, decoder);
+  const Thumbnail after = RenderStreamed(*rewritten, cx, decoder);
+  ok &= Expect(after.status == ThumbnailStatus::kOk, name + ": rewritten render failed");
+  if (has_thumbnail) {
+    ok &= Expect(after.same_image(before), name + ": rewritten render differs");
+  } else {
+    ok &= Expect(after.size.width == before.size.width && after.size.height == before.size.height,
+                 name + ": generated thumbnail has the wrong size");
+  }
+  // A thumbnail that covers |cx| is all the provider needs to read.
+  const ImageSize thumbnail = has_thumbnail ? spec.thumbnail : before.size;
+  if (std::max(thumbnail.width, thumbnail.height) >= cx) {
+    ok &= Expect(after.bytes_read <= members[1].end + JsonFieldReader::kReadChunk,
+                 name + ": read " + std::to_string(after.bytes_read) + " bytes");
+  }
+  std::printf("%-28s %10zu %12.1f %12.1f\n", spec.name.data(), json.size(),
+              before.bytes_read / 1024.0, after.bytes_read / 1024.0);
+  return ok;
+}
+
+}  // namespace
+
+int RunLayoutBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  int failures = 0;
+  struct Timed {
+    const CorpusSpec* spec;
+    std::string json;
+    std::string rewritten;
+  };
+  std::vector<Timed> timed;
+  std::printf("\n== layout reads ==\n");
+  std::printf("%-28s %10s %12s %12s\n", "file", "bytes", "KB read", "KB rewritten");
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    std::string rewritten;
+    if (!VerifyFile(spec, *decoder, &rewritten)) ++failures;
+    if (spec.target_bytes >= (size_t{4} << 20) && !rewritten.empty()) {
+      timed.push_back({&spec, GenerateCorpusFile(spec).contents, std::move(rewritten)});
+    }
+  }
+
+  PrintBenchHeader("layout");
+  for (const Timed& t : timed) {
+    const std::string name(t.spec->name);
+    const uint32_t cx = t.spec->thumbnail.width != 0 ? t.spec->cx : kGenerateCx;
+    PrintBenchRow(name + " original", MeasureBench(t.json.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderStreamed(t.json, cx, *decoder));
+                  }));
+    PrintBenchRow(name + " thumbnail first",
+                  MeasureBench(t.rewritten.size(), options.iterations, [&] {
+                    DoNotOptimize(RenderStreamed(t.rewritten, cx, *decoder));
+                  }));
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d layout checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
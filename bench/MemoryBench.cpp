@@ -0,0 +1,213 @@
+#include "Bench.h"
+
+#include "AllocationCounter.h"
+#include "Base64.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+#include "Scaler.h"
+#include "ScratchArena.h"
+#include "ThumbnailPipeline.h"
+#include "VibeCorpus.h"
+
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr std::string_view kFieldNames[] = {"thumbnail", "image"};
+
+// Rounding of arena blocks and small bookkeeping allocations.
+constexpr size_t kSlackBytes = 64 * 1024;
+
+struct Payload {
+  // The selected field as it sits in the file, before unescaping.
+  size_t raw_size = 0;
+  std::vector<uint8_t> encoded;
+  // The decoded image at the size the decoder produced, as a whole-frame decode holds it.
+  size_t frame_bytes = 0;
+  // What decoding and scaling the payload cost on their own, warm: the decoder's arena
+  // temporaries and the scaler's heap use.
+  size_t decode_arena = 0;
+  AllocationStats scale_heap;
+};
+
+// Decodes the field RenderThumbnail picks the straightforward way, outside any measurement, at
+// the reduced size RenderThumbnail asks for.
+bool LoadPayload(const CorpusSpec& spec, const CorpusFile& file, ImageDecoder& decoder,
+                 Payload* payload) {
+  JsonStringSpan spans[std::size(kFieldNames)];
+  LocateJsonStringFields(file.contents, kFieldNames, spans);
+  const JsonStringSpan& selected = spans[file.field == kFieldNames[0] ? 0 : 1];
+  std::string unescaped;
+  std::string_view value;
+  if (!ResolveJsonString(selected, &unescaped, &value)) return false;
+  const std::string_view encoded_image = StripDataUrlPrefix(value);
+
+  payload->raw_size = selected.raw.size();
+  payload->encoded.resize(Base64DecodedSizeUpperBound(encoded_image.size()));
+  const Base64Result decoded =
+      DecodeBase64(encoded_image, payload->encoded.data(), payload->encoded.size());
+  if (decoded.status != Base64Status::kOk) return false;
+  payload->encoded.resize(decoded.written);
+
+  DecodedImage image;
+  if (decoder.Decode(payload->encoded, spec.cx, &image) != DecodeStatus::kOk) return false;
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  arena.ResetPeak();
+  image = {};
+  if (decoder.Decode(payload->encoded, spec.cx, &image) != DecodeStatus::kOk) return false;
+  payload->decode_arena = arena.peak_bytes();
+  payload->frame_bytes = image.stride * image.height;
+
+  const ImageSize size = file.expected;
+  std::vector<uint8_t> dest(static_cast<size_t>(size.width) * size.height * 4);
+  AllocationCounter counter;
+  ScaleToPremultipliedBgra(image.pixels.get(), image.width, image.height, image.stride,
+                           dest.data(), size.width, size.height, dest.size() / size.height);
+  payload->scale_heap = counter.stats();
+  return true;
+}
+
+// Renders |file| once to warm the thread's arena, then again under an AllocationCounter, and
+// checks that the payload was held once encoded and never as a whole decoded frame: the arena
+// peak must fit the file buffer (streams) or one payload block (views) next to the decoder's own
+// temporaries, and the heap may only see what scaling takes on its own, plus the arena's
+// temporary chunks when the call is too large to keep memory for.
+bool CheckSource(const CorpusSpec& spec, const CorpusFile& file, const Payload& payload,
+                 bool streamed, ImageDecoder& decoder) {
+  std::vector<uint8_t> dest(static_cast<size_t>(file.expected.width) * file.expected.height * 4);
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    return *stride * height <= dest.size() ? dest.data() : nullptr;
+  };
+
+  const auto render = [&] {
+    MemoryByteSource view(file.contents);
+    ChunkedMemorySource stream(file.contents, JsonFieldReader::kReadChunk);
+    ByteSource& source = streamed ? static_cast<ByteSource&>(stream) : view;
+    return RenderThumbnail(source, spec.cx, decoder, allocate);
+  };
+
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  ThumbnailStatus status = render();
+  arena.ResetPeak();
+  AllocationStats heap;
+  {
+    AllocationCounter counter;
+    if (status == ThumbnailStatus::kOk) status = render();
+    heap = counter.stats();
+  }
+  const size_t arena_peak = arena.peak_bytes();
+
+  const size_t buffer_bytes = streamed ? file.contents.size() + 1 : payload.raw_size;
+  const size_t arena_budget = buffer_bytes + payload.decode_arena + kSlackBytes;
+  // Chunks beyond what the arena retains come from the heap on every call, at most twice the peak
+  // since each new chunk doubles the reservation.
+  const bool oversized = arena_peak > ScratchArena::kRetainedBytes;
+  const size_t heap_budget =
+      payload.scale_heap.peak_bytes + (oversized ? 2 * arena_peak : 0) + kSlackBytes;
+  const uint64_t allocation_budget = payload.scale_heap.allocations + (oversized ? 4 : 0);
+
+  const std::string name = std::string(spec.name) + (streamed ? " stream" : " view");
+  std::printf("%-44s %12llu %12.1f %12.1f\n", name.c_str(),
+              static_cast<unsigned long long>(heap.allocations), heap.peak_bytes / 1024.0,
+              arena_peak / 1024.0);
+  if (status != ThumbnailStatus::kOk) {
+    std::printf("FAILED: %s: %s\n", name.c_str(), ThumbnailStatusName(status));
+    return false;
+  }
+  if (heap.allocations > allocation_budget || heap.peak_bytes > heap_budget ||
+      arena_peak > arena_budget) {
+    std::printf("FAILED: %s: over budget (%llu allocations, %zu heap bytes, %zu arena bytes; "
+                "budget %llu, %zu, %zu)\n",
+                name.c_str(), static_cast<unsigned long long>(heap.allocations), heap.peak_bytes,
+                arena_peak, static_cast<unsigned long long>(allocation_budget), heap_budget,
+                arena_budget);
+    return false;
+  }
+  return true;
+}
+
+// Decoders that stream rows keep a few rows of working memory, not the frame. Interlaced PNGs
+// scatter every pass over the whole image and are exempt.
+bool CheckStreamingDecode(const CorpusSpec& spec, const Payload& payload) {
+  if (spec.interlaced || payload.frame_bytes < (size_t{1} << 20)) return true;
+  if (payload.decode_arena < payload.frame_bytes / 4) return true;
+  std::printf("FAILED: %.*s: decoder held %zu bytes for a %zu-byte frame\n",
+              static_cast<int>(spec.name.size()), spec.name.data(), payload.decode_arena,
+              payload.frame_bytes);
+  return false;
+}
+
+// Renders |file| under limits it exceeds and checks that it is refused before the thumbnail is
+// allocated: by pixel count from the probed header, and by memory once the decoder has announced
+// what it needs.
+bool CheckLimits(const CorpusSpec& spec, const CorpusFile& file, const Payload& payload,
+                 ImageDecoder& decoder) {
+  bool allocated = false;
+  const ThumbnailAllocator allocate = [&](uint32_t, uint32_t, size_t*) -> uint8_t* {
+    allocated = true;
+    return nullptr;
+  };
+
+  const ImageSize source = file.field == kFieldNames[0] ? spec.thumbnail : spec.image;
+  DecodeLimits pixels;
+  pixels.max_pixels = static_cast<uint64_t>(source.width) * source.height - 1;
+  DecodeLimits bytes;
+  bytes.max_bytes = payload.decode_arena / 2;
+
+  bool ok = true;
+  for (const DecodeLimits& limits : {pixels, bytes}) {
+    MemoryByteSource source(file.contents);
+    allocated = false;
+    const ThumbnailStatus status = RenderThumbnail(source, spec.cx, decoder, allocate, limits);
+    if (status != ThumbnailStatus::kTooLarge || allocated) {
+      std::printf("FAILED: %.*s: limits of %llu pixels, %llu bytes gave %s%s\n",
+                  static_cast<int>(spec.name.size()), spec.name.data(),
+                  static_cast<unsigned long long>(limits.max_pixels),
+                  static_cast<unsigned long long>(limits.max_bytes), ThumbnailStatusName(status),
+                  allocated ? " after allocating" : "");
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+}  // namespace
+
+int RunMemoryBench(const BenchOptions&) {
+  std::printf("\n== memory ==\n");
+  std::printf("%-44s %12s %12s %12s\n", "case", "allocations", "heap KB", "arena KB");
+
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  int failures = 0;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    const CorpusFile file = GenerateCorpusFile(spec);
+    Payload payload;
+    if (!LoadPayload(spec, file, *decoder, &payload)) {
+      std::printf("FAILED: %.*s: payload does not decode\n", static_cast<int>(spec.name.size()),
+                  spec.name.data());
+      ++failures;
+      continue;
+    }
+
+    for (const bool streamed : {false, true}) {
+      if (!CheckSource(spec, file, payload, streamed, *decoder)) ++failures;
+    }
+    if (!CheckStreamingDecode(spec, payload)) ++failures;
+    if (!CheckLimits(spec, file, payload, *decoder)) ++failures;
+  }
+  if (failures != 0) {
+    std::printf("FAILED: %d cases\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
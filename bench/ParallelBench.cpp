@@ -0,0 +1,187 @@
+#include "Bench.h"
+
+#include "Base64.h"
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "PngEncoder.h"
+#include "ReferenceBase64.h"
+#include "ScratchArena.h"
+#include "ThumbnailPipeline.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr unsigned kWidths[] = {1, 2, 4, 8};
+constexpr uint32_t kCx = 256;
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+std::vector<uint8_t> RandomBytes(size_t size, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::vector<uint8_t> bytes(size);
+  for (uint8_t& byte : bytes) byte = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+// The parallel decoder must agree with the single pass on status, length, error offset and bytes,
+// including the inputs that make it fall back.
+bool VerifyBase64(WorkStealingPool& pool) {
+  const std::vector<uint8_t> data = RandomBytes(3 * 1024 * 1024 + 2, 5);
+  const std::string plain = reference::EncodeBase64(data);
+  std::string invalid = plain;
+  invalid[invalid.size() / 2 + 1] = '*';
+  std::string early_padding = plain;
+  early_padding[early_padding.size() / 3 / 4 * 4 + 3] = '=';
+
+  struct Input {
+    const char* name;
+    std::string text;
+    size_t capacity;
+  };
+  const Input inputs[] = {
+      {"plain", plain, Base64DecodedSizeUpperBound(plain.size())},
+      {"crlf lines", reference::EncodeBase64(data, 76), Base64DecodedSizeUpperBound(plain.size())},
+      {"invalid character", invalid, Base64DecodedSizeUpperBound(plain.size())},
+      {"early padding", early_padding, Base64DecodedSizeUpperBound(plain.size())},
+      {"output too small", plain, data.size() / 2},
+  };
+  bool ok = true;
+  for (const Input& input : inputs) {
+    std::vector<uint8_t> expected(input.capacity);
+    std::vector<uint8_t> got(input.capacity);
+    const Base64Result want = DecodeBase64(input.text, expected.data(), expected.size());
+    const Base64Result have = DecodeBase64Parallel(input.text, got.data(), got.size(), pool);
+    const size_t compared = want.status == Base64Status::kOk ? want.written : 0;
+    ok &= Expect(want.status == have.status && want.written == have.written &&
+                     want.error_offset == have.error_offset &&
+                     std::equal(expected.begin(), expected.begin() + compared, got.begin()),
+                 std::string("parallel base64 differs: ") + input.name);
+  }
+  return ok;
+}
+
+// A vibe file holding nothing but an "image" PNG of noise, which barely compresses: the outlier
+// shape this path exists for.
+std::string MakeLargeFile(uint32_t width, uint32_t height) {
+  const std::vector<uint8_t> pixels = RandomBytes(static_cast<size_t>(width) * height * 4, width);
+  const std::vector<uint8_t> png = EncodePng(pixels.data(), width, height, width * 4, false);
+  return "{\"identifier\":\"novelai-vibe-transfer\",\"image\":\"" + reference::EncodeBase64(png) +
+         "\"}";
+}
+
+ThumbnailStatus RenderFile(const std::string& contents, ImageDecoder& decoder,
+                           const ParallelOptions& parallel, std::vector<uint8_t>* pixels) {
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    *stride = static_cast<size_t>(width) * 4;
+    pixels->assign(*stride * height, 0);
+    return pixels->data();
+  };
+  MemoryByteSource source(contents);
+  return RenderThumbnail(source, kCx, decoder, allocate, DecodeLimits(), nullptr, parallel);
+}
+
+// Below the threshold nothing changes: same pixels and not a byte more of arena.
+bool VerifyThreshold(WorkStealingPool& pool, ImageDecoder& decoder) {
+  const std::string small = MakeLargeFile(512, 384);
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  std::vector<uint8_t> sequential;
+  std::vector<uint8_t> parallel;
+  RenderFile(small, decoder, ParallelOptions(), &sequential);
+  arena.ResetPeak();
+  RenderFile(small, decoder, ParallelOptions(), &sequential);
+  const size_t sequential_peak = arena.peak_bytes();
+  arena.ResetPeak();
+  RenderFile(small, decoder, ParallelOptions{&pool}, &parallel);
+  return Expect(parallel == sequential && arena.peak_bytes() == sequential_peak,
+                "payload under the threshold left the single-threaded path");
+}
+
+}  // namespace
+
+int RunParallelBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  std::vector<std::unique_ptr<WorkStealingPool>> pools;
+  for (const unsigned width : kWidths) pools.push_back(std::make_unique<WorkStealingPool>(width));
+  WorkStealingPool& widest = *pools.back();
+
+  int failures = 0;
+  if (!VerifyBase64(widest)) ++failures;
+  if (!VerifyThreshold(widest, *decoder)) ++failures;
+
+  struct Size {
+    uint32_t width;
+    uint32_t height;
+  };
+  const Size sizes[] = {{1024, 768}, {2048, 1536}, {3072, 2304}};
+  const int iterations = std::min(options.iterations, 5);
+
+  std::printf("\n== parallel ==\n");
+  std::printf("%-24s %12s %12s", "case", "payload MB", "serial ms");
+  for (const unsigned width : kWidths) std::printf("   x%u speedup", width);
+  std::printf("\n");
+  for (const Size& size : sizes) {
+    const std::string file = MakeLargeFile(size.width, size.height);
+    const std::string name = std::to_string(size.width) + "x" + std::to_string(size.height);
+    std::vector<uint8_t> expected;
+    if (!Expect(RenderFile(file, *decoder, ParallelOptions(), &expected) == ThumbnailStatus::kOk,
+                name + ": serial render")) {
+      ++failures;
+      continue;
+    }
+
+    std::vector<uint8_t> got;
+    const BenchStats serial = MeasureBench(file.size(), iterations, [&] {
+      RenderFile(file, *decoder, ParallelOptions(), &got);
+    });
+    std::printf("%-24s %12.1f %12.1f", name.c_str(), file.size() / (1024.0 * 1024.0),
+                serial.p50_ms);
+    for (size_t p = 0; p < pools.size(); ++p) {
+      // A zero threshold forces the parallel path even for the smallest case, for the curve.
+      const ParallelOptions parallel{pools[p].get(), 0};
+      const ThumbnailStatus status = RenderFile(file, *decoder, parallel, &got);
+      if (status != ThumbnailStatus::kOk || got != expected) {
+        std::printf("\nFAILED: %s x%u: parallel render differs\n", name.c_str(), kWidths[p]);
+        ++failures;
+        continue;
+      }
+      const BenchStats stats = MeasureBench(file.size(), iterations, [&] {
+        RenderFile(file, *decoder, parallel, &got);
+      });
+      std::printf(" %12.2f", serial.p50_ms / std::max(stats.p50_ms, 1e-6));
+    }
+    std::printf("\n");
+  }
+
+  PrintBenchHeader("parallel base64");
+  const std::string text = reference::EncodeBase64(RandomBytes(24 * 1024 * 1024, 9));
+  std::vector<uint8_t> output(Base64DecodedSizeUpperBound(text.size()));
+  PrintBenchRow("24 MB serial", MeasureBench(text.size(), iterations, [&] {
+                  DecodeBase64(text, output.data(), output.size());
+                }));
+  for (size_t p = 0; p < pools.size(); ++p) {
+    PrintBenchRow("24 MB x" + std::to_string(kWidths[p]),
+                  MeasureBench(text.size(), iterations, [&] {
+                    DecodeBase64Parallel(text, output.data(), output.size(), *pools[p]);
+                  }));
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d parallel checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,367 @@
+#include "Bench.h"
+
+#include "Base64.h"
+#include "Base64Reader.h"
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ImageProbe.h"
+#include "JpegEncoder.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+#include "PngEncoder.h"
+#include "Scaler.h"
+#include "ThumbnailPipeline.h"
+#include "Trace.h"
+#include "VibeCorpus.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr std::string_view kFieldNames[] = {"thumbnail", "image"};
+
+// Stands in for WIC on the lazy path: takes the payload still encoded and pulls it through a
+// Base64Reader the way a stream-reading decoder would, size first, then in small reads.
+class LazyTestDecoder final : public ImageDecoder {
+ public:
+  explicit LazyTestDecoder(ImageDecoder& inner) : inner_(inner) {}
+
+  const char* name() const override { return "lazy test"; }
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override {
+    return inner_.DecodeRows(data, format, min_long_edge, sink);
+  }
+
+  bool decodes_base64() const override { return true; }
+  DecodeStatus DecodeBase64Rows(std::string_view encoded, ImageFormat format,
+                                uint32_t min_long_edge, ImageRowSink* sink) override {
+    const auto reader = std::make_unique<Base64Reader>(encoded);
+    std::vector<uint8_t> data(reader->size());
+    size_t offset = 0;
+    for (size_t read = 1; read != 0 && offset < data.size(); offset += read) {
+      if (!reader->Read(data.data() + offset, std::min<size_t>(4096, data.size() - offset),
+                        &read)) {
+        return DecodeStatus::kCorrupt;
+      }
+    }
+    if (offset != data.size()) return DecodeStatus::kCorrupt;
+    return inner_.DecodeRows(data, format, min_long_edge, sink);
+  }
+
+ private:
+  ImageDecoder& inner_;
+};
+
+// Runs RenderThumbnail over both source kinds (mapped view and 64 KB stream chunks) and checks
+// the status, the output size and, when tracing is built in, that every stage recorded a span.
+bool VerifyCorpusFile(const CorpusSpec& spec, const CorpusFile& file, ImageDecoder& decoder) {
+  TraceStageCounters before[kTraceStageCount];
+  SnapshotTraceCounters(before);
+
+  std::vector<uint8_t> pixels;
+  ImageSize produced;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    produced = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    pixels.assign(*stride * height, 0);
+    return pixels.data();
+  };
+
+  MemoryByteSource view(file.contents);
+  ChunkedMemorySource stream(file.contents, JsonFieldReader::kReadChunk);
+  ByteSource* sources[] = {&view, &stream};
+  for (ByteSource* source : sources) {
+    const ThumbnailStatus status = RenderThumbnail(*source, spec.cx, decoder, allocate);
+    if (status != ThumbnailStatus::kOk || produced.width != file.expected.width ||
+        produced.height != file.expected.height) {
+      std::printf("FAILED: %.*s: %s, %ux%u (expected %ux%u)\n",
+                  static_cast<int>(spec.name.size()), spec.name.data(),
+                  ThumbnailStatusName(status), produced.width, produced.height,
+                  file.expected.width, file.expected.height);
+      return false;
+    }
+  }
+
+  if constexpr (kTracingEnabled) {
+    TraceStageCounters after[kTraceStageCount];
+    SnapshotTraceCounters(after);
+    for (size_t i = 0; i < kTraceStageCount; ++i) {
+      if (after[i].calls - before[i].calls != std::size(sources) ||
+          after[i].failures != before[i].failures) {
+        std::printf("FAILED: %.*s: %llu %s spans, %llu failed\n",
+                    static_cast<int>(spec.name.size()), spec.name.data(),
+                    static_cast<unsigned long long>(after[i].calls - before[i].calls),
+                    TraceStageName(static_cast<TraceStage>(i)),
+                    static_cast<unsigned long long>(after[i].failures - before[i].failures));
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Decodes |encoded| at full size and reduced for |cx|. A reduced image must keep the long edge at
+// or above |cx| and match the full one: interlaced PNG (|exact|) at every |scale|-th pixel, JPEG
+// to within a few levels of each |scale| x |scale| area's average.
+bool CheckReducedDecode(std::string_view name, std::span<const uint8_t> encoded, bool reducible,
+                        bool exact, uint32_t cx, ImageDecoder& decoder) {
+  DecodedImage full;
+  DecodedImage reduced;
+  if (decoder.Decode(encoded, 0, &full) != DecodeStatus::kOk ||
+      decoder.Decode(encoded, cx, &reduced) != DecodeStatus::kOk) {
+    std::printf("FAILED: %.*s: payload does not decode\n", static_cast<int>(name.size()),
+                name.data());
+    return false;
+  }
+  const uint32_t scale = reducible ? SelectDecodeScale(full.width, full.height, cx) : 1;
+  if (reduced.source_width != full.width || reduced.source_height != full.height ||
+      reduced.width != (full.width + scale - 1) / scale ||
+      reduced.height != (full.height + scale - 1) / scale) {
+    std::printf("FAILED: %.*s: reduced to %ux%u of %ux%u for %u\n", static_cast<int>(name.size()),
+                name.data(), reduced.width, reduced.height, full.width, full.height, cx);
+    return false;
+  }
+
+  uint64_t total_error = 0;
+  uint32_t worst_error = 0;
+  const uint32_t area = exact ? 1 : scale;
+  for (uint32_t y = 0; y < reduced.height; ++y) {
+    for (uint32_t x = 0; x < reduced.width; ++x) {
+      for (int c = 0; c < 4; ++c) {
+        uint32_t sum = 0;
+        uint32_t count = 0;
+        for (uint32_t sy = y * scale; sy < std::min(y * scale + area, full.height); ++sy) {
+          for (uint32_t sx = x * scale; sx < std::min(x * scale + area, full.width); ++sx) {
+            sum += full.row(sy)[sx * 4 + c];
+            ++count;
+          }
+        }
+        const int expected = static_cast<int>((sum + count / 2) / count);
+        const uint32_t error =
+            static_cast<uint32_t>(std::abs(expected - reduced.row(y)[x * 4 + c]));
+        total_error += error;
+        worst_error = std::max(worst_error, error);
+      }
+    }
+  }
+  const double mean_error =
+      static_cast<double>(total_error) / (4.0 * reduced.width * reduced.height);
+  if (exact ? worst_error != 0 : mean_error > 3.0) {
+    std::printf("FAILED: %.*s: 1/%u decode is off by %.2f on average, %u at worst\n",
+                static_cast<int>(name.size()), name.data(), scale, mean_error, worst_error);
+    return false;
+  }
+  return true;
+}
+
+bool VerifyReducedDecode(const CorpusSpec& spec, const CorpusFile& file, ImageDecoder& decoder) {
+  JsonStringSpan spans[std::size(kFieldNames)];
+  LocateJsonStringFields(file.contents, kFieldNames, spans);
+  std::string unescaped;
+  std::string_view value;
+  ResolveJsonString(spans[file.field == kFieldNames[0] ? 0 : 1], &unescaped, &value);
+  const std::string_view encoded_image = StripDataUrlPrefix(value);
+  std::vector<uint8_t> encoded(Base64DecodedSizeUpperBound(encoded_image.size()));
+  encoded.resize(DecodeBase64(encoded_image, encoded.data(), encoded.size()).written);
+  const bool jpeg = spec.format == CorpusImageFormat::kJpeg;
+  return CheckReducedDecode(spec.name, encoded, jpeg || spec.interlaced, !jpeg, spec.cx, decoder);
+}
+
+// Sizes that leave partial blocks, partial MCUs and empty Adam7 passes, at every scale.
+bool VerifyReducedEdgeSizes(ImageDecoder& decoder) {
+  const ImageSize sizes[] = {{1, 1}, {3, 2}, {7, 5}, {9, 17}, {33, 20}, {70, 41}};
+  for (const ImageSize size : sizes) {
+    std::vector<uint8_t> bgra(static_cast<size_t>(size.width) * size.height * 4);
+    for (size_t i = 0; i < bgra.size(); ++i) bgra[i] = static_cast<uint8_t>(i * 7 + i / 13);
+    const size_t stride = static_cast<size_t>(size.width) * 4;
+    const std::vector<uint8_t> png =
+        EncodePng(bgra.data(), size.width, size.height, stride, true, true);
+    const std::vector<uint8_t> jpeg = EncodeJpeg(bgra.data(), size.width, size.height, stride, 90);
+    for (const uint32_t cx : {1u, 2u, 5u, 9u}) {
+      const std::string name = std::to_string(size.width) + "x" + std::to_string(size.height);
+      if (!CheckReducedDecode(name + " adam7", png, true, true, cx, decoder)) return false;
+      DecodedImage image;
+      // Noise is far from what DCT scaling approximates well, so JPEG only has to keep its size.
+      if (decoder.Decode(jpeg, cx, &image) != DecodeStatus::kOk ||
+          image.width != (size.width + SelectDecodeScale(size.width, size.height, cx) - 1) /
+                             SelectDecodeScale(size.width, size.height, cx)) {
+        std::printf("FAILED: %s jpeg at %u\n", name.c_str(), cx);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// The corpus only holds PNG and JPEG, so WebP headers are built here: lossy, lossless and extended,
+// 1000x600 each. Every format must also ask for more bytes rather than guess from a cut header.
+bool VerifyProbes() {
+  const std::vector<uint8_t> webp_headers[] = {
+      {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', ' ', 0, 0, 0, 0,
+       0, 0, 0, 0x9D, 0x01, 0x2A, 0xE8, 0x03, 0x58, 0x02},
+      {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', 'L', 0, 0, 0, 0,
+       0x2F, 0xE7, 0xC3, 0x95, 0x00, 0, 0, 0, 0, 0},
+      {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'E', 'B', 'P', 'V', 'P', '8', 'X', 0, 0, 0, 0,
+       0, 0, 0, 0, 0xE7, 0x03, 0x00, 0x57, 0x02, 0x00},
+  };
+  for (const std::vector<uint8_t>& header : webp_headers) {
+    ImageSize size;
+    size_t needed = 0;
+    const ProbeStatus status = ProbeImageSize(header, &size, &needed);
+    if (status != ProbeStatus::kOk || size.width != 1000 || size.height != 600) {
+      std::printf("FAILED: webp probe: %s, %ux%u\n", ProbeStatusName(status), size.width,
+                  size.height);
+      return false;
+    }
+    const std::span<const uint8_t> cut(header.data(), header.size() - 1);
+    if (ProbeImageSize(cut, &size, &needed) != ProbeStatus::kNeedMore ||
+        needed != header.size()) {
+      std::printf("FAILED: cut webp probe\n");
+      return false;
+    }
+  }
+
+  const std::vector<uint8_t> png = EncodePng(webp_headers[0].data(), 1, 1, 4);
+  const std::vector<uint8_t> jpeg = EncodeJpeg(webp_headers[0].data(), 1, 1, 4, 90);
+  for (const std::vector<uint8_t>* image : {&png, &jpeg}) {
+    ImageSize size;
+    size_t needed = 0;
+    for (size_t length = 12; length < image->size(); ++length) {
+      const ProbeStatus status = ProbeImageSize(std::span(image->data(), length), &size, &needed);
+      if (status == ProbeStatus::kOk) break;
+      if (status != ProbeStatus::kNeedMore || needed <= length) {
+        std::printf("FAILED: %s probe at %zu bytes: %s\n", image == &png ? "png" : "jpeg",
+                    length, ProbeStatusName(status));
+        return false;
+      }
+    }
+    if (size.width != 1 || size.height != 1) {
+      std::printf("FAILED: %s probe: %ux%u\n", image == &png ? "png" : "jpeg", size.width,
+                  size.height);
+      return false;
+    }
+  }
+  return true;
+}
+
+void PrintStage(const CorpusSpec& spec, const char* stage, const BenchStats& stats) {
+  PrintBenchRow(std::string(spec.name) + " " + stage, stats);
+}
+
+// Times each GetThumbnail stage on its own, each fed by the previous stage's output.
+void BenchCorpusFile(const CorpusSpec& spec, const CorpusFile& file, ImageDecoder& decoder,
+                     int iterations) {
+  const std::string_view contents = file.contents;
+  // Where the pipeline's selection settles in every corpus layout.
+  const size_t preferred = file.field == kFieldNames[0] ? 0 : 1;
+
+  PrintStage(spec, "read", MeasureBench(contents.size(), iterations, [&] {
+    ChunkedMemorySource source(contents, JsonFieldReader::kReadChunk);
+    JsonFieldReader reader(kFieldNames);
+    reader.Read(source, [&](size_t index) { return index == preferred; });
+    DoNotOptimize(reader);
+  }));
+
+  JsonStringSpan spans[std::size(kFieldNames)];
+  PrintStage(spec, "locate", MeasureBench(contents.size(), iterations, [&] {
+    LocateJsonStringFields(contents, kFieldNames, spans);
+    DoNotOptimize(spans);
+  }));
+
+  const JsonStringSpan& selected = spans[file.field == kFieldNames[0] ? 0 : 1];
+  std::string unescaped;
+  std::string_view value;
+  ResolveJsonString(selected, &unescaped, &value);
+  const std::string_view encoded_image = StripDataUrlPrefix(value);
+  std::vector<uint8_t> encoded(Base64DecodedSizeUpperBound(encoded_image.size()));
+  Base64Result decoded;
+  PrintStage(spec, "base64", MeasureBench(selected.raw.size(), iterations, [&] {
+    std::string storage;
+    std::string_view text;
+    ResolveJsonString(selected, &storage, &text);
+    decoded = DecodeBase64(StripDataUrlPrefix(text), encoded.data(), encoded.size());
+    DoNotOptimize(decoded);
+  }));
+
+  const std::span<const uint8_t> image_bytes(encoded.data(), decoded.written);
+  DecodedImage image;
+  PrintStage(spec, "decode", MeasureBench(image_bytes.size(), iterations, [&] {
+    decoder.Decode(image_bytes, spec.cx, &image);
+    DoNotOptimize(image);
+  }));
+  if (image.width != image.source_width) {
+    // What the reduced decode saves.
+    DecodedImage full;
+    PrintStage(spec, "decode-full", MeasureBench(image_bytes.size(), iterations, [&] {
+      decoder.Decode(image_bytes, 0, &full);
+      DoNotOptimize(full);
+    }));
+  }
+
+  const ImageSize size = file.expected;
+  const size_t dest_stride = static_cast<size_t>(size.width) * 4;
+  std::vector<uint8_t> dest(dest_stride * size.height);
+  PrintStage(spec, "scale",
+             MeasureBench(static_cast<size_t>(image.height) * image.stride, iterations, [&] {
+               ScaleToPremultipliedBgra(image.pixels.get(), image.width, image.height,
+                                        image.stride, dest.data(), size.width, size.height,
+                                        dest_stride);
+               DoNotOptimize(dest);
+             }));
+
+  // A DIB section arrives as fresh zeroed pages, so every call pays for the first touch.
+  PrintStage(spec, "dib-fill", MeasureBench(dest.size(), iterations, [&] {
+    std::unique_ptr<uint8_t[]> bits(new uint8_t[dest.size()]());
+    std::memcpy(bits.get(), dest.data(), dest.size());
+    DoNotOptimize(bits);
+  }));
+
+  PrintStage(spec, "end-to-end", MeasureBench(contents.size(), iterations, [&] {
+    ChunkedMemorySource source(contents, JsonFieldReader::kReadChunk);
+    std::unique_ptr<uint8_t[]> bits;
+    RenderThumbnail(source, spec.cx, decoder, [&](uint32_t width, uint32_t height,
+                                                  size_t* stride) {
+      *stride = static_cast<size_t>(width) * 4;
+      bits.reset(new uint8_t[*stride * height]());
+      return bits.get();
+    });
+    DoNotOptimize(bits);
+  }));
+}
+
+}  // namespace
+
+int RunPipelineBench(const BenchOptions& options) {
+  PrintBenchHeader("pipeline");
+
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  int failures = VerifyProbes() ? 0 : 1;
+  if (!VerifyReducedEdgeSizes(*decoder)) ++failures;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    const CorpusFile file = GenerateCorpusFile(spec);
+    LazyTestDecoder lazy(*decoder);
+    if (!VerifyCorpusFile(spec, file, *decoder) || !VerifyCorpusFile(spec, file, lazy) ||
+        !VerifyReducedDecode(spec, file, *decoder)) {
+      ++failures;
+      continue;
+    }
+    BenchCorpusFile(spec, file, *decoder, options.iterations);
+  }
+  if (failures != 0) {
+    std::printf("FAILED: %d corpus files\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
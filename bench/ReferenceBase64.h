@@ -0,0 +1,105 @@
+#pragma once
+
+// A deliberately naive, one-character-at-a-time decoder that implements the same grammar as
+// vibe::DecodeBase64. Used as the oracle for differential checks and as the scalar baseline.
+
+#include "Base64.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibe::bench::reference {
+
+inline int Base64Value(char ch) {
+  if (ch >= 'A' && ch <= 'Z') return ch - 'A';
+  if (ch >= 'a' && ch <= 'z') return ch - 'a' + 26;
+  if (ch >= '0' && ch <= '9') return ch - '0' + 52;
+  if (ch == '+') return 62;
+  if (ch == '/') return 63;
+  return -1;
+}
+
+inline bool IsBase64Whitespace(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+}
+
+inline Base64Result DecodeBase64(std::string_view input, std::vector<uint8_t>* output) {
+  output->clear();
+  std::vector<int> sextets;
+  size_t i = 0;
+  for (; i < input.size(); ++i) {
+    const char ch = input[i];
+    if (IsBase64Whitespace(ch)) continue;
+    if (ch == '=') break;
+    const int value = Base64Value(ch);
+    if (value < 0) return {Base64Status::kInvalidCharacter, output->size(), i};
+    sextets.push_back(value);
+    if (sextets.size() == 4) {
+      output->push_back(static_cast<uint8_t>((sextets[0] << 2) | (sextets[1] >> 4)));
+      output->push_back(static_cast<uint8_t>((sextets[1] << 4) | (sextets[2] >> 2)));
+      output->push_back(static_cast<uint8_t>((sextets[2] << 6) | sextets[3]));
+      sextets.clear();
+    }
+  }
+
+  if (i < input.size()) {
+    if (sextets.size() < 2) return {Base64Status::kInvalidPadding, output->size(), i};
+    const size_t allowed = 4 - sextets.size();
+    size_t pads = 0;
+    for (size_t j = i; j < input.size(); ++j) {
+      if (input[j] == '=') {
+        if (++pads > allowed) return {Base64Status::kInvalidPadding, output->size(), j};
+      } else if (!IsBase64Whitespace(input[j])) {
+        return {Base64Status::kInvalidPadding, output->size(), j};
+      }
+    }
+  }
+
+  if (sextets.size() == 1) return {Base64Status::kTruncated, output->size(), input.size()};
+  if (sextets.size() >= 2) {
+    output->push_back(static_cast<uint8_t>((sextets[0] << 2) | (sextets[1] >> 4)));
+  }
+  if (sextets.size() == 3) {
+    output->push_back(static_cast<uint8_t>((sextets[1] << 4) | (sextets[2] >> 2)));
+  }
+  return {Base64Status::kOk, output->size(), 0};
+}
+
+inline constexpr char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Standard alphabet with padding; a non-zero |line_length| wraps lines with CRLF.
+inline std::string EncodeBase64(std::span<const uint8_t> data, size_t line_length = 0) {
+  std::string out;
+  out.reserve(data.size() / 3 * 4 + 4 + (line_length ? data.size() / line_length * 2 : 0));
+  size_t column = 0;
+  auto emit = [&](char ch) {
+    out.push_back(ch);
+    if (line_length && ++column == line_length) {
+      out.append("\r\n");
+      column = 0;
+    }
+  };
+  size_t i = 0;
+  for (; i + 3 <= data.size(); i += 3) {
+    const uint32_t quantum = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+    emit(kBase64Alphabet[(quantum >> 18) & 63]);
+    emit(kBase64Alphabet[(quantum >> 12) & 63]);
+    emit(kBase64Alphabet[(quantum >> 6) & 63]);
+    emit(kBase64Alphabet[quantum & 63]);
+  }
+  if (i < data.size()) {
+    const uint32_t quantum = (data[i] << 16) | (i + 1 < data.size() ? data[i + 1] << 8 : 0);
+    emit(kBase64Alphabet[(quantum >> 18) & 63]);
+    emit(kBase64Alphabet[(quantum >> 12) & 63]);
+    emit(i + 1 < data.size() ? kBase64Alphabet[(quantum >> 6) & 63] : '=');
+    emit('=');
+  }
+  return out;
+}
+
+}  // namespace vibe::bench::reference
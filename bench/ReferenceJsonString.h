@@ -0,0 +1,138 @@
+#pragma once
+
+// The byte-at-a-time JSON string decoder the provider shipped with before the vectorized scanner.
+// Kept verbatim as the baseline for benchmarks and differential checks.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace vibe::bench::reference {
+
+inline bool ParseHex4(std::string_view text, size_t pos, uint16_t* value) {
+  if (!value || pos + 4 > text.size()) return false;
+
+  uint16_t result = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const unsigned char ch = static_cast<unsigned char>(text[pos + i]);
+    uint16_t nibble = 0;
+    if (ch >= '0' && ch <= '9') {
+      nibble = static_cast<uint16_t>(ch - '0');
+    } else if (ch >= 'A' && ch <= 'F') {
+      nibble = static_cast<uint16_t>(ch - 'A' + 10);
+    } else if (ch >= 'a' && ch <= 'f') {
+      nibble = static_cast<uint16_t>(ch - 'a' + 10);
+    } else {
+      return false;
+    }
+    result = static_cast<uint16_t>((result << 4) | nibble);
+  }
+
+  *value = result;
+  return true;
+}
+
+inline void AppendUtf8Codepoint(uint32_t codepoint, std::string* out) {
+  if (!out) return;
+
+  if (codepoint <= 0x7F) {
+    out->push_back(static_cast<char>(codepoint));
+    return;
+  }
+
+  if (codepoint <= 0x7FF) {
+    out->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    return;
+  }
+
+  if (codepoint <= 0xFFFF) {
+    out->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+    return;
+  }
+
+  if (codepoint <= 0x10FFFF) {
+    out->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+  }
+}
+
+inline bool DecodeJsonString(std::string_view text, size_t quote_pos, std::string* out, size_t* end_pos) {
+  if (!out || !end_pos || quote_pos >= text.size() || text[quote_pos] != '"') return false;
+
+  std::string decoded;
+  size_t i = quote_pos + 1;
+  while (i < text.size()) {
+    char ch = text[i++];
+    if (ch == '"') {
+      *out = std::move(decoded);
+      *end_pos = i;
+      return true;
+    }
+
+    if (ch != '\\') {
+      decoded.push_back(ch);
+      continue;
+    }
+
+    if (i >= text.size()) return false;
+    char escaped = text[i++];
+    switch (escaped) {
+      case '"':
+      case '\\':
+      case '/':
+        decoded.push_back(escaped);
+        break;
+      case 'b':
+        decoded.push_back('\b');
+        break;
+      case 'f':
+        decoded.push_back('\f');
+        break;
+      case 'n':
+        decoded.push_back('\n');
+        break;
+      case 'r':
+        decoded.push_back('\r');
+        break;
+      case 't':
+        decoded.push_back('\t');
+        break;
+      case 'u':
+        {
+          uint16_t code_unit = 0;
+          if (!ParseHex4(text, i, &code_unit)) return false;
+          i += 4;
+
+          uint32_t codepoint = code_unit;
+          if (code_unit >= 0xD800 && code_unit <= 0xDBFF) {
+            if (i + 6 > text.size() || text[i] != '\\' || text[i + 1] != 'u') return false;
+            uint16_t low_surrogate = 0;
+            if (!ParseHex4(text, i + 2, &low_surrogate)) return false;
+            if (low_surrogate < 0xDC00 || low_surrogate > 0xDFFF) return false;
+            i += 6;
+
+            codepoint = 0x10000 +
+                        ((static_cast<uint32_t>(code_unit - 0xD800) << 10) |
+                         static_cast<uint32_t>(low_surrogate - 0xDC00));
+          } else if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+            return false;
+          }
+
+          AppendUtf8Codepoint(codepoint, &decoded);
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace vibe::bench::reference
@@ -0,0 +1,215 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "CpuFeatures.h"
+#include "Scaler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr SimdLevel kLevels[] = {SimdLevel::kScalar, SimdLevel::kSse41, SimdLevel::kAvx2};
+constexpr double kMinPsnr = 40.0;
+
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+// Smooth gradients with noise and a patchy alpha channel, so premultiplication matters.
+Image MakeImage(std::mt19937& rng, uint32_t width, uint32_t height) {
+  Image image{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4)};
+  std::uniform_int_distribution<int> noise(-12, 12);
+  const int alpha_mode = static_cast<int>(rng() % 3);
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      uint8_t* pixel = image.pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+      pixel[0] = static_cast<uint8_t>(std::clamp(static_cast<int>(x * 255 / width) + noise(rng),
+                                                 0, 255));
+      pixel[1] = static_cast<uint8_t>(std::clamp(static_cast<int>(y * 255 / height) + noise(rng),
+                                                 0, 255));
+      pixel[2] = static_cast<uint8_t>(((x / 7) ^ (y / 5)) & 1 ? 230 : 20);
+      if (alpha_mode == 0) {
+        pixel[3] = 255;
+      } else if (alpha_mode == 1) {
+        pixel[3] = static_cast<uint8_t>((x / 9 + y / 9) % 3 == 0 ? 0 : 255);
+      } else {
+        pixel[3] = static_cast<uint8_t>(rng());
+      }
+    }
+  }
+  return image;
+}
+
+// Independent double-precision resampler: the same filters evaluated directly per destination
+// pixel, without the padded windows or the row ring.
+std::vector<double> ReferenceWeights(uint32_t source, uint32_t dest, bool area, uint32_t o) {
+  const double scale = static_cast<double>(source) / dest;
+  std::vector<double> weights(source, 0.0);
+  double total = 0.0;
+  for (uint32_t i = 0; i < source; ++i) {
+    double weight = 0.0;
+    if (area) {
+      weight = std::min<double>(i + 1, (o + 1) * scale) - std::max<double>(i, o * scale);
+    } else {
+      const double support = std::max(1.0, scale);
+      const double center = (o + 0.5) * scale - 0.5;
+      weight = 1.0 - std::abs(i - center) / support;
+    }
+    weights[i] = std::max(0.0, weight);
+    total += weights[i];
+  }
+  if (total <= 0.0) {
+    const int64_t nearest = static_cast<int64_t>((o + 0.5) * scale);
+    weights[std::clamp<int64_t>(nearest, 0, source - 1)] = total = 1.0;
+  }
+  for (double& weight : weights) weight /= total;
+  return weights;
+}
+
+std::vector<uint8_t> ReferenceScale(const Image& image, uint32_t dest_width,
+                                    uint32_t dest_height, bool area) {
+  std::vector<uint8_t> out(static_cast<size_t>(dest_width) * dest_height * 4);
+  for (uint32_t oy = 0; oy < dest_height; ++oy) {
+    const std::vector<double> wy = ReferenceWeights(image.height, dest_height, area, oy);
+    for (uint32_t ox = 0; ox < dest_width; ++ox) {
+      const std::vector<double> wx = ReferenceWeights(image.width, dest_width, area, ox);
+      double sum[4] = {};
+      for (uint32_t y = 0; y < image.height; ++y) {
+        if (wy[y] == 0.0) continue;
+        for (uint32_t x = 0; x < image.width; ++x) {
+          if (wx[x] == 0.0) continue;
+          const uint8_t* pixel =
+              image.pixels.data() + (static_cast<size_t>(y) * image.width + x) * 4;
+          const double weight = wy[y] * wx[x];
+          const double alpha = pixel[3] / 255.0;
+          for (int c = 0; c < 3; ++c) sum[c] += weight * alpha * pixel[c];
+          sum[3] += weight * pixel[3];
+        }
+      }
+      uint8_t* dest = out.data() + (static_cast<size_t>(oy) * dest_width + ox) * 4;
+      for (int c = 0; c < 4; ++c) {
+        dest[c] = static_cast<uint8_t>(std::clamp(std::lround(sum[c]), 0L, 255L));
+      }
+    }
+  }
+  return out;
+}
+
+double Psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b) {
+  double squared = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    const double diff = static_cast<double>(a[i]) - b[i];
+    squared += diff * diff;
+  }
+  if (squared == 0.0) return 99.0;
+  return 10.0 * std::log10(255.0 * 255.0 * a.size() / squared);
+}
+
+bool IsPremultiplied(const std::vector<uint8_t>& pixels) {
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    if (pixels[i] > pixels[i + 3] || pixels[i + 1] > pixels[i + 3] ||
+        pixels[i + 2] > pixels[i + 3]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> Scale(const Image& image, ImageSize size, ScaleFilter filter) {
+  std::vector<uint8_t> out(static_cast<size_t>(size.width) * size.height * 4);
+  ScaleToPremultipliedBgra(image.pixels.data(), image.width, image.height,
+                           static_cast<size_t>(image.width) * 4, out.data(), size.width,
+                           size.height, static_cast<size_t>(size.width) * 4, filter);
+  return out;
+}
+
+// Every dispatch level must match the scalar kernel bit for bit, and the scalar kernel must stay
+// within kMinPsnr of the double-precision reference.
+int VerifyAgainstReference() {
+  std::mt19937 rng(0x5ca1e);
+  int failures = 0;
+  double worst_psnr = 99.0;
+  for (int i = 0; i < 300; ++i) {
+    const uint32_t width = 1 + rng() % 160;
+    const uint32_t height = 1 + rng() % 160;
+    const Image image = MakeImage(rng, width, height);
+    const uint32_t cx = 1 + rng() % std::max(width, height);
+    const ImageSize size = ComputeThumbnailSize(width, height, cx);
+    const ScaleFilter filter = i % 3 == 0 ? ScaleFilter::kBilinear : ScaleFilter::kAreaAverage;
+
+    SetSimdLevelCap(SimdLevel::kScalar);
+    const std::vector<uint8_t> scalar = Scale(image, size, filter);
+    const std::vector<uint8_t> expected =
+        ReferenceScale(image, size.width, size.height, filter == ScaleFilter::kAreaAverage);
+    const double psnr = Psnr(scalar, expected);
+    worst_psnr = std::min(worst_psnr, psnr);
+    if ((psnr < kMinPsnr || !IsPremultiplied(scalar)) && failures++ < 5) {
+      std::printf("quality failure %ux%u -> %ux%u: %.2f dB\n", width, height, size.width,
+                  size.height, psnr);
+    }
+
+    for (SimdLevel level : kLevels) {
+      SetSimdLevelCap(level);
+      if (Scale(image, size, filter) != scalar && failures++ < 5) {
+        std::printf("mismatch at %s: %ux%u -> %ux%u\n", SimdLevelName(level), width, height,
+                    size.width, size.height);
+      }
+    }
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+  std::printf("worst PSNR against the reference: %.2f dB\n", worst_psnr);
+  return failures;
+}
+
+void BenchCase(uint32_t width, uint32_t height, uint32_t cx, ScaleFilter filter, int iterations) {
+  std::mt19937 rng(width ^ cx);
+  const Image image = MakeImage(rng, width, height);
+  const ImageSize size = ComputeThumbnailSize(width, height, cx);
+  std::vector<uint8_t> out(static_cast<size_t>(size.width) * size.height * 4);
+
+  const SimdLevel detected = ActiveSimdLevel();
+  for (SimdLevel level : kLevels) {
+    if (level > detected) continue;
+    SetSimdLevelCap(level);
+    const std::string name = std::to_string(width) + "x" + std::to_string(height) + " -> " +
+                             std::to_string(size.width) + "x" + std::to_string(size.height) +
+                             (filter == ScaleFilter::kBilinear ? " bilinear " : " ") +
+                             SimdLevelName(level);
+    PrintBenchRow(name, MeasureBench(image.pixels.size(), iterations, [&] {
+      ScaleToPremultipliedBgra(image.pixels.data(), width, height,
+                               static_cast<size_t>(width) * 4, out.data(), size.width,
+                               size.height, static_cast<size_t>(size.width) * 4, filter);
+      DoNotOptimize(out);
+    }));
+  }
+  SetSimdLevelCap(SimdLevel::kAvx2);
+}
+
+}  // namespace
+
+int RunScaleBench(const BenchOptions& options) {
+  PrintBenchHeader("scale");
+
+  const int failures = VerifyAgainstReference();
+  if (failures != 0) {
+    std::printf("FAILED: %d scaler checks\n", failures);
+    return 1;
+  }
+
+  BenchCase(1024, 1024, 96, ScaleFilter::kAuto, options.iterations);
+  BenchCase(1024, 1024, 256, ScaleFilter::kAuto, options.iterations);
+  BenchCase(2048, 1536, 256, ScaleFilter::kAuto, options.iterations);
+  BenchCase(640, 480, 400, ScaleFilter::kAuto, options.iterations);
+  return 0;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,165 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "CpuFeatures.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr std::string_view kKeys[] = {"thumbnail", "image"};
+constexpr SimdLevel kLevels[] = {SimdLevel::kScalar, SimdLevel::kSse2, SimdLevel::kAvx2};
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+// String bodies built to trip a structural index: brackets and quotes that must be masked off,
+// and backslash runs of both parities.
+constexpr std::string_view kStringPieces[] = {
+    "[", "]", "{", "}", "\\\"", "\\\\", "\\\\\\\"", "\\\\\\\\", "\\/", "\\u005B", "abc", ":,",
+};
+
+void AppendString(std::mt19937& rng, std::string* out) {
+  out->push_back('"');
+  const size_t pieces = rng() % 8;
+  for (size_t i = 0; i < pieces; ++i) out->append(kStringPieces[rng() % std::size(kStringPieces)]);
+  out->push_back('"');
+}
+
+void AppendValue(std::mt19937& rng, int depth, std::string* out) {
+  const unsigned kind = depth > 6 ? rng() % 3 : rng() % 5;
+  if (kind == 0) {
+    AppendString(rng, out);
+  } else if (kind == 1) {
+    *out += std::to_string(static_cast<int>(rng() % 20000) - 10000) + ".25e-3";
+  } else if (kind == 2) {
+    *out += rng() % 2 ? "true" : "null";
+  } else {
+    const bool object = kind == 3;
+    out->push_back(object ? '{' : '[');
+    const size_t count = rng() % 6;
+    for (size_t i = 0; i < count; ++i) {
+      if (i) *out += rng() % 2 ? "," : " ,\n ";
+      if (object) {
+        AppendString(rng, out);
+        out->push_back(':');
+      }
+      AppendValue(rng, depth + 1, out);
+    }
+    out->push_back(object ? '}' : ']');
+  }
+}
+
+// Field spans as offsets, comparable across runs over the same bytes.
+std::vector<size_t> Locate(const std::string& json, bool structural = true) {
+  JsonScanBudget budget;
+  budget.structural_skip = structural;
+  JsonStringSpan spans[std::size(kKeys)];
+  LocateJsonStringFields(json, kKeys, spans, budget);
+  std::vector<size_t> found;
+  for (const JsonStringSpan& span : spans) {
+    found.push_back(span.found ? static_cast<size_t>(span.raw.data() - json.data()) : 0);
+  }
+  return found;
+}
+
+std::vector<size_t> LocateStreamed(const std::string& json) {
+  ChunkedMemorySource source(json, 1000);
+  JsonFieldReader reader(kKeys);
+  reader.Read(source, nullptr);
+  std::vector<size_t> found;
+  for (size_t i = 0; i < std::size(kKeys); ++i) {
+    const JsonStringSpan span = reader.field(i);
+    found.push_back(span.found ? static_cast<size_t>(span.raw.data() - reader.data().data()) : 0);
+  }
+  return found;
+}
+
+// On valid documents the structural skip must land exactly where the token walker does, at
+// every SIMD level, at every alignment against the 64-byte blocks, whole and streamed.
+bool VerifyAgainstTokenWalker() {
+  std::mt19937 rng(0x5c1b);
+  int mismatches = 0;
+  for (int i = 0; i < 3000; ++i) {
+    std::string metadata;
+    AppendValue(rng, 0, &metadata);
+    const std::string json = "{\"pad\":\"" + std::string(i % 130, ' ') + "\",\"meta\":" +
+                             metadata + ",\"thumbnail\":\"t\",\"more\":[" + metadata +
+                             "],\"image\":\"i\"}";
+    const std::vector<size_t> expected = Locate(json, false);
+    for (const SimdLevel level : kLevels) {
+      SetSimdLevelCap(level);
+      if (Locate(json) != expected || LocateStreamed(json) != expected) {
+        if (++mismatches <= 5) {
+          std::printf("FAILED: structural skip differs at %s on %s\n", SimdLevelName(level),
+                      json.c_str());
+        }
+      }
+    }
+    SetSimdLevelCap(SimdLevel::kAvx2);
+  }
+  return Expect(mismatches == 0, std::to_string(mismatches) + " structural skip mismatches");
+}
+
+// A vibe file whose metadata carries |megabytes| of numeric vectors ahead of the payloads.
+std::string MakeNumericFile(size_t megabytes) {
+  std::mt19937 rng(static_cast<uint32_t>(megabytes));
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  std::string json = "{\"identifier\":\"novelai-vibe-transfer\",\"encodings\":{\"v4full\":[";
+  char number[32];
+  while (json.size() < megabytes << 20) {
+    json += "{\"values\":[";
+    for (int i = 0; i < 1024; ++i) {
+      if (i) json.push_back(',');
+      json.append(number, std::snprintf(number, sizeof(number), "%.7f", value(rng)));
+    }
+    json += "],\"strength\":0.6},";
+  }
+  json.back() = ']';
+  json += "},\"thumbnail\":\"aGVsbG8=\",\"image\":\"aGVsbG8=\"}";
+  return json;
+}
+
+}  // namespace
+
+int RunSkipBench(const BenchOptions& options) {
+  int failures = 0;
+  if (!VerifyAgainstTokenWalker()) ++failures;
+
+  PrintBenchHeader("skip");
+  for (const size_t megabytes : {1, 2, 5, 10}) {
+    const std::string json = MakeNumericFile(megabytes);
+    const std::string name = std::to_string(megabytes) + " MB numbers ";
+    const std::vector<size_t> expected = Locate(json, false);
+    PrintBenchRow(name + "token walker", MeasureBench(json.size(), options.iterations, [&] {
+                    DoNotOptimize(Locate(json, false));
+                  }));
+    for (const SimdLevel level : kLevels) {
+      SetSimdLevelCap(level);
+      if (ActiveSimdLevel() != level) continue;
+      if (!Expect(Locate(json) == expected, name + "structural skip differs")) ++failures;
+      PrintBenchRow(name + "structural " + SimdLevelName(level),
+                    MeasureBench(json.size(), options.iterations,
+                                 [&] { DoNotOptimize(Locate(json)); }));
+    }
+    SetSimdLevelCap(SimdLevel::kAvx2);
+  }
+
+  if (failures != 0) {
+    std::printf("FAILED: %d skip checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
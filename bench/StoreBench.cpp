@@ -0,0 +1,385 @@
+#include "Bench.h"
+
+#include "BenchUtil.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "JsonFieldLocator.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailPipeline.h"
+#include "ThumbnailStore.h"
+#include "VibeCorpus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr std::string_view kFiles[] = {"thumb-64k", "thumb-image-1m", "jpeg-thumb-image-4m",
+                                       "big-thumb-image-4m", "small-thumb-image-1m"};
+constexpr uint32_t kSizes[] = {96, 256};
+constexpr uint64_t kStoreBytes = uint64_t{16} << 20;
+
+struct Thumbnail {
+  ImageSize size;
+  std::vector<uint8_t> pixels;
+};
+
+ThumbnailAllocator AllocateInto(Thumbnail* thumbnail) {
+  return [thumbnail](uint32_t width, uint32_t height, size_t* stride) {
+    thumbnail->size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    thumbnail->pixels.assign(*stride * height, 0);
+    return thumbnail->pixels.data();
+  };
+}
+
+bool Same(const Thumbnail& a, const Thumbnail& b) {
+  return a.size.width == b.size.width && a.size.height == b.size.height && a.pixels == b.pixels;
+}
+
+struct Case {
+  std::string name;
+  std::string contents;
+  uint32_t cx = 0;
+  // The key RenderThumbnail uses for the field it selects.
+  ThumbnailCacheKey key;
+  Thumbnail expected;
+};
+
+ThumbnailStatus Render(const Case& c, ImageDecoder& decoder, ThumbnailCache* cache,
+                       Thumbnail* thumbnail) {
+  MemoryByteSource source(c.contents);
+  return RenderThumbnail(source, c.cx, decoder, AllocateInto(thumbnail), DecodeLimits(), cache);
+}
+
+std::vector<Case> BuildCases(ImageDecoder& decoder) {
+  constexpr std::string_view kFieldNames[] = {"thumbnail", "image"};
+  std::vector<Case> cases;
+  for (const CorpusSpec& spec : DefaultCorpus()) {
+    if (std::find(std::begin(kFiles), std::end(kFiles), spec.name) == std::end(kFiles)) continue;
+    const CorpusFile file = GenerateCorpusFile(spec);
+    JsonStringSpan spans[std::size(kFieldNames)];
+    LocateJsonStringFields(file.contents, kFieldNames, spans);
+    const ThumbnailCacheKey key =
+        ThumbnailCacheKey::For(spans[file.field == kFieldNames[0] ? 0 : 1].raw);
+    for (const uint32_t cx : kSizes) {
+      Case c{std::string(spec.name) + " cx" + std::to_string(cx), file.contents, cx, key, {}};
+      if (Render(c, decoder, nullptr, &c.expected) != ThumbnailStatus::kOk) {
+        std::printf("FAILED: %s: uncached render\n", c.name.c_str());
+        return {};
+      }
+      cases.push_back(std::move(c));
+    }
+  }
+  return cases;
+}
+
+bool Expect(bool condition, const std::string& what) {
+  if (!condition) std::printf("FAILED: %s\n", what.c_str());
+  return condition;
+}
+
+void PrintRow(const std::string& name, const ThumbnailStoreStats& stats) {
+  std::printf("%-44s %12llu %12llu %12llu\n", name.c_str(),
+              static_cast<unsigned long long>(stats.hits),
+              static_cast<unsigned long long>(stats.misses),
+              static_cast<unsigned long long>(stats.compactions));
+}
+
+// Looks every case up in |store| directly. A hit must be exactly the uncached render; returns
+// the number of hits, or -1 after a wrong answer.
+int CountHits(ThumbnailStore& store, const std::vector<Case>& cases) {
+  int hits = 0;
+  for (const Case& c : cases) {
+    Thumbnail got;
+    StoredThumbnail stored;
+    if (store.Lookup(c.key, c.cx, AllocateInto(&got), &stored) != CacheLookup::kHit) continue;
+    if (!Same(got, c.expected)) {
+      std::printf("FAILED: %s: stored thumbnail differs\n", c.name.c_str());
+      return -1;
+    }
+    ++hits;
+  }
+  return hits;
+}
+
+// Fills a store through a cache, then renders everything again with a fresh cache and a reopened
+// store, as after the surrogate process was recycled.
+bool VerifyRestart(const std::filesystem::path& path, const std::vector<Case>& cases,
+                   ImageDecoder& decoder) {
+  bool ok = true;
+  {
+    ThumbnailStore store;
+    ok &= Expect(store.Open(path, kStoreBytes), "store does not open");
+    ThumbnailCache cache(size_t{64} << 20);
+    cache.set_store(&store);
+    for (const Case& c : cases) {
+      Thumbnail got;
+      ok &= Expect(Render(c, decoder, &cache, &got) == ThumbnailStatus::kOk && Same(got, c.expected),
+                   "first render through the store");
+    }
+    ok &= Expect(store.stats().insertions == cases.size(), "every render was stored");
+  }
+
+  ThumbnailStore store;
+  ok &= Expect(store.Open(path, kStoreBytes), "store does not reopen");
+  ThumbnailCache cache(size_t{64} << 20);
+  cache.set_store(&store);
+  for (const Case& c : cases) {
+    Thumbnail got;
+    ok &= Expect(Render(c, decoder, &cache, &got) == ThumbnailStatus::kOk && Same(got, c.expected),
+                 "render after reopening differs");
+  }
+  const ThumbnailCacheStats stats = cache.stats();
+  ok &= Expect(stats.stored == cases.size() && stats.misses == 0,
+               "reopened store did not answer every render");
+  ok &= Expect(store.stats().entries == cases.size(), "entries after reopening");
+  PrintRow("restart", store.stats());
+  return ok;
+}
+
+void Overwrite(const std::filesystem::path& path, uint64_t offset, std::string_view bytes) {
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(static_cast<std::streamoff>(offset));
+  file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Refills the store with every case and checks that all of them are then found.
+bool Refill(ThumbnailStore& store, const std::vector<Case>& cases, const std::string& what) {
+  for (const Case& c : cases) {
+    store.Insert(c.key, c.cx, 0, 0, c.expected.pixels.data(), c.expected.size.width,
+                 c.expected.size.height, static_cast<size_t>(c.expected.size.width) * 4);
+  }
+  return Expect(CountHits(store, cases) == static_cast<int>(cases.size()), what);
+}
+
+// Damages the file the ways a crash, a full disk or a stray writer might, and checks that the
+// store never hands out wrong pixels and keeps working afterwards.
+bool VerifyDamage(const std::filesystem::path& path, const std::vector<Case>& cases) {
+  bool ok = true;
+  ThumbnailStore store;
+  std::mt19937 rng(99);
+
+  // One header copy torn: the other one still describes a consistent store.
+  Overwrite(path, 0, std::string(64, '\xA5'));
+  ok &= Expect(store.Open(path, kStoreBytes), "open with one header copy torn");
+  ok &= Expect(CountHits(store, cases) >= 0, "wrong pixels after a torn header");
+  ok &= Refill(store, cases, "store unusable after a torn header");
+  store.Close();
+
+  // Both copies gone: the store starts over.
+  Overwrite(path, 0, std::string(512, '\0'));
+  ok &= Expect(store.Open(path, kStoreBytes), "open with both header copies gone");
+  ok &= Expect(CountHits(store, cases) == 0, "entries survived losing both headers");
+  ok &= Refill(store, cases, "store unusable after losing both headers");
+  store.Close();
+
+  // Bytes flipped all over the index and heap.
+  for (int i = 0; i < 400; ++i) {
+    const uint64_t offset = 4096 + rng() % (kStoreBytes - 4096);
+    Overwrite(path, offset, std::string(1, static_cast<char>(rng())));
+  }
+  ok &= Expect(store.Open(path, kStoreBytes), "open after random damage");
+  const int survived = CountHits(store, cases);
+  ok &= Expect(survived >= 0, "wrong pixels after random damage");
+  ok &= Refill(store, cases, "store unusable after random damage");
+  PrintRow("damaged (" + std::to_string(survived) + " survived)", store.stats());
+  store.Close();
+
+  // Truncated: a file of another size is a different store.
+  std::filesystem::resize_file(path, kStoreBytes / 2);
+  ok &= Expect(store.Open(path, kStoreBytes), "open after truncation");
+  ok &= Expect(CountHits(store, cases) == 0, "entries survived truncation");
+  ok &= Refill(store, cases, "store unusable after truncation");
+  return ok;
+}
+
+// A store reopened at another capacity, as after StoreMegabytes changed, takes that size and
+// starts over; reopened at the same one, it keeps its entries.
+bool VerifyResize(const std::filesystem::path& path, const std::vector<Case>& cases) {
+  bool ok = true;
+  ThumbnailStore store;
+  for (const uint64_t capacity : {kStoreBytes, kStoreBytes * 2, kStoreBytes / 4}) {
+    const std::string size = std::to_string(capacity >> 20) + " MB";
+    ok &= Expect(store.Open(path, capacity), "open at " + size);
+    std::error_code error;
+    ok &= Expect(std::filesystem::file_size(path, error) == capacity,
+                 "store not resized to " + size);
+    ok &= Expect(CountHits(store, cases) == 0, "entries survived resizing to " + size);
+    ok &= Refill(store, cases, "store unusable after resizing to " + size);
+    store.Close();
+    ok &= Expect(store.Open(path, capacity), "reopen at " + size);
+    ok &= Expect(CountHits(store, cases) == static_cast<int>(cases.size()),
+                 "entries lost reopening at " + size);
+    store.Close();
+  }
+
+  // While another instance has the file mapped, opening it at another capacity leaves it be.
+  ok &= Expect(store.Open(path, kStoreBytes), "open before sharing");
+  ok &= Refill(store, cases, "store unusable before sharing");
+  ThumbnailStore other;
+  ok &= Expect(other.Open(path, kStoreBytes * 2), "open at another capacity while mapped");
+  std::error_code error;
+  ok &= Expect(std::filesystem::file_size(path, error) == kStoreBytes,
+               "store resized while mapped elsewhere");
+  ok &= Expect(CountHits(other, cases) == static_cast<int>(cases.size()),
+               "entries lost opening at another capacity while mapped");
+  other.Close();
+  store.Close();
+  return ok;
+}
+
+// A synthetic thumbnail whose every byte depends on |id|.
+std::vector<uint8_t> Pattern(uint64_t id, uint32_t width, uint32_t height) {
+  std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    pixels[i] = static_cast<uint8_t>(id * 131 + i * 7 + (i >> 9));
+  }
+  return pixels;
+}
+
+bool LookupPattern(ThumbnailStore& store, uint64_t id, uint32_t cx, bool* wrong) {
+  Thumbnail got;
+  StoredThumbnail stored;
+  if (store.Lookup({id, id}, cx, AllocateInto(&got), &stored) != CacheLookup::kHit) return false;
+  if (got.pixels != Pattern(id, cx, cx)) *wrong = true;
+  return true;
+}
+
+// Inserts far more than fits while keeping a few entries hot, and checks that compaction keeps
+// the hot ones and the newest.
+bool VerifyCompaction(const std::filesystem::path& path) {
+  constexpr uint32_t kCx = 96;
+  constexpr uint64_t kHot = 4;
+  constexpr uint64_t kInserted = 300;
+  ThumbnailStore store;
+  bool ok = Expect(store.Open(path, ThumbnailStore::kMinCapacity), "small store does not open");
+  bool wrong = false;
+  for (uint64_t id = 1; id <= kInserted; ++id) {
+    const std::vector<uint8_t> pixels = Pattern(id, kCx, kCx);
+    ok &= Expect(store.Insert({id, id}, kCx, kCx, kCx, pixels.data(), kCx, kCx, kCx * 4),
+                 "insert into a full store");
+    for (uint64_t hot = 1; hot <= std::min(kHot, id); ++hot) {
+      ok &= Expect(LookupPattern(store, hot, kCx, &wrong), "hot entry compacted away");
+    }
+  }
+  ok &= Expect(LookupPattern(store, kInserted, kCx, &wrong), "newest entry compacted away");
+  ok &= Expect(!LookupPattern(store, kHot + 1, kCx, &wrong), "cold entry outlived compaction");
+  ok &= Expect(!wrong, "wrong pixels after compaction");
+  const ThumbnailStoreStats stats = store.stats();
+  ok &= Expect(stats.compactions > 0, "store never compacted");
+  ok &= Expect(stats.heap_bytes <= ThumbnailStore::kMinCapacity, "heap outgrew the file");
+  ok &= Expect(std::filesystem::file_size(path) == ThumbnailStore::kMinCapacity,
+               "file size changed");
+  PrintRow("compaction 1 MB", stats);
+  return ok;
+}
+
+// Two stores on the same file, as two surrogate processes would have, used from several threads
+// at once.
+bool VerifySharing(const std::filesystem::path& path) {
+  constexpr uint32_t kCx = 64;
+  ThumbnailStore stores[2];
+  bool ok = true;
+  for (ThumbnailStore& store : stores) {
+    ok &= Expect(store.Open(path, uint64_t{4} << 20), "shared store does not open");
+  }
+  std::atomic<bool> wrong{false};
+  std::atomic<int> hits{0};
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < 4; ++t) {
+    workers.emplace_back([&, t] {
+      std::mt19937 rng(7 + t);
+      bool saw_wrong = false;
+      for (int i = 0; i < 400; ++i) {
+        ThumbnailStore& store = stores[rng() % 2];
+        const uint64_t id = 1 + rng() % 200;
+        if (LookupPattern(store, id, kCx, &saw_wrong)) {
+          hits.fetch_add(1);
+          continue;
+        }
+        const std::vector<uint8_t> pixels = Pattern(id, kCx, kCx);
+        store.Insert({id, id}, kCx, kCx, kCx, pixels.data(), kCx, kCx, kCx * 4);
+      }
+      if (saw_wrong) wrong = true;
+    });
+  }
+  for (std::thread& worker : workers) worker.join();
+
+  ok &= Expect(!wrong.load(), "wrong pixels from a shared store");
+  ok &= Expect(hits.load() > 0, "shared stores never saw each other's entries");
+  ThumbnailStoreStats combined = stores[0].stats();
+  const ThumbnailStoreStats second = stores[1].stats();
+  combined.hits += second.hits;
+  combined.misses += second.misses;
+  combined.compactions += second.compactions;
+  PrintRow("shared x2 processes, 4 threads", combined);
+  return ok;
+}
+
+}  // namespace
+
+int RunStoreBench(const BenchOptions& options) {
+  std::unique_ptr<ImageDecoder> decoder = CreatePortableImageDecoder();
+  const std::vector<Case> cases = BuildCases(*decoder);
+  if (cases.empty()) return 1;
+
+  std::error_code error;
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path(error) /
+      ("naiv4vibe-store-bench-" + std::to_string(std::random_device()()));
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    std::printf("FAILED: cannot create %s\n", directory.string().c_str());
+    return 1;
+  }
+
+  int failures = 0;
+  std::printf("\n== store ==\n");
+  std::printf("%-44s %12s %12s %12s\n", "case", "hits", "misses", "compactions");
+  if (!VerifyRestart(directory / "restart.store", cases, *decoder)) ++failures;
+  if (!VerifyDamage(directory / "restart.store", cases)) ++failures;
+  if (!VerifyResize(directory / "resize.store", cases)) ++failures;
+  if (!VerifyCompaction(directory / "compaction.store")) ++failures;
+  if (!VerifySharing(directory / "shared.store")) ++failures;
+
+  PrintBenchHeader("store timing");
+  ThumbnailStore store;
+  if (store.Open(directory / "timing.store", kStoreBytes)) {
+    for (const Case& c : cases) {
+      if (c.cx != 256) continue;
+      Thumbnail got;
+      PrintBenchRow(c.name + " uncached", MeasureBench(c.contents.size(), options.iterations, [&] {
+                      Render(c, *decoder, nullptr, &got);
+                    }));
+      store.Insert(c.key, c.cx, 0, 0, c.expected.pixels.data(), c.expected.size.width,
+                   c.expected.size.height, static_cast<size_t>(c.expected.size.width) * 4);
+      StoredThumbnail stored;
+      PrintBenchRow(c.name + " store hit", MeasureBench(c.contents.size(), options.iterations, [&] {
+                      store.Lookup(c.key, c.cx, AllocateInto(&got), &stored);
+                    }));
+    }
+  } else {
+    ++failures;
+  }
+  store.Close();
+  std::filesystem::remove_all(directory, error);
+
+  if (failures != 0) {
+    std::printf("FAILED: %d store checks\n", failures);
+    return 1;
+  }
+  return 0;
+}
+
+}  // namespace vibe::bench
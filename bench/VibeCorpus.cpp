@@ -0,0 +1,236 @@
+#include "VibeCorpus.h"
+
+#include "JpegEncoder.h"
+#include "JsonFieldLocator.h"
+#include "PngEncoder.h"
+#include "ReferenceBase64.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vibe::bench {
+namespace {
+
+constexpr size_t kKiB = 1024;
+constexpr size_t kMiB = 1024 * 1024;
+
+constexpr ImageSize kThumbnail = {256, 192};
+
+constexpr CorpusSpec kDefaultCorpus[] = {
+    {.name = "thumb-64k", .target_bytes = 64 * kKiB, .thumbnail = kThumbnail,
+     .format = CorpusImageFormat::kJpeg, .data_url = true, .cx = 96},
+    {.name = "thumb-image-1m", .target_bytes = kMiB, .thumbnail = kThumbnail,
+     .image = {640, 480}, .data_url = true, .cx = 256},
+    {.name = "thumb-image-8m-cx1024", .target_bytes = 8 * kMiB, .thumbnail = kThumbnail,
+     .image = {1024, 768}, .data_url = true, .cx = 1024},
+    {.name = "jpeg-thumb-image-4m", .target_bytes = 4 * kMiB, .thumbnail = kThumbnail,
+     .image = {1600, 1200}, .format = CorpusImageFormat::kJpeg, .data_url = true, .cx = 1024},
+    {.name = "big-thumb-image-4m", .target_bytes = 4 * kMiB, .thumbnail = {1024, 640},
+     .image = {1600, 1200}, .format = CorpusImageFormat::kJpeg, .cx = 1024},
+    {.name = "small-thumb-image-1m", .target_bytes = kMiB, .thumbnail = {128, 96},
+     .image = {640, 480}, .data_url = true, .cx = 256},
+    {.name = "image-only-32m", .target_bytes = 32 * kMiB, .image = {2048, 1536}, .cx = 256},
+    {.name = "image-only-jpeg-2k", .target_bytes = 4 * kMiB, .image = {2048, 1536},
+     .format = CorpusImageFormat::kJpeg, .cx = 256},
+    {.name = "image-only-adam7-2k", .target_bytes = 16 * kMiB, .image = {2048, 1536},
+     .interlaced = true, .cx = 96},
+    {.name = "escaped-data-url", .target_bytes = 256 * kKiB, .thumbnail = kThumbnail,
+     .data_url = true, .escape_slashes = true, .cx = 96},
+    {.name = "max-nesting", .target_bytes = 128 * kKiB, .thumbnail = kThumbnail,
+     .nesting_depth = kMaxJsonNestingDepth, .metadata_first = true, .cx = 96},
+    {.name = "encodings-first-8m", .target_bytes = 8 * kMiB, .thumbnail = kThumbnail,
+     .data_url = true, .metadata_first = true, .cx = 256},
+    {.name = "image-first-8m", .target_bytes = 8 * kMiB, .thumbnail = kThumbnail,
+     .image = {1024, 768}, .data_url = true, .metadata_first = true, .image_first = true,
+     .cx = 256},
+};
+
+// Only raw engine output is used: std::mt19937 is fully specified, the distributions are not.
+uint32_t Below(std::mt19937& rng, uint32_t bound) { return rng() % bound; }
+
+// Gradients, a few flat discs and mild noise, which compresses roughly like illustration art.
+std::vector<uint8_t> MakeImage(std::mt19937& rng, ImageSize size) {
+  struct Disc {
+    int x, y, radius;
+    uint8_t b, g, r;
+  };
+  Disc discs[6];
+  for (Disc& disc : discs) {
+    disc = {static_cast<int>(Below(rng, size.width)), static_cast<int>(Below(rng, size.height)),
+            static_cast<int>(Below(rng, std::max(2u, size.width / 4)) + 1),
+            static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()),
+            static_cast<uint8_t>(rng())};
+  }
+
+  std::vector<uint8_t> pixels(static_cast<size_t>(size.width) * size.height * 4);
+  for (uint32_t y = 0; y < size.height; ++y) {
+    for (uint32_t x = 0; x < size.width; ++x) {
+      uint8_t* pixel = pixels.data() + (static_cast<size_t>(y) * size.width + x) * 4;
+      int b = static_cast<int>((x + y) * 255 / (size.width + size.height));
+      int g = static_cast<int>(y * 255 / size.height);
+      int r = static_cast<int>(x * 255 / size.width);
+      for (const Disc& disc : discs) {
+        const int dx = static_cast<int>(x) - disc.x;
+        const int dy = static_cast<int>(y) - disc.y;
+        if (dx * dx + dy * dy <= disc.radius * disc.radius) {
+          b = disc.b;
+          g = disc.g;
+          r = disc.r;
+        }
+      }
+      const int noise = static_cast<int>(Below(rng, 5)) - 2;
+      pixel[0] = static_cast<uint8_t>(std::clamp(b + noise, 0, 255));
+      pixel[1] = static_cast<uint8_t>(std::clamp(g + noise, 0, 255));
+      pixel[2] = static_cast<uint8_t>(std::clamp(r + noise, 0, 255));
+      pixel[3] = 255;
+    }
+  }
+  return pixels;
+}
+
+std::string MakePayload(std::mt19937& rng, const CorpusSpec& spec, ImageSize size) {
+  const std::vector<uint8_t> pixels = MakeImage(rng, size);
+  const size_t stride = static_cast<size_t>(size.width) * 4;
+  const bool jpeg = spec.format == CorpusImageFormat::kJpeg;
+  const std::vector<uint8_t> encoded =
+      jpeg ? EncodeJpeg(pixels.data(), size.width, size.height, stride, 90)
+           : EncodePng(pixels.data(), size.width, size.height, stride, false, spec.interlaced);
+
+  std::string value = spec.data_url ? (jpeg ? "data:image/jpeg;base64," : "data:image/png;base64,")
+                                    : "";
+  value += reference::EncodeBase64(encoded);
+  if (!spec.escape_slashes) return value;
+
+  std::string escaped;
+  escaped.reserve(value.size() + value.size() / 32);
+  for (char ch : value) {
+    if (ch == '/') escaped.push_back('\\');
+    escaped.push_back(ch);
+  }
+  return escaped;
+}
+
+std::string MakeHash(std::mt19937& rng) {
+  static constexpr char kHex[] = "0123456789abcdef";
+  std::string hash;
+  for (int i = 0; i < 64; ++i) hash.push_back(kHex[rng() & 15]);
+  return hash;
+}
+
+// "encodings" entries shaped like stored vibe encodings, a base64 blob plus a numeric array,
+// appended until the object is about |budget| bytes.
+std::string MakeEncodings(std::mt19937& rng, size_t budget) {
+  std::string out = "\"encodings\":{\"v4full\":{";
+  bool first = true;
+  while (first || out.size() + 512 < budget) {
+    if (!first) out.push_back(',');
+    first = false;
+    const size_t remaining = budget > out.size() ? budget - out.size() : 0;
+    std::vector<uint8_t> blob(std::clamp<size_t>(remaining / 2, 16, 3072));
+    for (uint8_t& byte : blob) byte = static_cast<uint8_t>(rng());
+
+    out += '"' + MakeHash(rng) + "\":{\"encoding\":\"" + reference::EncodeBase64(blob) +
+           "\",\"params\":{\"information_extracted\":1,\"strength\":0.6},\"values\":[";
+    const size_t values = std::clamp<size_t>(remaining / 16, 1, 256);
+    for (size_t i = 0; i < values; ++i) {
+      char number[16];
+      std::snprintf(number, sizeof(number), "%s%d.%04u", i ? "," : "",
+                    static_cast<int>(Below(rng, 3)) - 1, Below(rng, 10000));
+      out += number;
+    }
+    out += "]}";
+  }
+  out += "}}";
+  return out;
+}
+
+std::string MakeImportInfo(size_t depth) {
+  // The object is one level; "history" nests the remaining levels around a scalar.
+  const size_t arrays = depth > 1 ? depth - 1 : 0;
+  std::string out = "\"importInfo\":{\"model\":\"v4full\",\"information_extracted\":1,"
+                    "\"strength\":0.6,\"history\":";
+  out.append(arrays, '[');
+  out += '0';
+  out.append(arrays, ']');
+  out += '}';
+  return out;
+}
+
+uint32_t SeedFor(std::string_view name) {
+  uint32_t hash = 2166136261u;
+  for (char ch : name) hash = (hash ^ static_cast<uint8_t>(ch)) * 16777619u;
+  return hash;
+}
+
+}  // namespace
+
+std::span<const CorpusSpec> DefaultCorpus() { return kDefaultCorpus; }
+
+CorpusFile GenerateCorpusFile(const CorpusSpec& spec) {
+  std::mt19937 rng(SeedFor(spec.name));
+
+  std::string thumbnail;
+  std::string image;
+  if (spec.thumbnail.width) {
+    thumbnail = "\"thumbnail\":\"" + MakePayload(rng, spec, spec.thumbnail) + '"';
+  }
+  if (spec.image.width) image = "\"image\":\"" + MakePayload(rng, spec, spec.image) + '"';
+  std::vector<std::string> payloads;
+  if (spec.image_first) {
+    if (!image.empty()) payloads.push_back(std::move(image));
+    if (!thumbnail.empty()) payloads.push_back(std::move(thumbnail));
+  } else {
+    if (!thumbnail.empty()) payloads.push_back(std::move(thumbnail));
+    if (!image.empty()) payloads.push_back(std::move(image));
+  }
+
+  const std::string header = "{\"identifier\":\"novelai-vibe-transfer\",\"version\":1,"
+                             "\"type\":\"image\",\"id\":\"" + MakeHash(rng) + '"';
+  const std::string name =
+      "\"name\":\"vibe \\\"sample\\\" \\\\ caf\\u00e9 \\ud83c\\udfa8 \\/ tab\\t end\"";
+  const std::string import_info = MakeImportInfo(spec.nesting_depth);
+  const std::string trailer = ",\"createdAt\":1700000000000}";
+
+  size_t fixed = header.size() + name.size() + import_info.size() + trailer.size() + 4;
+  for (const std::string& payload : payloads) fixed += payload.size() + 1;
+  const std::string encodings =
+      MakeEncodings(rng, spec.target_bytes > fixed ? spec.target_bytes - fixed : 0);
+
+  std::vector<const std::string*> fields;
+  const std::string* metadata[] = {&encodings, &name, &import_info};
+  if (spec.metadata_first) fields.insert(fields.end(), std::begin(metadata), std::end(metadata));
+  for (const std::string& payload : payloads) fields.push_back(&payload);
+  if (!spec.metadata_first) fields.insert(fields.end(), std::begin(metadata), std::end(metadata));
+
+  CorpusFile file;
+  file.contents = header;
+  for (const std::string* field : fields) {
+    file.contents += ',';
+    file.contents += *field;
+  }
+  file.contents += trailer;
+
+  // The pipeline's size rule: the smallest payload whose long edge reaches cx, else the largest.
+  const uint32_t thumbnail_edge = std::max(spec.thumbnail.width, spec.thumbnail.height);
+  const uint32_t image_edge = std::max(spec.image.width, spec.image.height);
+  bool use_thumbnail = thumbnail_edge != 0;
+  if (use_thumbnail && image_edge != 0) {
+    const bool thumbnail_fits = thumbnail_edge >= spec.cx;
+    const bool image_fits = image_edge >= spec.cx;
+    use_thumbnail = thumbnail_fits != image_fits
+                        ? thumbnail_fits
+                        : (thumbnail_fits ? thumbnail_edge <= image_edge
+                                          : thumbnail_edge >= image_edge);
+  }
+  file.field = use_thumbnail ? "thumbnail" : "image";
+  const ImageSize selected = use_thumbnail ? spec.thumbnail : spec.image;
+  file.expected = ComputeThumbnailSize(selected.width, selected.height, spec.cx);
+  return file;
+}
+
+}  // namespace vibe::bench
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Scaler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace vibe::bench {
+
+enum class CorpusImageFormat {
+  kPng,
+  kJpeg,
+};
+
+// One synthetic .naiv4vibe file. Laid out like a NovelAI vibe export: identifier/version header,
+// an "encodings" object, "name", "importInfo", then the "thumbnail" / "image" payloads.
+struct CorpusSpec {
+  std::string_view name;
+  // "encodings" filler pads the file up to about this size.
+  size_t target_bytes = 0;
+  // Pixel sizes of the two payloads; a zero width leaves the field out.
+  ImageSize thumbnail;
+  ImageSize image;
+  CorpusImageFormat format = CorpusImageFormat::kPng;
+  // Adam7-interlace PNG payloads.
+  bool interlaced = false;
+  // Prefix payloads with "data:image/...;base64,".
+  bool data_url = false;
+  // Write every '/' of the payloads as "\/", which forces the unescape path.
+  bool escape_slashes = false;
+  // Depth of the nested "importInfo" value, up to kMaxJsonNestingDepth.
+  size_t nesting_depth = 2;
+  // Place "encodings", "name" and "importInfo" before the payloads instead of after them.
+  bool metadata_first = false;
+  // Emit "image" before "thumbnail".
+  bool image_first = false;
+  // The thumbnail size requested from the pipeline.
+  uint32_t cx = 256;
+};
+
+struct CorpusFile {
+  std::string contents;
+  // The payload RenderThumbnail should pick for |spec.cx|: "thumbnail" or "image".
+  std::string_view field;
+  // What RenderThumbnail must produce for |spec.cx|.
+  ImageSize expected;
+};
+
+// The built-in shapes: thumbnail-only and thumbnail+image files from 64 KB to 32 MB, data URLs,
+// escaped strings, maximum nesting and large "encodings" ahead of the target field.
+std::span<const CorpusSpec> DefaultCorpus();
+
+// Builds |spec| from a fixed seed, so a given spec always yields the same bytes.
+CorpusFile GenerateCorpusFile(const CorpusSpec& spec);
+
+}  // namespace vibe::bench
@@ -0,0 +1,305 @@
+#include "Base64.h"
+
+#include "CpuFeatures.h"
+#include "WorkStealingPool.h"
+
+#if defined(VIBE_ARCH_X86)
+#include <immintrin.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+namespace vibe {
+namespace {
+
+constexpr uint8_t kWhitespace = 0x80;
+constexpr uint8_t kPadding = 0x81;
+constexpr uint8_t kInvalid = 0xFF;
+
+struct DecodeTable {
+  uint8_t values[256];
+
+  constexpr DecodeTable() : values() {
+    for (int i = 0; i < 256; ++i) values[i] = kInvalid;
+    for (int i = 0; i < 26; ++i) {
+      values['A' + i] = static_cast<uint8_t>(i);
+      values['a' + i] = static_cast<uint8_t>(26 + i);
+    }
+    for (int i = 0; i < 10; ++i) values['0' + i] = static_cast<uint8_t>(52 + i);
+    values['+'] = 62;
+    values['/'] = 63;
+    values['='] = kPadding;
+    values[' '] = kWhitespace;
+    values['\t'] = kWhitespace;
+    values['\r'] = kWhitespace;
+    values['\n'] = kWhitespace;
+  }
+};
+
+constexpr DecodeTable kDecodeTable;
+
+uint8_t Lookup(char ch) {
+  return kDecodeTable.values[static_cast<unsigned char>(ch)];
+}
+
+#if defined(VIBE_ARCH_X86)
+// Vector kernels after Muła and Lemire: classify every byte through two nibble lookups, translate
+// ASCII to 6-bit values with a per-range offset, then pack four sextets into three bytes. They
+// return false, leaving |out| untouched, when the block holds anything but alphabet characters;
+// the scalar path then takes care of whitespace, padding and error reporting.
+VIBE_TARGET("ssse3")
+bool DecodeBlockSsse3(const char* in, uint8_t* out) {
+  const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                       0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10,
+                                       0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m128i lut_roll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+  __m128i str = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+  const __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+  const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+  const __m128i invalid = _mm_and_si128(lo, hi);
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xFFFF) return false;
+
+  const __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+  const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+  str = _mm_add_epi8(str, roll);
+
+  const __m128i merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+  __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  packed = _mm_shuffle_epi8(packed,
+                            _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), packed);
+  return true;
+}
+
+VIBE_TARGET("avx2")
+bool DecodeBlockAvx2(const char* in, uint8_t* out) {
+  const __m256i lut_lo = _mm256_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+  const __m256i lut_hi = _mm256_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+  __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+  const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+  const __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+  const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+  const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+  if (!_mm256_testz_si256(lo, hi)) return false;
+
+  const __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+  const __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+  str = _mm256_add_epi8(str, roll);
+
+  const __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+  __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+  packed = _mm256_shuffle_epi8(
+      packed, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6,
+                               5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), packed);
+  return true;
+}
+#endif
+
+// Writes the one or two bytes held by an unfinished final quantum of |count| sextets.
+Base64Result FlushPartialQuantum(uint32_t acc, int count, uint8_t* output, size_t capacity,
+                                 size_t written, size_t offset) {
+  if (count == 0) return {Base64Status::kOk, written, 0};
+  if (count == 1) return {Base64Status::kTruncated, written, offset};
+
+  const size_t needed = count == 2 ? 1 : 2;
+  if (capacity - written < needed) return {Base64Status::kOutputTooSmall, written, offset};
+  if (count == 2) {
+    output[written++] = static_cast<uint8_t>(acc >> 4);
+  } else {
+    output[written++] = static_cast<uint8_t>(acc >> 10);
+    output[written++] = static_cast<uint8_t>(acc >> 2);
+  }
+  return {Base64Status::kOk, written, 0};
+}
+
+}  // namespace
+
+Base64Result DecodeBase64(std::string_view input, uint8_t* output, size_t capacity) {
+  if (!output) capacity = 0;
+
+  const char* const in = input.data();
+  const size_t size = input.size();
+#if defined(VIBE_ARCH_X86)
+  const SimdLevel level = ActiveSimdLevel();
+#endif
+
+  size_t i = 0;
+  size_t o = 0;
+  uint32_t acc = 0;
+  int count = 0;
+  while (i < size) {
+    if (count == 0) {
+#if defined(VIBE_ARCH_X86)
+      if (level >= SimdLevel::kAvx2) {
+        while (size - i >= 32 && capacity - o >= 32 && DecodeBlockAvx2(in + i, output + o)) {
+          i += 32;
+          o += 24;
+        }
+      }
+      if (level >= SimdLevel::kSsse3) {
+        while (size - i >= 16 && capacity - o >= 16 && DecodeBlockSsse3(in + i, output + o)) {
+          i += 16;
+          o += 12;
+        }
+      }
+#endif
+      while (size - i >= 4 && capacity - o >= 3) {
+        const uint32_t a = Lookup(in[i]);
+        const uint32_t b = Lookup(in[i + 1]);
+        const uint32_t c = Lookup(in[i + 2]);
+        const uint32_t d = Lookup(in[i + 3]);
+        if ((a | b | c | d) & 0xC0) break;
+        const uint32_t quantum = (a << 18) | (b << 12) | (c << 6) | d;
+        output[o] = static_cast<uint8_t>(quantum >> 16);
+        output[o + 1] = static_cast<uint8_t>(quantum >> 8);
+        output[o + 2] = static_cast<uint8_t>(quantum);
+        i += 4;
+        o += 3;
+      }
+      if (i >= size) break;
+    }
+
+    const uint8_t value = Lookup(in[i]);
+    if (value < 64) {
+      acc = (acc << 6) | value;
+      if (++count == 4) {
+        if (capacity - o < 3) return {Base64Status::kOutputTooSmall, o, i};
+        output[o] = static_cast<uint8_t>(acc >> 16);
+        output[o + 1] = static_cast<uint8_t>(acc >> 8);
+        output[o + 2] = static_cast<uint8_t>(acc);
+        o += 3;
+        acc = 0;
+        count = 0;
+      }
+      ++i;
+      continue;
+    }
+    if (value == kWhitespace) {
+      ++i;
+      continue;
+    }
+    if (value != kPadding) return {Base64Status::kInvalidCharacter, o, i};
+
+    // Padding ends the data: it may only complete a quantum of two or three sextets and be
+    // followed by nothing but whitespace.
+    if (count < 2) return {Base64Status::kInvalidPadding, o, i};
+    const int allowed = 4 - count;
+    int pads = 0;
+    for (size_t j = i; j < size; ++j) {
+      const uint8_t tail = Lookup(in[j]);
+      if (tail == kPadding) {
+        if (++pads > allowed) return {Base64Status::kInvalidPadding, o, j};
+      } else if (tail != kWhitespace) {
+        return {Base64Status::kInvalidPadding, o, j};
+      }
+    }
+    return FlushPartialQuantum(acc, count, output, capacity, o, size);
+  }
+
+  return FlushPartialQuantum(acc, count, output, capacity, o, size);
+}
+
+Base64Result DecodeBase64Parallel(std::string_view input, uint8_t* output, size_t capacity,
+                                  WorkStealingPool& pool) {
+  // Below this a chunk is not worth a thread.
+  constexpr size_t kMinChunkBytes = 256 * 1024;
+  const size_t size = input.size();
+  const size_t wanted = std::min<size_t>(pool.size() * 2, size / kMinChunkBytes);
+  const bool overlaps = output && reinterpret_cast<const char*>(output) < input.data() + size &&
+                        input.data() < reinterpret_cast<const char*>(output) + capacity;
+  if (wanted < 2 || !output || overlaps) return DecodeBase64(input, output, capacity);
+
+  // Chunks start on 4-character boundaries, so each one decodes to the place it would in a
+  // single pass as long as the text holds no whitespace or padding before its end. A chunk that
+  // writes anything else than three bytes per four characters shows otherwise, and then the
+  // whole input goes through the single pass, which also reports errors at the right offset.
+  const size_t chunk_chars = ((size + wanted - 1) / wanted + 3) / 4 * 4;
+  const size_t chunks = (size + chunk_chars - 1) / chunk_chars;
+  std::vector<Base64Result> results(chunks);
+  pool.ParallelFor(chunks, [&](size_t chunk) {
+    const size_t begin = chunk * chunk_chars;
+    const size_t length = std::min(chunk_chars, size - begin);
+    const size_t offset = begin / 4 * 3;
+    if (offset > capacity) {
+      results[chunk] = {Base64Status::kOutputTooSmall, 0, begin};
+      return;
+    }
+    const size_t room = chunk + 1 < chunks ? std::min(length / 4 * 3, capacity - offset)
+                                           : capacity - offset;
+    results[chunk] = DecodeBase64(input.substr(begin, length), output + offset, room);
+  });
+
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    const bool last = chunk + 1 == chunks;
+    if (results[chunk].status != Base64Status::kOk ||
+        (!last && results[chunk].written != chunk_chars / 4 * 3)) {
+      return DecodeBase64(input, output, capacity);
+    }
+  }
+  return {Base64Status::kOk, (chunks - 1) * (chunk_chars / 4 * 3) + results.back().written, 0};
+}
+
+size_t Base64DecodedSize(std::string_view input) {
+  size_t data = 0;
+  for (const char ch : input) data += Lookup(ch) < 64;
+  return data / 4 * 3 + (data % 4 == 3 ? 2 : data % 4 == 2 ? 1 : 0);
+}
+
+size_t EncodeBase64(std::span<const uint8_t> input, char* output) {
+  static constexpr char kAlphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char* out = output;
+  size_t i = 0;
+  for (; i + 3 <= input.size(); i += 3) {
+    const uint32_t triple = (uint32_t{input[i]} << 16) | (uint32_t{input[i + 1]} << 8) |
+                            input[i + 2];
+    *out++ = kAlphabet[triple >> 18];
+    *out++ = kAlphabet[(triple >> 12) & 0x3F];
+    *out++ = kAlphabet[(triple >> 6) & 0x3F];
+    *out++ = kAlphabet[triple & 0x3F];
+  }
+  if (i < input.size()) {
+    const bool two = i + 2 == input.size();
+    const uint32_t triple = (uint32_t{input[i]} << 16) | (two ? uint32_t{input[i + 1]} << 8 : 0);
+    *out++ = kAlphabet[triple >> 18];
+    *out++ = kAlphabet[(triple >> 12) & 0x3F];
+    *out++ = two ? kAlphabet[(triple >> 6) & 0x3F] : '=';
+    *out++ = '=';
+  }
+  return static_cast<size_t>(out - output);
+}
+
+const char* Base64StatusName(Base64Status status) {
+  switch (status) {
+    case Base64Status::kOk:
+      return "ok";
+    case Base64Status::kInvalidCharacter:
+      return "invalid character";
+    case Base64Status::kInvalidPadding:
+      return "invalid padding";
+    case Base64Status::kTruncated:
+      return "truncated";
+    case Base64Status::kOutputTooSmall:
+      return "output too small";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace vibe {
+
+class WorkStealingPool;
+
+enum class Base64Status {
+  kOk,
+  kInvalidCharacter,
+  kInvalidPadding,
+  kTruncated,
+  kOutputTooSmall,
+};
+
+struct Base64Result {
+  Base64Status status = Base64Status::kOk;
+  size_t written = 0;
+  // Offset into the input of the first byte that could not be consumed when status is not kOk.
+  size_t error_offset = 0;
+};
+
+// Worst-case decoded size of |encoded_size| input characters.
+constexpr size_t Base64DecodedSizeUpperBound(size_t encoded_size) {
+  return (encoded_size / 4 + 1) * 3;
+}
+
+// Decodes standard base64 straight from |input| into |output|. Accepts what
+// CryptStringToBinary(CRYPT_STRING_BASE64) accepts: spaces, tabs and CR/LF anywhere, and a final
+// quantum that is padded with '=' or left unpadded. |output| may alias |input| as long as it does
+// not start after it, so a payload can be decoded in place.
+Base64Result DecodeBase64(std::string_view input, uint8_t* output, size_t capacity);
+
+// DecodeBase64 split into 4-character-aligned chunks decoded concurrently on |pool|, with the
+// same result. |output| must not overlap |input|; inputs too small to split, and those whose
+// chunks do not line up (whitespace, misplaced padding, errors), take the single-threaded path.
+Base64Result DecodeBase64Parallel(std::string_view input, uint8_t* output, size_t capacity,
+                                  WorkStealingPool& pool);
+
+// Exact decoded size of well-formed |input|, counted from its data characters.
+size_t Base64DecodedSize(std::string_view input);
+
+// Characters EncodeBase64 writes for |size| bytes, padding included.
+constexpr size_t Base64EncodedSize(size_t size) { return (size + 2) / 3 * 4; }
+
+// Standard padded base64 of |input| without line breaks, the form vibe files store. |output|
+// needs Base64EncodedSize(input.size()) characters; returns how many were written.
+size_t EncodeBase64(std::span<const uint8_t> input, char* output);
+
+const char* Base64StatusName(Base64Status status);
+
+}  // namespace vibe
@@ -0,0 +1,136 @@
+#include "Base64Reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vibe {
+namespace {
+
+bool IsDataCharacter(char ch) {
+  return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || (ch >= '0' && ch <= '9') ||
+         ch == '+' || ch == '/';
+}
+
+}  // namespace
+
+Base64Reader::Base64Reader(std::string_view encoded) : encoded_(encoded) {}
+
+uint64_t Base64Reader::size() {
+  if (size_ == UINT64_MAX) size_ = Base64DecodedSize(encoded_);
+  return size_;
+}
+
+void Base64Reader::AddCheckpoint() {
+  if (out_ < checkpoints_[checkpoint_count_ - 1].decoded + checkpoint_interval_) return;
+  if (checkpoint_count_ == kMaxCheckpoints) {
+    for (size_t i = 1; i < kMaxCheckpoints / 2; ++i) checkpoints_[i] = checkpoints_[i * 2];
+    checkpoint_count_ = kMaxCheckpoints / 2;
+    checkpoint_interval_ *= 2;
+    if (out_ < checkpoints_[checkpoint_count_ - 1].decoded + checkpoint_interval_) return;
+  }
+  checkpoints_[checkpoint_count_++] = {out_, in_};
+}
+
+bool Base64Reader::DecodeNext(uint8_t* output, size_t capacity, size_t* written) {
+  // Without whitespace the slice holds exactly the quanta that fit. Whitespace can leave it
+  // ending inside a quantum; those characters are handed back and decoded with the next slice.
+  size_t end = std::min(encoded_.size(), in_ + capacity / 3 * 4);
+  for (;;) {
+    const bool last = end == encoded_.size();
+    const Base64Result decoded = DecodeBase64(encoded_.substr(in_, end - in_), output, capacity);
+    size_t kept = decoded.written;
+    size_t returned = 0;
+    if (decoded.status == Base64Status::kTruncated && !last) {
+      returned = 1;
+    } else if (decoded.status != Base64Status::kOk) {
+      status_ = decoded.status;
+      return false;
+    } else if (!last && kept % 3 != 0) {
+      returned = kept % 3 + 1;
+      kept -= kept % 3;
+    }
+
+    size_t next = end;
+    for (; returned > 0; --next) {
+      if (IsDataCharacter(encoded_[next - 1])) --returned;
+    }
+    if (kept == 0 && !last) {
+      // Fewer than four data characters in the whole slice: take exactly the next quantum.
+      size_t data = 0;
+      for (end = in_; end < encoded_.size() && data < 4; ++end) {
+        data += IsDataCharacter(encoded_[end]);
+      }
+      continue;
+    }
+
+    in_ = next;
+    out_ += kept;
+    *written = kept;
+    AddCheckpoint();
+    return true;
+  }
+}
+
+bool Base64Reader::Fill(uint64_t position) {
+  // Resume from the closest quantum boundary at or before |position|.
+  if (out_ > position || out_ + checkpoint_interval_ < position) {
+    const Checkpoint* checkpoint =
+        std::upper_bound(checkpoints_, checkpoints_ + checkpoint_count_, position,
+                         [](uint64_t value, const Checkpoint& c) { return value < c.decoded; }) -
+        1;
+    if (checkpoint->decoded > out_ || out_ > position) {
+      out_ = checkpoint->decoded;
+      in_ = checkpoint->encoded;
+    }
+  }
+
+  block_size_ = 0;
+  while (in_ < encoded_.size()) {
+    size_t written = 0;
+    if (!DecodeNext(block_, kBlockBytes, &written)) return false;
+    block_start_ = out_ - written;
+    block_size_ = written;
+    if (out_ > position) break;
+  }
+  return true;
+}
+
+bool Base64Reader::Read(void* buffer, size_t capacity, size_t* bytes_read) {
+  *bytes_read = 0;
+  if (status_ != Base64Status::kOk) return false;
+
+  auto* output = static_cast<uint8_t*>(buffer);
+  while (capacity > 0) {
+    if (position_ >= block_start_ && position_ - block_start_ < block_size_) {
+      const size_t offset = static_cast<size_t>(position_ - block_start_);
+      const size_t count = std::min(capacity, block_size_ - offset);
+      std::memcpy(output, block_ + offset, count);
+      output += count;
+      capacity -= count;
+      position_ += count;
+      *bytes_read += count;
+      continue;
+    }
+
+    if (position_ != out_) {
+      if (!Fill(position_)) return false;
+      if (position_ < block_start_ || position_ - block_start_ >= block_size_) break;
+      continue;
+    }
+    if (in_ == encoded_.size()) break;
+
+    if (capacity >= kBlockBytes) {
+      size_t written = 0;
+      if (!DecodeNext(output, capacity, &written)) return false;
+      output += written;
+      capacity -= written;
+      position_ += written;
+      *bytes_read += written;
+    } else if (!Fill(position_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace vibe
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Base64.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace vibe {
+
+// Sequential, seekable view of the bytes base64 text decodes to, decoded only as they are read.
+// Decoding always restarts on a quantum boundary: the reader remembers the input offset of every
+// |checkpoint_interval_| decoded bytes, so a seek backwards re-decodes at most that much and a
+// seek forwards decodes only up to the target. The text must outlive the reader.
+class Base64Reader {
+ public:
+  // Bytes decoded ahead for small reads. Reads at least this large decode straight into the
+  // caller's buffer.
+  static constexpr size_t kBlockBytes = 12 * 1024;
+  static constexpr size_t kMaxCheckpoints = 64;
+
+  explicit Base64Reader(std::string_view encoded);
+
+  Base64Reader(const Base64Reader&) = delete;
+  Base64Reader& operator=(const Base64Reader&) = delete;
+
+  // Reads up to |capacity| bytes from position(). Returning true with |*bytes_read| == 0 signals
+  // the end; false means the text stopped being valid base64, see status().
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read);
+
+  // Positions past the end are allowed and read as the end.
+  void Seek(uint64_t position) { position_ = position; }
+  uint64_t position() const { return position_; }
+
+  // Total decoded size. Counted over the whole text on first use.
+  uint64_t size();
+
+  Base64Status status() const { return status_; }
+  std::string_view encoded() const { return encoded_; }
+
+ private:
+  struct Checkpoint {
+    uint64_t decoded = 0;
+    size_t encoded = 0;
+  };
+
+  // Decodes whole quanta from |in_| into |output|, advancing |in_| and |out_|.
+  bool DecodeNext(uint8_t* output, size_t capacity, size_t* written);
+  // Decodes into |block_| until it holds |position|, or the text ends.
+  bool Fill(uint64_t position);
+  void AddCheckpoint();
+
+  std::string_view encoded_;
+  size_t in_ = 0;
+  uint64_t out_ = 0;
+  uint64_t position_ = 0;
+  uint64_t size_ = UINT64_MAX;
+  Base64Status status_ = Base64Status::kOk;
+
+  Checkpoint checkpoints_[kMaxCheckpoints];
+  size_t checkpoint_count_ = 1;
+  // Doubles whenever the table fills up, so any payload fits.
+  uint64_t checkpoint_interval_ = 64 * 1024;
+
+  uint64_t block_start_ = 0;
+  size_t block_size_ = 0;
+  uint8_t block_[kBlockBytes];
+};
+
+}  // namespace vibe
@@ -0,0 +1,140 @@
+#include "Base64Stream.h"
+
+#include <Windows.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace vibe {
+
+HRESULT Base64Stream::Create(std::string_view encoded, IStream** stream) {
+  if (!stream) return E_POINTER;
+  *stream = new (std::nothrow) Base64Stream(encoded);
+  return *stream ? S_OK : E_OUTOFMEMORY;
+}
+
+IFACEMETHODIMP Base64Stream::QueryInterface(REFIID riid, void** ppv) {
+  if (!ppv) return E_POINTER;
+
+  if (riid == IID_IUnknown || riid == IID_ISequentialStream || riid == IID_IStream) {
+    *ppv = static_cast<IStream*>(this);
+  } else {
+    *ppv = nullptr;
+    return E_NOINTERFACE;
+  }
+
+  AddRef();
+  return S_OK;
+}
+
+IFACEMETHODIMP_(ULONG) Base64Stream::AddRef() { return InterlockedIncrement(&ref_count_); }
+
+IFACEMETHODIMP_(ULONG) Base64Stream::Release() {
+  ULONG count = InterlockedDecrement(&ref_count_);
+  if (count == 0) delete this;
+  return count;
+}
+
+IFACEMETHODIMP Base64Stream::Read(void* pv, ULONG cb, ULONG* pcbRead) {
+  if (!pv) return STG_E_INVALIDPOINTER;
+
+  size_t read = 0;
+  const bool ok = reader_.Read(pv, cb, &read);
+  if (pcbRead) *pcbRead = static_cast<ULONG>(read);
+  if (!ok) return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  return read == cb ? S_OK : S_FALSE;
+}
+
+IFACEMETHODIMP Base64Stream::Write(const void*, ULONG, ULONG* pcbWritten) {
+  if (pcbWritten) *pcbWritten = 0;
+  return STG_E_ACCESSDENIED;
+}
+
+IFACEMETHODIMP Base64Stream::Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin,
+                                  ULARGE_INTEGER* plibNewPosition) {
+  int64_t base = 0;
+  switch (dwOrigin) {
+    case STREAM_SEEK_SET:
+      break;
+    case STREAM_SEEK_CUR:
+      base = static_cast<int64_t>(reader_.position());
+      break;
+    case STREAM_SEEK_END:
+      base = static_cast<int64_t>(reader_.size());
+      break;
+    default:
+      return STG_E_INVALIDFUNCTION;
+  }
+  const int64_t position = base + dlibMove.QuadPart;
+  if (position < 0) return STG_E_INVALIDFUNCTION;
+
+  reader_.Seek(static_cast<uint64_t>(position));
+  if (plibNewPosition) plibNewPosition->QuadPart = static_cast<ULONGLONG>(position);
+  return S_OK;
+}
+
+IFACEMETHODIMP Base64Stream::SetSize(ULARGE_INTEGER) { return STG_E_ACCESSDENIED; }
+
+IFACEMETHODIMP Base64Stream::CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead,
+                                    ULARGE_INTEGER* pcbWritten) {
+  if (!pstm) return STG_E_INVALIDPOINTER;
+
+  uint8_t buffer[Base64Reader::kBlockBytes];
+  ULONGLONG copied = 0;
+  ULONGLONG written_total = 0;
+  HRESULT hr = S_OK;
+  while (copied < cb.QuadPart) {
+    const ULONG request =
+        static_cast<ULONG>(std::min<ULONGLONG>(sizeof(buffer), cb.QuadPart - copied));
+    size_t read = 0;
+    if (!reader_.Read(buffer, request, &read)) {
+      hr = HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+      break;
+    }
+    if (read == 0) break;
+    copied += read;
+    ULONG written = 0;
+    hr = pstm->Write(buffer, static_cast<ULONG>(read), &written);
+    written_total += written;
+    if (FAILED(hr)) break;
+  }
+  if (pcbRead) pcbRead->QuadPart = copied;
+  if (pcbWritten) pcbWritten->QuadPart = written_total;
+  return hr;
+}
+
+IFACEMETHODIMP Base64Stream::Commit(DWORD) { return S_OK; }
+
+IFACEMETHODIMP Base64Stream::Revert() { return S_OK; }
+
+IFACEMETHODIMP Base64Stream::LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) {
+  return STG_E_INVALIDFUNCTION;
+}
+
+IFACEMETHODIMP Base64Stream::UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) {
+  return STG_E_INVALIDFUNCTION;
+}
+
+IFACEMETHODIMP Base64Stream::Stat(STATSTG* pstatstg, DWORD) {
+  if (!pstatstg) return STG_E_INVALIDPOINTER;
+
+  *pstatstg = {};
+  pstatstg->type = STGTY_STREAM;
+  pstatstg->cbSize.QuadPart = reader_.size();
+  pstatstg->grfMode = STGM_READ | STGM_SHARE_DENY_WRITE;
+  return S_OK;
+}
+
+IFACEMETHODIMP Base64Stream::Clone(IStream** ppstm) {
+  if (!ppstm) return STG_E_INVALIDPOINTER;
+
+  *ppstm = nullptr;
+  auto* clone = new (std::nothrow) Base64Stream(reader_.encoded());
+  if (!clone) return E_OUTOFMEMORY;
+  clone->reader_.Seek(reader_.position());
+  *ppstm = clone;
+  return S_OK;
+}
+
+}  // namespace vibe
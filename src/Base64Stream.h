@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Base64Reader.h"
+
+#include <Objidl.h>
+
+#include <string_view>
+
+namespace vibe {
+
+// Read-only IStream over base64 text that decodes only what its reader pulls, so WIC can parse an
+// embedded image without the payload ever being decoded into a buffer of its own. The text must
+// outlive the stream and every clone of it.
+class Base64Stream final : public IStream {
+ public:
+  static HRESULT Create(std::string_view encoded, IStream** stream);
+
+  // IUnknown
+  IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv) override;
+  IFACEMETHODIMP_(ULONG) AddRef() override;
+  IFACEMETHODIMP_(ULONG) Release() override;
+
+  // ISequentialStream
+  IFACEMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead) override;
+  IFACEMETHODIMP Write(const void* pv, ULONG cb, ULONG* pcbWritten) override;
+
+  // IStream
+  IFACEMETHODIMP Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin,
+                      ULARGE_INTEGER* plibNewPosition) override;
+  IFACEMETHODIMP SetSize(ULARGE_INTEGER libNewSize) override;
+  IFACEMETHODIMP CopyTo(IStream* pstm, ULARGE_INTEGER cb, ULARGE_INTEGER* pcbRead,
+                        ULARGE_INTEGER* pcbWritten) override;
+  IFACEMETHODIMP Commit(DWORD grfCommitFlags) override;
+  IFACEMETHODIMP Revert() override;
+  IFACEMETHODIMP LockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb,
+                            DWORD dwLockType) override;
+  IFACEMETHODIMP UnlockRegion(ULARGE_INTEGER libOffset, ULARGE_INTEGER cb,
+                              DWORD dwLockType) override;
+  IFACEMETHODIMP Stat(STATSTG* pstatstg, DWORD grfStatFlag) override;
+  IFACEMETHODIMP Clone(IStream** ppstm) override;
+
+ private:
+  explicit Base64Stream(std::string_view encoded) : reader_(encoded) {}
+  ~Base64Stream() = default;
+
+  long ref_count_ = 1;
+  Base64Reader reader_;
+};
+
+}  // namespace vibe
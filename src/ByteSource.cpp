@@ -0,0 +1,77 @@
+#include "ByteSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace vibe {
+namespace {
+
+bool CopyOut(std::string_view data, size_t max_chunk, size_t* offset, void* buffer,
+             size_t capacity, size_t* bytes_read) {
+  if (!bytes_read || (!buffer && capacity)) return false;
+
+  const size_t count = std::min({capacity, max_chunk, data.size() - *offset});
+  if (count) std::memcpy(buffer, data.data() + *offset, count);
+  *offset += count;
+  *bytes_read = count;
+  return true;
+}
+
+}  // namespace
+
+bool ByteSource::Skip(uint64_t count) {
+  char discard[4096];
+  while (count != 0) {
+    size_t read = 0;
+    if (!Read(discard, static_cast<size_t>(std::min<uint64_t>(count, sizeof(discard))), &read) ||
+        read == 0) {
+      return false;
+    }
+    count -= read;
+  }
+  return true;
+}
+
+MemoryByteSource::MemoryByteSource(std::string_view data) : data_(data) {}
+
+bool MemoryByteSource::Read(void* buffer, size_t capacity, size_t* bytes_read) {
+  return CopyOut(data_, data_.size(), &offset_, buffer, capacity, bytes_read);
+}
+
+bool MemoryByteSource::SizeHint(uint64_t* size) {
+  if (!size) return false;
+  *size = data_.size();
+  return true;
+}
+
+bool MemoryByteSource::Skip(uint64_t count) {
+  if (count > data_.size() - offset_) return false;
+  offset_ += static_cast<size_t>(count);
+  return true;
+}
+
+ChunkedMemorySource::ChunkedMemorySource(std::string_view data, size_t max_chunk,
+                                         bool report_size)
+    : data_(data), max_chunk_(std::max<size_t>(1, max_chunk)), report_size_(report_size) {}
+
+bool ChunkedMemorySource::Read(void* buffer, size_t capacity, size_t* bytes_read) {
+  return CopyOut(data_, max_chunk_, &offset_, buffer, capacity, bytes_read);
+}
+
+bool ChunkedMemorySource::SizeHint(uint64_t* size) {
+  if (!size || !report_size_) return false;
+  *size = data_.size();
+  return true;
+}
+
+PrefixedByteSource::PrefixedByteSource(std::string_view prefix, ByteSource& source)
+    : prefix_(prefix), source_(source) {}
+
+bool PrefixedByteSource::Read(void* buffer, size_t capacity, size_t* bytes_read) {
+  if (offset_ < prefix_.size()) {
+    return CopyOut(prefix_, prefix_.size(), &offset_, buffer, capacity, bytes_read);
+  }
+  return source_.Read(buffer, capacity, bytes_read);
+}
+
+}  // namespace vibe
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace vibe {
+
+// Producer of file bytes. Sources whose whole content is addressable in place (a mapped view or
+// an in-memory buffer) expose it through View() so the parser and decoders work on it directly;
+// everything else, such as an IStream, is read sequentially.
+class ByteSource {
+ public:
+  virtual ~ByteSource() = default;
+
+  // Reads up to |capacity| bytes. Returning true with |*bytes_read| == 0 signals end of data.
+  virtual bool Read(void* buffer, size_t capacity, size_t* bytes_read) = 0;
+
+  // Total size of the data when the source knows it up front.
+  virtual bool SizeHint(uint64_t* size) {
+    (void)size;
+    return false;
+  }
+
+  // The complete content when it can be used without copying; empty otherwise.
+  virtual std::string_view View() const { return {}; }
+
+  // Moves |count| bytes ahead without handing them out. Sources that can seek override this; the
+  // default reads and drops them. Fails when the data ends first.
+  virtual bool Skip(uint64_t count);
+};
+
+// A buffer owned by the caller, exposed in place.
+class MemoryByteSource final : public ByteSource {
+ public:
+  explicit MemoryByteSource(std::string_view data);
+
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override;
+  bool SizeHint(uint64_t* size) override;
+  std::string_view View() const override { return data_; }
+  bool Skip(uint64_t count) override;
+
+ private:
+  std::string_view data_;
+  size_t offset_ = 0;
+};
+
+// Replays a buffer the way a stream delivers it: no view, reads of at most |max_chunk| bytes and
+// an optional size hint. Lets the incremental path be exercised with arbitrary chunk boundaries.
+class ChunkedMemorySource final : public ByteSource {
+ public:
+  ChunkedMemorySource(std::string_view data, size_t max_chunk, bool report_size = true);
+
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override;
+  bool SizeHint(uint64_t* size) override;
+
+  size_t bytes_served() const { return offset_; }
+
+ private:
+  std::string_view data_;
+  size_t max_chunk_;
+  bool report_size_;
+  size_t offset_ = 0;
+};
+
+// Hands out |prefix|, bytes already read from |source| to look at the start of the file, before
+// continuing with |source| itself. Both must outlive it.
+class PrefixedByteSource final : public ByteSource {
+ public:
+  PrefixedByteSource(std::string_view prefix, ByteSource& source);
+
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override;
+  bool SizeHint(uint64_t* size) override { return source_.SizeHint(size); }
+
+ private:
+  std::string_view prefix_;
+  ByteSource& source_;
+  size_t offset_ = 0;
+};
+
+}  // namespace vibe
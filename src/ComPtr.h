@@ -0,0 +1,30 @@
+#pragma once
+
+namespace vibe {
+
+// Minimal owning pointer for COM interfaces.
+template <typename T>
+class ComPtr {
+ public:
+  ComPtr() : ptr_(nullptr) {}
+  ~ComPtr() {
+    if (ptr_) ptr_->Release();
+  }
+
+  ComPtr(const ComPtr&) = delete;
+  ComPtr& operator=(const ComPtr&) = delete;
+
+  T** operator&() { return &ptr_; }
+  T* get() const { return ptr_; }
+  T* operator->() const { return ptr_; }
+
+  void Attach(T* value) {
+    if (ptr_) ptr_->Release();
+    ptr_ = value;
+  }
+
+ private:
+  T* ptr_;
+};
+
+}  // namespace vibe
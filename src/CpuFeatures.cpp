@@ -0,0 +1,93 @@
+#include "CpuFeatures.h"
+
+#include <atomic>
+
+#if defined(VIBE_ARCH_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace vibe {
+namespace {
+
+#if defined(VIBE_ARCH_X86)
+void Cpuid(int leaf, int subleaf, unsigned int regs[4]) {
+#if defined(_MSC_VER)
+  int values[4] = {};
+  __cpuidex(values, leaf, subleaf);
+  for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned int>(values[i]);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+unsigned long long ReadXcr0() {
+#if defined(_MSC_VER)
+  return _xgetbv(0);
+#else
+  unsigned int eax = 0;
+  unsigned int edx = 0;
+  __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+SimdLevel DetectSimdLevel() {
+#if defined(VIBE_ARCH_X86)
+  unsigned int regs[4] = {};
+  Cpuid(0, 0, regs);
+  const unsigned int max_leaf = regs[0];
+
+  Cpuid(1, 0, regs);
+  const unsigned int ecx = regs[2];
+  const unsigned int edx = regs[3];
+  if (!(edx & (1u << 26))) return SimdLevel::kScalar;
+  if (!(ecx & (1u << 9))) return SimdLevel::kSse2;
+  if (!(ecx & (1u << 19))) return SimdLevel::kSsse3;
+
+  const bool os_saves_ymm = (ecx & (1u << 27)) && (ReadXcr0() & 0x6) == 0x6;
+  if (max_leaf >= 7 && os_saves_ymm) {
+    Cpuid(7, 0, regs);
+    if (regs[1] & (1u << 5)) return SimdLevel::kAvx2;
+  }
+  return SimdLevel::kSse41;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+std::atomic<int> g_simd_level_cap{static_cast<int>(SimdLevel::kAvx2)};
+
+}  // namespace
+
+SimdLevel ActiveSimdLevel() {
+  static const SimdLevel detected = DetectSimdLevel();
+  const int cap = g_simd_level_cap.load(std::memory_order_relaxed);
+  return static_cast<int>(detected) < cap ? detected : static_cast<SimdLevel>(cap);
+}
+
+void SetSimdLevelCap(SimdLevel level) {
+  g_simd_level_cap.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+const char* SimdLevelName(SimdLevel level) {
+  switch (level) {
+    case SimdLevel::kScalar:
+      return "scalar";
+    case SimdLevel::kSse2:
+      return "sse2";
+    case SimdLevel::kSsse3:
+      return "ssse3";
+    case SimdLevel::kSse41:
+      return "sse4.1";
+    case SimdLevel::kAvx2:
+      return "avx2";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
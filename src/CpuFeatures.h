@@ -0,0 +1,33 @@
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VIBE_ARCH_X86 1
+#endif
+
+// Marks a function as compiled for |features| so intrinsics can be used without raising the
+// baseline of the whole target. MSVC accepts intrinsics anywhere and needs no attribute.
+#if defined(VIBE_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define VIBE_TARGET(features) __attribute__((target(features)))
+#else
+#define VIBE_TARGET(features)
+#endif
+
+namespace vibe {
+
+enum class SimdLevel {
+  kScalar = 0,
+  kSse2,
+  kSsse3,
+  kSse41,
+  kAvx2,
+};
+
+// Highest level supported by both the CPU and the current cap.
+SimdLevel ActiveSimdLevel();
+
+// Limits dispatch to at most |level|; used by benchmarks to compare kernels on one machine.
+void SetSimdLevelCap(SimdLevel level);
+
+const char* SimdLevelName(SimdLevel level);
+
+}  // namespace vibe
@@ -0,0 +1,108 @@
+#include "ImageDecoder.h"
+
+#include "JpegDecoder.h"
+#include "PngDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace vibe {
+namespace {
+
+class PortableImageDecoder final : public ImageDecoder {
+ public:
+  const char* name() const override { return "portable"; }
+
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override {
+    if (format == ImageFormat::kUnknown) format = SniffImageFormat(data);
+    switch (format) {
+      case ImageFormat::kPng:
+        return DecodePng(data, min_long_edge, sink);
+      case ImageFormat::kJpeg:
+        return DecodeJpeg(data, min_long_edge, sink);
+      default:
+        return DecodeStatus::kUnsupported;
+    }
+  }
+};
+
+class DecodedImageSink final : public ImageRowSink {
+ public:
+  explicit DecodedImageSink(DecodedImage* image) : image_(image) {}
+
+  DecodeStatus Begin(const ImageLayout& layout) override {
+    const DecodeStatus status = image_->Allocate(layout.width, layout.height);
+    image_->source_width = layout.source_width;
+    image_->source_height = layout.source_height;
+    return status;
+  }
+  void PushRow(const uint8_t* row) override {
+    if (next_row_ < image_->height) std::memcpy(image_->row(next_row_++), row, image_->stride);
+  }
+
+  bool complete() const { return image_->pixels && next_row_ == image_->height; }
+
+ private:
+  DecodedImage* image_;
+  uint32_t next_row_ = 0;
+};
+
+}  // namespace
+
+DecodeStatus DecodedImage::Allocate(uint32_t image_width, uint32_t image_height) {
+  if (image_width == 0 || image_height == 0) return DecodeStatus::kCorrupt;
+  if (image_width > kMaxImageDimension || image_height > kMaxImageDimension ||
+      static_cast<uint64_t>(image_width) * image_height > kMaxImagePixels) {
+    return DecodeStatus::kTooLarge;
+  }
+
+  const size_t image_stride = static_cast<size_t>(image_width) * 4;
+  pixels.reset(new (std::nothrow) uint8_t[image_stride * image_height]);
+  if (!pixels) return DecodeStatus::kOutOfMemory;
+  width = image_width;
+  height = image_height;
+  stride = image_stride;
+  source_width = image_width;
+  source_height = image_height;
+  return DecodeStatus::kOk;
+}
+
+DecodeStatus ImageDecoder::Decode(std::span<const uint8_t> data, uint32_t min_long_edge,
+                                  DecodedImage* image) {
+  DecodedImageSink sink(image);
+  const DecodeStatus status = DecodeRows(data, SniffImageFormat(data), min_long_edge, &sink);
+  if (status == DecodeStatus::kOk && !sink.complete()) return DecodeStatus::kCorrupt;
+  return status;
+}
+
+uint32_t SelectDecodeScale(uint32_t width, uint32_t height, uint32_t min_long_edge) {
+  const uint32_t long_edge = std::max(width, height);
+  if (min_long_edge == 0) return 1;
+  uint32_t scale = 8;
+  while (scale > 1 && (long_edge + scale - 1) / scale < min_long_edge) scale /= 2;
+  return scale;
+}
+
+const char* DecodeStatusName(DecodeStatus status) {
+  switch (status) {
+    case DecodeStatus::kOk:
+      return "ok";
+    case DecodeStatus::kUnsupported:
+      return "unsupported";
+    case DecodeStatus::kCorrupt:
+      return "corrupt";
+    case DecodeStatus::kTooLarge:
+      return "too large";
+    case DecodeStatus::kOutOfMemory:
+      return "out of memory";
+  }
+  return "unknown";
+}
+
+std::unique_ptr<ImageDecoder> CreatePortableImageDecoder() {
+  return std::make_unique<PortableImageDecoder>();
+}
+
+}  // namespace vibe
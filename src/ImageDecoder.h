@@ -0,0 +1,120 @@
+#pragma once
+
+#include "ImageFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace vibe {
+
+// Decoders refuse anything larger instead of allocating for it.
+constexpr uint32_t kMaxImageDimension = 1u << 15;
+constexpr uint64_t kMaxImagePixels = uint64_t{1} << 26;
+
+enum class DecodeStatus {
+  kOk,
+  kUnsupported,
+  kCorrupt,
+  kTooLarge,
+  kOutOfMemory,
+};
+
+const char* DecodeStatusName(DecodeStatus status);
+
+// What the caller is willing to spend on one image, checked before anything is allocated for it.
+struct DecodeLimits {
+  // Pixels of the encoded image, whatever size it is decoded at.
+  uint64_t max_pixels = kMaxImagePixels;
+  // Decoder working memory plus the caller's own buffers for the result.
+  uint64_t max_bytes = uint64_t{256} << 20;
+};
+
+// Announced by a decoder once the header is parsed, before it allocates anything sized by the
+// image.
+struct ImageLayout {
+  // Size of the rows that follow.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Size of the encoded image; larger when the decoder reduces it.
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+  // What the decoder holds on top of the rows it hands out.
+  uint64_t working_bytes = 0;
+  // Every row will have alpha 255: the format has no alpha channel, or none this image uses.
+  bool opaque = false;
+};
+
+// Receives a decoded image as straight-alpha BGRA rows, top to bottom. Decoders that can produce
+// rows as they go never hold the whole frame.
+class ImageRowSink {
+ public:
+  virtual ~ImageRowSink() = default;
+
+  // Anything but kOk stops the decode with that status.
+  virtual DecodeStatus Begin(const ImageLayout& layout) = 0;
+  // |row| holds |layout.width| pixels and is only valid during the call.
+  virtual void PushRow(const uint8_t* row) = 0;
+};
+
+// Straight-alpha BGRA pixels, top row first, rows |stride| bytes apart.
+struct DecodedImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  size_t stride = 0;
+  std::unique_ptr<uint8_t[]> pixels;
+  // Size of the encoded image. Larger than |width| x |height| when the decoder reduced it.
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+
+  // Sizes the buffer for |width| x |height| pixels and takes that as the source size too.
+  // Contents are left uninitialized.
+  DecodeStatus Allocate(uint32_t image_width, uint32_t image_height);
+  uint8_t* row(uint32_t y) { return pixels.get() + y * stride; }
+  const uint8_t* row(uint32_t y) const { return pixels.get() + y * stride; }
+};
+
+// The largest of 1, 2, 4 and 8 that a |width| x |height| image can be divided by while its long
+// edge stays at least |min_long_edge|. A zero |min_long_edge| asks for the full size.
+uint32_t SelectDecodeScale(uint32_t width, uint32_t height, uint32_t min_long_edge);
+
+// Turns an encoded image (PNG, JPEG, ...) into rows for an ImageRowSink. Implementations may keep
+// state between calls but are not shared across threads.
+//
+// |min_long_edge| is the largest edge the caller will scale down to. Decoders that can skip detail
+// cheaply (JPEG DCT scaling, the early Adam7 passes) may return the image reduced by
+// SelectDecodeScale(); the rest ignore it.
+class ImageDecoder {
+ public:
+  virtual ~ImageDecoder() = default;
+
+  virtual const char* name() const = 0;
+  // |format| is what the caller found the payload to be, from its signature or its data URL, so
+  // the matching codec is set up directly; with kUnknown the decoder works it out itself.
+  virtual DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                                  uint32_t min_long_edge, ImageRowSink* sink) = 0;
+
+  // Decoders that pull their input on demand take the payload still base64-encoded and read it
+  // through a Base64Reader, so bytes they never ask for are never decoded. Callers check
+  // decodes_base64() and otherwise decode the payload themselves and call DecodeRows().
+  virtual bool decodes_base64() const { return false; }
+  virtual DecodeStatus DecodeBase64Rows(std::string_view encoded, ImageFormat format,
+                                        uint32_t min_long_edge, ImageRowSink* sink) {
+    (void)encoded;
+    (void)format;
+    (void)min_long_edge;
+    (void)sink;
+    return DecodeStatus::kUnsupported;
+  }
+
+  // Collects the rows into |image|, taking the format from the data's signature.
+  DecodeStatus Decode(std::span<const uint8_t> data, uint32_t min_long_edge, DecodedImage* image);
+};
+
+// Built-in PNG and baseline JPEG decoding with no platform dependencies. Other formats are
+// refused as kUnsupported.
+std::unique_ptr<ImageDecoder> CreatePortableImageDecoder();
+
+}  // namespace vibe
@@ -0,0 +1,92 @@
+#include "ImageFormat.h"
+
+#include <cstring>
+
+namespace vibe {
+namespace {
+
+bool HasPrefix(std::span<const uint8_t> data, const void* prefix, size_t length) {
+  return data.size() >= length && std::memcmp(data.data(), prefix, length) == 0;
+}
+
+bool EqualsIgnoringCase(std::string_view a, std::string_view b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); ++i) {
+    const char lower = a[i] >= 'A' && a[i] <= 'Z' ? static_cast<char>(a[i] - 'A' + 'a') : a[i];
+    if (lower != b[i]) return false;
+  }
+  return true;
+}
+
+struct MimeType {
+  std::string_view name;
+  ImageFormat format;
+};
+
+// "image/jpg" is not registered but shows up in data URLs all the same.
+constexpr MimeType kMimeTypes[] = {
+    {"image/png", ImageFormat::kPng},   {"image/jpeg", ImageFormat::kJpeg},
+    {"image/jpg", ImageFormat::kJpeg},  {"image/webp", ImageFormat::kWebp},
+    {"image/gif", ImageFormat::kGif},   {"image/bmp", ImageFormat::kBmp},
+};
+
+}  // namespace
+
+ImageFormat SniffImageFormat(std::span<const uint8_t> header) {
+  constexpr uint8_t kPng[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  constexpr uint8_t kJpeg[3] = {0xFF, 0xD8, 0xFF};
+  if (HasPrefix(header, kPng, sizeof(kPng))) return ImageFormat::kPng;
+  if (HasPrefix(header, kJpeg, sizeof(kJpeg))) return ImageFormat::kJpeg;
+  if (header.size() >= 12 && HasPrefix(header, "RIFF", 4) &&
+      std::memcmp(header.data() + 8, "WEBP", 4) == 0) {
+    return ImageFormat::kWebp;
+  }
+  if (HasPrefix(header, "GIF87a", 6) || HasPrefix(header, "GIF89a", 6)) return ImageFormat::kGif;
+  // "BM" alone is too weak: the two reserved words after the file size must be zero too.
+  if (header.size() >= 10 && HasPrefix(header, "BM", 2) && header[6] == 0 && header[7] == 0 &&
+      header[8] == 0 && header[9] == 0) {
+    return ImageFormat::kBmp;
+  }
+  return ImageFormat::kUnknown;
+}
+
+ImageFormat ImageFormatFromDataUrl(std::string_view payload) {
+  constexpr std::string_view kScheme = "data:";
+  if (payload.size() < kScheme.size() || !EqualsIgnoringCase(payload.substr(0, 5), kScheme)) {
+    return ImageFormat::kUnknown;
+  }
+  const size_t end = payload.find_first_of(";,", kScheme.size());
+  if (end == std::string_view::npos) return ImageFormat::kUnknown;
+  const std::string_view type = payload.substr(kScheme.size(), end - kScheme.size());
+  for (const MimeType& mime : kMimeTypes) {
+    if (EqualsIgnoringCase(type, mime.name)) return mime.format;
+  }
+  return ImageFormat::kUnknown;
+}
+
+const char* ImageFormatMimeType(ImageFormat format) {
+  for (const MimeType& mime : kMimeTypes) {
+    if (mime.format == format) return mime.name.data();
+  }
+  return nullptr;
+}
+
+const char* ImageFormatName(ImageFormat format) {
+  switch (format) {
+    case ImageFormat::kUnknown:
+      return "unknown";
+    case ImageFormat::kPng:
+      return "png";
+    case ImageFormat::kJpeg:
+      return "jpeg";
+    case ImageFormat::kWebp:
+      return "webp";
+    case ImageFormat::kGif:
+      return "gif";
+    case ImageFormat::kBmp:
+      return "bmp";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
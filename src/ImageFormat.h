@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace vibe {
+
+// Image formats a payload may be in, as far as choosing a decoder goes.
+enum class ImageFormat {
+  kUnknown,
+  kPng,
+  kJpeg,
+  kWebp,
+  kGif,
+  kBmp,
+};
+constexpr size_t kImageFormatCount = 6;
+
+const char* ImageFormatName(ImageFormat format);
+
+// "image/png" and so on; null for kUnknown.
+const char* ImageFormatMimeType(ImageFormat format);
+
+// Bytes SniffImageFormat needs to tell every format apart.
+constexpr size_t kImageSignatureBytes = 12;
+// Base64 characters that decode to them.
+constexpr size_t kImageSignatureChars = kImageSignatureBytes / 3 * 4;
+
+// The format whose signature |header|, the start of an encoded image, begins with.
+ImageFormat SniffImageFormat(std::span<const uint8_t> header);
+
+// The format named by the MIME type of a "data:image/...;base64," |payload|; kUnknown when there
+// is no data URL prefix or its type is not one of ours.
+ImageFormat ImageFormatFromDataUrl(std::string_view payload);
+
+}  // namespace vibe
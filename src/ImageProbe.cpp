@@ -0,0 +1,136 @@
+#include "ImageProbe.h"
+
+#include <cstring>
+
+namespace vibe {
+namespace {
+
+uint32_t ReadBigEndian16(const uint8_t* p) { return (uint32_t{p[0]} << 8) | p[1]; }
+
+uint32_t ReadBigEndian32(const uint8_t* p) {
+  return (uint32_t{p[0]} << 24) | (uint32_t{p[1]} << 16) | (uint32_t{p[2]} << 8) | p[3];
+}
+
+uint32_t ReadLittleEndian16(const uint8_t* p) { return p[0] | (uint32_t{p[1]} << 8); }
+
+uint32_t ReadLittleEndian24(const uint8_t* p) {
+  return p[0] | (uint32_t{p[1]} << 8) | (uint32_t{p[2]} << 16);
+}
+
+uint32_t ReadLittleEndian32(const uint8_t* p) {
+  return ReadLittleEndian24(p) | (uint32_t{p[3]} << 24);
+}
+
+bool HasPrefix(std::span<const uint8_t> data, const void* prefix, size_t length) {
+  return data.size() >= length && std::memcmp(data.data(), prefix, length) == 0;
+}
+
+ProbeStatus NeedMore(size_t length, size_t* needed) {
+  *needed = length;
+  return ProbeStatus::kNeedMore;
+}
+
+ProbeStatus Found(uint32_t width, uint32_t height, ImageSize* size) {
+  if (width == 0 || height == 0) return ProbeStatus::kCorrupt;
+  *size = {width, height};
+  return ProbeStatus::kOk;
+}
+
+// Signature, then IHDR: length, type, width, height.
+ProbeStatus ProbePng(std::span<const uint8_t> data, ImageSize* size, size_t* needed) {
+  if (data.size() < 24) return NeedMore(24, needed);
+  if (std::memcmp(data.data() + 12, "IHDR", 4) != 0) return ProbeStatus::kCorrupt;
+  return Found(ReadBigEndian32(data.data() + 16), ReadBigEndian32(data.data() + 20), size);
+}
+
+// Walks the marker segments up to the first SOFn; APPn segments (EXIF, ICC profiles) ahead of it
+// can run to tens of kilobytes.
+ProbeStatus ProbeJpeg(std::span<const uint8_t> data, ImageSize* size, size_t* needed) {
+  size_t pos = 2;
+  for (;;) {
+    if (data.size() - pos < 2) return NeedMore(pos + 2, needed);
+    if (data[pos] != 0xFF) return ProbeStatus::kCorrupt;
+    const uint8_t marker = data[pos + 1];
+    if (marker == 0xFF) {
+      ++pos;  // Fill byte.
+      continue;
+    }
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+      pos += 2;  // TEM, RSTn and SOI carry no length.
+      continue;
+    }
+    if (marker == 0xDA || marker == 0xD9) return ProbeStatus::kCorrupt;  // Data before a frame.
+
+    const bool frame = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                       marker != 0xCC;
+    if (frame) {
+      if (data.size() - pos < 9) return NeedMore(pos + 9, needed);
+      return Found(ReadBigEndian16(data.data() + pos + 7), ReadBigEndian16(data.data() + pos + 5),
+                   size);
+    }
+    if (data.size() - pos < 4) return NeedMore(pos + 4, needed);
+    const uint32_t length = ReadBigEndian16(data.data() + pos + 2);
+    if (length < 2) return ProbeStatus::kCorrupt;
+    pos += 2 + length;
+    if (pos > data.size()) return NeedMore(pos + 2, needed);
+  }
+}
+
+// RIFF header, then the first chunk: lossy "VP8 ", lossless "VP8L" or extended "VP8X".
+ProbeStatus ProbeWebp(std::span<const uint8_t> data, ImageSize* size, size_t* needed) {
+  if (data.size() < 30) return NeedMore(30, needed);
+  const uint8_t* chunk = data.data() + 12;
+  const uint8_t* body = chunk + 8;
+  if (std::memcmp(chunk, "VP8 ", 4) == 0) {
+    // Frame tag (3 bytes), start code, then 14-bit sizes under 2-bit scale fields.
+    if (body[3] != 0x9D || body[4] != 0x01 || body[5] != 0x2A) return ProbeStatus::kCorrupt;
+    return Found(ReadLittleEndian16(body + 6) & 0x3FFF, ReadLittleEndian16(body + 8) & 0x3FFF,
+                 size);
+  }
+  if (std::memcmp(chunk, "VP8L", 4) == 0) {
+    if (body[0] != 0x2F) return ProbeStatus::kCorrupt;
+    const uint32_t bits = ReadLittleEndian32(body + 1);
+    return Found((bits & 0x3FFF) + 1, ((bits >> 14) & 0x3FFF) + 1, size);
+  }
+  if (std::memcmp(chunk, "VP8X", 4) == 0) {
+    return Found(ReadLittleEndian24(body + 4) + 1, ReadLittleEndian24(body + 7) + 1, size);
+  }
+  return ProbeStatus::kUnsupported;
+}
+
+constexpr uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+constexpr uint8_t kJpegSignature[3] = {0xFF, 0xD8, 0xFF};
+
+}  // namespace
+
+ProbeStatus ProbeImageSize(std::span<const uint8_t> header, ImageSize* size, size_t* needed) {
+  if (!size || !needed) return ProbeStatus::kUnsupported;
+
+  if (header.size() < 12) return NeedMore(12, needed);
+  if (HasPrefix(header, kPngSignature, sizeof(kPngSignature))) {
+    return ProbePng(header, size, needed);
+  }
+  if (HasPrefix(header, kJpegSignature, sizeof(kJpegSignature))) {
+    return ProbeJpeg(header, size, needed);
+  }
+  if (HasPrefix(header, "RIFF", 4) && std::memcmp(header.data() + 8, "WEBP", 4) == 0) {
+    return ProbeWebp(header, size, needed);
+  }
+  return ProbeStatus::kUnsupported;
+}
+
+const char* ProbeStatusName(ProbeStatus status) {
+  switch (status) {
+    case ProbeStatus::kOk:
+      return "ok";
+    case ProbeStatus::kNeedMore:
+      return "need more";
+    case ProbeStatus::kUnsupported:
+      return "unsupported";
+    case ProbeStatus::kCorrupt:
+      return "corrupt";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
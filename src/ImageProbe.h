@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Scaler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace vibe {
+
+enum class ProbeStatus {
+  kOk,
+  kNeedMore,
+  kUnsupported,
+  kCorrupt,
+};
+
+const char* ProbeStatusName(ProbeStatus status);
+
+// Reads the pixel size of a PNG, JPEG or WebP image from the first bytes of its encoding, without
+// decoding it. When |header| ends too early returns kNeedMore and sets |needed| to the length that
+// gets further: the full answer for PNG and WebP, the next segment for JPEG.
+ProbeStatus ProbeImageSize(std::span<const uint8_t> header, ImageSize* size, size_t* needed);
+
+}  // namespace vibe
@@ -0,0 +1,451 @@
+#include "Inflate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace vibe {
+namespace {
+
+constexpr int kFastBits = 10;
+constexpr int kMaxCodeLength = 15;
+constexpr int kMaxSymbols = 288;
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                        33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                        1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+constexpr uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8,  7, 9,  6, 10, 5,
+                                          11, 4,  12, 3, 13, 2, 14, 1, 15};
+
+// Canonical Huffman code. Codes up to kFastBits long resolve with one table lookup; longer ones
+// walk the per-length counts bit by bit.
+struct HuffmanTable {
+  // Symbol in the low 9 bits and code length above them; 0 when the prefix needs the slow path.
+  uint16_t fast[1 << kFastBits];
+  uint16_t count[kMaxCodeLength + 1];
+  uint16_t symbols[kMaxSymbols];
+
+  bool Build(const uint8_t* lengths, int symbol_count) {
+    std::fill(std::begin(count), std::end(count), uint16_t{0});
+    for (int i = 0; i < symbol_count; ++i) ++count[lengths[i]];
+    count[0] = 0;
+
+    int left = 1;
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+      left = (left << 1) - count[length];
+      if (left < 0) return false;
+    }
+
+    uint16_t offsets[kMaxCodeLength + 2] = {};
+    for (int length = 1; length <= kMaxCodeLength; ++length) {
+      offsets[length + 1] = static_cast<uint16_t>(offsets[length] + count[length]);
+    }
+    for (int symbol = 0; symbol < symbol_count; ++symbol) {
+      if (lengths[symbol]) symbols[offsets[lengths[symbol]]++] = static_cast<uint16_t>(symbol);
+    }
+
+    std::fill(std::begin(fast), std::end(fast), uint16_t{0});
+    uint32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= kMaxCodeLength; ++length, code <<= 1) {
+      for (int k = 0; k < count[length]; ++k, ++code, ++index) {
+        if (length > kFastBits) continue;
+        uint32_t reversed = 0;
+        for (int bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+        for (uint32_t slot = reversed; slot < (1u << kFastBits); slot += 1u << length) {
+          fast[slot] = static_cast<uint16_t>((length << 9) | symbols[index]);
+        }
+      }
+    }
+    return true;
+  }
+
+  // |bits| holds at least kMaxCodeLength upcoming bits, first bit in the lowest position.
+  int DecodeSlow(uint32_t bits, int* length) const {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int len = 1; len <= kMaxCodeLength; ++len) {
+      code |= (bits >> (len - 1)) & 1;
+      const int n = count[len];
+      if (code - n < first) {
+        *length = len;
+        return symbols[index + (code - first)];
+      }
+      index += n;
+      first = (first + n) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+};
+
+struct FixedTables {
+  HuffmanTable literal;
+  HuffmanTable distance;
+
+  FixedTables() {
+    uint8_t lengths[kMaxSymbols];
+    std::fill(lengths, lengths + 144, uint8_t{8});
+    std::fill(lengths + 144, lengths + 256, uint8_t{9});
+    std::fill(lengths + 256, lengths + 280, uint8_t{7});
+    std::fill(lengths + 280, lengths + 288, uint8_t{8});
+    literal.Build(lengths, 288);
+    std::fill(lengths, lengths + 30, uint8_t{5});
+    distance.Build(lengths, 30);
+  }
+};
+
+}  // namespace
+
+// Resumable: Run() stops with kOutputFull whenever the output runs out, between symbols or in the
+// middle of a match, and the next call carries on from there.
+class Inflater {
+ public:
+  explicit Inflater(std::span<const uint8_t> input)
+      : in_(input.data()), in_end_(input.data() + input.size()) {}
+
+  // Inflates into [out, end). Matches may reach back as far as |history|, which holds the output
+  // of earlier calls right before |out|.
+  InflateStatus Run(uint8_t* history, uint8_t* out, uint8_t* end, size_t* written) {
+    out_begin_ = history;
+    out_ = out;
+    out_end_ = end;
+    InflateStatus status = InflateStatus::kOk;
+    while (status == InflateStatus::kOk && block_ != Block::kDone) {
+      switch (block_) {
+        case Block::kHeader:
+          status = BlockHeader();
+          break;
+        case Block::kStored:
+          status = StoredBlock();
+          break;
+        case Block::kCodes:
+          status = CodesBlock();
+          break;
+        case Block::kDone:
+          break;
+      }
+      if (status == InflateStatus::kOk && Overrun()) status = InflateStatus::kTruncated;
+    }
+    *written = static_cast<size_t>(out_ - out);
+    return status;
+  }
+
+ private:
+  enum class Block { kHeader, kStored, kCodes, kDone };
+
+  struct BitState {
+    const uint8_t* in;
+    uint64_t bits;
+    int count;
+    size_t padding;
+  };
+
+  // Tops the bit buffer up to at least 56 bits. Past the end of the input it shifts in zeros and
+  // counts them, so truncation is detected once those bits are actually consumed.
+  void Refill() {
+    if (in_end_ - in_ >= 8) {
+      uint64_t value = 0;
+      std::memcpy(&value, in_, sizeof(value));
+      bits_ |= value << count_;
+      in_ += (63 - count_) >> 3;
+      count_ |= 56;
+      return;
+    }
+    while (count_ <= 56) {
+      uint64_t byte = 0;
+      if (in_ < in_end_) {
+        byte = *in_++;
+      } else {
+        ++padding_;
+      }
+      bits_ |= byte << count_;
+      count_ += 8;
+    }
+  }
+
+  uint32_t GetBits(int n) {
+    if (count_ < n) Refill();
+    const uint32_t value = static_cast<uint32_t>(bits_ & ((uint64_t{1} << n) - 1));
+    bits_ >>= n;
+    count_ -= n;
+    return value;
+  }
+
+  bool Overrun() const { return padding_ * 8 > static_cast<size_t>(count_); }
+
+  int DecodeSymbol(const HuffmanTable& table) {
+    if (count_ < kMaxCodeLength) Refill();
+    const uint16_t entry = table.fast[bits_ & ((1u << kFastBits) - 1)];
+    int length = entry >> 9;
+    int symbol = entry & 511;
+    if (!entry) {
+      symbol = table.DecodeSlow(static_cast<uint32_t>(bits_), &length);
+      if (symbol < 0) return -1;
+    }
+    bits_ >>= length;
+    count_ -= length;
+    return symbol;
+  }
+
+  InflateStatus BlockHeader() {
+    if (final_block_) {
+      block_ = Block::kDone;
+      return InflateStatus::kOk;
+    }
+    final_block_ = GetBits(1) != 0;
+    switch (GetBits(2)) {
+      case 0:
+        return StoredHeader();
+      case 1: {
+        static const FixedTables fixed;
+        literal_table_ = &fixed.literal;
+        distance_table_ = &fixed.distance;
+        block_ = Block::kCodes;
+        return InflateStatus::kOk;
+      }
+      case 2:
+        return DynamicHeader();
+      default:
+        return InflateStatus::kCorrupt;
+    }
+  }
+
+  InflateStatus StoredHeader() {
+    GetBits(count_ & 7);
+    // Hand the whole bytes still buffered back to the input and copy straight from it.
+    const size_t buffered = static_cast<size_t>(count_) / 8;
+    if (buffered < padding_) return InflateStatus::kTruncated;
+    in_ -= buffered - padding_;
+    bits_ = 0;
+    count_ = 0;
+    padding_ = 0;
+
+    if (in_end_ - in_ < 4) return InflateStatus::kTruncated;
+    const uint32_t length = in_[0] | (in_[1] << 8);
+    const uint32_t complement = in_[2] | (in_[3] << 8);
+    in_ += 4;
+    if ((length ^ 0xFFFF) != complement) return InflateStatus::kCorrupt;
+    stored_left_ = length;
+    block_ = Block::kStored;
+    return InflateStatus::kOk;
+  }
+
+  InflateStatus StoredBlock() {
+    const size_t available = static_cast<size_t>(in_end_ - in_);
+    const size_t room = static_cast<size_t>(out_end_ - out_);
+    const size_t copy = std::min({stored_left_, available, room});
+    std::memcpy(out_, in_, copy);
+    out_ += copy;
+    in_ += copy;
+    stored_left_ -= copy;
+    if (stored_left_ != 0) {
+      return copy == available ? InflateStatus::kTruncated : InflateStatus::kOutputFull;
+    }
+    block_ = Block::kHeader;
+    return InflateStatus::kOk;
+  }
+
+  InflateStatus DynamicHeader() {
+    const int literal_count = static_cast<int>(GetBits(5)) + 257;
+    const int distance_count = static_cast<int>(GetBits(5)) + 1;
+    const int code_length_count = static_cast<int>(GetBits(4)) + 4;
+    if (literal_count > 286 || distance_count > 30) return InflateStatus::kCorrupt;
+
+    uint8_t code_lengths[19] = {};
+    for (int i = 0; i < code_length_count; ++i) {
+      code_lengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(GetBits(3));
+    }
+    HuffmanTable code_length_table;
+    if (!code_length_table.Build(code_lengths, 19)) return InflateStatus::kCorrupt;
+
+    uint8_t lengths[286 + 30] = {};
+    const int total = literal_count + distance_count;
+    for (int n = 0; n < total;) {
+      const int symbol = DecodeSymbol(code_length_table);
+      if (symbol < 0) return InflateStatus::kCorrupt;
+      if (symbol < 16) {
+        lengths[n++] = static_cast<uint8_t>(symbol);
+        continue;
+      }
+
+      uint8_t value = 0;
+      int repeat = 0;
+      if (symbol == 16) {
+        if (n == 0) return InflateStatus::kCorrupt;
+        value = lengths[n - 1];
+        repeat = 3 + static_cast<int>(GetBits(2));
+      } else if (symbol == 17) {
+        repeat = 3 + static_cast<int>(GetBits(3));
+      } else {
+        repeat = 11 + static_cast<int>(GetBits(7));
+      }
+      if (repeat > total - n) return InflateStatus::kCorrupt;
+      std::fill(lengths + n, lengths + n + repeat, value);
+      n += repeat;
+    }
+    if (Overrun()) return InflateStatus::kTruncated;
+    if (lengths[256] == 0) return InflateStatus::kCorrupt;
+
+    if (!literal_.Build(lengths, literal_count) ||
+        !distance_.Build(lengths + literal_count, distance_count)) {
+      return InflateStatus::kCorrupt;
+    }
+    literal_table_ = &literal_;
+    distance_table_ = &distance_;
+    block_ = Block::kCodes;
+    return InflateStatus::kOk;
+  }
+
+  // Copies up to |length| bytes from |back| bytes behind the output; true when all fit.
+  bool CopyMatch(size_t length, size_t back) {
+    const size_t copy = std::min(length, static_cast<size_t>(out_end_ - out_));
+    const uint8_t* from = out_ - back;
+    if (back >= copy) {
+      std::memcpy(out_, from, copy);
+      out_ += copy;
+    } else {
+      for (size_t i = 0; i < copy; ++i) *out_++ = *from++;
+    }
+    match_left_ = length - copy;
+    match_back_ = back;
+    return match_left_ == 0;
+  }
+
+  InflateStatus CodesBlock() {
+    if (match_left_ != 0 && !CopyMatch(match_left_, match_back_)) {
+      return InflateStatus::kOutputFull;
+    }
+    for (;;) {
+      // A literal that finds the output full is put back for the next call.
+      const BitState saved = {in_, bits_, count_, padding_};
+      int symbol = DecodeSymbol(*literal_table_);
+      if (symbol < 0) return InflateStatus::kCorrupt;
+      if (symbol < 256) {
+        if (out_ == out_end_) {
+          if (Overrun()) return InflateStatus::kTruncated;
+          in_ = saved.in;
+          bits_ = saved.bits;
+          count_ = saved.count;
+          padding_ = saved.padding;
+          return InflateStatus::kOutputFull;
+        }
+        *out_++ = static_cast<uint8_t>(symbol);
+        continue;
+      }
+      if (symbol == 256) {
+        block_ = Block::kHeader;
+        return InflateStatus::kOk;
+      }
+
+      symbol -= 257;
+      if (symbol >= 29) return InflateStatus::kCorrupt;
+      const size_t length = kLengthBase[symbol] + GetBits(kLengthExtra[symbol]);
+      const int distance_symbol = DecodeSymbol(*distance_table_);
+      if (distance_symbol < 0 || distance_symbol >= 30) return InflateStatus::kCorrupt;
+      const size_t back = kDistanceBase[distance_symbol] + GetBits(kDistanceExtra[distance_symbol]);
+      if (Overrun()) return InflateStatus::kTruncated;
+      if (back > static_cast<size_t>(out_ - out_begin_)) return InflateStatus::kCorrupt;
+      if (!CopyMatch(length, back)) return InflateStatus::kOutputFull;
+    }
+  }
+
+  const uint8_t* in_;
+  const uint8_t* const in_end_;
+  uint8_t* out_begin_ = nullptr;
+  uint8_t* out_ = nullptr;
+  uint8_t* out_end_ = nullptr;
+  uint64_t bits_ = 0;
+  int count_ = 0;
+  size_t padding_ = 0;
+
+  Block block_ = Block::kHeader;
+  bool final_block_ = false;
+  size_t stored_left_ = 0;
+  size_t match_left_ = 0;
+  size_t match_back_ = 0;
+  const HuffmanTable* literal_table_ = nullptr;
+  const HuffmanTable* distance_table_ = nullptr;
+  HuffmanTable literal_;
+  HuffmanTable distance_;
+};
+
+namespace {
+
+InflateStatus CheckZlibHeader(std::span<const uint8_t> input) {
+  if (input.size() < 2) return InflateStatus::kTruncated;
+  const uint32_t cmf = input[0];
+  const uint32_t flags = input[1];
+  if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flags) % 31 != 0 || (flags & 0x20)) {
+    return InflateStatus::kCorrupt;
+  }
+  return InflateStatus::kOk;
+}
+
+}  // namespace
+
+InflateStatus ZlibInflate(std::span<const uint8_t> input, std::span<uint8_t> output,
+                          size_t* written) {
+  *written = 0;
+  const InflateStatus header = CheckZlibHeader(input);
+  if (header != InflateStatus::kOk) return header;
+
+  // The output is its own history.
+  Inflater inflater(input.subspan(2));
+  return inflater.Run(output.data(), output.data(), output.data() + output.size(), written);
+}
+
+size_t ZlibStream::ArenaBytes() {
+  const auto round = [](size_t size) {
+    return (size + ScratchArena::kAlignment - 1) / ScratchArena::kAlignment *
+           ScratchArena::kAlignment;
+  };
+  return round(sizeof(Inflater)) + round(kWindowBytes + kChunkBytes);
+}
+
+InflateStatus ZlibStream::Init(std::span<const uint8_t> input, ScratchArena& arena) {
+  const InflateStatus header = CheckZlibHeader(input);
+  if (header != InflateStatus::kOk) return header;
+  void* memory = arena.Allocate(sizeof(Inflater));
+  window_ = arena.AllocateArray<uint8_t>(kWindowBytes + kChunkBytes);
+  if (!memory || !window_) return InflateStatus::kOutOfMemory;
+  // Trivially destructible, so releasing the arena scope is all the cleanup it needs.
+  inflater_ = new (memory) Inflater(input.subspan(2));
+  read_ = 0;
+  filled_ = 0;
+  status_ = InflateStatus::kOutputFull;
+  return InflateStatus::kOk;
+}
+
+InflateStatus ZlibStream::Read(std::span<uint8_t> output, size_t* written) {
+  *written = 0;
+  if (!inflater_) return InflateStatus::kCorrupt;
+  for (;;) {
+    const size_t copy = std::min(output.size() - *written, filled_ - read_);
+    std::memcpy(output.data() + *written, window_ + read_, copy);
+    read_ += copy;
+    *written += copy;
+    if (*written == output.size()) return InflateStatus::kOk;
+    // Everything inflated has been handed out; kOk here means the stream ended.
+    if (status_ != InflateStatus::kOutputFull) return status_;
+
+    if (filled_ == kWindowBytes + kChunkBytes) {
+      std::memmove(window_, window_ + kChunkBytes, kWindowBytes);
+      filled_ = kWindowBytes;
+      read_ = kWindowBytes;
+    }
+    size_t inflated = 0;
+    status_ = inflater_->Run(window_, window_ + filled_, window_ + kWindowBytes + kChunkBytes,
+                             &inflated);
+    filled_ += inflated;
+  }
+}
+
+}  // namespace vibe
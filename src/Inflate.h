@@ -0,0 +1,53 @@
+#pragma once
+
+#include "ScratchArena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace vibe {
+
+enum class InflateStatus {
+  kOk,
+  kCorrupt,
+  kTruncated,
+  // The stream holds more data than |output| can take; |output| is full.
+  kOutputFull,
+  kOutOfMemory,
+};
+
+// Decompresses a zlib stream (RFC 1950 framing around RFC 1951 deflate) into |output|. The
+// Adler-32 trailer is not checked. |written| receives the number of bytes produced.
+InflateStatus ZlibInflate(std::span<const uint8_t> input, std::span<uint8_t> output,
+                          size_t* written);
+
+class Inflater;
+
+// Inflates a zlib stream a piece at a time, keeping only the 32 KB of history deflate can refer
+// to, so the whole output never has to exist at once.
+class ZlibStream {
+ public:
+  static constexpr size_t kWindowBytes = 32 * 1024;
+  static constexpr size_t kChunkBytes = 32 * 1024;
+
+  // What Init takes from the arena.
+  static size_t ArenaBytes();
+
+  // The decoder state and window come from |arena| and stay valid until the Scope they were
+  // allocated in closes.
+  InflateStatus Init(std::span<const uint8_t> input, ScratchArena& arena);
+
+  // Fills |output| and returns kOk, unless the stream ends first: then kOk with |*written| short
+  // of the size, or the reason it could not be read further.
+  InflateStatus Read(std::span<uint8_t> output, size_t* written);
+
+ private:
+  Inflater* inflater_ = nullptr;
+  uint8_t* window_ = nullptr;
+  size_t read_ = 0;
+  size_t filled_ = 0;
+  InflateStatus status_ = InflateStatus::kCorrupt;
+};
+
+}  // namespace vibe
@@ -0,0 +1,835 @@
+#include "JpegDecoder.h"
+
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+namespace vibe {
+namespace {
+
+constexpr int kFastBits = 9;
+constexpr int kMaxComponents = 3;
+
+// Natural (row-major) position of each zigzag index.
+constexpr uint8_t kZigzag[64] = {0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+                                 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+                                 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+                                 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Fixed-point constants of libjpeg's jidctint.c (CONST_BITS = 13).
+constexpr int kConstBits = 13;
+constexpr int kPass1Bits = 2;
+constexpr int64_t kFix0_298631336 = 2446;
+constexpr int64_t kFix0_390180644 = 3196;
+constexpr int64_t kFix0_541196100 = 4433;
+constexpr int64_t kFix0_765366865 = 6270;
+constexpr int64_t kFix0_899976223 = 7373;
+constexpr int64_t kFix1_175875602 = 9633;
+constexpr int64_t kFix1_501321110 = 12299;
+constexpr int64_t kFix1_847759065 = 15137;
+constexpr int64_t kFix1_961570560 = 16069;
+constexpr int64_t kFix2_053119869 = 16819;
+constexpr int64_t kFix2_562915447 = 20995;
+constexpr int64_t kFix3_072711026 = 25172;
+
+uint16_t ReadBigEndian16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+int64_t Descale(int64_t value, int bits) {
+  return (value + (int64_t{1} << (bits - 1))) >> bits;
+}
+
+uint8_t ClampSample(int64_t value) {
+  return static_cast<uint8_t>(std::clamp<int64_t>(value, 0, 255));
+}
+
+// libjpeg's accurate integer inverse DCT. Intermediates are 64-bit so corrupt coefficients cannot
+// overflow.
+void IdctBlock(const int32_t* in, uint8_t* out, size_t stride) {
+  int64_t ws[64];
+  for (int col = 0; col < 8; ++col) {
+    const int32_t* c = in + col;
+    if (!c[8] && !c[16] && !c[24] && !c[32] && !c[40] && !c[48] && !c[56]) {
+      const int64_t dc = static_cast<int64_t>(c[0]) << kPass1Bits;
+      for (int k = 0; k < 8; ++k) ws[k * 8 + col] = dc;
+      continue;
+    }
+
+    int64_t z2 = c[16];
+    int64_t z3 = c[48];
+    int64_t z1 = (z2 + z3) * kFix0_541196100;
+    int64_t tmp2 = z1 + z3 * -kFix1_847759065;
+    int64_t tmp3 = z1 + z2 * kFix0_765366865;
+    z2 = c[0];
+    z3 = c[32];
+    int64_t tmp0 = (z2 + z3) * (int64_t{1} << kConstBits);
+    int64_t tmp1 = (z2 - z3) * (int64_t{1} << kConstBits);
+    const int64_t tmp10 = tmp0 + tmp3;
+    const int64_t tmp13 = tmp0 - tmp3;
+    const int64_t tmp11 = tmp1 + tmp2;
+    const int64_t tmp12 = tmp1 - tmp2;
+
+    tmp0 = c[56];
+    tmp1 = c[40];
+    tmp2 = c[24];
+    tmp3 = c[8];
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    int64_t z4 = tmp1 + tmp3;
+    const int64_t z5 = (z3 + z4) * kFix1_175875602;
+    tmp0 *= kFix0_298631336;
+    tmp1 *= kFix2_053119869;
+    tmp2 *= kFix3_072711026;
+    tmp3 *= kFix1_501321110;
+    z1 *= -kFix0_899976223;
+    z2 *= -kFix2_562915447;
+    z3 = z3 * -kFix1_961570560 + z5;
+    z4 = z4 * -kFix0_390180644 + z5;
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    constexpr int kShift = kConstBits - kPass1Bits;
+    ws[col] = Descale(tmp10 + tmp3, kShift);
+    ws[56 + col] = Descale(tmp10 - tmp3, kShift);
+    ws[8 + col] = Descale(tmp11 + tmp2, kShift);
+    ws[48 + col] = Descale(tmp11 - tmp2, kShift);
+    ws[16 + col] = Descale(tmp12 + tmp1, kShift);
+    ws[40 + col] = Descale(tmp12 - tmp1, kShift);
+    ws[24 + col] = Descale(tmp13 + tmp0, kShift);
+    ws[32 + col] = Descale(tmp13 - tmp0, kShift);
+  }
+
+  for (int row = 0; row < 8; ++row, out += stride) {
+    const int64_t* w = ws + row * 8;
+    if (!w[1] && !w[2] && !w[3] && !w[4] && !w[5] && !w[6] && !w[7]) {
+      std::memset(out, ClampSample(Descale(w[0], kPass1Bits + 3) + 128), 8);
+      continue;
+    }
+
+    int64_t z2 = w[2];
+    int64_t z3 = w[6];
+    int64_t z1 = (z2 + z3) * kFix0_541196100;
+    int64_t tmp2 = z1 + z3 * -kFix1_847759065;
+    int64_t tmp3 = z1 + z2 * kFix0_765366865;
+    int64_t tmp0 = (w[0] + w[4]) * (int64_t{1} << kConstBits);
+    int64_t tmp1 = (w[0] - w[4]) * (int64_t{1} << kConstBits);
+    const int64_t tmp10 = tmp0 + tmp3;
+    const int64_t tmp13 = tmp0 - tmp3;
+    const int64_t tmp11 = tmp1 + tmp2;
+    const int64_t tmp12 = tmp1 - tmp2;
+
+    tmp0 = w[7];
+    tmp1 = w[5];
+    tmp2 = w[3];
+    tmp3 = w[1];
+    z1 = tmp0 + tmp3;
+    z2 = tmp1 + tmp2;
+    z3 = tmp0 + tmp2;
+    int64_t z4 = tmp1 + tmp3;
+    const int64_t z5 = (z3 + z4) * kFix1_175875602;
+    tmp0 *= kFix0_298631336;
+    tmp1 *= kFix2_053119869;
+    tmp2 *= kFix3_072711026;
+    tmp3 *= kFix1_501321110;
+    z1 *= -kFix0_899976223;
+    z2 *= -kFix2_562915447;
+    z3 = z3 * -kFix1_961570560 + z5;
+    z4 = z4 * -kFix0_390180644 + z5;
+    tmp0 += z1 + z3;
+    tmp1 += z2 + z4;
+    tmp2 += z2 + z3;
+    tmp3 += z1 + z4;
+
+    constexpr int kShift = kConstBits + kPass1Bits + 3;
+    out[0] = ClampSample(Descale(tmp10 + tmp3, kShift) + 128);
+    out[7] = ClampSample(Descale(tmp10 - tmp3, kShift) + 128);
+    out[1] = ClampSample(Descale(tmp11 + tmp2, kShift) + 128);
+    out[6] = ClampSample(Descale(tmp11 - tmp2, kShift) + 128);
+    out[2] = ClampSample(Descale(tmp12 + tmp1, kShift) + 128);
+    out[5] = ClampSample(Descale(tmp12 - tmp1, kShift) + 128);
+    out[3] = ClampSample(Descale(tmp13 + tmp0, kShift) + 128);
+    out[4] = ClampSample(Descale(tmp13 - tmp0, kShift) + 128);
+  }
+}
+
+// Basis of the N-point inverse DCTs used for scaled decoding, N = 1, 2 or 4, in kConstBits fixed
+// point: basis[x][u] = c(u) * cos((2x + 1) * u * pi / 2N) with c(0) = 1 and c(u) = sqrt(2).
+// Transforming a block's lowest N x N coefficients with it and dividing by 8 yields the block
+// scaled to N x N, about the average of each 8/N x 8/N area of the full inverse DCT.
+struct ReducedIdctTables {
+  int64_t basis[3][4][4] = {};
+
+  ReducedIdctTables() {
+    const double pi = std::acos(-1.0);
+    for (int level = 0; level < 3; ++level) {
+      const int size = 1 << level;
+      for (int x = 0; x < size; ++x) {
+        for (int u = 0; u < size; ++u) {
+          const double weight = u == 0 ? 1.0 : std::sqrt(2.0);
+          basis[level][x][u] = std::lround(weight * std::cos((2 * x + 1) * u * pi / (2 * size)) *
+                                           (1 << kConstBits));
+        }
+      }
+    }
+  }
+};
+
+// Inverse DCT of the top-left |size| x |size| coefficients of |in| (size 1, 2 or 4) to a
+// |size| x |size| block.
+void IdctReducedBlock(const int32_t* in, int size, uint8_t* out, size_t stride) {
+  if (size == 1) {
+    *out = ClampSample(Descale(in[0], 3) + 128);
+    return;
+  }
+
+  static const ReducedIdctTables tables;
+  const auto& basis = tables.basis[size == 2 ? 1 : 2];
+  int64_t ws[4][4];
+  for (int u = 0; u < size; ++u) {
+    for (int y = 0; y < size; ++y) {
+      int64_t sum = 0;
+      for (int v = 0; v < size; ++v) sum += basis[y][v] * in[v * 8 + u];
+      ws[y][u] = sum;
+    }
+  }
+  for (int y = 0; y < size; ++y, out += stride) {
+    for (int x = 0; x < size; ++x) {
+      int64_t sum = 0;
+      for (int u = 0; u < size; ++u) sum += basis[x][u] * ws[y][u];
+      out[x] = ClampSample(Descale(sum, 2 * kConstBits + 3) + 128);
+    }
+  }
+}
+
+// libjpeg's fixed-point YCbCr to RGB tables (jdcolor.c, SCALEBITS = 16).
+struct YccTables {
+  int cr_r[256];
+  int cb_b[256];
+  int cr_g[256];
+  int cb_g[256];
+
+  YccTables() {
+    constexpr int kOneHalf = 1 << 15;
+    for (int i = 0; i < 256; ++i) {
+      const int x = i - 128;
+      cr_r[i] = (91881 * x + kOneHalf) >> 16;
+      cb_b[i] = (116130 * x + kOneHalf) >> 16;
+      cr_g[i] = -46802 * x;
+      cb_g[i] = -22554 * x + kOneHalf;
+    }
+  }
+};
+
+// Triangle-filter 2x horizontal upsampling of libjpeg's h2v1_fancy_upsample.
+void FancyUpsampleH2V1(const uint8_t* in, uint32_t width, uint8_t* out) {
+  for (uint32_t x = 0; x < width; ++x) {
+    const int value = in[x] * 3;
+    const int left = in[x > 0 ? x - 1 : 0];
+    const int right = in[x + 1 < width ? x + 1 : x];
+    out[2 * x] = x == 0 ? in[x] : static_cast<uint8_t>((value + left + 1) >> 2);
+    out[2 * x + 1] = x + 1 == width ? in[x] : static_cast<uint8_t>((value + right + 2) >> 2);
+  }
+}
+
+// 2x2 upsampling of libjpeg's h2v2_fancy_upsample: |near| is the source row closest to the output
+// row and |far| the one on its other side.
+void FancyUpsampleH2V2(const uint8_t* near, const uint8_t* far, uint32_t width, uint8_t* out) {
+  auto column_sum = [&](uint32_t x) { return near[x] * 3 + far[x]; };
+  for (uint32_t x = 0; x < width; ++x) {
+    const int value = column_sum(x);
+    out[2 * x] = static_cast<uint8_t>(
+        x == 0 ? (value * 4 + 8) >> 4 : (value * 3 + column_sum(x - 1) + 8) >> 4);
+    out[2 * x + 1] = static_cast<uint8_t>(
+        x + 1 == width ? (value * 4 + 7) >> 4 : (value * 3 + column_sum(x + 1) + 7) >> 4);
+  }
+}
+
+int Extend(uint32_t value, int size) {
+  return value < (1u << (size - 1)) ? static_cast<int>(value) - (1 << size) + 1
+                                    : static_cast<int>(value);
+}
+
+struct HuffmanTable {
+  bool defined = false;
+  uint8_t fast_length[1 << kFastBits];
+  uint8_t fast_symbol[1 << kFastBits];
+  // Largest code of each length (-1 when there is none) and the offset that maps a code of that
+  // length to its index in |values|.
+  int32_t max_code[17];
+  int32_t value_offset[17];
+  uint8_t values[256];
+
+  bool Build(const uint8_t* counts, const uint8_t* symbols, int total) {
+    std::memcpy(values, symbols, static_cast<size_t>(total));
+    std::memset(fast_length, 0, sizeof(fast_length));
+    int32_t code = 0;
+    int index = 0;
+    for (int length = 1; length <= 16; ++length) {
+      value_offset[length] = index - code;
+      for (int i = 0; i < counts[length - 1]; ++i, ++code, ++index) {
+        if (code >= (1 << length)) return false;
+        if (length <= kFastBits) {
+          const int first = code << (kFastBits - length);
+          for (int j = 0; j < (1 << (kFastBits - length)); ++j) {
+            fast_length[first + j] = static_cast<uint8_t>(length);
+            fast_symbol[first + j] = values[index];
+          }
+        }
+      }
+      max_code[length] = counts[length - 1] ? code - 1 : -1;
+      code <<= 1;
+    }
+    defined = true;
+    return true;
+  }
+};
+
+struct Component {
+  uint8_t id = 0;
+  int h = 1;
+  int v = 1;
+  int quant = 0;
+  int dc_table = 0;
+  int ac_table = 0;
+  int dc_pred = 0;
+  // Sample dimensions of this component at the output scale; the plane is padded to whole MCUs.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // Blocks the component covers, as a non-interleaved scan codes them.
+  uint32_t blocks_x = 0;
+  uint32_t blocks_y = 0;
+  size_t stride = 0;
+  // The plane keeps |plane_rows| rows, the whole component or a ring of the last few stripes.
+  size_t plane_rows = 0;
+  uint8_t* plane = nullptr;  // In the thread's ScratchArena.
+
+  uint8_t* row(size_t y) const { return plane + y % plane_rows * stride; }
+};
+
+class JpegReader {
+ public:
+  JpegReader(std::span<const uint8_t> data, uint32_t min_long_edge, ImageRowSink* sink)
+      : data_(data), min_long_edge_(min_long_edge), sink_(sink) {}
+
+  DecodeStatus Decode() {
+    size_t pos = 2;
+    bool have_frame = false;
+    bool have_scan = false;
+    for (;;) {
+      while (pos < data_.size() && data_[pos] != 0xFF) ++pos;
+      while (pos < data_.size() && data_[pos] == 0xFF) ++pos;
+      if (pos >= data_.size()) break;
+      const uint8_t marker = data_[pos++];
+      if (marker == 0xD9) break;
+      if ((marker >= 0xD0 && marker <= 0xD8) || marker == 0x01) continue;
+
+      if (data_.size() - pos < 2) break;
+      const size_t length = ReadBigEndian16(data_.data() + pos);
+      if (length < 2 || length > data_.size() - pos) return DecodeStatus::kCorrupt;
+      const std::span<const uint8_t> body = data_.subspan(pos + 2, length - 2);
+      pos += length;
+
+      DecodeStatus status = DecodeStatus::kOk;
+      switch (marker) {
+        case 0xC0:
+        case 0xC1:
+          if (have_frame) return DecodeStatus::kCorrupt;
+          status = ParseFrame(body);
+          have_frame = true;
+          break;
+        case 0xC2:
+        case 0xC3:
+        case 0xC5:
+        case 0xC6:
+        case 0xC7:
+        case 0xC9:
+        case 0xCA:
+        case 0xCB:
+        case 0xCD:
+        case 0xCE:
+        case 0xCF:
+          return DecodeStatus::kUnsupported;
+        case 0xC4:
+          status = ParseHuffmanTables(body);
+          break;
+        case 0xDB:
+          status = ParseQuantTables(body);
+          break;
+        case 0xDD:
+          if (body.size() != 2) return DecodeStatus::kCorrupt;
+          restart_interval_ = ReadBigEndian16(body.data());
+          break;
+        case 0xDA:
+          if (!have_frame) return DecodeStatus::kCorrupt;
+          status = DecodeScan(body, &pos);
+          have_scan = true;
+          break;
+        case 0xE0:
+          if (body.size() >= 5 && std::memcmp(body.data(), "JFIF", 5) == 0) jfif_ = true;
+          break;
+        case 0xEE:
+          if (body.size() >= 12 && std::memcmp(body.data(), "Adobe", 5) == 0) {
+            adobe_ = true;
+            adobe_transform_ = body[11];
+          }
+          break;
+        default:
+          break;
+      }
+      if (status != DecodeStatus::kOk) return status;
+    }
+    if (!have_frame || !have_scan) return DecodeStatus::kCorrupt;
+    EmitRows(out_height_);
+    return DecodeStatus::kOk;
+  }
+
+ private:
+  DecodeStatus ParseFrame(std::span<const uint8_t> body) {
+    if (body.size() < 6) return DecodeStatus::kCorrupt;
+    if (body[0] != 8) return DecodeStatus::kUnsupported;
+    height_ = ReadBigEndian16(body.data() + 1);
+    width_ = ReadBigEndian16(body.data() + 3);
+    component_count_ = body[5];
+    // A zero height would be defined later by a DNL marker.
+    if (height_ == 0) return DecodeStatus::kUnsupported;
+    if (width_ == 0) return DecodeStatus::kCorrupt;
+    if (component_count_ == 4) return DecodeStatus::kUnsupported;
+    if (component_count_ != 1 && component_count_ != 3) return DecodeStatus::kCorrupt;
+    if (body.size() < 6 + 3 * static_cast<size_t>(component_count_)) return DecodeStatus::kCorrupt;
+    if (width_ > kMaxImageDimension || height_ > kMaxImageDimension ||
+        static_cast<uint64_t>(width_) * height_ > kMaxImagePixels) {
+      return DecodeStatus::kTooLarge;
+    }
+
+    for (int i = 0; i < component_count_; ++i) {
+      Component& component = components_[i];
+      const uint8_t* p = body.data() + 6 + i * 3;
+      component.id = p[0];
+      component.h = p[1] >> 4;
+      component.v = p[1] & 15;
+      component.quant = p[2];
+      if (component.h < 1 || component.h > 4 || component.v < 1 || component.v > 4 ||
+          component.quant > 3) {
+        return DecodeStatus::kCorrupt;
+      }
+      max_h_ = std::max(max_h_, component.h);
+      max_v_ = std::max(max_v_, component.v);
+    }
+
+    // Each 8x8 block decodes to |block_| x |block_| samples.
+    const uint32_t scale = SelectDecodeScale(width_, height_, min_long_edge_);
+    block_ = static_cast<int>(8 / scale);
+    out_width_ = (width_ + scale - 1) / scale;
+    out_height_ = (height_ + scale - 1) / scale;
+    mcus_x_ = (width_ + 8 * max_h_ - 1) / (8 * max_h_);
+    mcus_y_ = (height_ + 8 * max_v_ - 1) / (8 * max_v_);
+    for (int i = 0; i < component_count_; ++i) {
+      Component& component = components_[i];
+      component.blocks_x = ((width_ * component.h + max_h_ - 1) / max_h_ + 7) / 8;
+      component.blocks_y = ((height_ * component.v + max_v_ - 1) / max_v_ + 7) / 8;
+      component.width = (width_ * component.h + max_h_ * scale - 1) / (max_h_ * scale);
+      component.height = (height_ * component.v + max_v_ * scale - 1) / (max_v_ * scale);
+      component.stride = static_cast<size_t>(mcus_x_) * component.h * block_;
+    }
+    return DecodeStatus::kOk;
+  }
+
+  // Sizes the planes once the first scan shows how the image is coded, and starts the sink. When
+  // that scan carries every component, rows are emitted as it goes and each plane only keeps the
+  // stripes upsampling still reads: the one being decoded and the two before it. Otherwise the
+  // planes hold the whole image until the last scan is done.
+  DecodeStatus AllocatePlanes(bool streaming) {
+    streaming_ = streaming;
+    // Fancy upsampling produces an even number of samples, one more than |out_width_| at most.
+    scratch_stride_ = static_cast<size_t>(out_width_) + 2;
+    uint64_t working_bytes = sizeof(JpegReader) + scratch_stride_ * component_count_ +
+                             static_cast<uint64_t>(out_width_) * 4;
+    for (int i = 0; i < component_count_; ++i) {
+      Component& component = components_[i];
+      const size_t rows = static_cast<size_t>(mcus_y_) * component.v * block_;
+      const size_t stripe_rows = static_cast<size_t>(component_count_ > 1 ? component.v : 1) *
+                                 block_;
+      component.plane_rows = streaming ? std::min(rows, 3 * stripe_rows) : rows;
+      working_bytes += component.stride * component.plane_rows;
+    }
+
+    const DecodeStatus status =
+        sink_->Begin({out_width_, out_height_, width_, height_, working_bytes, true});
+    if (status != DecodeStatus::kOk) return status;
+
+    ScratchArena& arena = ScratchArena::ForCurrentThread();
+    scratch_ = arena.AllocateArray<uint8_t>(scratch_stride_ * component_count_);
+    bgra_ = arena.AllocateArray<uint8_t>(static_cast<size_t>(out_width_) * 4);
+    if (!scratch_ || !bgra_) return DecodeStatus::kOutOfMemory;
+    for (int i = 0; i < component_count_; ++i) {
+      Component& component = components_[i];
+      const size_t bytes = component.stride * component.plane_rows;
+      component.plane = arena.AllocateArray<uint8_t>(bytes);
+      if (!component.plane) return DecodeStatus::kOutOfMemory;
+      // Components that never get a scan come out as mid-gray, as in libjpeg.
+      if (!streaming) std::memset(component.plane, 128, bytes);
+    }
+    return DecodeStatus::kOk;
+  }
+
+  DecodeStatus ParseQuantTables(std::span<const uint8_t> body) {
+    while (!body.empty()) {
+      const int precision = body[0] >> 4;
+      const int id = body[0] & 15;
+      const size_t size = precision ? 129 : 65;
+      if (id > 3 || precision > 1 || body.size() < size) return DecodeStatus::kCorrupt;
+      for (int k = 0; k < 64; ++k) {
+        quant_[id][k] = precision ? ReadBigEndian16(body.data() + 1 + k * 2) : body[1 + k];
+      }
+      quant_defined_[id] = true;
+      body = body.subspan(size);
+    }
+    return DecodeStatus::kOk;
+  }
+
+  DecodeStatus ParseHuffmanTables(std::span<const uint8_t> body) {
+    while (!body.empty()) {
+      if (body.size() < 17) return DecodeStatus::kCorrupt;
+      const int table_class = body[0] >> 4;
+      const int id = body[0] & 15;
+      if (table_class > 1 || id > 3) return DecodeStatus::kCorrupt;
+      int total = 0;
+      for (int i = 0; i < 16; ++i) total += body[1 + i];
+      if (total > 256 || body.size() < 17 + static_cast<size_t>(total)) {
+        return DecodeStatus::kCorrupt;
+      }
+      HuffmanTable& table = table_class ? ac_tables_[id] : dc_tables_[id];
+      if (!table.Build(body.data() + 1, body.data() + 17, total)) return DecodeStatus::kCorrupt;
+      body = body.subspan(17 + static_cast<size_t>(total));
+    }
+    return DecodeStatus::kOk;
+  }
+
+  DecodeStatus DecodeScan(std::span<const uint8_t> body, size_t* pos) {
+    if (body.empty()) return DecodeStatus::kCorrupt;
+    const int count = body[0];
+    if (count < 1 || count > component_count_ || body.size() < 4 + 2 * static_cast<size_t>(count)) {
+      return DecodeStatus::kCorrupt;
+    }
+
+    Component* scan[kMaxComponents] = {};
+    int blocks_per_mcu = 0;
+    for (int i = 0; i < count; ++i) {
+      const uint8_t id = body[1 + i * 2];
+      const uint8_t tables = body[2 + i * 2];
+      for (int c = 0; c < component_count_; ++c) {
+        if (components_[c].id == id) scan[i] = &components_[c];
+      }
+      if (!scan[i]) return DecodeStatus::kCorrupt;
+      scan[i]->dc_table = tables >> 4;
+      scan[i]->ac_table = tables & 15;
+      if (scan[i]->dc_table > 3 || scan[i]->ac_table > 3 ||
+          !dc_tables_[scan[i]->dc_table].defined || !ac_tables_[scan[i]->ac_table].defined ||
+          !quant_defined_[scan[i]->quant]) {
+        return DecodeStatus::kCorrupt;
+      }
+      blocks_per_mcu += scan[i]->h * scan[i]->v;
+    }
+    const uint8_t* spectral = body.data() + 1 + count * 2;
+    if (spectral[0] != 0 || spectral[1] != 63 || spectral[2] != 0) {
+      return DecodeStatus::kUnsupported;
+    }
+    if (count > 1 && blocks_per_mcu > 10) return DecodeStatus::kCorrupt;
+    if (!components_[0].plane) {
+      const DecodeStatus status = AllocatePlanes(count == component_count_);
+      if (status != DecodeStatus::kOk) return status;
+    } else if (streaming_) {
+      // Every component was already in the first scan.
+      return DecodeStatus::kCorrupt;
+    }
+
+    in_ = data_.data() + *pos;
+    in_end_ = data_.data() + data_.size();
+    bits_ = 0;
+    bit_count_ = 0;
+    marker_hit_ = false;
+    restarts_left_ = restart_interval_;
+    for (int i = 0; i < count; ++i) scan[i]->dc_pred = 0;
+
+    if (count == 1) {
+      // Non-interleaved: every block is its own MCU.
+      Component& component = *scan[0];
+      for (uint32_t by = 0; by < component.blocks_y; ++by) {
+        for (uint32_t bx = 0; bx < component.blocks_x; ++bx) {
+          NextMcu(scan, count);
+          uint8_t* out = component.row(static_cast<size_t>(by) * block_) +
+                         static_cast<size_t>(bx) * block_;
+          if (!DecodeBlock(component, out)) return DecodeStatus::kCorrupt;
+        }
+        if (streaming_) EmitRows(by * block_);
+      }
+    } else {
+      for (uint32_t my = 0; my < mcus_y_; ++my) {
+        for (uint32_t mx = 0; mx < mcus_x_; ++mx) {
+          NextMcu(scan, count);
+          for (int i = 0; i < count; ++i) {
+            Component& component = *scan[i];
+            for (int y = 0; y < component.v; ++y) {
+              for (int x = 0; x < component.h; ++x) {
+                const size_t row = (static_cast<size_t>(my) * component.v + y) * block_;
+                const size_t column = (static_cast<size_t>(mx) * component.h + x) * block_;
+                uint8_t* out = component.row(row) + column;
+                if (!DecodeBlock(component, out)) return DecodeStatus::kCorrupt;
+              }
+            }
+          }
+        }
+        // Rows above this MCU row no longer need anything below it.
+        if (streaming_) EmitRows(my * max_v_ * block_);
+      }
+    }
+
+    *pos = static_cast<size_t>(in_ - data_.data());
+    return DecodeStatus::kOk;
+  }
+
+  // Handles the restart marker that precedes every |restart_interval_|-th MCU.
+  void NextMcu(Component* const* scan, int count) {
+    if (restart_interval_ == 0) return;
+    if (restarts_left_ == 0) {
+      bits_ = 0;
+      bit_count_ = 0;
+      marker_hit_ = false;
+      while (in_end_ - in_ >= 2) {
+        if (in_[0] == 0xFF) {
+          if (in_[1] >= 0xD0 && in_[1] <= 0xD7) {
+            in_ += 2;
+            break;
+          }
+          if (in_[1] != 0x00 && in_[1] != 0xFF) break;
+        }
+        ++in_;
+      }
+      for (int i = 0; i < count; ++i) scan[i]->dc_pred = 0;
+      restarts_left_ = restart_interval_;
+    }
+    --restarts_left_;
+  }
+
+  // Keeps at least 57 bits buffered. Stuffed 0xFF00 pairs yield 0xFF; at a marker the data ends and
+  // zeros are shifted in instead.
+  void Fill() {
+    while (bit_count_ <= 56) {
+      uint32_t byte = 0;
+      if (!marker_hit_ && in_ < in_end_) {
+        byte = *in_;
+        if (byte != 0xFF) {
+          ++in_;
+        } else if (in_end_ - in_ >= 2 && in_[1] == 0x00) {
+          in_ += 2;
+        } else {
+          marker_hit_ = true;
+          byte = 0;
+        }
+      }
+      bits_ |= static_cast<uint64_t>(byte) << (56 - bit_count_);
+      bit_count_ += 8;
+    }
+  }
+
+  uint32_t GetBits(int n) {
+    if (n == 0) return 0;
+    if (bit_count_ < n) Fill();
+    const uint32_t value = static_cast<uint32_t>(bits_ >> (64 - n));
+    bits_ <<= n;
+    bit_count_ -= n;
+    return value;
+  }
+
+  int DecodeHuffman(const HuffmanTable& table) {
+    if (bit_count_ < 16) Fill();
+    const uint32_t peek = static_cast<uint32_t>(bits_ >> (64 - kFastBits));
+    int length = table.fast_length[peek];
+    if (length) {
+      bits_ <<= length;
+      bit_count_ -= length;
+      return table.fast_symbol[peek];
+    }
+
+    const int32_t bits16 = static_cast<int32_t>(bits_ >> 48);
+    for (length = kFastBits + 1; length <= 16; ++length) {
+      const int32_t code = bits16 >> (16 - length);
+      if (code <= table.max_code[length]) {
+        bits_ <<= length;
+        bit_count_ -= length;
+        return table.values[table.value_offset[length] + code];
+      }
+    }
+    return -1;
+  }
+
+  bool DecodeBlock(Component& component, uint8_t* out) {
+    const uint16_t* quant = quant_[component.quant];
+    auto dequantize = [](int value, uint16_t factor) {
+      return static_cast<int32_t>(
+          std::clamp<int64_t>(static_cast<int64_t>(value) * factor, -32768, 32767));
+    };
+
+    int32_t coefficients[64] = {};
+    const int dc_size = DecodeHuffman(dc_tables_[component.dc_table]);
+    if (dc_size < 0 || dc_size > 11) return false;
+    if (dc_size) {
+      component.dc_pred =
+          std::clamp(component.dc_pred + Extend(GetBits(dc_size), dc_size), -65536, 65535);
+    }
+    coefficients[0] = dequantize(component.dc_pred, quant[0]);
+
+    const HuffmanTable& ac = ac_tables_[component.ac_table];
+    for (int k = 1; k < 64;) {
+      const int symbol = DecodeHuffman(ac);
+      if (symbol < 0) return false;
+      const int run = symbol >> 4;
+      const int size = symbol & 15;
+      if (size == 0) {
+        if (run != 15) break;
+        k += 16;
+        continue;
+      }
+      k += run;
+      if (k > 63) return false;
+      coefficients[kZigzag[k]] = dequantize(Extend(GetBits(size), size), quant[k]);
+      ++k;
+    }
+
+    if (block_ == 8) {
+      IdctBlock(coefficients, out, component.stride);
+    } else {
+      IdctReducedBlock(coefficients, block_, out, component.stride);
+    }
+    return true;
+  }
+
+  // Row |y| of |component| at the output size; |scratch| backs rows that need upsampling.
+  const uint8_t* UpsampledRow(const Component& component, uint32_t y, uint8_t* scratch) const {
+    if (component.h == max_h_ && component.v == max_v_) return component.row(y);
+
+    if (max_h_ == 2 * component.h && max_v_ == component.v) {
+      FancyUpsampleH2V1(component.row(y), component.width, scratch);
+      return scratch;
+    }
+    if (max_h_ == 2 * component.h && max_v_ == 2 * component.v) {
+      const uint32_t row = y / 2;
+      const uint32_t other = y % 2 == 0 ? (row > 0 ? row - 1 : 0)
+                                        : std::min(row + 1, component.height - 1);
+      FancyUpsampleH2V2(component.row(row), component.row(other), component.width, scratch);
+      return scratch;
+    }
+
+    const size_t row = std::min<size_t>(static_cast<size_t>(y) * component.v / max_v_,
+                                        component.height - 1);
+    const uint8_t* in = component.row(row);
+    for (uint32_t x = 0; x < out_width_; ++x) {
+      scratch[x] = in[static_cast<size_t>(x) * component.h / max_h_];
+    }
+    return scratch;
+  }
+
+  bool IsRgb() const {
+    if (jfif_) return false;
+    if (adobe_) return adobe_transform_ == 0;
+    return components_[0].id == 'R' && components_[1].id == 'G' && components_[2].id == 'B';
+  }
+
+  // Converts the output rows from the last one emitted up to |end| and hands them to the sink.
+  void EmitRows(uint32_t end) {
+    static const YccTables ycc;
+    const bool rgb = component_count_ == 3 && IsRgb();
+    for (; emitted_ < std::min(end, out_height_); ++emitted_) {
+      const uint8_t* rows[kMaxComponents] = {};
+      for (int c = 0; c < component_count_; ++c) {
+        rows[c] = UpsampledRow(components_[c], emitted_, scratch_ + c * scratch_stride_);
+      }
+
+      uint8_t* out = bgra_;
+      for (uint32_t x = 0; x < out_width_; ++x, out += 4) {
+        if (component_count_ == 1) {
+          out[0] = out[1] = out[2] = rows[0][x];
+        } else if (rgb) {
+          out[0] = rows[2][x];
+          out[1] = rows[1][x];
+          out[2] = rows[0][x];
+        } else {
+          const int luma = rows[0][x];
+          const int cb = rows[1][x];
+          const int cr = rows[2][x];
+          out[0] = ClampSample(luma + ycc.cb_b[cb]);
+          out[1] = ClampSample(luma + ((ycc.cb_g[cb] + ycc.cr_g[cr]) >> 16));
+          out[2] = ClampSample(luma + ycc.cr_r[cr]);
+        }
+        out[3] = 255;
+      }
+      sink_->PushRow(bgra_);
+    }
+  }
+
+  std::span<const uint8_t> data_;
+  uint32_t min_long_edge_ = 0;
+  ImageRowSink* sink_ = nullptr;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  uint32_t out_width_ = 0;
+  uint32_t out_height_ = 0;
+  int block_ = 8;
+  int component_count_ = 0;
+  int max_h_ = 1;
+  int max_v_ = 1;
+  uint32_t mcus_x_ = 0;
+  uint32_t mcus_y_ = 0;
+  Component components_[kMaxComponents];
+  uint16_t quant_[4][64] = {};
+  bool quant_defined_[4] = {};
+  HuffmanTable dc_tables_[4];
+  HuffmanTable ac_tables_[4];
+  uint32_t restart_interval_ = 0;
+  uint32_t restarts_left_ = 0;
+  bool jfif_ = false;
+  bool adobe_ = false;
+  uint8_t adobe_transform_ = 1;
+
+  bool streaming_ = false;
+  uint32_t emitted_ = 0;
+  uint8_t* scratch_ = nullptr;
+  size_t scratch_stride_ = 0;
+  uint8_t* bgra_ = nullptr;
+
+  const uint8_t* in_ = nullptr;
+  const uint8_t* in_end_ = nullptr;
+  uint64_t bits_ = 0;
+  int bit_count_ = 0;
+  bool marker_hit_ = false;
+};
+
+}  // namespace
+
+bool IsJpeg(std::span<const uint8_t> data) {
+  return data.size() >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF;
+}
+
+DecodeStatus DecodeJpeg(std::span<const uint8_t> data, uint32_t min_long_edge,
+                        ImageRowSink* sink) {
+  if (!IsJpeg(data)) return DecodeStatus::kUnsupported;
+  // The reader holds the Huffman tables and is too large for the stack. It and the component
+  // planes it allocates are released together when |scope| closes.
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  ScratchArena::Scope scope(arena);
+  void* memory = arena.Allocate(sizeof(JpegReader));
+  if (!memory) return DecodeStatus::kOutOfMemory;
+  JpegReader* reader = new (memory) JpegReader(data, min_long_edge, sink);
+  const DecodeStatus status = reader->Decode();
+  reader->~JpegReader();
+  return status;
+}
+
+}  // namespace vibe
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <cstdint>
+#include <span>
+
+namespace vibe {
+
+bool IsJpeg(std::span<const uint8_t> data);
+
+// Decodes 8-bit sequential Huffman JPEG (baseline and extended) with one or three components to
+// BGRA. Follows libjpeg's default integer IDCT, fancy upsampling and YCbCr conversion. Progressive,
+// arithmetic-coded, lossless and CMYK files report kUnsupported. When |min_long_edge| allows,
+// blocks go through a 4x4, 2x2 or 1x1 inverse DCT of their lowest frequencies instead, as
+// libjpeg's scaled decoding does, for a 1/2, 1/4 or 1/8 size image.
+// Files coded in a single interleaved scan, as baseline encoders write them, are handed to |sink|
+// one MCU row at a time with only three MCU rows of samples held; others keep whole planes.
+DecodeStatus DecodeJpeg(std::span<const uint8_t> data, uint32_t min_long_edge,
+                        ImageRowSink* sink);
+
+}  // namespace vibe
@@ -0,0 +1,799 @@
+#include "JsonFieldLocator.h"
+
+#include "StringScan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace vibe {
+namespace {
+
+size_t SkipJsonWhitespace(std::string_view text, size_t pos) {
+  while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
+    ++pos;
+  }
+  return pos;
+}
+
+size_t SkipOptionalUtf8Bom(std::string_view text, size_t pos) {
+  if (pos + 3 <= text.size() && static_cast<unsigned char>(text[pos]) == 0xEF &&
+      static_cast<unsigned char>(text[pos + 1]) == 0xBB &&
+      static_cast<unsigned char>(text[pos + 2]) == 0xBF) {
+    return pos + 3;
+  }
+  return pos;
+}
+
+bool ParseHex4(std::string_view text, size_t pos, uint16_t* value) {
+  if (!value || pos + 4 > text.size()) return false;
+
+  uint16_t result = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    const unsigned char ch = static_cast<unsigned char>(text[pos + i]);
+    uint16_t nibble = 0;
+    if (ch >= '0' && ch <= '9') {
+      nibble = static_cast<uint16_t>(ch - '0');
+    } else if (ch >= 'A' && ch <= 'F') {
+      nibble = static_cast<uint16_t>(ch - 'A' + 10);
+    } else if (ch >= 'a' && ch <= 'f') {
+      nibble = static_cast<uint16_t>(ch - 'a' + 10);
+    } else {
+      return false;
+    }
+    result = static_cast<uint16_t>((result << 4) | nibble);
+  }
+
+  *value = result;
+  return true;
+}
+
+// Writes |codepoint| as UTF-8 and returns the byte count: at most 4, and 0 past U+10FFFF.
+size_t EncodeUtf8(uint32_t codepoint, char* out) {
+  if (codepoint <= 0x7F) {
+    out[0] = static_cast<char>(codepoint);
+    return 1;
+  }
+
+  if (codepoint <= 0x7FF) {
+    out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+    out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 2;
+  }
+
+  if (codepoint <= 0xFFFF) {
+    out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 3;
+  }
+
+  if (codepoint <= 0x10FFFF) {
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+  }
+  return 0;
+}
+
+// Parses the escape sequence whose backslash sits at text[pos - 1]. On success |pos| is advanced
+// past the sequence and |codepoint| holds the character it encodes.
+bool ParseEscape(std::string_view text, size_t* pos, uint32_t* codepoint) {
+  size_t i = *pos;
+  if (i >= text.size()) return false;
+  char escaped = text[i++];
+  switch (escaped) {
+    case '"':
+    case '\\':
+    case '/':
+      *codepoint = static_cast<unsigned char>(escaped);
+      break;
+    case 'b':
+      *codepoint = '\b';
+      break;
+    case 'f':
+      *codepoint = '\f';
+      break;
+    case 'n':
+      *codepoint = '\n';
+      break;
+    case 'r':
+      *codepoint = '\r';
+      break;
+    case 't':
+      *codepoint = '\t';
+      break;
+    case 'u':
+      {
+        uint16_t code_unit = 0;
+        if (!ParseHex4(text, i, &code_unit)) return false;
+        i += 4;
+
+        uint32_t value = code_unit;
+        if (code_unit >= 0xD800 && code_unit <= 0xDBFF) {
+          if (i + 6 > text.size() || text[i] != '\\' || text[i + 1] != 'u') return false;
+          uint16_t low_surrogate = 0;
+          if (!ParseHex4(text, i + 2, &low_surrogate)) return false;
+          if (low_surrogate < 0xDC00 || low_surrogate > 0xDFFF) return false;
+          i += 6;
+
+          value = 0x10000 + ((static_cast<uint32_t>(code_unit - 0xD800) << 10) |
+                             static_cast<uint32_t>(low_surrogate - 0xDC00));
+        } else if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+          return false;
+        }
+        *codepoint = value;
+      }
+      break;
+    default:
+      return false;
+  }
+
+  *pos = i;
+  return true;
+}
+
+// Ends a number, true, false or null starting at |pos|.
+bool SkipJsonScalar(std::string_view json, size_t pos, size_t* end_pos) {
+  if (json.compare(pos, 4, "true") == 0) {
+    *end_pos = pos + 4;
+    return true;
+  }
+  if (json.compare(pos, 5, "false") == 0) {
+    *end_pos = pos + 5;
+    return true;
+  }
+  if (json.compare(pos, 4, "null") == 0) {
+    *end_pos = pos + 4;
+    return true;
+  }
+
+  size_t cursor = pos;
+  if (json[cursor] == '-') ++cursor;
+  if (cursor >= json.size()) return false;
+
+  if (json[cursor] == '0') {
+    ++cursor;
+  } else {
+    if (!std::isdigit(static_cast<unsigned char>(json[cursor]))) return false;
+    while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
+      ++cursor;
+    }
+  }
+
+  if (cursor < json.size() && json[cursor] == '.') {
+    ++cursor;
+    if (cursor >= json.size() || !std::isdigit(static_cast<unsigned char>(json[cursor]))) {
+      return false;
+    }
+    while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
+      ++cursor;
+    }
+  }
+
+  if (cursor < json.size() && (json[cursor] == 'e' || json[cursor] == 'E')) {
+    ++cursor;
+    if (cursor < json.size() && (json[cursor] == '+' || json[cursor] == '-')) ++cursor;
+    if (cursor >= json.size() || !std::isdigit(static_cast<unsigned char>(json[cursor]))) {
+      return false;
+    }
+    while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
+      ++cursor;
+    }
+  }
+
+  *end_pos = cursor;
+  return true;
+}
+
+enum class SkipResult {
+  kOk,
+  kInvalid,
+  kOverBudget,
+  kCancelled,
+};
+
+SkipResult CheckDeadline(const JsonScanBudget& budget) {
+  if (budget.cancel && budget.cancel->load(std::memory_order_relaxed)) {
+    return SkipResult::kCancelled;
+  }
+  if (budget.deadline != std::chrono::steady_clock::time_point::max() &&
+      std::chrono::steady_clock::now() >= budget.deadline) {
+    return SkipResult::kOverBudget;
+  }
+  return SkipResult::kOk;
+}
+
+// Counts one token against |budget|. The clock and the cancellation flag are only looked at every
+// kJsonBudgetCheckInterval tokens.
+SkipResult ChargeToken(const JsonScanBudget& budget, JsonScanUsage& usage) {
+  if (++usage.tokens > budget.max_tokens) return SkipResult::kOverBudget;
+  if (usage.tokens % kJsonBudgetCheckInterval != 0) return SkipResult::kOk;
+  return CheckDeadline(budget);
+}
+
+SkipResult ChargeBytes(const JsonScanBudget& budget, JsonScanUsage& usage, size_t bytes) {
+  usage.bytes += bytes;
+  return usage.bytes > budget.max_bytes ? SkipResult::kOverBudget : SkipResult::kOk;
+}
+
+// The scanner's failure for a walk that did not end in kOk.
+JsonFieldScanner::Status FailureStatus(SkipResult result) {
+  switch (result) {
+    case SkipResult::kOverBudget:
+      return JsonFieldScanner::Status::kBudgetExceeded;
+    case SkipResult::kCancelled:
+      return JsonFieldScanner::Status::kCancelled;
+    default:
+      return JsonFieldScanner::Status::kError;
+  }
+}
+
+// Walks one value of any shape without recursing: the open containers are kept as one bit each
+// (set for objects), so native stack use does not grow with the nesting.
+SkipResult SkipJsonValueBounded(std::string_view json, size_t pos, size_t* end_pos,
+                                const JsonScanBudget& budget, JsonScanUsage& usage) {
+  constexpr size_t kWordBits = 64;
+  uint64_t objects[kMaxJsonNestingDepth / kWordBits + 1] = {};
+  size_t depth = 0;
+  const auto in_object = [&] {
+    const size_t top = depth - 1;
+    return ((objects[top / kWordBits] >> (top % kWordBits)) & 1) != 0;
+  };
+
+  size_t cursor = pos;
+  SkipResult result = SkipResult::kInvalid;
+  // Moves |cursor| past a member's key and colon.
+  const auto skip_key = [&] {
+    if (cursor >= json.size() || json[cursor] != '"') return false;
+    bool has_escapes = false;
+    if (!ScanJsonString(json, cursor, &cursor, &has_escapes)) return false;
+    cursor = SkipJsonWhitespace(json, cursor);
+    if (cursor >= json.size() || json[cursor] != ':') return false;
+    ++cursor;
+    return true;
+  };
+
+  while (true) {
+    // A value starts at |cursor|.
+    if ((result = ChargeToken(budget, usage)) != SkipResult::kOk) break;
+    result = SkipResult::kInvalid;
+    cursor = SkipJsonWhitespace(json, cursor);
+    if (cursor >= json.size() || depth > kMaxJsonNestingDepth) break;
+
+    const char first = json[cursor];
+    bool opened = false;
+    if (first == '{' || first == '[') {
+      const uint64_t bit = uint64_t{1} << (depth % kWordBits);
+      uint64_t& word = objects[depth / kWordBits];
+      word = first == '{' ? word | bit : word & ~bit;
+      ++depth;
+      cursor = SkipJsonWhitespace(json, cursor + 1);
+      if (cursor < json.size() && json[cursor] == (first == '{' ? '}' : ']')) {
+        ++cursor;
+        --depth;
+      } else {
+        opened = true;
+      }
+    } else if (first == '"') {
+      bool has_escapes = false;
+      if (!ScanJsonString(json, cursor, &cursor, &has_escapes)) break;
+    } else if (!SkipJsonScalar(json, cursor, &cursor)) {
+      break;
+    }
+
+    if (opened) {
+      if (in_object() && !skip_key()) break;
+      continue;
+    }
+
+    // After a value: close every container it ends, then move on to the next element or member.
+    bool next = false;
+    while (depth > 0) {
+      cursor = SkipJsonWhitespace(json, cursor);
+      if (cursor >= json.size()) break;
+      const bool object = in_object();
+      if (json[cursor] == (object ? '}' : ']')) {
+        ++cursor;
+        --depth;
+        continue;
+      }
+      if (json[cursor] != ',') break;
+      cursor = SkipJsonWhitespace(json, cursor + 1);
+      next = !object || skip_key();
+      break;
+    }
+    if (next) continue;
+    if (depth == 0) {
+      *end_pos = cursor;
+      result = SkipResult::kOk;
+    }
+    break;
+  }
+
+  const SkipResult charged = ChargeBytes(budget, usage, std::min(cursor, json.size()) - pos);
+  return result == SkipResult::kOk ? charged : result;
+}
+
+unsigned CountTrailingZeros64(uint64_t mask) {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward64(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+// Bit i set when bit i or any below it is set an odd number of times in |mask|.
+uint64_t PrefixXor(uint64_t mask) {
+  mask ^= mask << 1;
+  mask ^= mask << 2;
+  mask ^= mask << 4;
+  mask ^= mask << 8;
+  mask ^= mask << 16;
+  mask ^= mask << 32;
+  return mask;
+}
+
+// The bytes of a block that follow an unescaped backslash. |carry| is 1 when the block's first
+// byte is escaped by the previous block, and is set for the next one the same way.
+uint64_t EscapedBytes(uint64_t backslashes, uint64_t* carry) {
+  uint64_t escaped = *carry;
+  *carry = 0;
+  backslashes &= ~escaped;
+  while (backslashes) {
+    const unsigned bit = CountTrailingZeros64(backslashes);
+    if (bit == 63) {
+      *carry = 1;
+      break;
+    }
+    const uint64_t next = uint64_t{2} << bit;
+    escaped |= next;
+    backslashes &= ~(next | (next >> 1));
+  }
+  return escaped;
+}
+
+// Finds where the object or array opening at |pos| ends without tokenizing it: each 64-byte
+// block is classified at once, escaped quotes and brackets inside strings are masked off, and
+// only the brackets left are visited.
+SkipResult SkipJsonContainerStructural(std::string_view json, size_t pos, size_t* end_pos,
+                                       const JsonScanBudget& budget, JsonScanUsage& usage) {
+  constexpr size_t kBlock = 64;
+  constexpr size_t kWordBits = 64;
+  const JsonBlockClassifier classify = ActiveJsonBlockClassifier();
+  uint64_t objects[kMaxJsonNestingDepth / kWordBits + 1] = {};
+  size_t depth = 0;
+  uint64_t escaped_carry = 0;
+  // All ones while the walk is inside a string at a block boundary.
+  uint64_t string_carry = 0;
+  char tail[kBlock];
+
+  const auto finish = [&](SkipResult result, size_t reached) {
+    const SkipResult charged = ChargeBytes(budget, usage, reached - pos);
+    return result == SkipResult::kOk ? charged : result;
+  };
+
+  size_t blocks = 0;
+  for (size_t block = pos; block < json.size(); block += kBlock) {
+    const char* bytes = json.data() + block;
+    if (json.size() - block < kBlock) {
+      std::memset(tail, ' ', kBlock);
+      std::memcpy(tail, bytes, json.size() - block);
+      bytes = tail;
+    }
+    const JsonBlockMasks masks = classify(bytes);
+    const uint64_t quotes = masks.quotes & ~EscapedBytes(masks.backslashes, &escaped_carry);
+    const uint64_t in_string = PrefixXor(quotes) ^ string_carry;
+    string_carry = 0 - (in_string >> 63);
+
+    for (uint64_t brackets = (masks.opens | masks.closes) & ~in_string; brackets != 0;
+         brackets &= brackets - 1) {
+      const size_t at = block + CountTrailingZeros64(brackets);
+      const SkipResult charged = ChargeToken(budget, usage);
+      if (charged != SkipResult::kOk) return finish(charged, at);
+
+      const bool object = json[at] == '{';
+      if (object || json[at] == '[') {
+        if (depth > kMaxJsonNestingDepth) return finish(SkipResult::kInvalid, at);
+        const uint64_t bit = uint64_t{1} << (depth % kWordBits);
+        uint64_t& word = objects[depth / kWordBits];
+        word = object ? word | bit : word & ~bit;
+        ++depth;
+        continue;
+      }
+      const size_t top = depth - 1;
+      const bool closes_object = json[at] == '}';
+      if (depth == 0 || ((objects[top / kWordBits] >> (top % kWordBits)) & 1) != closes_object) {
+        return finish(SkipResult::kInvalid, at);
+      }
+      if (--depth == 0) {
+        *end_pos = at + 1;
+        return finish(SkipResult::kOk, at + 1);
+      }
+    }
+
+    // Blocks without brackets charge no tokens, so the clock is looked at every 256KB as well.
+    if (++blocks % kJsonBudgetCheckInterval == 0) {
+      const SkipResult checked = CheckDeadline(budget);
+      if (checked != SkipResult::kOk) return finish(checked, block + kBlock);
+    }
+  }
+  return finish(SkipResult::kInvalid, json.size());
+}
+
+}  // namespace
+
+bool ScanJsonString(std::string_view text, size_t quote_pos, size_t* end_pos, bool* has_escapes) {
+  if (!end_pos || !has_escapes || quote_pos >= text.size() || text[quote_pos] != '"') return false;
+
+  const char* const base = text.data();
+  const char* const end = base + text.size();
+  bool escapes = false;
+  size_t i = quote_pos + 1;
+  while (i < text.size()) {
+    i = static_cast<size_t>(FindQuoteOrBackslash(base + i, end) - base);
+    if (i >= text.size()) break;
+    if (text[i++] == '"') {
+      *end_pos = i;
+      *has_escapes = escapes;
+      return true;
+    }
+
+    uint32_t codepoint = 0;
+    if (!ParseEscape(text, &i, &codepoint)) return false;
+    escapes = true;
+  }
+
+  return false;
+}
+
+bool UnescapeJsonString(std::string_view body, char* out, size_t* written) {
+  if (!out || !written) return false;
+
+  // Every escape is at least as long as what it decodes to, so |out| never passes the read
+  // position and may alias |body|.
+  const char* const base = body.data();
+  const char* const end = base + body.size();
+  size_t o = 0;
+  size_t i = 0;
+  while (i < body.size()) {
+    const size_t run_end = static_cast<size_t>(FindQuoteOrBackslash(base + i, end) - base);
+    if (out + o != base + i) std::memmove(out + o, base + i, run_end - i);
+    o += run_end - i;
+    i = run_end;
+    if (i >= body.size()) break;
+    if (body[i++] == '"') return false;
+
+    uint32_t codepoint = 0;
+    if (!ParseEscape(body, &i, &codepoint)) return false;
+    o += EncodeUtf8(codepoint, out + o);
+  }
+
+  *written = o;
+  return true;
+}
+
+bool UnescapeJsonString(std::string_view body, std::string* out) {
+  if (!out) return false;
+
+  std::string decoded(body.size(), '\0');
+  size_t written = 0;
+  if (!UnescapeJsonString(body, decoded.data(), &written)) return false;
+  decoded.resize(written);
+  *out = std::move(decoded);
+  return true;
+}
+
+bool DecodeJsonString(std::string_view text, size_t quote_pos, std::string* out, size_t* end_pos) {
+  if (!out || !end_pos) return false;
+
+  size_t end = quote_pos;
+  bool has_escapes = false;
+  if (!ScanJsonString(text, quote_pos, &end, &has_escapes)) return false;
+
+  std::string_view body = text.substr(quote_pos + 1, end - quote_pos - 2);
+  if (has_escapes) {
+    if (!UnescapeJsonString(body, out)) return false;
+  } else {
+    out->assign(body);
+  }
+  *end_pos = end;
+  return true;
+}
+
+bool ResolveJsonString(const JsonStringSpan& span, std::string* storage, std::string_view* value) {
+  if (!storage || !value || !span.found) return false;
+
+  if (!span.has_escapes) {
+    *value = span.raw;
+    return true;
+  }
+
+  if (!UnescapeJsonString(span.raw, storage)) return false;
+  *value = *storage;
+  return true;
+}
+
+JsonFieldScanner::JsonFieldScanner(std::span<const std::string_view> keys,
+                                   const JsonScanBudget& budget)
+    : keys_(keys.first(std::min(keys.size(), kMaxKeys))), budget_(budget) {}
+
+JsonFieldScanner::Status JsonFieldScanner::Fail(Status status) {
+  phase_ = Phase::kError;
+  error_ = status;
+  return status;
+}
+
+JsonStringSpan JsonFieldScanner::field(size_t index, std::string_view data) const {
+  JsonStringSpan span;
+  if (index >= keys_.size() || !slots_[index].found) return span;
+  span.raw = data.substr(slots_[index].begin, slots_[index].length);
+  span.found = true;
+  span.has_escapes = slots_[index].has_escapes;
+  return span;
+}
+
+JsonFieldScanner::Status JsonFieldScanner::ScanValueString(std::string_view data,
+                                                           bool end_of_input) {
+  // Enough room for the longest escape, a surrogate pair spelled as two \u sequences.
+  constexpr size_t kMaxEscapeLength = 12;
+
+  const char* const base = data.data();
+  const char* const end = base + data.size();
+  size_t i = string_cursor_;
+  while (true) {
+    i = static_cast<size_t>(FindQuoteOrBackslash(base + i, end) - base);
+    if (i >= data.size()) {
+      if (ChargeBytes(budget_, usage_, data.size() - string_cursor_) != SkipResult::kOk) {
+        return Fail(Status::kBudgetExceeded);
+      }
+      string_cursor_ = data.size();
+      return end_of_input ? Fail() : Status::kNeedMore;
+    }
+    if (data[i] == '"') break;
+
+    if (!end_of_input && data.size() - i < kMaxEscapeLength) {
+      if (ChargeBytes(budget_, usage_, i - string_cursor_) != SkipResult::kOk) {
+        return Fail(Status::kBudgetExceeded);
+      }
+      string_cursor_ = i;
+      return Status::kNeedMore;
+    }
+    ++i;
+    uint32_t codepoint = 0;
+    if (!ParseEscape(data, &i, &codepoint)) return Fail();
+    string_has_escapes_ = true;
+  }
+
+  const size_t value_end = i + 1;
+  const SkipResult charged = ChargeBytes(budget_, usage_, value_end - string_cursor_);
+  if (charged != SkipResult::kOk) return Fail(FailureStatus(charged));
+  phase_ = Phase::kAfterValue;
+  cursor_ = value_end;
+  if (value_slot_ >= keys_.size()) return Status::kNeedMore;
+
+  Slot& slot = slots_[value_slot_];
+  slot.begin = value_start_ + 1;
+  slot.length = i - value_start_ - 1;
+  slot.found = true;
+  slot.has_escapes = string_has_escapes_;
+  last_found_ = value_slot_;
+  ++found_count_;
+  return Status::kFieldFound;
+}
+
+JsonFieldScanner::Status JsonFieldScanner::Feed(std::string_view data, bool end_of_input) {
+  if (phase_ != Phase::kDone && phase_ != Phase::kError) {
+    const SkipResult checked = CheckDeadline(budget_);
+    if (checked != SkipResult::kOk) return Fail(FailureStatus(checked));
+  }
+
+  while (true) {
+    switch (phase_) {
+      case Phase::kDone:
+        return Status::kDone;
+      case Phase::kError:
+        return error_;
+
+      case Phase::kStart:
+        {
+          size_t pos = SkipJsonWhitespace(data, 0);
+          if (!end_of_input && data.size() - pos < 3) return Status::kNeedMore;
+          pos = SkipOptionalUtf8Bom(data, pos);
+          pos = SkipJsonWhitespace(data, pos);
+          if (pos >= data.size()) return end_of_input ? Fail() : Status::kNeedMore;
+          if (data[pos] != '{') return Fail();
+
+          pos = SkipJsonWhitespace(data, pos + 1);
+          if (pos >= data.size()) return end_of_input ? Fail() : Status::kNeedMore;
+          if (data[pos] == '}') {
+            phase_ = Phase::kDone;
+            return Status::kDone;
+          }
+          cursor_ = pos;
+          phase_ = Phase::kKey;
+        }
+        break;
+
+      case Phase::kKey:
+        {
+          if (found_count_ == keys_.size()) {
+            phase_ = Phase::kDone;
+            return Status::kDone;
+          }
+          if (!end_of_input && data.size() < retry_size_) return Status::kNeedMore;
+
+          // Keys are short, so an incomplete member header is simply parsed again from its
+          // opening quote once more data has arrived.
+          const size_t member = SkipJsonWhitespace(data, cursor_);
+          if (member >= data.size()) return end_of_input ? Fail() : Status::kNeedMore;
+          if (data[member] != '"') return Fail();
+          cursor_ = member;
+
+          const SkipResult charged = ChargeToken(budget_, usage_);
+          if (charged != SkipResult::kOk) return Fail(FailureStatus(charged));
+          size_t key_end = member;
+          bool key_has_escapes = false;
+          const bool key_complete = ScanJsonString(data, member, &key_end, &key_has_escapes);
+          if (ChargeBytes(budget_, usage_, (key_complete ? key_end : data.size()) - member) !=
+              SkipResult::kOk) {
+            return Fail(Status::kBudgetExceeded);
+          }
+          if (!key_complete) {
+            if (end_of_input) return Fail();
+            retry_size_ = data.size() + (data.size() - member);
+            return Status::kNeedMore;
+          }
+
+          std::string_view key = data.substr(member + 1, key_end - member - 2);
+          if (key_has_escapes) {
+            if (!UnescapeJsonString(key, &unescaped_key_)) return Fail();
+            key = unescaped_key_;
+          }
+
+          const size_t colon = SkipJsonWhitespace(data, key_end);
+          const size_t value_start =
+              colon < data.size() ? SkipJsonWhitespace(data, colon + 1) : data.size();
+          if (value_start >= data.size()) {
+            if (end_of_input) return Fail();
+            retry_size_ = data.size() + (data.size() - member);
+            return Status::kNeedMore;
+          }
+          if (data[colon] != ':') return Fail();
+
+          value_slot_ = keys_.size();
+          if (data[value_start] == '"') {
+            for (size_t i = 0; i < keys_.size(); ++i) {
+              if (!slots_[i].found && keys_[i] == key) {
+                value_slot_ = i;
+                break;
+              }
+            }
+          }
+
+          value_start_ = value_start;
+          string_cursor_ = value_start + 1;
+          string_has_escapes_ = false;
+          retry_size_ = 0;
+          phase_ = Phase::kValue;
+        }
+        break;
+
+      case Phase::kValue:
+        {
+          if (data[value_start_] == '"') {
+            const Status status = ScanValueString(data, end_of_input);
+            if (status != Status::kNeedMore || phase_ != Phase::kAfterValue) return status;
+            break;
+          }
+
+          if (!end_of_input && data.size() < retry_size_) return Status::kNeedMore;
+
+          // A scalar that touches the end of the data may still grow (a number, or a literal cut
+          // in half), so it only counts as complete when something follows it.
+          size_t value_end = value_start_;
+          const char first = data[value_start_];
+          const SkipResult walked =
+              (first == '{' || first == '[') && budget_.structural_skip
+                  ? SkipJsonContainerStructural(data, value_start_, &value_end, budget_, usage_)
+                  : SkipJsonValueBounded(data, value_start_, &value_end, budget_, usage_);
+          if (walked == SkipResult::kOverBudget || walked == SkipResult::kCancelled) {
+            return Fail(FailureStatus(walked));
+          }
+          const bool complete =
+              walked == SkipResult::kOk && (value_end < data.size() || end_of_input);
+          if (!complete) {
+            if (end_of_input) return Fail();
+            retry_size_ = data.size() + (data.size() - value_start_);
+            return Status::kNeedMore;
+          }
+
+          retry_size_ = 0;
+          cursor_ = value_end;
+          phase_ = Phase::kAfterValue;
+        }
+        break;
+
+      case Phase::kAfterValue:
+        {
+          size_t pos = SkipJsonWhitespace(data, cursor_);
+          if (pos >= data.size()) {
+            if (end_of_input) return Fail();
+            return Status::kNeedMore;
+          }
+          if (data[pos] == '}') {
+            phase_ = Phase::kDone;
+            return Status::kDone;
+          }
+          if (data[pos] != ',') return Fail();
+
+          cursor_ = pos + 1;
+          phase_ = Phase::kKey;
+        }
+        break;
+    }
+  }
+}
+
+size_t LocateJsonStringFields(std::string_view json, std::span<const std::string_view> keys,
+                              std::span<JsonStringSpan> spans, const JsonScanBudget& budget) {
+  if (spans.size() < keys.size()) return 0;
+  for (size_t i = 0; i < keys.size(); ++i) spans[i] = {};
+
+  JsonFieldScanner scanner(keys, budget);
+  while (scanner.Feed(json, true) == JsonFieldScanner::Status::kFieldFound) {
+  }
+
+  for (size_t i = 0; i < keys.size(); ++i) spans[i] = scanner.field(i, json);
+  return scanner.found_count();
+}
+
+bool ListJsonMembers(std::string_view json, std::vector<JsonMember>* members,
+                     const JsonScanBudget& budget) {
+  if (!members) return false;
+  members->clear();
+  JsonScanUsage usage;
+  size_t pos = SkipJsonWhitespace(json, SkipOptionalUtf8Bom(json, SkipJsonWhitespace(json, 0)));
+  if (pos >= json.size() || json[pos] != '{') return false;
+  pos = SkipJsonWhitespace(json, pos + 1);
+  if (pos < json.size() && json[pos] == '}') return true;
+
+  while (true) {
+    if (pos >= json.size() || json[pos] != '"') return false;
+    JsonMember member;
+    member.begin = pos;
+    size_t key_end = pos;
+    if (!ScanJsonString(json, pos, &key_end, &member.key_has_escapes)) return false;
+    member.key = json.substr(pos + 1, key_end - pos - 2);
+    pos = SkipJsonWhitespace(json, key_end);
+    if (pos >= json.size() || json[pos] != ':') return false;
+    member.value_begin = SkipJsonWhitespace(json, pos + 1);
+    if (member.value_begin >= json.size()) return false;
+
+    const char first = json[member.value_begin];
+    const SkipResult walked =
+        (first == '{' || first == '[') && budget.structural_skip
+            ? SkipJsonContainerStructural(json, member.value_begin, &member.end, budget, usage)
+            : SkipJsonValueBounded(json, member.value_begin, &member.end, budget, usage);
+    if (walked != SkipResult::kOk) return false;
+    members->push_back(member);
+
+    pos = SkipJsonWhitespace(json, member.end);
+    if (pos >= json.size()) return false;
+    if (json[pos] == '}') return true;
+    if (json[pos] != ',') return false;
+    pos = SkipJsonWhitespace(json, pos + 1);
+  }
+}
+
+}  // namespace vibe
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibe {
+
+constexpr size_t kMaxJsonNestingDepth = 256;
+
+// Bounds the work one scan may spend on a document, so a hostile file (millions of tiny tokens,
+// containers truncated over and over in a stream) cannot pin the thread that scans it. Tokens are
+// keys, scalars and container brackets; bytes are everything walked over, rescans included. The
+// deadline and |cancel| are looked at every kJsonBudgetCheckInterval tokens and on every Feed().
+struct JsonScanBudget {
+  uint64_t max_tokens = uint64_t{1} << 22;
+  uint64_t max_bytes = std::numeric_limits<uint64_t>::max();
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  const std::atomic<bool>* cancel = nullptr;
+  // Non-string values are objects and arrays far more often than not, and in vibe files they can
+  // run to megabytes of numbers. Their end is found from a bitmap of quotes, backslashes and
+  // brackets built 64 bytes at a time: bracket pairing and nesting are checked, the scalars,
+  // commas and colons in between are not. Turning this off walks and validates every token.
+  bool structural_skip = true;
+};
+
+constexpr uint64_t kJsonBudgetCheckInterval = 4096;
+
+// Work a scan has done so far, charged against its JsonScanBudget.
+struct JsonScanUsage {
+  uint64_t tokens = 0;
+  uint64_t bytes = 0;
+};
+
+struct JsonStringSpan {
+  // Bytes between the quotes, still escaped when |has_escapes| is set.
+  std::string_view raw;
+  bool found = false;
+  bool has_escapes = false;
+};
+
+// Resumable form of the top-level field search. The document may arrive in pieces: every Feed()
+// sees all bytes received so far and continues where the previous call stopped, so each byte is
+// tokenized about once no matter where chunk boundaries fall.
+class JsonFieldScanner {
+ public:
+  static constexpr size_t kMaxKeys = 8;
+
+  enum class Status {
+    kNeedMore,
+    kFieldFound,
+    kDone,
+    kError,
+    // The JsonScanBudget ran out; fields found before that are still reported.
+    kBudgetExceeded,
+    kCancelled,
+  };
+
+  // |keys| must outlive the scanner.
+  explicit JsonFieldScanner(std::span<const std::string_view> keys,
+                            const JsonScanBudget& budget = JsonScanBudget());
+
+  // |data| holds every byte received so far. Bytes already fed must not change, but the buffer may
+  // have moved. Returns kFieldFound each time a key is recorded; call again to keep scanning.
+  Status Feed(std::string_view data, bool end_of_input);
+
+  size_t found_count() const { return found_count_; }
+  size_t last_found() const { return last_found_; }
+  const JsonScanUsage& usage() const { return usage_; }
+
+  // Field |index| as a span into |data|, the same bytes passed to Feed().
+  JsonStringSpan field(size_t index, std::string_view data) const;
+
+ private:
+  enum class Phase {
+    kStart,
+    kKey,
+    kValue,
+    kAfterValue,
+    kDone,
+    kError,
+  };
+
+  struct Slot {
+    size_t begin = 0;
+    size_t length = 0;
+    bool found = false;
+    bool has_escapes = false;
+  };
+
+  Status Fail(Status status = Status::kError);
+  Status ScanValueString(std::string_view data, bool end_of_input);
+
+  std::span<const std::string_view> keys_;
+  Slot slots_[kMaxKeys];
+  size_t found_count_ = 0;
+  size_t last_found_ = 0;
+
+  JsonScanBudget budget_;
+  JsonScanUsage usage_;
+  Status error_ = Status::kError;
+
+  Phase phase_ = Phase::kStart;
+  size_t cursor_ = 0;
+  size_t value_start_ = 0;
+  size_t value_slot_ = 0;
+  size_t string_cursor_ = 0;
+  bool string_has_escapes_ = false;
+  // A non-string value that ran off the end of the data is retried once this much data is
+  // available, so truncated containers are rescanned a logarithmic number of times.
+  size_t retry_size_ = 0;
+  std::string unescaped_key_;
+};
+
+// Scans the top-level object of |json| once and records the first string value of every key in
+// |keys| into the matching slot of |spans|. Skipped values are never decoded or copied. Returns
+// the number of keys found; scanning stops as soon as all of them are, or when |budget| runs out.
+size_t LocateJsonStringFields(std::string_view json, std::span<const std::string_view> keys,
+                              std::span<JsonStringSpan> spans,
+                              const JsonScanBudget& budget = JsonScanBudget());
+
+// One member of a top-level object, as offsets into the document.
+struct JsonMember {
+  // Bytes between the key's quotes, still escaped when |key_has_escapes| is set.
+  std::string_view key;
+  bool key_has_escapes = false;
+  // From the key's opening quote to just past the value.
+  size_t begin = 0;
+  size_t end = 0;
+  size_t value_begin = 0;
+};
+
+// Lists the members of the top-level object of |json| in document order, skipping each value the
+// way the field search does. Fails when |json| is not an object or |budget| runs out.
+bool ListJsonMembers(std::string_view json, std::vector<JsonMember>* members,
+                     const JsonScanBudget& budget = JsonScanBudget());
+
+// Yields the unescaped value of |span|. Escape-free spans are returned as-is; anything else is
+// decoded into |storage| and |value| views it.
+bool ResolveJsonString(const JsonStringSpan& span, std::string* storage, std::string_view* value);
+
+// Validates the string starting at |quote_pos| without decoding it.
+bool ScanJsonString(std::string_view text, size_t quote_pos, size_t* end_pos, bool* has_escapes);
+
+// Decodes the body of a JSON string (the bytes between the quotes).
+bool UnescapeJsonString(std::string_view body, std::string* out);
+
+// Same, into |out|, which needs room for body.size() bytes and may be body.data() itself.
+bool UnescapeJsonString(std::string_view body, char* out, size_t* written);
+
+bool DecodeJsonString(std::string_view text, size_t quote_pos, std::string* out, size_t* end_pos);
+
+}  // namespace vibe
@@ -0,0 +1,89 @@
+#include "JsonFieldReader.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <new>
+
+namespace vibe {
+
+JsonFieldReader::JsonFieldReader(std::span<const std::string_view> keys, ScratchArena* arena,
+                                 const JsonScanBudget& budget)
+    : scanner_(keys, budget), arena_(arena) {}
+
+bool JsonFieldReader::Reserve(size_t capacity) {
+  if (arena_) {
+    // The buffer is normally the arena's latest block, so it grows where it is.
+    if (buffer_ && arena_->Extend(buffer_, capacity_, capacity)) {
+      capacity_ = capacity;
+      return true;
+    }
+    char* grown = arena_->AllocateArray<char>(capacity);
+    if (!grown) return false;
+    if (size_) std::memcpy(grown, buffer_, size_);
+    buffer_ = grown;
+    capacity_ = capacity;
+    return true;
+  }
+
+  std::unique_ptr<char[]> grown(new (std::nothrow) char[capacity]);
+  if (!grown) return false;
+  if (size_) std::memcpy(grown.get(), buffer_, size_);
+  owned_ = std::move(grown);
+  buffer_ = owned_.get();
+  capacity_ = capacity;
+  return true;
+}
+
+bool JsonFieldReader::Fill(ByteSource& source, bool* end_of_input) {
+  // Growth is only needed without a size hint, or when the file grew past it.
+  if (size_ == capacity_ && !Reserve(std::max(capacity_ * 2, kReadChunk))) return false;
+
+  size_t read = 0;
+  if (!source.Read(buffer_ + size_, std::min(kReadChunk, capacity_ - size_), &read)) {
+    return false;
+  }
+  size_ += read;
+  *end_of_input = read == 0;
+  return true;
+}
+
+bool JsonFieldReader::Read(ByteSource& source, const std::function<bool(size_t)>& stop) {
+  const std::string_view view = source.View();
+  if (!view.empty()) {
+    view_ = view;
+    while ((status_ = scanner_.Feed(view_, true)) == JsonFieldScanner::Status::kFieldFound) {
+      if (stop && stop(scanner_.last_found())) break;
+    }
+    return true;
+  }
+
+  uint64_t hint = 0;
+  if (capacity_ == 0 && reserve_whole_source_ && source.SizeHint(&hint) &&
+      hint < std::numeric_limits<size_t>::max()) {
+    // One allocation covers the whole file plus the byte the end-of-data read is offered.
+    if (!Reserve(static_cast<size_t>(hint) + 1)) return false;
+  }
+
+  bool end_of_input = false;
+  while (true) {
+    if (!Fill(source, &end_of_input)) return false;
+
+    while (true) {
+      status_ = scanner_.Feed(data(), end_of_input);
+      if (status_ == JsonFieldScanner::Status::kFieldFound) {
+        if (stop && stop(scanner_.last_found())) return true;
+        continue;
+      }
+      if (status_ != JsonFieldScanner::Status::kNeedMore || end_of_input) return true;
+      if (found_count() != 0 && settle_deadline_ != std::chrono::steady_clock::time_point::max() &&
+          std::chrono::steady_clock::now() >= settle_deadline_) {
+        status_ = JsonFieldScanner::Status::kBudgetExceeded;
+        return true;
+      }
+      break;
+    }
+  }
+}
+
+}  // namespace vibe
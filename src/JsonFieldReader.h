@@ -0,0 +1,76 @@
+#pragma once
+
+#include "ByteSource.h"
+#include "JsonFieldLocator.h"
+#include "ScratchArena.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace vibe {
+
+// Locates fields in a document held by a ByteSource. Sources with a view are scanned in place;
+// others are pulled into one buffer while a JsonFieldScanner tokenizes each chunk as it lands, so
+// reading can stop as soon as the wanted field is complete.
+class JsonFieldReader {
+ public:
+  static constexpr size_t kReadChunk = 64 * 1024;
+
+  // |keys| must outlive the reader. With an |arena|, the buffer for sequential sources comes from
+  // it and lives until the caller's scope closes; otherwise the reader owns a heap buffer. The
+  // scan stops where |budget| runs out.
+  explicit JsonFieldReader(std::span<const std::string_view> keys, ScratchArena* arena = nullptr,
+                           const JsonScanBudget& budget = JsonScanBudget());
+
+  // Sources that report their size get one buffer for all of it up front. Turned off for files
+  // expected to be read only in part, whose buffer then grows as they are read.
+  void set_reserve_whole_source(bool reserve) { reserve_whole_source_ = reserve; }
+
+  // Once a field has been found, a sequential source is read no further than |deadline|, for
+  // callers that would rather have some field in time than the best one late. Until then, only
+  // the budget bounds the reading.
+  void set_settle_deadline(std::chrono::steady_clock::time_point deadline) {
+    settle_deadline_ = deadline;
+  }
+
+  // Reads until |stop| returns true for a freshly found key index, the document ends, or the
+  // source is exhausted. Returns false only when the source fails or memory runs out; a malformed
+  // document simply leaves the fields found before the error.
+  bool Read(ByteSource& source, const std::function<bool(size_t)>& stop);
+
+  // How the scan ended: kBudgetExceeded or kCancelled when the budget cut it short, and
+  // kBudgetExceeded too when reading stopped at the settle deadline.
+  JsonFieldScanner::Status status() const { return status_; }
+
+  // The scanned bytes: the source's own view, or the reader's buffer for sequential sources.
+  std::string_view data() const {
+    return view_.data() ? view_ : std::string_view(buffer_, size_);
+  }
+  // The reader's buffer, which callers may decode fields into once reading is done; null when the
+  // source's view was scanned.
+  char* writable_data() { return view_.data() ? nullptr : buffer_; }
+  JsonStringSpan field(size_t index) const { return scanner_.field(index, data()); }
+  size_t found_count() const { return scanner_.found_count(); }
+
+ private:
+  bool Fill(ByteSource& source, bool* end_of_input);
+  bool Reserve(size_t capacity);
+
+  JsonFieldScanner scanner_;
+  JsonFieldScanner::Status status_ = JsonFieldScanner::Status::kNeedMore;
+  std::string_view view_;
+  ScratchArena* arena_;
+  std::unique_ptr<char[]> owned_;
+  char* buffer_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  bool reserve_whole_source_ = true;
+  std::chrono::steady_clock::time_point settle_deadline_ =
+      std::chrono::steady_clock::time_point::max();
+};
+
+}  // namespace vibe
@@ -0,0 +1,127 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vibe {
+
+MappedFileByteSource::~MappedFileByteSource() {
+  Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFileByteSource::Open(const std::filesystem::path& path) {
+  Close();
+
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+
+  LARGE_INTEGER size = {};
+  if (!GetFileSizeEx(file, &size) || static_cast<unsigned long long>(size.QuadPart) > SIZE_MAX) {
+    CloseHandle(file);
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return true;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (!mapping) return false;
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    return false;
+  }
+
+  mapping_ = mapping;
+  data_ = static_cast<const char*>(view);
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFileByteSource::Close() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  mapping_ = nullptr;
+  data_ = nullptr;
+  size_ = 0;
+  offset_ = 0;
+}
+
+#else
+
+bool MappedFileByteSource::Open(const std::filesystem::path& path) {
+  Close();
+
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat info = {};
+  if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+    close(fd);
+    return false;
+  }
+  if (info.st_size == 0) {
+    close(fd);
+    return true;
+  }
+
+  void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (view == MAP_FAILED) return false;
+  madvise(view, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+  data_ = static_cast<const char*>(view);
+  size_ = static_cast<size_t>(info.st_size);
+  return true;
+}
+
+void MappedFileByteSource::Close() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+  data_ = nullptr;
+  size_ = 0;
+  offset_ = 0;
+}
+
+#endif
+
+bool MappedFileByteSource::Read(void* buffer, size_t capacity, size_t* bytes_read) {
+  if (!bytes_read || (!buffer && capacity)) return false;
+
+  const size_t count = std::min(capacity, size_ - offset_);
+  if (count) std::memcpy(buffer, data_ + offset_, count);
+  offset_ += count;
+  *bytes_read = count;
+  return true;
+}
+
+bool MappedFileByteSource::Skip(uint64_t count) {
+  if (count > size_ - offset_) return false;
+  offset_ += static_cast<size_t>(count);
+  return true;
+}
+
+bool MappedFileByteSource::SizeHint(uint64_t* size) {
+  if (!size) return false;
+  *size = size_;
+  return true;
+}
+
+}  // namespace vibe
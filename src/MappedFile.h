@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ByteSource.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace vibe {
+
+// Read-only memory-mapped view of a whole file: CreateFileMapping on Windows, mmap elsewhere.
+class MappedFileByteSource final : public ByteSource {
+ public:
+  MappedFileByteSource() = default;
+  ~MappedFileByteSource() override;
+
+  MappedFileByteSource(const MappedFileByteSource&) = delete;
+  MappedFileByteSource& operator=(const MappedFileByteSource&) = delete;
+
+  // Maps |path|. An empty file opens successfully with an empty view.
+  bool Open(const std::filesystem::path& path);
+  void Close();
+
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override;
+  bool SizeHint(uint64_t* size) override;
+  std::string_view View() const override { return std::string_view(data_, size_); }
+  bool Skip(uint64_t count) override;
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  size_t offset_ = 0;
+#if defined(_WIN32)
+  void* mapping_ = nullptr;
+#endif
+};
+
+}  // namespace vibe
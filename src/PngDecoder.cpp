@@ -0,0 +1,421 @@
+#include "PngDecoder.h"
+
+#include "Inflate.h"
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace vibe {
+namespace {
+
+constexpr uint8_t kSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+enum ColorType : uint8_t {
+  kGray = 0,
+  kRgb = 2,
+  kPalette = 3,
+  kGrayAlpha = 4,
+  kRgba = 6,
+};
+
+struct Adam7Pass {
+  uint32_t x0;
+  uint32_t y0;
+  uint32_t dx;
+  uint32_t dy;
+};
+
+constexpr Adam7Pass kAdam7[7] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+                                 {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+
+// Passes that together hold every pixel whose coordinates are multiples of the scale: pass 1
+// alone for 1/8, passes 1-3 for 1/4, 1-5 for 1/2.
+int Adam7PassCount(uint32_t scale) {
+  switch (scale) {
+    case 8:
+      return 1;
+    case 4:
+      return 3;
+    case 2:
+      return 5;
+    default:
+      return 7;
+  }
+}
+
+struct Header {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t depth = 0;
+  uint8_t color_type = 0;
+  bool interlaced = false;
+
+  int channels() const {
+    switch (color_type) {
+      case kRgb:
+        return 3;
+      case kGrayAlpha:
+        return 2;
+      case kRgba:
+        return 4;
+      default:
+        return 1;
+    }
+  }
+  size_t row_bytes(uint32_t pixels) const {
+    return (static_cast<size_t>(pixels) * channels() * depth + 7) / 8;
+  }
+  // Distance to the corresponding byte of the previous pixel, as the filters define it.
+  size_t filter_step() const { return std::max<size_t>(1, static_cast<size_t>(channels()) * depth / 8); }
+};
+
+struct Palette {
+  // BGRA entries; entries without a tRNS value stay opaque.
+  uint8_t colors[256][4] = {};
+  uint32_t size = 0;
+  // tRNS color key for gray and RGB images, compared against raw samples.
+  bool has_key = false;
+  uint16_t key[3] = {};
+};
+
+uint32_t ReadBigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint16_t ReadBigEndian16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+bool ValidDepth(uint8_t color_type, uint8_t depth) {
+  switch (color_type) {
+    case kGray:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+    case kPalette:
+      return depth == 1 || depth == 2 || depth == 4 || depth == 8;
+    case kRgb:
+    case kGrayAlpha:
+    case kRgba:
+      return depth == 8 || depth == 16;
+    default:
+      return false;
+  }
+}
+
+uint8_t Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+  return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+// Reverses the filter of one row of |row_bytes| bytes, preceded by its filter type byte, in place.
+// |previous| is the unfiltered row above, or null for the first row.
+bool UnfilterRow(uint8_t* row, const uint8_t* previous, size_t row_bytes, size_t step) {
+  const uint8_t filter = row[0];
+  uint8_t* cur = row + 1;
+  switch (filter) {
+    case 0:
+      break;
+    case 1:
+      for (size_t i = step; i < row_bytes; ++i) cur[i] = static_cast<uint8_t>(cur[i] + cur[i - step]);
+      break;
+    case 2:
+      if (!previous) break;
+      for (size_t i = 0; i < row_bytes; ++i) cur[i] = static_cast<uint8_t>(cur[i] + previous[i]);
+      break;
+    case 3:
+      for (size_t i = 0; i < row_bytes; ++i) {
+        const int left = i >= step ? cur[i - step] : 0;
+        const int up = previous ? previous[i] : 0;
+        cur[i] = static_cast<uint8_t>(cur[i] + ((left + up) >> 1));
+      }
+      break;
+    case 4:
+      for (size_t i = 0; i < row_bytes; ++i) {
+        const int left = i >= step ? cur[i - step] : 0;
+        const int up = previous ? previous[i] : 0;
+        const int up_left = previous && i >= step ? previous[i - step] : 0;
+        cur[i] = static_cast<uint8_t>(cur[i] + Paeth(left, up, up_left));
+      }
+      break;
+    default:
+      return false;
+  }
+  return true;
+}
+
+// Reverses the per-row filters of |rows| rows of |row_bytes| bytes, each preceded by its filter
+// type byte, in place.
+bool Unfilter(uint8_t* data, uint32_t rows, size_t row_bytes, size_t step) {
+  const uint8_t* previous = nullptr;
+  for (uint32_t y = 0; y < rows; ++y) {
+    uint8_t* row = data + y * (row_bytes + 1);
+    if (!UnfilterRow(row, previous, row_bytes, step)) return false;
+    previous = row + 1;
+  }
+  return true;
+}
+
+void StorePixel(uint8_t* out, uint8_t r, uint8_t g, uint8_t b, uint8_t a) {
+  out[0] = b;
+  out[1] = g;
+  out[2] = r;
+  out[3] = a;
+}
+
+// Converts one unfiltered row of |count| pixels to BGRA, writing every |out_step| bytes.
+void ExpandRow(const Header& header, const Palette& palette, const uint8_t* row, uint32_t count,
+               uint8_t* out, size_t out_step) {
+  const uint8_t depth = header.depth;
+  if (depth < 8) {
+    const uint32_t mask = (1u << depth) - 1;
+    const uint8_t gray_scale = static_cast<uint8_t>(255 / mask);
+    for (uint32_t x = 0; x < count; ++x, out += out_step) {
+      const size_t bit = static_cast<size_t>(x) * depth;
+      const uint32_t value = (row[bit / 8] >> (8 - depth - bit % 8)) & mask;
+      if (header.color_type == kPalette) {
+        std::memcpy(out, palette.colors[value], 4);
+      } else {
+        const uint8_t gray = static_cast<uint8_t>(value * gray_scale);
+        const bool clear = palette.has_key && value == palette.key[0];
+        StorePixel(out, gray, gray, gray, clear ? 0 : 255);
+      }
+    }
+    return;
+  }
+
+  const int bytes = depth / 8;
+  auto sample = [&](const uint8_t* p) -> uint16_t {
+    return bytes == 2 ? ReadBigEndian16(p) : *p;
+  };
+  const size_t pixel_bytes = static_cast<size_t>(header.channels()) * bytes;
+  for (uint32_t x = 0; x < count; ++x, out += out_step, row += pixel_bytes) {
+    switch (header.color_type) {
+      case kGray: {
+        const bool clear = palette.has_key && sample(row) == palette.key[0];
+        StorePixel(out, row[0], row[0], row[0], clear ? 0 : 255);
+        break;
+      }
+      case kPalette:
+        std::memcpy(out, palette.colors[row[0]], 4);
+        break;
+      case kRgb: {
+        const bool clear = palette.has_key && sample(row) == palette.key[0] &&
+                           sample(row + bytes) == palette.key[1] &&
+                           sample(row + 2 * bytes) == palette.key[2];
+        StorePixel(out, row[0], row[bytes], row[2 * bytes], clear ? 0 : 255);
+        break;
+      }
+      case kGrayAlpha:
+        StorePixel(out, row[0], row[0], row[0], row[bytes]);
+        break;
+      case kRgba:
+        StorePixel(out, row[0], row[bytes], row[2 * bytes], row[3 * bytes]);
+        break;
+    }
+  }
+}
+
+DecodeStatus ParseHeader(std::span<const uint8_t> body, Header* header) {
+  if (body.size() != 13) return DecodeStatus::kCorrupt;
+  header->width = ReadBigEndian32(body.data());
+  header->height = ReadBigEndian32(body.data() + 4);
+  header->depth = body[8];
+  header->color_type = body[9];
+  header->interlaced = body[12] == 1;
+  if (header->width == 0 || header->height == 0 || body[10] != 0 || body[11] != 0 || body[12] > 1 ||
+      !ValidDepth(header->color_type, header->depth)) {
+    return DecodeStatus::kCorrupt;
+  }
+  if (header->width > kMaxImageDimension || header->height > kMaxImageDimension ||
+      static_cast<uint64_t>(header->width) * header->height > kMaxImagePixels) {
+    return DecodeStatus::kTooLarge;
+  }
+  return DecodeStatus::kOk;
+}
+
+}  // namespace
+
+bool IsPng(std::span<const uint8_t> data) {
+  return data.size() >= sizeof(kSignature) &&
+         std::memcmp(data.data(), kSignature, sizeof(kSignature)) == 0;
+}
+
+DecodeStatus DecodePng(std::span<const uint8_t> data, uint32_t min_long_edge,
+                       ImageRowSink* sink) {
+  if (!IsPng(data)) return DecodeStatus::kUnsupported;
+
+  Header header;
+  bool have_header = false;
+  Palette palette;
+  for (auto& color : palette.colors) color[3] = 255;
+
+  // A single IDAT chunk is inflated in place; several are joined first.
+  std::span<const uint8_t> compressed;
+  size_t idat_count = 0;
+  size_t idat_bytes = 0;
+  size_t pos = sizeof(kSignature);
+  while (data.size() - pos >= 12) {
+    const uint32_t length = ReadBigEndian32(data.data() + pos);
+    const uint8_t* type = data.data() + pos + 4;
+    if (length > data.size() - pos - 12) return DecodeStatus::kCorrupt;
+    const std::span<const uint8_t> body = data.subspan(pos + 8, length);
+    pos += 12 + static_cast<size_t>(length);
+
+    if (std::memcmp(type, "IHDR", 4) == 0) {
+      if (have_header) return DecodeStatus::kCorrupt;
+      const DecodeStatus status = ParseHeader(body, &header);
+      if (status != DecodeStatus::kOk) return status;
+      have_header = true;
+    } else if (!have_header) {
+      return DecodeStatus::kCorrupt;
+    } else if (std::memcmp(type, "PLTE", 4) == 0) {
+      if (length % 3 != 0 || length / 3 > 256) return DecodeStatus::kCorrupt;
+      palette.size = length / 3;
+      for (uint32_t i = 0; i < palette.size; ++i) {
+        StorePixel(palette.colors[i], body[i * 3], body[i * 3 + 1], body[i * 3 + 2],
+                   palette.colors[i][3]);
+      }
+    } else if (std::memcmp(type, "tRNS", 4) == 0) {
+      if (header.color_type == kPalette) {
+        if (length > 256) return DecodeStatus::kCorrupt;
+        for (uint32_t i = 0; i < length; ++i) palette.colors[i][3] = body[i];
+      } else if (header.color_type == kGray && length == 2) {
+        palette.has_key = true;
+        palette.key[0] = ReadBigEndian16(body.data());
+      } else if (header.color_type == kRgb && length == 6) {
+        palette.has_key = true;
+        for (int c = 0; c < 3; ++c) palette.key[c] = ReadBigEndian16(body.data() + c * 2);
+      }
+    } else if (std::memcmp(type, "IDAT", 4) == 0) {
+      if (idat_count++ == 0) compressed = body;
+      idat_bytes += length;
+    } else if (std::memcmp(type, "IEND", 4) == 0) {
+      break;
+    }
+  }
+  if (!have_header || idat_bytes == 0) return DecodeStatus::kCorrupt;
+  if (header.color_type == kPalette && palette.size == 0) return DecodeStatus::kCorrupt;
+
+  // Filtered scanlines of every pass needed, each row led by its filter type byte. The passes
+  // follow each other in the zlib stream, so inflating stops where the last one needed ends.
+  const uint32_t scale =
+      header.interlaced ? SelectDecodeScale(header.width, header.height, min_long_edge) : 1;
+  const std::span<const Adam7Pass> passes(kAdam7, Adam7PassCount(scale));
+  ImageLayout layout;
+  layout.width = (header.width + scale - 1) / scale;
+  layout.height = (header.height + scale - 1) / scale;
+  layout.source_width = header.width;
+  layout.source_height = header.height;
+  layout.working_bytes = idat_count > 1 ? idat_bytes : 0;
+  switch (header.color_type) {
+    case kGray:
+    case kRgb:
+      layout.opaque = !palette.has_key;
+      break;
+    case kPalette:
+      layout.opaque = true;
+      for (uint32_t i = 0; i < palette.size; ++i) layout.opaque &= palette.colors[i][3] == 255;
+      break;
+    default:
+      break;
+  }
+  size_t raw_size = 0;
+  if (header.interlaced) {
+    for (const Adam7Pass& pass : passes) {
+      if (header.width <= pass.x0 || header.height <= pass.y0) continue;
+      const uint32_t pass_width = (header.width - pass.x0 + pass.dx - 1) / pass.dx;
+      const uint32_t pass_height = (header.height - pass.y0 + pass.dy - 1) / pass.dy;
+      raw_size += pass_height * (header.row_bytes(pass_width) + 1);
+    }
+    // Passes scatter over the whole image, so it is assembled before any row goes out.
+    layout.working_bytes += raw_size + static_cast<uint64_t>(layout.width) * layout.height * 4;
+  } else {
+    // Rows stream out of the inflater one at a time, unfiltered against the one before.
+    layout.working_bytes += ZlibStream::ArenaBytes() + 2 * (header.row_bytes(header.width) + 1) +
+                            static_cast<uint64_t>(header.width) * 4;
+  }
+  const DecodeStatus status = sink->Begin(layout);
+  if (status != DecodeStatus::kOk) return status;
+
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  ScratchArena::Scope scope(arena);
+  if (idat_count > 1) {
+    uint8_t* joined = arena.AllocateArray<uint8_t>(idat_bytes);
+    if (!joined) return DecodeStatus::kOutOfMemory;
+    size_t joined_size = 0;
+    for (size_t chunk = sizeof(kSignature); joined_size < idat_bytes;) {
+      const uint32_t length = ReadBigEndian32(data.data() + chunk);
+      if (std::memcmp(data.data() + chunk + 4, "IDAT", 4) == 0) {
+        std::memcpy(joined + joined_size, data.data() + chunk + 8, length);
+        joined_size += length;
+      }
+      chunk += 12 + static_cast<size_t>(length);
+    }
+    compressed = std::span<const uint8_t>(joined, idat_bytes);
+  }
+
+  const size_t step = header.filter_step();
+  if (!header.interlaced) {
+    const size_t row_bytes = header.row_bytes(header.width);
+    ZlibStream zlib;
+    const InflateStatus init_status = zlib.Init(compressed, arena);
+    if (init_status == InflateStatus::kOutOfMemory) return DecodeStatus::kOutOfMemory;
+    if (init_status != InflateStatus::kOk) return DecodeStatus::kCorrupt;
+    uint8_t* rows = arena.AllocateArray<uint8_t>(2 * (row_bytes + 1));
+    uint8_t* bgra = arena.AllocateArray<uint8_t>(static_cast<size_t>(header.width) * 4);
+    if (!rows || !bgra) return DecodeStatus::kOutOfMemory;
+
+    const uint8_t* previous = nullptr;
+    for (uint32_t y = 0; y < header.height; ++y) {
+      uint8_t* row = rows + (y % 2) * (row_bytes + 1);
+      size_t read = 0;
+      if (zlib.Read(std::span<uint8_t>(row, row_bytes + 1), &read) != InflateStatus::kOk ||
+          read != row_bytes + 1 || !UnfilterRow(row, previous, row_bytes, step)) {
+        return DecodeStatus::kCorrupt;
+      }
+      ExpandRow(header, palette, row + 1, header.width, bgra, 4);
+      sink->PushRow(bgra);
+      previous = row + 1;
+    }
+    return DecodeStatus::kOk;
+  }
+
+  uint8_t* raw = arena.AllocateArray<uint8_t>(raw_size);
+  if (!raw) return DecodeStatus::kOutOfMemory;
+  size_t inflated = 0;
+  const InflateStatus inflate_status =
+      ZlibInflate(compressed, std::span<uint8_t>(raw, raw_size), &inflated);
+  if ((inflate_status != InflateStatus::kOk && inflate_status != InflateStatus::kOutputFull) ||
+      inflated != raw_size) {
+    return DecodeStatus::kCorrupt;
+  }
+
+  // The passes taken cover every pixel of the reduced image, so the frame needs no clearing.
+  const size_t stride = static_cast<size_t>(layout.width) * 4;
+  uint8_t* frame = arena.AllocateArray<uint8_t>(stride * layout.height);
+  if (!frame) return DecodeStatus::kOutOfMemory;
+  uint8_t* pass_data = raw;
+  for (const Adam7Pass& pass : passes) {
+    if (header.width <= pass.x0 || header.height <= pass.y0) continue;
+    const uint32_t pass_width = (header.width - pass.x0 + pass.dx - 1) / pass.dx;
+    const uint32_t pass_height = (header.height - pass.y0 + pass.dy - 1) / pass.dy;
+    const size_t row_bytes = header.row_bytes(pass_width);
+    if (!Unfilter(pass_data, pass_height, row_bytes, step)) return DecodeStatus::kCorrupt;
+    for (uint32_t y = 0; y < pass_height; ++y) {
+      uint8_t* out = frame + (pass.y0 + y * pass.dy) / scale * stride +
+                     static_cast<size_t>(pass.x0 / scale) * 4;
+      ExpandRow(header, palette, pass_data + y * (row_bytes + 1) + 1, pass_width, out,
+                static_cast<size_t>(pass.dx / scale) * 4);
+    }
+    pass_data += pass_height * (row_bytes + 1);
+  }
+  for (uint32_t y = 0; y < layout.height; ++y) sink->PushRow(frame + y * stride);
+  return DecodeStatus::kOk;
+}
+
+}  // namespace vibe
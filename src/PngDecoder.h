@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ImageDecoder.h"
+
+#include <cstdint>
+#include <span>
+
+namespace vibe {
+
+bool IsPng(std::span<const uint8_t> data);
+
+// Decodes every standard PNG color type and bit depth, interlaced or not, to 8-bit BGRA. 16-bit
+// samples keep their high byte; gamma, color profiles and CRCs are ignored. Interlaced images that
+// |min_long_edge| allows to reduce are built from the early Adam7 passes alone, whose pixels are
+// every 8th, 4th or 2nd of the full image, and the later passes are never inflated.
+// Rows of non-interlaced images are inflated and handed to |sink| one at a time.
+DecodeStatus DecodePng(std::span<const uint8_t> data, uint32_t min_long_edge, ImageRowSink* sink);
+
+}  // namespace vibe
@@ -0,0 +1,285 @@
+#include "PngEncoder.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+
+namespace vibe {
+namespace {
+
+constexpr uint16_t kLengthBase[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,
+                                      15, 17, 19, 23, 27, 31, 35, 43, 51,  59,
+                                      67, 83, 99, 115, 131, 163, 195, 227, 258};
+constexpr uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+constexpr uint16_t kDistanceBase[30] = {1,    2,    3,    4,    5,     7,     9,     13,
+                                        17,   25,   33,   49,   65,    97,    129,   193,
+                                        257,  385,  513,  769,  1025,  1537,  2049,  3073,
+                                        4097, 6145, 8193, 12289, 16385, 24577};
+constexpr uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+                                        6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+constexpr int kHashBits = 15;
+constexpr size_t kWindowSize = 32768;
+constexpr size_t kMaxMatch = 258;
+
+struct Crc32Table {
+  uint32_t values[256];
+
+  constexpr Crc32Table() : values() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit) crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+      values[i] = crc;
+    }
+  }
+};
+
+constexpr Crc32Table kCrc32Table;
+
+uint32_t UpdateCrc32(uint32_t crc, const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) crc = kCrc32Table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc;
+}
+
+uint32_t Adler32(const uint8_t* data, size_t size) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    const size_t block = size < 5552 ? size : 5552;
+    for (size_t i = 0; i < block; ++i) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += block;
+    size -= block;
+  }
+  return (b << 16) | a;
+}
+
+void AppendBigEndian32(std::vector<uint8_t>* out, uint32_t value) {
+  out->push_back(static_cast<uint8_t>(value >> 24));
+  out->push_back(static_cast<uint8_t>(value >> 16));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+void AppendChunk(std::vector<uint8_t>* out, const char* type, const uint8_t* body, size_t size) {
+  AppendBigEndian32(out, static_cast<uint32_t>(size));
+  const size_t type_pos = out->size();
+  out->insert(out->end(), type, type + 4);
+  if (size) out->insert(out->end(), body, body + size);
+  AppendBigEndian32(out, ~UpdateCrc32(~0u, out->data() + type_pos, size + 4));
+}
+
+class BitWriter {
+ public:
+  explicit BitWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+  void Put(uint32_t value, int bits) {
+    buffer_ |= static_cast<uint64_t>(value) << count_;
+    count_ += bits;
+    while (count_ >= 8) {
+      out_->push_back(static_cast<uint8_t>(buffer_));
+      buffer_ >>= 8;
+      count_ -= 8;
+    }
+  }
+
+  // Huffman codes go out most significant bit first.
+  void PutCode(uint32_t code, int bits) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < bits; ++i) reversed |= ((code >> i) & 1) << (bits - 1 - i);
+    Put(reversed, bits);
+  }
+
+  void Flush() {
+    if (count_ > 0) out_->push_back(static_cast<uint8_t>(buffer_));
+    buffer_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  std::vector<uint8_t>* out_;
+  uint64_t buffer_ = 0;
+  int count_ = 0;
+};
+
+void PutLiteral(BitWriter& writer, int symbol) {
+  if (symbol < 144) {
+    writer.PutCode(0x30 + symbol, 8);
+  } else if (symbol < 256) {
+    writer.PutCode(0x190 + symbol - 144, 9);
+  } else if (symbol < 280) {
+    writer.PutCode(symbol - 256, 7);
+  } else {
+    writer.PutCode(0xC0 + symbol - 280, 8);
+  }
+}
+
+uint32_t Hash3(const uint8_t* p) {
+  const uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+  return (value * 2654435761u) >> (32 - kHashBits);
+}
+
+// A single final block with the fixed codes, matches found through one hash head per 3-byte
+// prefix.
+void Deflate(const uint8_t* data, size_t size, std::vector<uint8_t>* out) {
+  BitWriter writer(out);
+  writer.Put(1, 1);
+  writer.Put(1, 2);
+
+  std::vector<int64_t> head(size_t{1} << kHashBits, -1);
+  size_t i = 0;
+  while (i < size) {
+    size_t best_length = 0;
+    size_t best_distance = 0;
+    if (size - i >= 3) {
+      const uint32_t hash = Hash3(data + i);
+      const int64_t candidate = head[hash];
+      head[hash] = static_cast<int64_t>(i);
+      if (candidate >= 0 && i - static_cast<size_t>(candidate) <= kWindowSize) {
+        const uint8_t* match = data + candidate;
+        const size_t limit = std::min(kMaxMatch, size - i);
+        size_t length = 0;
+        while (length < limit && match[length] == data[i + length]) ++length;
+        if (length >= 3) {
+          best_length = length;
+          best_distance = i - static_cast<size_t>(candidate);
+        }
+      }
+    }
+
+    if (best_length == 0) {
+      PutLiteral(writer, data[i++]);
+      continue;
+    }
+
+    int length_symbol = 28;
+    while (kLengthBase[length_symbol] > best_length) --length_symbol;
+    PutLiteral(writer, 257 + length_symbol);
+    writer.Put(static_cast<uint32_t>(best_length - kLengthBase[length_symbol]),
+               kLengthExtra[length_symbol]);
+    int distance_symbol = 29;
+    while (kDistanceBase[distance_symbol] > best_distance) --distance_symbol;
+    writer.PutCode(static_cast<uint32_t>(distance_symbol), 5);
+    writer.Put(static_cast<uint32_t>(best_distance - kDistanceBase[distance_symbol]),
+               kDistanceExtra[distance_symbol]);
+
+    for (size_t j = i + 1; j < i + best_length && size - j >= 3; ++j) {
+      head[Hash3(data + j)] = static_cast<int64_t>(j);
+    }
+    i += best_length;
+  }
+  PutLiteral(writer, 256);
+  writer.Flush();
+}
+
+uint8_t Paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+  return static_cast<uint8_t>(pb <= pc ? b : c);
+}
+
+}  // namespace
+
+std::vector<uint8_t> EncodePng(const uint8_t* bgra, uint32_t width, uint32_t height, size_t stride,
+                               bool keep_alpha, bool interlaced) {
+  const size_t channels = keep_alpha ? 4 : 3;
+  struct Pass {
+    uint32_t x0, y0, dx, dy;
+  };
+  static constexpr Pass kFull[1] = {{0, 0, 1, 1}};
+  static constexpr Pass kAdam7[7] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4},
+                                     {0, 2, 2, 4}, {1, 0, 2, 2}, {0, 1, 1, 2}};
+  const std::span<const Pass> passes = interlaced ? std::span<const Pass>(kAdam7)
+                                                  : std::span<const Pass>(kFull);
+
+  // Filtered scanlines of every pass, each led by the filter type that minimizes its sum of
+  // absolute values. Filtering starts afresh with each pass.
+  std::vector<uint8_t> filtered;
+  filtered.reserve((static_cast<size_t>(width) * channels + 1) * height);
+  for (const Pass& pass : passes) {
+    if (width <= pass.x0 || height <= pass.y0) continue;
+    const uint32_t pass_width = (width - pass.x0 + pass.dx - 1) / pass.dx;
+    const uint32_t pass_height = (height - pass.y0 + pass.dy - 1) / pass.dy;
+    const size_t row_bytes = static_cast<size_t>(pass_width) * channels;
+    std::vector<uint8_t> previous(row_bytes, 0);
+    std::vector<uint8_t> current(row_bytes);
+    std::vector<uint8_t> candidate(row_bytes);
+    for (uint32_t y = 0; y < pass_height; ++y) {
+      const uint8_t* in = bgra + static_cast<size_t>(pass.y0 + y * pass.dy) * stride +
+                          static_cast<size_t>(pass.x0) * 4;
+      for (uint32_t x = 0; x < pass_width; ++x, in += static_cast<size_t>(pass.dx) * 4) {
+        uint8_t* out = current.data() + x * channels;
+        out[0] = in[2];
+        out[1] = in[1];
+        out[2] = in[0];
+        if (keep_alpha) out[3] = in[3];
+      }
+
+      const size_t row_start = filtered.size();
+      filtered.resize(row_start + row_bytes + 1);
+      uint8_t* row = filtered.data() + row_start;
+      uint64_t best_cost = UINT64_MAX;
+      for (uint8_t filter = 0; filter < 5; ++filter) {
+        uint64_t cost = 0;
+        for (size_t i = 0; i < row_bytes; ++i) {
+          const int left = i >= channels ? current[i - channels] : 0;
+          const int up = previous[i];
+          const int up_left = i >= channels ? previous[i - channels] : 0;
+          int predictor = 0;
+          switch (filter) {
+            case 1:
+              predictor = left;
+              break;
+            case 2:
+              predictor = up;
+              break;
+            case 3:
+              predictor = (left + up) >> 1;
+              break;
+            case 4:
+              predictor = Paeth(left, up, up_left);
+              break;
+          }
+          candidate[i] = static_cast<uint8_t>(current[i] - predictor);
+          cost += static_cast<uint64_t>(std::abs(static_cast<int8_t>(candidate[i])));
+        }
+        if (cost < best_cost) {
+          best_cost = cost;
+          row[0] = filter;
+          std::memcpy(row + 1, candidate.data(), row_bytes);
+        }
+      }
+      previous.swap(current);
+    }
+  }
+
+  std::vector<uint8_t> compressed = {0x78, 0x01};
+  compressed.reserve(filtered.size() / 2 + 64);
+  Deflate(filtered.data(), filtered.size(), &compressed);
+  AppendBigEndian32(&compressed, Adler32(filtered.data(), filtered.size()));
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  uint8_t header[13] = {};
+  for (int i = 0; i < 4; ++i) {
+    header[i] = static_cast<uint8_t>(width >> (24 - 8 * i));
+    header[4 + i] = static_cast<uint8_t>(height >> (24 - 8 * i));
+  }
+  header[8] = 8;
+  header[9] = keep_alpha ? 6 : 2;
+  header[12] = interlaced ? 1 : 0;
+  AppendChunk(&png, "IHDR", header, sizeof(header));
+  AppendChunk(&png, "IDAT", compressed.data(), compressed.size());
+  AppendChunk(&png, "IEND", nullptr, 0);
+  return png;
+}
+
+}  // namespace vibe
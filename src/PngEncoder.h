@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vibe {
+
+// Encodes straight-alpha BGRA rows as an 8-bit RGBA PNG, or RGB when |keep_alpha| is false, and
+// Adam7-interlaced when |interlaced| is set. Rows get the usual minimum-sum-of-differences filter
+// choice and are compressed with greedy LZ77 and the fixed deflate codes: fast and deterministic
+// rather than small.
+std::vector<uint8_t> EncodePng(const uint8_t* bgra, uint32_t width, uint32_t height, size_t stride,
+                               bool keep_alpha = true, bool interlaced = false);
+
+}  // namespace vibe
@@ -0,0 +1,105 @@
+#include "RenderDeadline.h"
+
+#include <algorithm>
+
+namespace vibe {
+namespace {
+
+std::atomic<uint64_t> g_tier_counters[kRenderTierCount];
+
+// Smoothing of the per-pixel costs: each render moves them an eighth of the way to its own.
+constexpr float kCostSmoothing = 1.0f / 8.0f;
+
+size_t FormatIndex(ImageFormat format) {
+  switch (format) {
+    case ImageFormat::kJpeg:
+      return 0;
+    case ImageFormat::kPng:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+size_t ScaleIndex(uint32_t scale) {
+  size_t index = 0;
+  while (index + 1 < 4 && (1u << (index + 1)) <= scale) ++index;
+  return index;
+}
+
+}  // namespace
+
+const char* RenderTierName(RenderTier tier) {
+  switch (tier) {
+    case RenderTier::kFull:
+      return "full";
+    case RenderTier::kSmallerSource:
+      return "smaller source";
+    case RenderTier::kReducedDecode:
+      return "reduced decode";
+    case RenderTier::kFastScale:
+      return "fast scale";
+    case RenderTier::kOverrun:
+      return "overrun";
+    case RenderTier::kCount:
+      break;
+  }
+  return "unknown";
+}
+
+void SnapshotRenderTierCounters(uint64_t (&counters)[kRenderTierCount]) {
+  for (size_t i = 0; i < kRenderTierCount; ++i) {
+    counters[i] = g_tier_counters[i].load(std::memory_order_relaxed);
+  }
+}
+
+void CountRenderTier(RenderTier tier) {
+  g_tier_counters[static_cast<size_t>(tier)].fetch_add(1, std::memory_order_relaxed);
+}
+
+DecodeCostModel::DecodeCostModel() {
+  // Nanoseconds per source pixel with the portable decoder on a desktop core, at decode scales
+  // 1, 2, 4 and 8. JPEG scaling saves the IDCT and colour conversion but not the entropy
+  // decoding; other formats always decode in full.
+  constexpr float kDefaults[kFormats][kScales] = {
+      {14.0f, 9.0f, 7.0f, 6.0f},
+      {35.0f, 35.0f, 35.0f, 35.0f},
+      {40.0f, 40.0f, 40.0f, 40.0f},
+  };
+  // The fast filter mostly trims the horizontal pass, a modest share of the total.
+  constexpr float kFastShare = 0.85f;
+  for (size_t f = 0; f < kFormats; ++f) {
+    for (size_t s = 0; s < kScales; ++s) {
+      ns_per_pixel_[f][s][0].store(kDefaults[f][s], std::memory_order_relaxed);
+      ns_per_pixel_[f][s][1].store(kDefaults[f][s] * kFastShare, std::memory_order_relaxed);
+    }
+  }
+}
+
+std::chrono::nanoseconds DecodeCostModel::Estimate(ImageFormat format, uint32_t width,
+                                                   uint32_t height, uint32_t scale,
+                                                   bool fast) const {
+  const std::atomic<float>& cost =
+      ns_per_pixel_[FormatIndex(format)][ScaleIndex(scale)][fast ? 1 : 0];
+  const float per_pixel = cost.load(std::memory_order_relaxed);
+  return std::chrono::nanoseconds(
+      static_cast<int64_t>(per_pixel * static_cast<double>(width) * height));
+}
+
+void DecodeCostModel::Record(ImageFormat format, uint32_t width, uint32_t height, uint32_t scale,
+                             bool fast, std::chrono::nanoseconds took) {
+  const uint64_t pixels = static_cast<uint64_t>(width) * height;
+  if (pixels == 0) return;
+  std::atomic<float>& cost = ns_per_pixel_[FormatIndex(format)][ScaleIndex(scale)][fast ? 1 : 0];
+  const float sample = static_cast<float>(static_cast<double>(took.count()) / pixels);
+  const float current = cost.load(std::memory_order_relaxed);
+  cost.store(current + (sample - current) * kCostSmoothing, std::memory_order_relaxed);
+}
+
+bool DecodeCostModel::ProbeDue(ImageFormat format) {
+  const uint32_t count =
+      degraded_[FormatIndex(format)].fetch_add(1, std::memory_order_relaxed) + 1;
+  return count % kProbeInterval == 0;
+}
+
+}  // namespace vibe
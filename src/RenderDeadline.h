@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ImageFormat.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace vibe {
+
+// How a render with a deadline was settled, from the best result to the cheapest.
+enum class RenderTier {
+  // The source the size request calls for, decoded and scaled as usual.
+  kFull,
+  // A smaller payload than that one, or the only one found before reading ran out of time.
+  kSmallerSource,
+  // Decoded at a fraction of its size (JPEG DCT scaling) and scaled up to the thumbnail size.
+  kReducedDecode,
+  // Scaled with two taps per axis instead of averaging every source pixel.
+  kFastScale,
+  // Nothing was expected to finish in time, so the cheapest of the above ran anyway.
+  kOverrun,
+  kCount,
+};
+
+constexpr size_t kRenderTierCount = static_cast<size_t>(RenderTier::kCount);
+
+const char* RenderTierName(RenderTier tier);
+
+// Renders settled at each tier since the process started, over every thread.
+void SnapshotRenderTierCounters(uint64_t (&counters)[kRenderTierCount]);
+void CountRenderTier(RenderTier tier);
+
+// Predicts how long decoding and scaling an image takes, per source pixel, for each format, decode
+// scale and filter. Starts from figures measured with the portable decoder and follows the renders
+// it is told about, so it settles on what the decoder in use costs on this machine. Safe to share
+// between threads; concurrent updates may drop one another's samples.
+class DecodeCostModel {
+ public:
+  DecodeCostModel();
+
+  // Time to decode a |width| x |height| |format| image at 1/|scale| and scale it, with the fast
+  // filter when |fast| is set.
+  std::chrono::nanoseconds Estimate(ImageFormat format, uint32_t width, uint32_t height,
+                                    uint32_t scale, bool fast) const;
+  void Record(ImageFormat format, uint32_t width, uint32_t height, uint32_t scale, bool fast,
+              std::chrono::nanoseconds took);
+
+  // Called whenever a |format| render is planned below full although the full one is estimated
+  // to take at most kProbeOverrun times the time left. True every kProbeInterval calls: the full
+  // render then runs anyway, so an estimate only ever ruled out, and never measured, can come
+  // back down. Costs are per pixel, so a smaller image probes for a larger one the probe skips.
+  bool ProbeDue(ImageFormat format);
+
+  static constexpr uint32_t kProbeInterval = 16;
+  static constexpr int kProbeOverrun = 2;
+
+ private:
+  static constexpr size_t kFormats = 3;
+  static constexpr size_t kScales = 4;
+
+  std::atomic<float> ns_per_pixel_[kFormats][kScales][2];
+  std::atomic<uint32_t> degraded_[kFormats] = {};
+};
+
+// Bounds a whole render in time. Reading stops |decode_reserve| before |deadline| so there is
+// time left to decode whatever was found, once something has been; the decode is then planned
+// from |costs| to finish in time, stepping down through the RenderTiers as needed. Without a
+// |costs| model, or with the default |deadline|, renders are not timed.
+struct RenderDeadline {
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+  std::chrono::steady_clock::duration decode_reserve = std::chrono::milliseconds(50);
+  DecodeCostModel* costs = nullptr;
+
+  bool enabled() const {
+    return costs && deadline != std::chrono::steady_clock::time_point::max();
+  }
+};
+
+}  // namespace vibe
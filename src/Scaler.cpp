@@ -0,0 +1,541 @@
+#include "Scaler.h"
+
+#include "CpuFeatures.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(VIBE_ARCH_X86)
+#include <immintrin.h>
+#endif
+
+namespace vibe {
+namespace {
+
+constexpr float kInv255 = 1.0f / 255.0f;
+
+// All kernels perform the same float operations in the same order, so every dispatch level
+// produces bit-identical output.
+
+uint32_t LoadPixel(const uint8_t* pixel) {
+  uint32_t value = 0;
+  std::memcpy(&value, pixel, sizeof(value));
+  return value;
+}
+
+void HorizontalScalar(const uint8_t* row, const uint32_t* start, const float* weights,
+                      uint32_t taps, uint32_t dest_width, float* out) {
+  for (uint32_t x = 0; x < dest_width; ++x) {
+    const uint8_t* pixel = row + static_cast<size_t>(start[x]) * 4;
+    const float* w = weights + static_cast<size_t>(x) * taps;
+    float b = 0.0f;
+    float g = 0.0f;
+    float r = 0.0f;
+    float a = 0.0f;
+    for (uint32_t t = 0; t < taps; ++t, pixel += 4) {
+      const float alpha = pixel[3];
+      const float scale = w[t] * (alpha * kInv255);
+      b += scale * pixel[0];
+      g += scale * pixel[1];
+      r += scale * pixel[2];
+      a += w[t] * alpha;
+    }
+    out[x * 4] = b;
+    out[x * 4 + 1] = g;
+    out[x * 4 + 2] = r;
+    out[x * 4 + 3] = a;
+  }
+}
+
+// Same sums as HorizontalScalar for rows whose alpha is all 255, where premultiplying multiplies
+// by exactly 1.0f and can be left out.
+void HorizontalOpaqueScalar(const uint8_t* row, const uint32_t* start, const float* weights,
+                            uint32_t taps, uint32_t dest_width, float* out) {
+  for (uint32_t x = 0; x < dest_width; ++x) {
+    const uint8_t* pixel = row + static_cast<size_t>(start[x]) * 4;
+    const float* w = weights + static_cast<size_t>(x) * taps;
+    float sum[4] = {};
+    for (uint32_t t = 0; t < taps; ++t, pixel += 4) {
+      for (int c = 0; c < 4; ++c) sum[c] += w[t] * pixel[c];
+    }
+    std::memcpy(out + x * 4, sum, sizeof(sum));
+  }
+}
+
+void AccumulateScalar(float* accumulator, const float* row, float weight, size_t count) {
+  for (size_t i = 0; i < count; ++i) accumulator[i] += weight * row[i];
+}
+
+void EmitScalar(const float* accumulator, uint32_t dest_width, uint8_t* out) {
+  for (uint32_t x = 0; x < dest_width; ++x) {
+    const float* pixel = accumulator + x * 4;
+    const int alpha = static_cast<int>(pixel[3] + 0.5f);
+    for (int c = 0; c < 3; ++c) {
+      const int value = std::min(static_cast<int>(pixel[c] + 0.5f), alpha);
+      out[x * 4 + c] = static_cast<uint8_t>(std::clamp(value, 0, 255));
+    }
+    out[x * 4 + 3] = static_cast<uint8_t>(std::clamp(alpha, 0, 255));
+  }
+}
+
+bool IsOpaqueRowScalar(const uint8_t* row, uint32_t width) {
+  uint8_t all = 255;
+  for (uint32_t x = 0; x < width; ++x) all &= row[x * 4 + 3];
+  return all == 255;
+}
+
+#if defined(VIBE_ARCH_X86)
+VIBE_TARGET("sse4.1")
+__m128 WeightPixelSse41(const uint8_t* pixel, float weight) {
+  const __m128 value =
+      _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(LoadPixel(pixel)))));
+  const __m128 alpha = _mm_shuffle_ps(value, value, _MM_SHUFFLE(3, 3, 3, 3));
+  const __m128 premultiply = _mm_blend_ps(_mm_mul_ps(alpha, _mm_set1_ps(kInv255)),
+                                          _mm_set1_ps(1.0f), 0x8);
+  return _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(weight), premultiply), value);
+}
+
+VIBE_TARGET("sse4.1")
+void HorizontalSse41(const uint8_t* row, const uint32_t* start, const float* weights,
+                     uint32_t taps, uint32_t dest_width, float* out) {
+  for (uint32_t x = 0; x < dest_width; ++x) {
+    const uint8_t* pixel = row + static_cast<size_t>(start[x]) * 4;
+    const float* w = weights + static_cast<size_t>(x) * taps;
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t, pixel += 4) {
+      sum = _mm_add_ps(sum, WeightPixelSse41(pixel, w[t]));
+    }
+    _mm_storeu_ps(out + x * 4, sum);
+  }
+}
+
+VIBE_TARGET("sse4.1")
+void HorizontalOpaqueSse41(const uint8_t* row, const uint32_t* start, const float* weights,
+                           uint32_t taps, uint32_t dest_width, float* out) {
+  for (uint32_t x = 0; x < dest_width; ++x) {
+    const uint8_t* pixel = row + static_cast<size_t>(start[x]) * 4;
+    const float* w = weights + static_cast<size_t>(x) * taps;
+    __m128 sum = _mm_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t, pixel += 4) {
+      const __m128 value = _mm_cvtepi32_ps(
+          _mm_cvtepu8_epi32(_mm_cvtsi32_si128(static_cast<int>(LoadPixel(pixel)))));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w[t]), value));
+    }
+    _mm_storeu_ps(out + x * 4, sum);
+  }
+}
+
+VIBE_TARGET("sse4.1")
+void AccumulateSse41(float* accumulator, const float* row, float weight, size_t count) {
+  const __m128 w = _mm_set1_ps(weight);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    const __m128 sum = _mm_add_ps(_mm_loadu_ps(accumulator + i),
+                                  _mm_mul_ps(w, _mm_loadu_ps(row + i)));
+    _mm_storeu_ps(accumulator + i, sum);
+  }
+  AccumulateScalar(accumulator + i, row + i, weight, count - i);
+}
+
+VIBE_TARGET("sse4.1")
+__m128i RoundPixelSse41(const float* pixel) {
+  const __m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(pixel), _mm_set1_ps(0.5f)));
+  return _mm_min_epi32(value, _mm_shuffle_epi32(value, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+VIBE_TARGET("sse4.1")
+void EmitSse41(const float* accumulator, uint32_t dest_width, uint8_t* out) {
+  uint32_t x = 0;
+  for (; x + 4 <= dest_width; x += 4) {
+    const __m128i lo = _mm_packus_epi32(RoundPixelSse41(accumulator + x * 4),
+                                        RoundPixelSse41(accumulator + x * 4 + 4));
+    const __m128i hi = _mm_packus_epi32(RoundPixelSse41(accumulator + x * 4 + 8),
+                                        RoundPixelSse41(accumulator + x * 4 + 12));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(lo, hi));
+  }
+  EmitScalar(accumulator + x * 4, dest_width - x, out + x * 4);
+}
+
+VIBE_TARGET("avx2")
+void HorizontalAvx2(const uint8_t* row, const uint32_t* start, const float* weights,
+                    uint32_t taps, uint32_t dest_width, float* out) {
+  const __m256 inv255 = _mm256_set1_ps(kInv255);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  uint32_t x = 0;
+  // Two destination pixels per iteration, one in each 128-bit lane.
+  for (; x + 2 <= dest_width; x += 2) {
+    const uint8_t* first = row + static_cast<size_t>(start[x]) * 4;
+    const uint8_t* second = row + static_cast<size_t>(start[x + 1]) * 4;
+    const float* w0 = weights + static_cast<size_t>(x) * taps;
+    const float* w1 = w0 + taps;
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t, first += 4, second += 4) {
+      const __m128i packed =
+          _mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(LoadPixel(first))),
+                             _mm_cvtsi32_si128(static_cast<int>(LoadPixel(second))));
+      const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(packed));
+      const __m256 alpha = _mm256_permute_ps(value, _MM_SHUFFLE(3, 3, 3, 3));
+      const __m256 premultiply = _mm256_blend_ps(_mm256_mul_ps(alpha, inv255), one, 0x88);
+      const __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[t])),
+                                                 _mm_set1_ps(w1[t]), 1);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_mul_ps(weight, premultiply), value));
+    }
+    _mm256_storeu_ps(out + x * 4, sum);
+  }
+  HorizontalSse41(row, start + x, weights + static_cast<size_t>(x) * taps, taps, dest_width - x,
+                  out + x * 4);
+}
+
+VIBE_TARGET("avx2")
+void HorizontalOpaqueAvx2(const uint8_t* row, const uint32_t* start, const float* weights,
+                          uint32_t taps, uint32_t dest_width, float* out) {
+  uint32_t x = 0;
+  for (; x + 2 <= dest_width; x += 2) {
+    const uint8_t* first = row + static_cast<size_t>(start[x]) * 4;
+    const uint8_t* second = row + static_cast<size_t>(start[x + 1]) * 4;
+    const float* w0 = weights + static_cast<size_t>(x) * taps;
+    const float* w1 = w0 + taps;
+    __m256 sum = _mm256_setzero_ps();
+    for (uint32_t t = 0; t < taps; ++t, first += 4, second += 4) {
+      const __m128i packed =
+          _mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(LoadPixel(first))),
+                             _mm_cvtsi32_si128(static_cast<int>(LoadPixel(second))));
+      const __m256 value = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(packed));
+      const __m256 weight = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(w0[t])),
+                                                 _mm_set1_ps(w1[t]), 1);
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(weight, value));
+    }
+    _mm256_storeu_ps(out + x * 4, sum);
+  }
+  HorizontalOpaqueSse41(row, start + x, weights + static_cast<size_t>(x) * taps, taps,
+                        dest_width - x, out + x * 4);
+}
+
+VIBE_TARGET("avx2")
+void AccumulateAvx2(float* accumulator, const float* row, float weight, size_t count) {
+  const __m256 w = _mm256_set1_ps(weight);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const __m256 sum = _mm256_add_ps(_mm256_loadu_ps(accumulator + i),
+                                     _mm256_mul_ps(w, _mm256_loadu_ps(row + i)));
+    _mm256_storeu_ps(accumulator + i, sum);
+  }
+  AccumulateScalar(accumulator + i, row + i, weight, count - i);
+}
+
+VIBE_TARGET("sse2")
+bool IsOpaqueRowSse2(const uint8_t* row, uint32_t width) {
+  const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+  __m128i all = _mm_set1_epi32(-1);
+  uint32_t x = 0;
+  for (; x + 4 <= width; x += 4) {
+    all = _mm_and_si128(all, _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x * 4)));
+  }
+  const __m128i opaque = _mm_cmpeq_epi32(_mm_and_si128(all, alpha), alpha);
+  return _mm_movemask_epi8(opaque) == 0xFFFF && IsOpaqueRowScalar(row + x * 4, width - x);
+}
+
+VIBE_TARGET("avx2")
+bool IsOpaqueRowAvx2(const uint8_t* row, uint32_t width) {
+  const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+  __m256i all = _mm256_set1_epi32(-1);
+  uint32_t x = 0;
+  for (; x + 8 <= width; x += 8) {
+    all = _mm256_and_si256(all,
+                           _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x * 4)));
+  }
+  const __m256i opaque = _mm256_cmpeq_epi32(_mm256_and_si256(all, alpha), alpha);
+  return _mm256_movemask_epi8(opaque) == -1 && IsOpaqueRowSse2(row + x * 4, width - x);
+}
+#endif
+
+}  // namespace
+
+ImageSize ComputeThumbnailSize(uint32_t width, uint32_t height, uint32_t cx) {
+  ImageSize size{width, height};
+  if (std::max(width, height) > cx && cx > 0) {
+    if (width >= height) {
+      size.width = cx;
+      size.height = static_cast<uint32_t>(static_cast<uint64_t>(height) * cx / width);
+    } else {
+      size.height = cx;
+      size.width = static_cast<uint32_t>(static_cast<uint64_t>(width) * cx / height);
+    }
+
+    size.width = std::max(1u, size.width);
+    size.height = std::max(1u, size.height);
+  }
+  return size;
+}
+
+void BgraScaler::BuildAxis(uint32_t source, uint32_t dest, ScaleFilter filter, Axis* axis) {
+  const bool area = filter == ScaleFilter::kAreaAverage;
+  const double scale = static_cast<double>(source) / dest;
+  const double support = filter == ScaleFilter::kFast ? 1.0 : std::max(1.0, scale);
+
+  std::vector<uint32_t> first(dest);
+  std::vector<double> raw;
+  std::vector<uint32_t> offsets(dest + 1);
+  // Each output takes at most this many taps, so |raw| is allocated once.
+  raw.reserve(static_cast<size_t>(dest) * (2 * static_cast<size_t>(std::ceil(support)) + 2));
+  uint32_t taps = 1;
+  for (uint32_t o = 0; o < dest; ++o) {
+    offsets[o] = static_cast<uint32_t>(raw.size());
+    int64_t lo = 0;
+    int64_t hi = 0;
+    double center = 0.0;
+    if (area) {
+      lo = static_cast<int64_t>(std::floor(o * scale));
+      hi = static_cast<int64_t>(std::ceil((o + 1) * scale)) - 1;
+    } else {
+      center = (o + 0.5) * scale - 0.5;
+      lo = static_cast<int64_t>(std::floor(center - support)) + 1;
+      hi = static_cast<int64_t>(std::ceil(center + support)) - 1;
+    }
+    lo = std::clamp<int64_t>(lo, 0, source - 1);
+    hi = std::clamp<int64_t>(hi, lo, source - 1);
+
+    double total = 0.0;
+    for (int64_t i = lo; i <= hi; ++i) {
+      double weight = 0.0;
+      if (area) {
+        weight = std::min<double>(i + 1, (o + 1) * scale) - std::max<double>(i, o * scale);
+      } else {
+        weight = 1.0 - std::abs(i - center) / support;
+      }
+      weight = std::max(0.0, weight);
+      raw.push_back(weight);
+      total += weight;
+    }
+    if (total <= 0.0) {
+      raw.back() = 1.0;
+      total = 1.0;
+    }
+    for (size_t i = offsets[o]; i < raw.size(); ++i) raw[i] /= total;
+
+    first[o] = static_cast<uint32_t>(lo);
+    taps = std::max(taps, static_cast<uint32_t>(hi - lo + 1));
+  }
+  offsets[dest] = static_cast<uint32_t>(raw.size());
+
+  axis->taps = taps;
+  axis->start.assign(dest, 0);
+  axis->weights.assign(static_cast<size_t>(dest) * taps, 0.0f);
+  for (uint32_t o = 0; o < dest; ++o) {
+    const uint32_t start = std::min(first[o], source - taps);
+    axis->start[o] = start;
+    float* weights = axis->weights.data() + static_cast<size_t>(o) * taps + (first[o] - start);
+    for (uint32_t i = offsets[o]; i < offsets[o + 1]; ++i) {
+      *weights++ = static_cast<float>(raw[i]);
+    }
+  }
+}
+
+uint64_t BgraScaler::EstimateBytes(uint32_t source_width, uint32_t source_height,
+                                   uint32_t dest_width, uint32_t dest_height) {
+  if (source_width == 0 || source_height == 0 || dest_width == 0 || dest_height == 0) return 0;
+  // BuildAxis reserves this many taps per output, as doubles, next to the final float weights and
+  // three index arrays.
+  const auto max_taps = [](uint32_t source, uint32_t dest) {
+    const double support = std::max(1.0, static_cast<double>(source) / dest);
+    return 2 * static_cast<uint64_t>(std::ceil(support)) + 2;
+  };
+  const auto axis_bytes = [&](uint32_t source, uint32_t dest) {
+    return dest * (max_taps(source, dest) * (sizeof(double) + sizeof(float)) +
+                   3 * sizeof(uint32_t));
+  };
+  // Open destination rows are those whose windows overlap one source row.
+  const uint64_t vertical_taps = max_taps(source_height, dest_height);
+  const uint64_t ring_rows =
+      std::min<uint64_t>(dest_height, vertical_taps * dest_height / source_height + 2);
+  const uint64_t row_bytes = static_cast<uint64_t>(dest_width) * 4 * sizeof(float);
+  return axis_bytes(source_width, dest_width) + axis_bytes(source_height, dest_height) +
+         row_bytes * (ring_rows + 1);
+}
+
+bool BgraScaler::Init(uint32_t source_width, uint32_t source_height, uint8_t* dest,
+                      uint32_t dest_width, uint32_t dest_height, size_t dest_stride,
+                      ScaleFilter filter, bool opaque) {
+  if (!dest || source_width == 0 || source_height == 0 || dest_width == 0 ||
+      dest_height == 0 || dest_stride < static_cast<size_t>(dest_width) * 4) {
+    return false;
+  }
+
+  const bool reduce_2x = source_width >= dest_width * 2ull && source_height >= dest_height * 2ull;
+  if (filter == ScaleFilter::kAuto) {
+    filter = reduce_2x ? ScaleFilter::kAreaAverage : ScaleFilter::kBilinear;
+  }
+  BuildAxis(source_width, dest_width, filter, &horizontal_);
+  BuildAxis(source_height, dest_height, filter, &vertical_);
+
+  // Destination rows whose source windows overlap are accumulated at the same time; the ring
+  // holds as many of them as can be open at once.
+  ring_rows_ = 1;
+  uint32_t oldest_open = 0;
+  for (uint32_t o = 0; o < dest_height; ++o) {
+    while (vertical_.start[oldest_open] + vertical_.taps <= vertical_.start[o]) ++oldest_open;
+    ring_rows_ = std::max(ring_rows_, o - oldest_open + 1);
+  }
+
+  source_width_ = source_width;
+  source_height_ = source_height;
+  dest_ = dest;
+  dest_width_ = dest_width;
+  dest_height_ = dest_height;
+  dest_stride_ = dest_stride;
+  opaque_ = opaque;
+  row_.assign(static_cast<size_t>(dest_width) * 4, 0.0f);
+  accumulators_.assign(static_cast<size_t>(ring_rows_) * dest_width * 4, 0.0f);
+  next_source_row_ = 0;
+  next_dest_row_ = 0;
+  return true;
+}
+
+void BgraScaler::PushRow(const uint8_t* row) {
+  if (done()) return;
+  Horizontal(row, row_.data());
+  Accumulate(row_.data());
+}
+
+void BgraScaler::PushRows(const uint8_t* rows, size_t stride, uint32_t count,
+                          WorkStealingPool* pool) {
+  count = std::min(count, source_height_ - next_source_row_);
+  if (!pool || count < 2) {
+    for (uint32_t i = 0; i < count; ++i) PushRow(rows + i * stride);
+    return;
+  }
+
+  // The horizontal pass is most of the work and independent per row, so bands of rows go to the
+  // pool; the vertical pass then takes the results in order, exactly as PushRow would.
+  const size_t row_floats = static_cast<size_t>(dest_width_) * 4;
+  if (band_rows_.size() < count * row_floats) band_rows_.resize(count * row_floats);
+  const uint32_t bands = std::min<uint32_t>(count, pool->size() * 2);
+  pool->ParallelFor(bands, [&](size_t band) {
+    const uint32_t first = static_cast<uint32_t>(band * count / bands);
+    const uint32_t last = static_cast<uint32_t>((band + 1) * count / bands);
+    for (uint32_t i = first; i < last; ++i) {
+      Horizontal(rows + i * stride, band_rows_.data() + i * row_floats);
+    }
+  });
+  for (uint32_t i = 0; i < count; ++i) Accumulate(band_rows_.data() + i * row_floats);
+}
+
+void BgraScaler::Horizontal(const uint8_t* row, float* out) const {
+  const uint32_t* start = horizontal_.start.data();
+  const float* weights = horizontal_.weights.data();
+  const uint32_t taps = horizontal_.taps;
+#if defined(VIBE_ARCH_X86)
+  const SimdLevel level = ActiveSimdLevel();
+  if (level >= SimdLevel::kAvx2) {
+    (opaque_ ? HorizontalOpaqueAvx2 : HorizontalAvx2)(row, start, weights, taps, dest_width_, out);
+    return;
+  }
+  if (level >= SimdLevel::kSse41) {
+    (opaque_ ? HorizontalOpaqueSse41 : HorizontalSse41)(row, start, weights, taps, dest_width_,
+                                                          out);
+    return;
+  }
+#endif
+  (opaque_ ? HorizontalOpaqueScalar : HorizontalScalar)(row, start, weights, taps, dest_width_,
+                                                          out);
+}
+
+void BgraScaler::Accumulate(const float* horizontal) {
+  const SimdLevel level = ActiveSimdLevel();
+  const size_t row_floats = static_cast<size_t>(dest_width_) * 4;
+  const uint32_t y = next_source_row_;
+  for (uint32_t o = next_dest_row_; o < dest_height_ && vertical_.start[o] <= y; ++o) {
+    const uint32_t tap = y - vertical_.start[o];
+    if (tap >= vertical_.taps) continue;
+    const float weight = vertical_.weights[static_cast<size_t>(o) * vertical_.taps + tap];
+    if (weight == 0.0f) continue;
+
+    float* accumulator = accumulators_.data() + (o % ring_rows_) * row_floats;
+#if defined(VIBE_ARCH_X86)
+    if (level >= SimdLevel::kAvx2) {
+      AccumulateAvx2(accumulator, horizontal, weight, row_floats);
+      continue;
+    }
+    if (level >= SimdLevel::kSse41) {
+      AccumulateSse41(accumulator, horizontal, weight, row_floats);
+      continue;
+    }
+#endif
+    AccumulateScalar(accumulator, horizontal, weight, row_floats);
+  }
+
+  ++next_source_row_;
+  while (next_dest_row_ < dest_height_ &&
+         vertical_.start[next_dest_row_] + vertical_.taps <= next_source_row_) {
+    EmitRow(next_dest_row_++);
+  }
+}
+
+void BgraScaler::EmitRow(uint32_t dest_row) {
+  const size_t row_floats = static_cast<size_t>(dest_width_) * 4;
+  float* accumulator = accumulators_.data() + (dest_row % ring_rows_) * row_floats;
+  uint8_t* out = dest_ + static_cast<size_t>(dest_row) * dest_stride_;
+#if defined(VIBE_ARCH_X86)
+  if (ActiveSimdLevel() >= SimdLevel::kSse41) {
+    EmitSse41(accumulator, dest_width_, out);
+  } else
+#endif
+  {
+    EmitScalar(accumulator, dest_width_, out);
+  }
+  std::fill(accumulator, accumulator + row_floats, 0.0f);
+}
+
+bool ScaleToPremultipliedBgra(const uint8_t* source, uint32_t source_width,
+                              uint32_t source_height, size_t source_stride, uint8_t* dest,
+                              uint32_t dest_width, uint32_t dest_height, size_t dest_stride,
+                              ScaleFilter filter) {
+  if (!source || source_stride < static_cast<size_t>(source_width) * 4) return false;
+
+  BgraScaler scaler;
+  if (!scaler.Init(source_width, source_height, dest, dest_width, dest_height, dest_stride,
+                   filter)) {
+    return false;
+  }
+  for (uint32_t y = 0; y < source_height; ++y) {
+    scaler.PushRow(source + static_cast<size_t>(y) * source_stride);
+  }
+  return scaler.done();
+}
+
+bool IsOpaqueBgra(const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride) {
+  const SimdLevel level = ActiveSimdLevel();
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t* row = pixels + y * stride;
+#if defined(VIBE_ARCH_X86)
+    if (level >= SimdLevel::kAvx2) {
+      if (!IsOpaqueRowAvx2(row, width)) return false;
+      continue;
+    }
+    if (level >= SimdLevel::kSse2) {
+      if (!IsOpaqueRowSse2(row, width)) return false;
+      continue;
+    }
+#endif
+    if (!IsOpaqueRowScalar(row, width)) return false;
+  }
+  return true;
+}
+
+void UnpremultiplyBgraRow(const uint8_t* in, uint32_t width, uint8_t* out) {
+  for (uint32_t x = 0; x < width; ++x, in += 4, out += 4) {
+    const uint32_t alpha = in[3];
+    if (alpha == 255 || alpha == 0) {
+      std::memcpy(out, in, 4);
+      continue;
+    }
+    for (int c = 0; c < 3; ++c) {
+      out[c] = static_cast<uint8_t>(std::min<uint32_t>(255, (in[c] * 255 + alpha / 2) / alpha));
+    }
+    out[3] = static_cast<uint8_t>(alpha);
+  }
+}
+
+}  // namespace vibe
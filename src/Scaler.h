@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vibe {
+
+class WorkStealingPool;
+
+struct ImageSize {
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+// Output size for a |cx| request: the long edge shrinks to |cx| and the short edge follows the
+// aspect ratio (rounded down, at least 1). Images already within |cx| keep their size.
+ImageSize ComputeThumbnailSize(uint32_t width, uint32_t height, uint32_t cx);
+
+enum class ScaleFilter {
+  kAuto,
+  kAreaAverage,
+  kBilinear,
+  // Bilinear between the two nearest source pixels whatever the reduction: much cheaper than
+  // averaging for large reductions, at the price of aliasing.
+  kFast,
+};
+
+// Resamples straight-alpha BGRA rows into premultiplied BGRA in a single pass: every source pixel
+// is premultiplied as it is weighted, so no intermediate image exists. Rows are pushed top to
+// bottom and each destination row is written as soon as its last source row has arrived. kAuto
+// area-averages reductions of 2x or more and uses a bilinear (triangle) filter below that.
+class BgraScaler {
+ public:
+  // |opaque| promises every source pixel has alpha 255, as for formats without an alpha channel;
+  // premultiplying is then skipped, with the same output.
+  bool Init(uint32_t source_width, uint32_t source_height, uint8_t* dest, uint32_t dest_width,
+            uint32_t dest_height, size_t dest_stride, ScaleFilter filter = ScaleFilter::kAuto,
+            bool opaque = false);
+
+  // Upper bound of the heap memory Init() takes for these sizes, for callers that budget before
+  // committing to a decode.
+  static uint64_t EstimateBytes(uint32_t source_width, uint32_t source_height,
+                                uint32_t dest_width, uint32_t dest_height);
+
+  // Consumes the next source row of |source_width| straight-alpha BGRA pixels.
+  void PushRow(const uint8_t* row);
+  // Consumes the next |count| rows, |stride| bytes apart. With a |pool|, their horizontal passes
+  // run concurrently in bands; the output is bit-identical to pushing them one at a time.
+  void PushRows(const uint8_t* rows, size_t stride, uint32_t count, WorkStealingPool* pool);
+
+  bool done() const { return next_source_row_ == source_height_; }
+
+ private:
+  // Per destination pixel, |taps| weights over source indices [start, start + taps). Windows are
+  // shifted to stay inside the source so every entry has exactly |taps| (possibly zero) weights.
+  struct Axis {
+    std::vector<uint32_t> start;
+    std::vector<float> weights;
+    uint32_t taps = 0;
+  };
+
+  // |filter| is kAreaAverage, kBilinear or kFast.
+  static void BuildAxis(uint32_t source, uint32_t dest, ScaleFilter filter, Axis* axis);
+  // Resamples one source row across into |dest_width_| premultiplied float pixels.
+  void Horizontal(const uint8_t* row, float* out) const;
+  // Adds a horizontally resampled row into the destination rows it touches and emits those it
+  // completes.
+  void Accumulate(const float* horizontal);
+  void EmitRow(uint32_t dest_row);
+
+  uint32_t source_width_ = 0;
+  uint32_t source_height_ = 0;
+  uint8_t* dest_ = nullptr;
+  uint32_t dest_width_ = 0;
+  uint32_t dest_height_ = 0;
+  size_t dest_stride_ = 0;
+  bool opaque_ = false;
+
+  Axis horizontal_;
+  Axis vertical_;
+  std::vector<float> row_;
+  // Horizontal results of a PushRows() batch.
+  std::vector<float> band_rows_;
+  // Ring of vertical accumulators for destination rows still waiting for source rows.
+  std::vector<float> accumulators_;
+  uint32_t ring_rows_ = 0;
+  uint32_t next_source_row_ = 0;
+  uint32_t next_dest_row_ = 0;
+};
+
+// Convenience wrapper that pushes a whole straight-alpha BGRA image through a BgraScaler.
+bool ScaleToPremultipliedBgra(const uint8_t* source, uint32_t source_width,
+                              uint32_t source_height, size_t source_stride, uint8_t* dest,
+                              uint32_t dest_width, uint32_t dest_height, size_t dest_stride,
+                              ScaleFilter filter = ScaleFilter::kAuto);
+
+// True when every pixel of the |width| x |height| BGRA image has alpha 255. Bytes past the end of
+// each row are not looked at; the scan stops at the first row that has a translucent pixel.
+bool IsOpaqueBgra(const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+
+// Turns a row of premultiplied BGRA, as the scaler writes it, back into straight alpha, as the
+// scaler and the PNG encoder take it. |in| and |out| may be the same row.
+void UnpremultiplyBgraRow(const uint8_t* in, uint32_t width, uint8_t* out);
+
+}  // namespace vibe
@@ -0,0 +1,116 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace vibe {
+namespace {
+
+constexpr size_t kMinChunkBytes = size_t{256} << 10;
+
+size_t RoundUp(size_t size, size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+}  // namespace
+
+ScratchArena& ScratchArena::ForCurrentThread() {
+  thread_local ScratchArena arena;
+  return arena;
+}
+
+size_t ScratchArena::reserved_bytes() const {
+  size_t total = 0;
+  for (size_t i = 0; i < chunk_count_; ++i) total += chunks_[i].size;
+  return total;
+}
+
+bool ScratchArena::AddChunk(size_t size) {
+  if (chunk_count_ == kMaxChunks || size > std::numeric_limits<size_t>::max() - kAlignment) {
+    return false;
+  }
+  Chunk& chunk = chunks_[chunk_count_];
+  chunk.memory.reset(new (std::nothrow) uint8_t[size + kAlignment - 1]);
+  if (!chunk.memory) return false;
+  const uintptr_t address = reinterpret_cast<uintptr_t>(chunk.memory.get());
+  chunk.base = chunk.memory.get() + (RoundUp(address, kAlignment) - address);
+  chunk.size = size;
+  chunk.used = 0;
+  ++chunk_count_;
+  return true;
+}
+
+void* ScratchArena::Allocate(size_t size) {
+  if (size > std::numeric_limits<size_t>::max() - kAlignment) return nullptr;
+  size = RoundUp(std::max<size_t>(size, 1), kAlignment);
+
+  // Chunks past |current_| are empty; move on to the first one with room.
+  while (current_ < chunk_count_ && chunks_[current_].size - chunks_[current_].used < size) {
+    if (current_ + 1 == chunk_count_) break;
+    ++current_;
+  }
+  if (current_ >= chunk_count_ || chunks_[current_].size - chunks_[current_].used < size) {
+    if (!AddChunk(std::max({size, reserved_bytes(), kMinChunkBytes}))) return nullptr;
+    current_ = chunk_count_ - 1;
+  }
+
+  Chunk& chunk = chunks_[current_];
+  void* block = chunk.base + chunk.used;
+  chunk.used += size;
+  in_use_ += size;
+  peak_ = std::max(peak_, in_use_);
+  scope_peak_ = std::max(scope_peak_, in_use_);
+  return block;
+}
+
+bool ScratchArena::Extend(void* block, size_t old_size, size_t new_size) {
+  if (chunk_count_ == 0 || new_size < old_size ||
+      new_size > std::numeric_limits<size_t>::max() - kAlignment) {
+    return false;
+  }
+  Chunk& chunk = chunks_[current_];
+  const size_t old_rounded = RoundUp(std::max<size_t>(old_size, 1), kAlignment);
+  const size_t new_rounded = RoundUp(std::max<size_t>(new_size, 1), kAlignment);
+  if (chunk.used < old_rounded || block != chunk.base + chunk.used - old_rounded) return false;
+  if (new_rounded - old_rounded > chunk.size - chunk.used) return false;
+
+  chunk.used += new_rounded - old_rounded;
+  in_use_ += new_rounded - old_rounded;
+  peak_ = std::max(peak_, in_use_);
+  scope_peak_ = std::max(scope_peak_, in_use_);
+  return true;
+}
+
+void ScratchArena::Rewind(size_t chunk, size_t used, size_t in_use) {
+  for (size_t i = chunk + 1; i < chunk_count_; ++i) chunks_[i].used = 0;
+  if (chunk < chunk_count_) chunks_[chunk].used = used;
+  current_ = chunk;
+  in_use_ = in_use;
+}
+
+void ScratchArena::Trim() {
+  if (in_use_ != 0 || chunk_count_ == 0) return;
+  if (chunk_count_ == 1 && chunks_[0].size <= kRetainedBytes) return;
+
+  // Replace the chunks with one that fits the whole call, unless the call was too large to keep
+  // memory for.
+  for (size_t i = 0; i < chunk_count_; ++i) chunks_[i] = Chunk();
+  chunk_count_ = 0;
+  current_ = 0;
+  if (scope_peak_ <= kRetainedBytes) AddChunk(RoundUp(scope_peak_, kMinChunkBytes));
+}
+
+ScratchArena::Scope::Scope(ScratchArena& arena)
+    : arena_(arena),
+      chunk_(arena.current_),
+      used_(arena.current_ < arena.chunk_count_ ? arena.chunks_[arena.current_].used : 0),
+      in_use_(arena.in_use_) {
+  if (arena_.depth_++ == 0) arena_.scope_peak_ = arena_.in_use_;
+}
+
+ScratchArena::Scope::~Scope() {
+  arena_.Rewind(chunk_, used_, in_use_);
+  if (--arena_.depth_ == 0) arena_.Trim();
+}
+
+}  // namespace vibe
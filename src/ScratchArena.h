@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace vibe {
+
+// Bump allocator a thread keeps between thumbnails, so the file buffer, the decoded payload and
+// decoder temporaries stop going through the heap on every call. Allocations are released
+// together when the Scope they were made in closes.
+class ScratchArena {
+ public:
+  // What a thread keeps once its outermost scope closes. Calls that need more get temporary
+  // chunks, returned to the heap at the end of the call.
+  static constexpr size_t kRetainedBytes = size_t{16} << 20;
+  static constexpr size_t kAlignment = 64;
+
+  ScratchArena() = default;
+  ScratchArena(const ScratchArena&) = delete;
+  ScratchArena& operator=(const ScratchArena&) = delete;
+
+  static ScratchArena& ForCurrentThread();
+
+  // Uninitialized, |kAlignment|-aligned memory, or null when it cannot be had.
+  void* Allocate(size_t size);
+
+  template <typename T>
+  T* AllocateArray(size_t count) {
+    if (count > std::numeric_limits<size_t>::max() / sizeof(T)) return nullptr;
+    return static_cast<T*>(Allocate(count * sizeof(T)));
+  }
+
+  // Grows |block|, the most recent allocation, from |old_size| to |new_size| without moving it.
+  // Returns false when the chunk has no room; |block| is then unchanged.
+  bool Extend(void* block, size_t old_size, size_t new_size);
+
+  // Bytes handed out at most at once since the last ResetPeak().
+  size_t peak_bytes() const { return peak_; }
+  void ResetPeak() { peak_ = in_use_; }
+  size_t reserved_bytes() const;
+
+  // Everything allocated while a scope is open is released when it closes. Scopes nest; closing
+  // the outermost one also trims the arena to at most |kRetainedBytes| in a single chunk.
+  class Scope {
+   public:
+    explicit Scope(ScratchArena& arena);
+    ~Scope();
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+   private:
+    ScratchArena& arena_;
+    size_t chunk_;
+    size_t used_;
+    size_t in_use_;
+  };
+
+ private:
+  struct Chunk {
+    std::unique_ptr<uint8_t[]> memory;
+    uint8_t* base = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+  };
+
+  bool AddChunk(size_t size);
+  void Rewind(size_t chunk, size_t used, size_t in_use);
+  void Trim();
+
+  // Each new chunk at least doubles the reservation, so a few chunks cover any call.
+  static constexpr size_t kMaxChunks = 24;
+
+  std::array<Chunk, kMaxChunks> chunks_;
+  size_t chunk_count_ = 0;
+  size_t current_ = 0;
+  size_t in_use_ = 0;
+  size_t peak_ = 0;
+  size_t scope_peak_ = 0;
+  int depth_ = 0;
+};
+
+}  // namespace vibe
@@ -0,0 +1,149 @@
+#include "StringScan.h"
+
+#include "CpuFeatures.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(VIBE_ARCH_X86)
+#include <immintrin.h>
+#endif
+
+namespace vibe {
+namespace {
+
+unsigned CountTrailingZeros(unsigned mask) {
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+const char* FindQuoteOrBackslashScalar(const char* begin, const char* end) {
+  while (begin < end && *begin != '"' && *begin != '\\') ++begin;
+  return begin;
+}
+
+// '[' and ']' differ from '{' and '}' only in bit 5, so one compare after setting it covers both.
+JsonBlockMasks ClassifyJsonBlockScalar(const char* block) {
+  JsonBlockMasks masks;
+  for (unsigned i = 0; i < 64; ++i) {
+    const char c = block[i];
+    const char folded = static_cast<char>(c | 0x20);
+    const uint64_t bit = uint64_t{1} << i;
+    if (c == '"') masks.quotes |= bit;
+    if (c == '\\') masks.backslashes |= bit;
+    if (folded == '{') masks.opens |= bit;
+    if (folded == '}') masks.closes |= bit;
+  }
+  return masks;
+}
+
+#if defined(VIBE_ARCH_X86)
+VIBE_TARGET("sse2")
+const char* FindQuoteOrBackslashSse2(const char* begin, const char* end) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - begin >= 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    const __m128i hits =
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash));
+    const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+    if (mask) return begin + CountTrailingZeros(mask);
+    begin += 16;
+  }
+  return FindQuoteOrBackslashScalar(begin, end);
+}
+
+VIBE_TARGET("avx2")
+const char* FindQuoteOrBackslashAvx2(const char* begin, const char* end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  while (end - begin >= 32) {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    const __m256i hits =
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash));
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    if (mask) return begin + CountTrailingZeros(mask);
+    begin += 32;
+  }
+  return FindQuoteOrBackslashSse2(begin, end);
+}
+
+VIBE_TARGET("sse2")
+uint64_t MoveMask16(__m128i hits, unsigned shift) {
+  return static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(hits))) << shift;
+}
+
+VIBE_TARGET("avx2")
+uint64_t MoveMask64(__m256i low_hits, __m256i high_hits) {
+  return static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(low_hits))) |
+         static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(high_hits))) << 32;
+}
+
+VIBE_TARGET("sse2")
+JsonBlockMasks ClassifyJsonBlockSse2(const char* block) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i open = _mm_set1_epi8('{');
+  const __m128i close = _mm_set1_epi8('}');
+  const __m128i fold = _mm_set1_epi8(0x20);
+  JsonBlockMasks masks;
+  for (unsigned i = 0; i < 64; i += 16) {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+    const __m128i folded = _mm_or_si128(chunk, fold);
+    masks.quotes |= MoveMask16(_mm_cmpeq_epi8(chunk, quote), i);
+    masks.backslashes |= MoveMask16(_mm_cmpeq_epi8(chunk, backslash), i);
+    masks.opens |= MoveMask16(_mm_cmpeq_epi8(folded, open), i);
+    masks.closes |= MoveMask16(_mm_cmpeq_epi8(folded, close), i);
+  }
+  return masks;
+}
+
+VIBE_TARGET("avx2")
+JsonBlockMasks ClassifyJsonBlockAvx2(const char* block) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i open = _mm256_set1_epi8('{');
+  const __m256i close = _mm256_set1_epi8('}');
+  const __m256i fold = _mm256_set1_epi8(0x20);
+  const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+  JsonBlockMasks masks;
+  masks.quotes = MoveMask64(_mm256_cmpeq_epi8(low, quote), _mm256_cmpeq_epi8(high, quote));
+  masks.backslashes =
+      MoveMask64(_mm256_cmpeq_epi8(low, backslash), _mm256_cmpeq_epi8(high, backslash));
+  const __m256i low_folded = _mm256_or_si256(low, fold);
+  const __m256i high_folded = _mm256_or_si256(high, fold);
+  masks.opens =
+      MoveMask64(_mm256_cmpeq_epi8(low_folded, open), _mm256_cmpeq_epi8(high_folded, open));
+  masks.closes =
+      MoveMask64(_mm256_cmpeq_epi8(low_folded, close), _mm256_cmpeq_epi8(high_folded, close));
+  return masks;
+}
+#endif
+
+}  // namespace
+
+const char* FindQuoteOrBackslash(const char* begin, const char* end) {
+#if defined(VIBE_ARCH_X86)
+  const SimdLevel level = ActiveSimdLevel();
+  if (level >= SimdLevel::kAvx2) return FindQuoteOrBackslashAvx2(begin, end);
+  if (level >= SimdLevel::kSse2) return FindQuoteOrBackslashSse2(begin, end);
+#endif
+  return FindQuoteOrBackslashScalar(begin, end);
+}
+
+JsonBlockClassifier ActiveJsonBlockClassifier() {
+#if defined(VIBE_ARCH_X86)
+  const SimdLevel level = ActiveSimdLevel();
+  if (level >= SimdLevel::kAvx2) return ClassifyJsonBlockAvx2;
+  if (level >= SimdLevel::kSse2) return ClassifyJsonBlockSse2;
+#endif
+  return ClassifyJsonBlockScalar;
+}
+
+}  // namespace vibe
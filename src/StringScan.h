@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vibe {
+
+// Returns the first '"' or '\\' in [begin, end), or |end| when there is none. Dispatches to the
+// widest kernel the CPU supports.
+const char* FindQuoteOrBackslash(const char* begin, const char* end);
+
+// The characters of one 64-byte block that matter for finding where a JSON container ends; bit
+// i of each mask stands for byte i.
+struct JsonBlockMasks {
+  uint64_t quotes = 0;
+  uint64_t backslashes = 0;
+  // '{' and '['.
+  uint64_t opens = 0;
+  // '}' and ']'.
+  uint64_t closes = 0;
+};
+
+using JsonBlockClassifier = JsonBlockMasks (*)(const char* block);
+
+// Returns the widest kernel the CPU supports for classifying 64 bytes, so callers walking many
+// blocks dispatch once.
+JsonBlockClassifier ActiveJsonBlockClassifier();
+
+}  // namespace vibe
@@ -0,0 +1,266 @@
+#include "ThumbnailCache.h"
+
+#include "Scaler.h"
+#include "ThumbnailStore.h"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+namespace vibe {
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+uint64_t RotateLeft(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+// Only compared on this machine, so native byte order is fine.
+uint64_t Load64(const char* p) {
+  uint64_t value = 0;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint32_t Load32(const char* p) {
+  uint32_t value = 0;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+uint64_t Round(uint64_t accumulator, uint64_t input) {
+  return RotateLeft(accumulator + input * kPrime2, 31) * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+  return (hash ^ Round(0, accumulator)) * kPrime1 + kPrime4;
+}
+
+uint64_t Xxh64(std::string_view data) {
+  const char* p = data.data();
+  const char* end = p + data.size();
+  uint64_t hash = 0;
+  if (data.size() >= 32) {
+    uint64_t lanes[4] = {kPrime1 + kPrime2, kPrime2, 0, 0 - kPrime1};
+    for (; end - p >= 32; p += 32) {
+      for (int i = 0; i < 4; ++i) lanes[i] = Round(lanes[i], Load64(p + i * 8));
+    }
+    hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+           RotateLeft(lanes[3], 18);
+    for (uint64_t lane : lanes) hash = MergeRound(hash, lane);
+  } else {
+    hash = kPrime5;
+  }
+
+  hash += data.size();
+  for (; end - p >= 8; p += 8) {
+    hash = RotateLeft(hash ^ Round(0, Load64(p)), 27) * kPrime1 + kPrime4;
+  }
+  if (end - p >= 4) {
+    hash = RotateLeft(hash ^ (Load32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash = RotateLeft(hash ^ (static_cast<uint8_t>(*p) * kPrime5), 11) * kPrime1;
+  }
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+struct CachedImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::unique_ptr<uint8_t[]> pixels;  // Premultiplied BGRA, rows |width| * 4 bytes apart.
+
+  size_t bytes() const { return static_cast<size_t>(width) * height * 4; }
+};
+
+struct Entry {
+  ThumbnailCacheKey key;
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+  std::vector<std::shared_ptr<const CachedImage>> images;
+  size_t bytes = 0;
+};
+
+}  // namespace
+
+struct ThumbnailCache::Shard {
+  std::mutex mutex;
+  // Most recently used first; |index| points into it.
+  std::list<Entry> entries;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  size_t bytes = 0;
+};
+
+ThumbnailCacheKey ThumbnailCacheKey::For(std::string_view payload) {
+  return {Xxh64(payload), payload.size()};
+}
+
+ThumbnailCache::ThumbnailCache(size_t budget_bytes)
+    : budget_bytes_(budget_bytes), shards_(new Shard[kShardCount]) {}
+
+ThumbnailCache::~ThumbnailCache() = default;
+
+ThumbnailCache::Shard& ThumbnailCache::ShardFor(const ThumbnailCacheKey& key) const {
+  // The low bits also pick the hash table bucket; the top ones are independent of them.
+  return shards_[(key.hash >> 61) % kShardCount];
+}
+
+CacheLookup ThumbnailCache::Lookup(const ThumbnailCacheKey& key, uint32_t cx,
+                                   const ThumbnailAllocator& allocate) {
+  std::shared_ptr<const CachedImage> source;
+  ImageSize size;
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+  {
+    Shard& shard = ShardFor(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto found = shard.index.find(key.hash);
+    if (found != shard.index.end() && found->second->key.size == key.size) {
+      const Entry& entry = *found->second;
+      source_width = entry.source_width;
+      source_height = entry.source_height;
+      size = ComputeThumbnailSize(source_width, source_height, cx);
+      // The smallest cached size that still covers the request.
+      for (const std::shared_ptr<const CachedImage>& image : entry.images) {
+        if (image->width >= size.width && image->height >= size.height &&
+            (!source || image->bytes() < source->bytes())) {
+          source = image;
+        }
+      }
+      if (source) shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+    }
+  }
+  if (!source && store_) {
+    StoredThumbnail stored;
+    const CacheLookup result = store_->Lookup(key, cx, allocate, &stored);
+    if (result == CacheLookup::kHit) {
+      Remember(key, stored.source_width, stored.source_height, stored.pixels, stored.width,
+               stored.height, stored.stride);
+      stored_.fetch_add(1, std::memory_order_relaxed);
+      hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (result != CacheLookup::kMiss) return result;
+  }
+  if (!source) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return CacheLookup::kMiss;
+  }
+
+  size_t stride = 0;
+  uint8_t* dest = allocate(size.width, size.height, &stride);
+  if (!dest) return CacheLookup::kOutOfMemory;
+  const size_t source_stride = static_cast<size_t>(source->width) * 4;
+  if (source->width == size.width && source->height == size.height) {
+    for (uint32_t y = 0; y < size.height; ++y) {
+      std::memcpy(dest + y * stride, source->pixels.get() + y * source_stride, source_stride);
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return CacheLookup::kHit;
+  }
+
+  BgraScaler scaler;
+  if (!scaler.Init(source->width, source->height, dest, size.width, size.height, stride)) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return CacheLookup::kMiss;
+  }
+  std::vector<uint8_t> row(source_stride);
+  for (uint32_t y = 0; y < source->height; ++y) {
+    UnpremultiplyBgraRow(source->pixels.get() + y * source_stride, source->width, row.data());
+    scaler.PushRow(row.data());
+  }
+  derived_.fetch_add(1, std::memory_order_relaxed);
+  Insert(key, cx, source_width, source_height, dest, size.width, size.height, stride);
+  return CacheLookup::kDerived;
+}
+
+void ThumbnailCache::Insert(const ThumbnailCacheKey& key, uint32_t cx, uint32_t source_width,
+                            uint32_t source_height, const uint8_t* pixels, uint32_t width,
+                            uint32_t height, size_t stride) {
+  Remember(key, source_width, source_height, pixels, width, height, stride);
+  if (store_) store_->Insert(key, cx, source_width, source_height, pixels, width, height, stride);
+}
+
+void ThumbnailCache::Remember(const ThumbnailCacheKey& key, uint32_t source_width,
+                              uint32_t source_height, const uint8_t* pixels, uint32_t width,
+                              uint32_t height, size_t stride) {
+  const size_t shard_budget = budget_bytes_ / kShardCount;
+  const size_t row_bytes = static_cast<size_t>(width) * 4;
+  if (width == 0 || height == 0 || row_bytes * height > shard_budget) return;
+
+  // Copied before taking the lock; a racing insert of the same size just drops it.
+  auto image = std::make_shared<CachedImage>();
+  image->width = width;
+  image->height = height;
+  image->pixels.reset(new (std::nothrow) uint8_t[row_bytes * height]);
+  if (!image->pixels) return;
+  for (uint32_t y = 0; y < height; ++y) {
+    std::memcpy(image->pixels.get() + y * row_bytes, pixels + y * stride, row_bytes);
+  }
+
+  Shard& shard = ShardFor(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto found = shard.index.find(key.hash);
+  if (found != shard.index.end() && found->second->key.size != key.size) {
+    // A hash collision: the newer payload takes the slot.
+    shard.bytes -= found->second->bytes;
+    shard.entries.erase(found->second);
+    shard.index.erase(found);
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+    found = shard.index.end();
+  }
+  if (found == shard.index.end()) {
+    shard.entries.push_front(Entry{key, source_width, source_height, {}, 0});
+    found = shard.index.emplace(key.hash, shard.entries.begin()).first;
+  } else {
+    shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+  }
+
+  Entry& entry = *found->second;
+  for (const std::shared_ptr<const CachedImage>& cached : entry.images) {
+    if (cached->width == width && cached->height == height) return;
+  }
+  entry.images.push_back(std::move(image));
+  entry.bytes += row_bytes * height;
+  shard.bytes += row_bytes * height;
+  insertions_.fetch_add(1, std::memory_order_relaxed);
+
+  // Least recently used first; an entry whose sizes together outgrow the shard goes last.
+  while (shard.bytes > shard_budget) {
+    Entry& oldest = shard.entries.back();
+    shard.bytes -= oldest.bytes;
+    shard.index.erase(oldest.key.hash);
+    shard.entries.pop_back();
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+ThumbnailCacheStats ThumbnailCache::stats() const {
+  ThumbnailCacheStats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.stored = stored_.load(std::memory_order_relaxed);
+  stats.derived = derived_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.insertions = insertions_.load(std::memory_order_relaxed);
+  stats.evictions = evictions_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < kShardCount; ++i) {
+    std::lock_guard<std::mutex> lock(shards_[i].mutex);
+    stats.bytes += shards_[i].bytes;
+    stats.entries += shards_[i].entries.size();
+  }
+  return stats;
+}
+
+}  // namespace vibe
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ThumbnailPipeline.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace vibe {
+
+class ThumbnailStore;
+
+// Identifies a payload by its raw JSON text, so files that embed the same image share entries.
+struct ThumbnailCacheKey {
+  uint64_t hash = 0;
+  uint64_t size = 0;
+
+  // xxHash64 of |payload|: about 10 GB/s, a few milliseconds for the largest payloads.
+  static ThumbnailCacheKey For(std::string_view payload);
+};
+
+enum class CacheLookup {
+  kMiss,
+  // The requested size was cached and copied out.
+  kHit,
+  // Scaled down from a larger cached size, then cached itself.
+  kDerived,
+  // Cached, but |allocate| returned null.
+  kOutOfMemory,
+};
+
+struct ThumbnailCacheStats {
+  uint64_t hits = 0;
+  // Hits the persistent store answered after the memory missed; also counted in |hits|.
+  uint64_t stored = 0;
+  uint64_t derived = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t evictions = 0;
+  // Pixel bytes held right now.
+  uint64_t bytes = 0;
+  uint64_t entries = 0;
+};
+
+// Premultiplied thumbnails of recently rendered payloads, at every size produced so far, within a
+// memory budget. Keys are spread over shards with a lock each, and pixels are shared immutably,
+// so copying or scaling a cached image happens outside the lock and concurrent providers only
+// contend when they touch the same shard at the same moment. Each shard evicts its least
+// recently used payloads once it holds more than its share of the budget.
+//
+// With a ThumbnailStore attached, memory misses fall back to it and every insertion is written
+// through, so thumbnails outlive the process.
+class ThumbnailCache {
+ public:
+  static constexpr size_t kShardCount = 8;
+
+  explicit ThumbnailCache(size_t budget_bytes);
+  ~ThumbnailCache();
+
+  ThumbnailCache(const ThumbnailCache&) = delete;
+  ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+  // Set before the first lookup; |store| must outlive the cache.
+  void set_store(ThumbnailStore* store) { store_ = store; }
+
+  // Produces the |cx| thumbnail of |key| into storage from |allocate| when a cached size matches
+  // it, or is larger and can be scaled down to it, or the store holds it.
+  CacheLookup Lookup(const ThumbnailCacheKey& key, uint32_t cx, const ThumbnailAllocator& allocate);
+
+  // Remembers a freshly rendered |width| x |height| thumbnail for |cx| of a |source_width| x
+  // |source_height| image. Sizes already cached are left alone.
+  void Insert(const ThumbnailCacheKey& key, uint32_t cx, uint32_t source_width,
+              uint32_t source_height, const uint8_t* pixels, uint32_t width, uint32_t height,
+              size_t stride);
+
+  ThumbnailCacheStats stats() const;
+  size_t budget_bytes() const { return budget_bytes_; }
+
+ private:
+  struct Shard;
+
+  Shard& ShardFor(const ThumbnailCacheKey& key) const;
+  // Insert without writing through to the store.
+  void Remember(const ThumbnailCacheKey& key, uint32_t source_width, uint32_t source_height,
+                const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride);
+
+  size_t budget_bytes_;
+  std::unique_ptr<Shard[]> shards_;
+  ThumbnailStore* store_ = nullptr;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> stored_{0};
+  std::atomic<uint64_t> derived_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> insertions_{0};
+  std::atomic<uint64_t> evictions_{0};
+};
+
+}  // namespace vibe
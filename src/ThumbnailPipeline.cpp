@@ -0,0 +1,759 @@
+#include "ThumbnailPipeline.h"
+
+#include "Base64.h"
+#include "ImageFormat.h"
+#include "ImageProbe.h"
+#include "JsonFieldLocator.h"
+#include "JsonFieldReader.h"
+#include "RenderDeadline.h"
+#include "Scaler.h"
+#include "ScratchArena.h"
+#include "ThumbnailCache.h"
+#include "Trace.h"
+#include "VibeContainer.h"
+#include "VibeLayout.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+namespace vibe {
+
+std::string_view StripDataUrlPrefix(std::string_view input) {
+  auto comma = input.find(',');
+  if (comma == std::string_view::npos) return input;
+  return input.substr(comma + 1);
+}
+
+namespace {
+
+constexpr std::string_view kFieldNames[] = {"thumbnail", "image"};
+constexpr size_t kThumbnailField = 0;
+constexpr size_t kImageField = 1;
+
+// About 380 decoded bytes: enough for PNG and WebP headers and most JPEG frame headers. JPEGs
+// with large APPn segments ahead of the frame get longer prefixes, up to the limit.
+constexpr size_t kProbeChars = 512;
+constexpr size_t kMaxProbeChars = 256 * 1024;
+// "\uD83D\uDE00", the longest escape a prefix can cut in half.
+constexpr size_t kMaxEscapeLength = 12;
+// Decoded rows staged per pool thread before their horizontal scaling is fanned out.
+constexpr uint32_t kParallelRowsPerThread = 32;
+
+ThumbnailStatus Fail(TraceSpan& span, ThumbnailStatus status) {
+  span.Fail(ThumbnailStatusName(status));
+  return status;
+}
+
+// Size of the image in |field|, read from the start of its payload, or 0 x 0 when the header
+// cannot be found or is in an unknown format.
+ImageSize ProbeSize(const JsonStringSpan& field, ScratchArena& arena) {
+  for (size_t chars = kProbeChars;;) {
+    ScratchArena::Scope scope(arena);
+    std::string_view prefix = field.raw.substr(0, chars);
+    const bool whole = prefix.size() == field.raw.size();
+    if (field.has_escapes) {
+      char* unescaped = arena.AllocateArray<char>(prefix.size());
+      if (!unescaped) return {};
+      size_t written = 0;
+      for (size_t trimmed = 0; !UnescapeJsonString(prefix, unescaped, &written); ++trimmed) {
+        if (whole || trimmed == kMaxEscapeLength) return {};
+        prefix.remove_suffix(1);
+      }
+      prefix = std::string_view(unescaped, written);
+    }
+
+    const std::string_view encoded_image = StripDataUrlPrefix(prefix);
+    const size_t capacity = Base64DecodedSizeUpperBound(encoded_image.size());
+    uint8_t* header = arena.AllocateArray<uint8_t>(capacity);
+    if (!header) return {};
+    // A cut quantum fails the decode, but everything before it is still good.
+    const Base64Result decoded = DecodeBase64(encoded_image, header, capacity);
+
+    ImageSize size;
+    size_t needed = 0;
+    const ProbeStatus status =
+        ProbeImageSize(std::span<const uint8_t>(header, decoded.written), &size, &needed);
+    if (status == ProbeStatus::kOk) return size;
+    if (status != ProbeStatus::kNeedMore || whole || chars >= kMaxProbeChars) return {};
+    chars = std::min(kMaxProbeChars, std::max(chars * 4, needed / 3 * 4 + kProbeChars));
+  }
+}
+
+constexpr size_t kNoSource = std::size(kFieldNames);
+
+// The smallest source whose long edge reaches |cx|, or the largest when none does. Unless every
+// found source could be probed, falls back to the fixed rule: "thumbnail" up to 512 px, otherwise
+// "image". Returns kNoSource when neither was found.
+size_t SelectSource(const bool (&found)[2], const uint32_t (&edges)[2], uint32_t cx) {
+  size_t selected = kNoSource;
+  uint32_t selected_edge = 0;
+  for (size_t i = 0; i < 2; ++i) {
+    if (!found[i]) continue;
+    if (edges[i] == 0) {
+      selected = kNoSource;
+      break;
+    }
+    const bool fits = edges[i] >= cx;
+    const bool selected_fits = selected_edge >= cx;
+    if (selected == kNoSource || (fits != selected_fits ? fits
+                                                        : (fits ? edges[i] < selected_edge
+                                                                : edges[i] > selected_edge))) {
+      selected = i;
+      selected_edge = edges[i];
+    }
+  }
+  if (selected != kNoSource) return selected;
+
+  if (found[kThumbnailField] && cx <= 512) return kThumbnailField;
+  if (found[kImageField]) return kImageField;
+  if (found[kThumbnailField]) return kThumbnailField;
+  return kNoSource;
+}
+
+// Base64 decoding, charged on top of the decoder's own cost; slow enough for any machine.
+constexpr double kBase64NsPerChar = 1.0;
+
+// What a render decodes and how, as settled under a deadline.
+struct RenderPlan {
+  size_t index = kNoSource;
+  uint32_t min_long_edge = 0;
+  ScaleFilter filter = ScaleFilter::kAuto;
+  RenderTier tier = RenderTier::kFull;
+};
+
+// A payload a timed render may fall back to.
+struct PlanSource {
+  size_t index = kNoSource;
+  ImageSize size;
+  ImageFormat format = ImageFormat::kUnknown;
+  // Base64 text to decode before the image, if any.
+  uint64_t encoded_chars = 0;
+};
+
+// The format of a payload from the first base64 characters of |raw|, or its data URL.
+ImageFormat PayloadFormat(std::string_view raw) {
+  uint8_t signature[Base64DecodedSizeUpperBound(kImageSignatureChars)];
+  const std::string_view head = StripDataUrlPrefix(raw).substr(0, kImageSignatureChars);
+  const Base64Result decoded = DecodeBase64(head, signature, sizeof(signature));
+  const ImageFormat format = SniffImageFormat(std::span<const uint8_t>(signature, decoded.written));
+  return format != ImageFormat::kUnknown ? format : ImageFormatFromDataUrl(raw);
+}
+
+// Settles what to render before |deadline|: |sources[0]| as requested, then the smaller
+// |sources[1]|, then either at a reduced decode scale, then with the fast filter. When nothing
+// fits, the cheapest of these runs anyway, and now and then the full render does instead so its
+// estimate is checked. Payloads of unknown size cannot be costed and are rendered as requested.
+void PlanRender(std::span<const PlanSource> sources, uint32_t cx, const RenderDeadline& deadline,
+                RenderTier floor, RenderPlan* plan) {
+  plan->index = sources[0].index;
+  plan->min_long_edge = cx;
+  plan->tier = floor;
+  if (!deadline.enabled() || sources[0].size.width == 0) return;
+
+  const auto remaining = deadline.deadline - std::chrono::steady_clock::now();
+  const auto cost = [&](const PlanSource& source, uint32_t min_long_edge, bool fast) {
+    // Only JPEG decoders are known to reduce whatever the image's layout.
+    const uint32_t scale = source.format == ImageFormat::kJpeg
+                               ? SelectDecodeScale(source.size.width, source.size.height,
+                                                   min_long_edge)
+                               : 1;
+    return deadline.costs->Estimate(source.format, source.size.width, source.size.height, scale,
+                                    fast) +
+           std::chrono::nanoseconds(static_cast<int64_t>(source.encoded_chars * kBase64NsPerChar));
+  };
+  const auto fits = [&](const PlanSource& source, uint32_t min_long_edge, bool fast) {
+    return cost(source, min_long_edge, fast) <= remaining;
+  };
+  const auto choose = [&](const PlanSource& source, uint32_t min_long_edge, bool fast,
+                          RenderTier tier) {
+    plan->index = source.index;
+    plan->min_long_edge = min_long_edge;
+    plan->filter = fast ? ScaleFilter::kFast : ScaleFilter::kAuto;
+    plan->tier = std::max(tier, floor);
+  };
+
+  // Only full renders estimated to take at most kProbeOverrun times the time left are probed.
+  if (fits(sources[0], cx, false) ||
+      (cost(sources[0], cx, false) <= remaining * DecodeCostModel::kProbeOverrun &&
+       deadline.costs->ProbeDue(sources[0].format))) {
+    return choose(sources[0], cx, false, RenderTier::kFull);
+  }
+  if (sources.size() > 1 && sources[1].size.width != 0 && fits(sources[1], cx, false)) {
+    return choose(sources[1], cx, false, RenderTier::kSmallerSource);
+  }
+  for (const PlanSource& source : sources) {
+    if (source.size.width == 0 || source.format != ImageFormat::kJpeg) continue;
+    for (uint32_t edge = cx / 2; edge >= std::max(1u, cx / 8); edge /= 2) {
+      if (fits(source, edge, false)) return choose(source, edge, false, RenderTier::kReducedDecode);
+    }
+  }
+  // The fast filter goes with the smallest decode the format allows.
+  const auto fast_edge = [&](const PlanSource& source) {
+    return source.format == ImageFormat::kJpeg ? std::max(1u, cx / 8) : cx;
+  };
+  const PlanSource* cheapest = &sources[0];
+  for (const PlanSource& source : sources) {
+    if (source.size.width == 0) continue;
+    const uint32_t edge = fast_edge(source);
+    if (fits(source, edge, true)) return choose(source, edge, true, RenderTier::kFastScale);
+    if (cost(source, edge, true) < cost(*cheapest, fast_edge(*cheapest), true)) cheapest = &source;
+  }
+  choose(*cheapest, fast_edge(*cheapest), true, RenderTier::kOverrun);
+}
+
+// Reads until |capacity| bytes have come or the data ends.
+bool ReadFully(ByteSource& source, void* buffer, size_t capacity, size_t* bytes_read) {
+  *bytes_read = 0;
+  while (*bytes_read < capacity) {
+    size_t read = 0;
+    if (!source.Read(static_cast<char*>(buffer) + *bytes_read, capacity - *bytes_read, &read)) {
+      return false;
+    }
+    if (read == 0) break;
+    *bytes_read += read;
+  }
+  return true;
+}
+
+// Probes each field as the reader completes it and says whether reading can stop: once nothing
+// later could be selected. "thumbnail" is taken to be the smaller source, so one that covers |cx|
+// ends the search, and so does an "image" that falls short. Unprobed fields stop where the fixed
+// rule would. The reader gets a single pointer to this, which std::function stores inline.
+struct FieldProbe {
+  JsonFieldReader& reader;
+  ScratchArena& arena;
+  uint32_t cx = 0;
+  ImageSize sizes[std::size(kFieldNames)] = {};
+  uint32_t edges[std::size(kFieldNames)] = {};
+
+  bool operator()(size_t index) {
+    sizes[index] = ProbeSize(reader.field(index), arena);
+    edges[index] = std::max(sizes[index].width, sizes[index].height);
+    if (reader.found_count() == std::size(kFieldNames)) return true;
+    if (edges[index] == 0) return index == kThumbnailField ? cx <= 512 : cx > 512;
+    return index == kThumbnailField ? edges[index] >= cx : edges[index] < cx;
+  }
+};
+
+// Scales rows into the thumbnail as the decoder produces them. The thumbnail is allocated once
+// the decoder has announced the image, and only if the image and everything it would take stay
+// within the limits. With a |pool|, rows are staged in the arena and scaled a batch at a time.
+class ThumbnailSink final : public ImageRowSink {
+ public:
+  ThumbnailSink(uint32_t cx, ScaleFilter filter, const DecodeLimits& limits,
+                const ThumbnailAllocator& allocate, WorkStealingPool* pool, ScratchArena& arena)
+      : cx_(cx), filter_(filter), limits_(limits), allocate_(allocate), pool_(pool),
+        arena_(arena) {}
+
+  DecodeStatus Begin(const ImageLayout& layout) override {
+    if (static_cast<uint64_t>(layout.source_width) * layout.source_height > limits_.max_pixels) {
+      return DecodeStatus::kTooLarge;
+    }
+    // Decoders may have reduced the image already; the thumbnail keeps the source's proportions
+    // and the scaler covers what is left.
+    const ImageSize size = ComputeThumbnailSize(layout.source_width, layout.source_height, cx_);
+    const uint64_t dest_bytes = static_cast<uint64_t>(size.width) * size.height * 4;
+    row_bytes_ = static_cast<uint64_t>(layout.width) * 4;
+    if (pool_) {
+      staged_capacity_ = std::min(layout.height, kParallelRowsPerThread * pool_->size());
+    }
+    // Staged rows, and the floats their horizontal passes produce.
+    const uint64_t staging_bytes =
+        staged_capacity_ * (row_bytes_ + static_cast<uint64_t>(size.width) * 4 * sizeof(float));
+    const uint64_t bytes =
+        layout.working_bytes + dest_bytes + staging_bytes +
+        BgraScaler::EstimateBytes(layout.width, layout.height, size.width, size.height);
+    if (bytes > limits_.max_bytes) return DecodeStatus::kTooLarge;
+    if (staged_capacity_ != 0) {
+      staging_ = arena_.AllocateArray<uint8_t>(staged_capacity_ * row_bytes_);
+      if (!staging_) return DecodeStatus::kOutOfMemory;
+    }
+
+    TraceSpan span(TraceStage::kAllocate);
+    span.set_bytes(dest_bytes);
+    size_t stride = 0;
+    uint8_t* dest = allocate_(size.width, size.height, &stride);
+    if (!dest) {
+      span.Fail(ThumbnailStatusName(ThumbnailStatus::kOutOfMemory));
+      return DecodeStatus::kOutOfMemory;
+    }
+    if (!scaler_.Init(layout.width, layout.height, dest, size.width, size.height, stride,
+                      filter_, layout.opaque)) {
+      span.Fail(DecodeStatusName(DecodeStatus::kCorrupt));
+      return DecodeStatus::kCorrupt;
+    }
+    height_ = layout.height;
+    decode_scale_ = std::max(1u, layout.source_width / layout.width);
+    source_size_ = {layout.source_width, layout.source_height};
+    size_ = size;
+    dest_ = dest;
+    stride_ = stride;
+    return DecodeStatus::kOk;
+  }
+
+  void PushRow(const uint8_t* row) override {
+    rows_ += 1;
+    if (!staging_) {
+      scaler_.PushRow(row);
+      return;
+    }
+    std::memcpy(staging_ + staged_ * row_bytes_, row, row_bytes_);
+    if (++staged_ == staged_capacity_ || rows_ == height_) {
+      scaler_.PushRows(staging_, row_bytes_, staged_, pool_);
+      staged_ = 0;
+    }
+  }
+
+  bool done() const { return row_bytes_ != 0 && scaler_.done(); }
+  uint64_t bytes_scaled() const { return rows_ * row_bytes_; }
+  ImageSize source_size() const { return source_size_; }
+  // How far the decoder reduced the image: 1, 2, 4 or 8.
+  uint32_t decode_scale() const { return decode_scale_; }
+
+  // The finished thumbnail, for the cache.
+  void CacheResult(ThumbnailCache& cache, const ThumbnailCacheKey& key) const {
+    cache.Insert(key, cx_, source_size_.width, source_size_.height, dest_, size_.width,
+                 size_.height, stride_);
+  }
+
+ private:
+  uint32_t cx_;
+  ScaleFilter filter_;
+  const DecodeLimits& limits_;
+  const ThumbnailAllocator& allocate_;
+  WorkStealingPool* pool_;
+  ScratchArena& arena_;
+  BgraScaler scaler_;
+  uint64_t row_bytes_ = 0;
+  uint64_t rows_ = 0;
+  uint32_t height_ = 0;
+  uint32_t decode_scale_ = 1;
+  uint8_t* staging_ = nullptr;
+  uint32_t staged_capacity_ = 0;
+  uint32_t staged_ = 0;
+  ImageSize source_size_;
+  ImageSize size_;
+  uint8_t* dest_ = nullptr;
+  size_t stride_ = 0;
+};
+
+// Serves the |cx| thumbnail of |key| from |cache| when it has one. Returns false on a miss;
+// otherwise the render is over and |status| says how it went.
+bool ServeFromCache(ThumbnailCache& cache, const ThumbnailCacheKey& key, uint32_t cx,
+                    const ThumbnailAllocator& allocate, TraceSpan& span, ThumbnailStatus* status) {
+  const CacheLookup cached = cache.Lookup(key, cx, allocate);
+  if (cached == CacheLookup::kMiss) return false;
+  if (cached == CacheLookup::kOutOfMemory) {
+    *status = Fail(span, ThumbnailStatus::kOutOfMemory);
+  } else {
+    span.set_detail(cached == CacheLookup::kHit ? "cache hit" : "cache derived");
+    *status = ThumbnailStatus::kOk;
+  }
+  return true;
+}
+
+// Decodes the selected payload and scales it into the thumbnail: from |encoded_image|, its
+// base64 text, for decoders that read that themselves, from the raw |encoded| bytes otherwise.
+// The decoder may reduce the image as long as its long edge stays at least |plan.min_long_edge|.
+// With |costs|, the time taken goes into the model.
+ThumbnailStatus DecodeAndScale(std::string_view encoded_image, std::span<const uint8_t> encoded,
+                               ImageFormat format, uint32_t cx, const RenderPlan& plan,
+                               ImageDecoder& decoder, const ThumbnailAllocator& allocate,
+                               const DecodeLimits& limits, ThumbnailCache* cache,
+                               const ThumbnailCacheKey& key, WorkStealingPool* pool,
+                               DecodeCostModel* costs, ScratchArena& arena) {
+  const auto start = std::chrono::steady_clock::now();
+  ThumbnailSink sink(cx, plan.filter, limits, allocate, pool, arena);
+  {
+    TraceSpan span(TraceStage::kDecode);
+    span.set_detail(decoder.name());
+    const bool lazy = encoded.empty();
+    span.set_bytes(lazy ? encoded_image.size() : encoded.size());
+    const DecodeStatus decode_status =
+        lazy ? decoder.DecodeBase64Rows(encoded_image, format, plan.min_long_edge, &sink)
+             : decoder.DecodeRows(encoded, format, plan.min_long_edge, &sink);
+    if (decode_status != DecodeStatus::kOk) span.Fail(DecodeStatusName(decode_status));
+    if (decode_status == DecodeStatus::kOutOfMemory) return ThumbnailStatus::kOutOfMemory;
+    if (decode_status == DecodeStatus::kTooLarge) return ThumbnailStatus::kTooLarge;
+    if (decode_status != DecodeStatus::kOk) return ThumbnailStatus::kDecodeFailed;
+  }
+
+  // Scaling happened row by row during the decode; what is left is making sure every row came.
+  TraceSpan span(TraceStage::kScale);
+  span.set_detail(pool ? "parallel" : "streamed");
+  span.set_bytes(sink.bytes_scaled());
+  if (!sink.done()) return Fail(span, ThumbnailStatus::kDecodeFailed);
+  if (costs) {
+    const ImageSize size = sink.source_size();
+    costs->Record(format, size.width, size.height, sink.decode_scale(),
+                  plan.filter == ScaleFilter::kFast, std::chrono::steady_clock::now() - start);
+  }
+  // Degraded renders stay out of the cache, so a later render with time to spare redoes them.
+  if (cache && plan.tier <= RenderTier::kSmallerSource) sink.CacheResult(*cache, key);
+  return ThumbnailStatus::kOk;
+}
+
+ThumbnailStatus RenderJson(ByteSource& source, bool thumbnail_first, uint32_t cx,
+                           ImageDecoder& decoder, const ThumbnailAllocator& allocate,
+                           const DecodeLimits& limits, ThumbnailCache* cache,
+                           const ParallelOptions& parallel, const JsonScanBudget& budget,
+                           const RenderDeadline& deadline, ScratchArena& arena,
+                           uint64_t* bytes_read) {
+  // Mapped files are scanned in place. Streams are read only until the selection is settled,
+  // which skips whatever follows (often a multi-megabyte "image"). Each field's image size is
+  // probed from its first few hundred bytes as soon as the field is complete. Files laid out
+  // thumbnail first usually settle within their first chunks, so they are not given a buffer
+  // for the whole file. A timed render stops reading early enough to decode what it has, once it
+  // has anything; a stream that has not delivered a field by then is read on within |budget|.
+  const auto read_deadline = deadline.enabled() ? deadline.deadline - deadline.decode_reserve
+                                                : std::chrono::steady_clock::time_point::max();
+  JsonFieldReader reader(kFieldNames, &arena, budget);
+  reader.set_reserve_whole_source(!thumbnail_first);
+  reader.set_settle_deadline(read_deadline);
+  FieldProbe probe{reader, arena, cx};
+  RenderTier floor = RenderTier::kFull;
+  {
+    TraceSpan span(TraceStage::kRead);
+    if (thumbnail_first) span.set_detail("thumbnail first");
+    const bool read = reader.Read(source, [&probe](size_t index) { return probe(index); });
+    *bytes_read = reader.data().size();
+    span.set_bytes(*bytes_read);
+    if (!read) return Fail(span, ThumbnailStatus::kReadFailed);
+    // Out of reading time, a timed render makes do with the fields found so far.
+    if (reader.status() == JsonFieldScanner::Status::kBudgetExceeded) {
+      if (reader.found_count() == 0 || std::chrono::steady_clock::now() < read_deadline) {
+        return Fail(span, ThumbnailStatus::kBudgetExceeded);
+      }
+      span.set_detail(RenderTierName(RenderTier::kSmallerSource));
+      floor = RenderTier::kSmallerSource;
+    }
+    if (reader.status() == JsonFieldScanner::Status::kCancelled) {
+      return Fail(span, ThumbnailStatus::kCancelled);
+    }
+  }
+
+  // Unescaping and base64 both write no further than they have read, so the payload is decoded
+  // over itself in the reader's buffer. Only a read-only view needs a block of its own.
+  std::string_view value;
+  char* work = nullptr;
+  ThumbnailCacheKey key;
+  RenderPlan plan{kNoSource, cx};
+  plan.tier = floor;
+  {
+    TraceSpan span(TraceStage::kLocate);
+    const JsonStringSpan fields[] = {reader.field(kThumbnailField), reader.field(kImageField)};
+    const bool found[] = {fields[kThumbnailField].found, fields[kImageField].found};
+    size_t index = SelectSource(found, probe.edges, cx);
+    if (index == kNoSource) return Fail(span, ThumbnailStatus::kNoImageField);
+    const JsonStringSpan* selected = &fields[index];
+    span.set_detail(index == kThumbnailField ? "thumbnail" : "image");
+    span.set_bytes(selected->raw.size());
+    // A probed header already tells whether the image is over the limit; the decoder checks the
+    // rest once it has parsed the header itself.
+    const ImageSize probed = probe.sizes[index];
+    if (static_cast<uint64_t>(probed.width) * probed.height > limits.max_pixels) {
+      return Fail(span, ThumbnailStatus::kTooLarge);
+    }
+
+    if (cache) {
+      key = ThumbnailCacheKey::For(selected->raw);
+      ThumbnailStatus status;
+      if (ServeFromCache(*cache, key, cx, allocate, span, &status)) return status;
+    }
+
+    // Under a deadline the smaller field is the first thing to fall back to.
+    const size_t other = 1 - index;
+    PlanSource sources[2];
+    size_t source_count = 0;
+    if (deadline.enabled()) {
+      for (const size_t i : {index, other}) {
+        if (!found[i] || (i == other && probe.edges[other] >= probe.edges[index])) continue;
+        sources[source_count++] = {i, probe.sizes[i], PayloadFormat(fields[i].raw),
+                                   fields[i].raw.size()};
+      }
+      PlanRender(std::span(sources, source_count), cx, deadline, floor, &plan);
+      CountRenderTier(plan.tier);
+      if (plan.tier != RenderTier::kFull) span.set_detail(RenderTierName(plan.tier));
+      if (plan.index != index) {
+        index = plan.index;
+        selected = &fields[index];
+        if (cache) key = ThumbnailCacheKey::For(selected->raw);
+      }
+    }
+
+    value = selected->raw;
+    if (char* buffer = reader.writable_data()) {
+      work = buffer + (value.data() - reader.data().data());
+    }
+    if (selected->has_escapes) {
+      if (!work) work = arena.AllocateArray<char>(value.size());
+      if (!work) return Fail(span, ThumbnailStatus::kOutOfMemory);
+      size_t written = 0;
+      if (!UnescapeJsonString(value, work, &written)) {
+        return Fail(span, ThumbnailStatus::kBadString);
+      }
+      value = std::string_view(work, written);
+    }
+  }
+
+  // Decoders that read their input through a Base64Reader get the text as is; it is only
+  // materialized here for the ones that need the whole payload up front.
+  // The format comes from the payload's first bytes, or failing that from its data URL, which
+  // may be wrong about it. The data URL is read first, since an in-place decode overwrites it.
+  std::string_view encoded_image;
+  std::span<const uint8_t> encoded;
+  ImageFormat format = ImageFormat::kUnknown;
+  WorkStealingPool* pool = nullptr;
+  {
+    TraceSpan span(TraceStage::kBase64);
+    const ImageFormat declared = ImageFormatFromDataUrl(value);
+    encoded_image = StripDataUrlPrefix(value);
+    span.set_bytes(encoded_image.size());
+    if (encoded_image.empty()) return Fail(span, ThumbnailStatus::kBadBase64);
+    if (parallel.pool && encoded_image.size() >= parallel.min_payload_bytes) pool = parallel.pool;
+
+    if (decoder.decodes_base64()) {
+      span.set_detail("lazy");
+      uint8_t signature[Base64DecodedSizeUpperBound(kImageSignatureChars)];
+      const Base64Result decoded = DecodeBase64(encoded_image.substr(0, kImageSignatureChars),
+                                                signature, sizeof(signature));
+      format = SniffImageFormat(std::span<const uint8_t>(signature, decoded.written));
+    } else {
+      // Chunks decoded in parallel would overwrite each other's text in place.
+      uint8_t* output = pool ? nullptr : reinterpret_cast<uint8_t*>(work);
+      size_t capacity = value.size();
+      if (!output) {
+        capacity = Base64DecodedSizeUpperBound(encoded_image.size());
+        output = arena.AllocateArray<uint8_t>(capacity);
+        if (!output) return Fail(span, ThumbnailStatus::kOutOfMemory);
+      }
+      if (pool) span.set_detail("parallel");
+      const Base64Result decoded =
+          pool ? DecodeBase64Parallel(encoded_image, output, capacity, *pool)
+               : DecodeBase64(encoded_image, output, capacity);
+      if (decoded.status != Base64Status::kOk || decoded.written == 0) {
+        return Fail(span, ThumbnailStatus::kBadBase64);
+      }
+      encoded = std::span<const uint8_t>(output, decoded.written);
+      format = SniffImageFormat(encoded);
+    }
+    if (format == ImageFormat::kUnknown) format = declared;
+  }
+
+  return DecodeAndScale(encoded_image, encoded, format, cx, plan, decoder, allocate, limits, cache,
+                        key, pool, deadline.costs, arena);
+}
+
+// A binary container is read in three steps at most: its header and table, one skip, and the
+// selected payload, which a view hands to the decoder in place.
+ThumbnailStatus RenderContainer(ByteSource& source, std::string_view peeked, uint32_t cx,
+                                ImageDecoder& decoder, const ThumbnailAllocator& allocate,
+                                const DecodeLimits& limits, ThumbnailCache* cache,
+                                const ParallelOptions& parallel, const RenderDeadline& deadline,
+                                ScratchArena& arena, uint64_t* bytes_read) {
+  const std::string_view view = source.View();
+  ContainerLayout layout;
+  std::span<const uint8_t> payload;
+  {
+    TraceSpan span(TraceStage::kRead);
+    size_t needed = 0;
+    if (!view.empty()) {
+      if (ParseVibeContainer(view, view.size(), &layout, &needed) != ContainerStatus::kOk) {
+        return Fail(span, ThumbnailStatus::kNoImageField);
+      }
+    } else {
+      uint64_t file_size = 0;
+      if (!source.SizeHint(&file_size)) file_size = ~uint64_t{0};
+      constexpr size_t kTableCapacity =
+          kVibeContainerHeaderSize + kMaxContainerBlobs * kVibeContainerEntrySize;
+      char* table = arena.AllocateArray<char>(kTableCapacity);
+      if (!table) return Fail(span, ThumbnailStatus::kOutOfMemory);
+      std::memcpy(table, peeked.data(), peeked.size());
+      size_t have = peeked.size();
+      for (;;) {
+        const ContainerStatus status =
+            ParseVibeContainer(std::string_view(table, have), file_size, &layout, &needed);
+        if (status == ContainerStatus::kOk) break;
+        if (status == ContainerStatus::kInvalid || needed > kTableCapacity) {
+          *bytes_read = have;
+          return Fail(span, ThumbnailStatus::kNoImageField);
+        }
+        size_t read = 0;
+        const bool ok = ReadFully(source, table + have, needed - have, &read);
+        have += read;
+        *bytes_read = have;
+        if (!ok || read == 0) return Fail(span, ThumbnailStatus::kReadFailed);
+      }
+    }
+  }
+
+  ThumbnailCacheKey key;
+  RenderPlan plan{kNoSource, cx};
+  {
+    TraceSpan span(TraceStage::kLocate);
+    span.set_detail("container");
+    bool found[std::size(kFieldNames)] = {};
+    uint32_t edges[std::size(kFieldNames)] = {};
+    for (size_t i = 0; i < std::size(kFieldNames); ++i) {
+      if (const ContainerEntry* entry = layout.find(static_cast<ContainerBlob>(i))) {
+        found[i] = true;
+        edges[i] = std::max(entry->width, entry->height);
+      }
+    }
+    size_t index = SelectSource(found, edges, cx);
+    if (index == kNoSource) return Fail(span, ThumbnailStatus::kNoImageField);
+    if (deadline.enabled()) {
+      // A mapped container's payloads are sniffed in place; a streamed one's are costed as an
+      // unknown format, since they have not been read yet.
+      const size_t other = 1 - index;
+      PlanSource sources[2];
+      size_t source_count = 0;
+      for (const size_t i : {index, other}) {
+        if (!found[i] || (i == other && edges[other] >= edges[index])) continue;
+        const ContainerEntry& candidate = *layout.find(static_cast<ContainerBlob>(i));
+        ImageFormat format = ImageFormat::kUnknown;
+        if (!view.empty()) {
+          format = SniffImageFormat(std::span<const uint8_t>(
+              reinterpret_cast<const uint8_t*>(view.data()) + candidate.offset,
+              std::min<uint64_t>(candidate.length, kImageSignatureBytes)));
+        }
+        sources[source_count++] = {i, {candidate.width, candidate.height}, format, 0};
+      }
+      PlanRender(std::span(sources, source_count), cx, deadline, RenderTier::kFull, &plan);
+      CountRenderTier(plan.tier);
+      if (plan.tier != RenderTier::kFull) span.set_detail(RenderTierName(plan.tier));
+      index = plan.index;
+    }
+    const ContainerEntry& entry = *layout.find(static_cast<ContainerBlob>(index));
+    span.set_bytes(entry.length);
+    // Without a size to check it against, a streamed entry's length is only bounded here.
+    if (static_cast<uint64_t>(entry.width) * entry.height > limits.max_pixels ||
+        entry.length > limits.max_bytes) {
+      return Fail(span, ThumbnailStatus::kTooLarge);
+    }
+
+    if (!view.empty()) {
+      payload = std::span<const uint8_t>(
+          reinterpret_cast<const uint8_t*>(view.data()) + entry.offset, entry.length);
+      *bytes_read = entry.offset + entry.length;
+    } else {
+      TraceSpan read_span(TraceStage::kRead);
+      read_span.set_bytes(entry.length);
+      if (static_cast<size_t>(entry.length) != entry.length) {
+        return Fail(read_span, ThumbnailStatus::kOutOfMemory);
+      }
+      if (!source.Skip(entry.offset - *bytes_read)) {
+        return Fail(read_span, ThumbnailStatus::kReadFailed);
+      }
+      uint8_t* buffer = arena.AllocateArray<uint8_t>(static_cast<size_t>(entry.length));
+      if (!buffer) return Fail(read_span, ThumbnailStatus::kOutOfMemory);
+      size_t read = 0;
+      const bool ok = ReadFully(source, buffer, static_cast<size_t>(entry.length), &read);
+      *bytes_read = entry.offset + read;
+      if (!ok || read != entry.length) return Fail(read_span, ThumbnailStatus::kReadFailed);
+      payload = std::span<const uint8_t>(buffer, read);
+    }
+
+    if (cache) {
+      key = ThumbnailCacheKey::For(std::string_view(
+          reinterpret_cast<const char*>(payload.data()), payload.size()));
+      ThumbnailStatus status;
+      if (ServeFromCache(*cache, key, cx, allocate, span, &status)) return status;
+    }
+  }
+
+  // Payloads are split across the pool at the size their base64 text would have been.
+  WorkStealingPool* pool = nullptr;
+  if (parallel.pool && Base64EncodedSize(payload.size()) >= parallel.min_payload_bytes) {
+    pool = parallel.pool;
+  }
+  return DecodeAndScale({}, payload, SniffImageFormat(payload), cx, plan, decoder, allocate,
+                        limits, cache, key, pool, deadline.costs, arena);
+}
+
+// Binary containers and thumbnail-first JSON are told apart by their first bytes: looked at in
+// place when the source has a view, read and then handed back to the JSON reader when it does
+// not.
+ThumbnailStatus RenderStages(ByteSource& source, uint32_t cx, ImageDecoder& decoder,
+                             const ThumbnailAllocator& allocate, const DecodeLimits& limits,
+                             ThumbnailCache* cache, const ParallelOptions& parallel,
+                             const JsonScanBudget& budget, const RenderDeadline& deadline,
+                             ScratchArena& arena, uint64_t* bytes_read) {
+  const std::string_view view = source.View();
+  if (!view.empty()) {
+    if (IsVibeContainer(view)) {
+      return RenderContainer(source, {}, cx, decoder, allocate, limits, cache, parallel, deadline,
+                             arena, bytes_read);
+    }
+    return RenderJson(source, HasThumbnailFirstLayout(view.substr(0, kLayoutPeekBytes)), cx,
+                      decoder, allocate, limits, cache, parallel, budget, deadline, arena,
+                      bytes_read);
+  }
+
+  // The peek covers the magic, and stops short of where the payload of a container may start.
+  static_assert(kLayoutPeekBytes >= sizeof(kVibeContainerMagic) &&
+                kLayoutPeekBytes <= kVibeContainerHeaderSize + kVibeContainerEntrySize);
+  char peek[kLayoutPeekBytes];
+  size_t peeked = 0;
+  if (!ReadFully(source, peek, sizeof(peek), &peeked)) return ThumbnailStatus::kReadFailed;
+  const std::string_view prefix(peek, peeked);
+  if (IsVibeContainer(prefix)) {
+    *bytes_read = peeked;
+    return RenderContainer(source, prefix, cx, decoder, allocate, limits, cache, parallel,
+                           deadline, arena, bytes_read);
+  }
+  PrefixedByteSource prefixed(prefix, source);
+  return RenderJson(prefixed, HasThumbnailFirstLayout(prefix), cx, decoder, allocate, limits,
+                    cache, parallel, budget, deadline, arena, bytes_read);
+}
+
+}  // namespace
+
+ThumbnailStatus RenderThumbnail(ByteSource& source, uint32_t cx, ImageDecoder& decoder,
+                                const ThumbnailAllocator& allocate, const DecodeLimits& limits,
+                                ThumbnailCache* cache, const ParallelOptions& parallel,
+                                const JsonScanBudget& budget, const RenderDeadline& deadline) {
+  TraceSpan span(TraceStage::kThumbnail);
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  ScratchArena::Scope scope(arena);
+  uint64_t bytes_read = 0;
+  const ThumbnailStatus status =
+      RenderStages(source, cx, decoder, allocate, limits, cache, parallel, budget, deadline, arena,
+                   &bytes_read);
+  span.set_bytes(bytes_read);
+  if (status != ThumbnailStatus::kOk) span.Fail(ThumbnailStatusName(status));
+  return status;
+}
+
+const char* ThumbnailStatusName(ThumbnailStatus status) {
+  switch (status) {
+    case ThumbnailStatus::kOk:
+      return "ok";
+    case ThumbnailStatus::kReadFailed:
+      return "read failed";
+    case ThumbnailStatus::kNoImageField:
+      return "no image field";
+    case ThumbnailStatus::kBadString:
+      return "bad string";
+    case ThumbnailStatus::kBadBase64:
+      return "bad base64";
+    case ThumbnailStatus::kDecodeFailed:
+      return "decode failed";
+    case ThumbnailStatus::kOutOfMemory:
+      return "out of memory";
+    case ThumbnailStatus::kTooLarge:
+      return "too large";
+    case ThumbnailStatus::kBudgetExceeded:
+      return "scan budget exceeded";
+    case ThumbnailStatus::kCancelled:
+      return "cancelled";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "JsonFieldLocator.h"
+#include "RenderDeadline.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace vibe {
+
+class ThumbnailCache;
+class WorkStealingPool;
+
+enum class ThumbnailStatus {
+  kOk,
+  kReadFailed,
+  kNoImageField,
+  kBadString,
+  kBadBase64,
+  kDecodeFailed,
+  kOutOfMemory,
+  // Over the DecodeLimits, judged from the image header before anything was allocated for it.
+  kTooLarge,
+  // The JSON scan ran out of its JsonScanBudget, or was cancelled through it.
+  kBudgetExceeded,
+  kCancelled,
+};
+
+const char* ThumbnailStatusName(ThumbnailStatus status);
+
+// Returns storage for a |width| x |height| premultiplied BGRA thumbnail and its row stride, or
+// null when it cannot be allocated.
+using ThumbnailAllocator = std::function<uint8_t*(uint32_t width, uint32_t height, size_t* stride)>;
+
+// Spreads base64 decoding and the horizontal scaling pass of one large payload over |pool|, for
+// the rare files whose "image" runs to tens of megabytes. Payloads with less than
+// |min_payload_bytes| of base64 text keep the single-threaded path untouched.
+struct ParallelOptions {
+  WorkStealingPool* pool = nullptr;
+  uint64_t min_payload_bytes = uint64_t{8} << 20;
+};
+
+// Strips a "data:image/...;base64," prefix, if any.
+std::string_view StripDataUrlPrefix(std::string_view input);
+
+// The whole GetThumbnail path short of creating the HBITMAP: read |source| until it is settled
+// which payload to use, the smallest of "thumbnail" and "image" whose long edge reaches |cx| as
+// probed from the image headers, base64-decode it, decode the image with |decoder| and scale it
+// so its long edge is at most |cx|, straight into the buffer |allocate| returns. Decoded rows go
+// into the scaler as the decoder produces them, so no full-size frame is held unless the format
+// needs one (interlaced PNG). The file buffer, the decoded payload and decoder temporaries come
+// from the calling thread's ScratchArena; the scaler state and the thumbnail itself are the only
+// heap allocations. Images over |limits| are refused from their headers. With a |cache|, a
+// payload rendered before, at this size or a larger one, is served from it right after the field
+// is located, and fresh renders are added to it. Payloads large enough for |parallel| are base64
+// decoded into a block of their own in parallel chunks, and decoded rows are staged in bands
+// whose horizontal scaling runs concurrently; the thumbnail is the same either way. Locating the
+// fields stops with kBudgetExceeded or kCancelled once |budget| runs out. With a |deadline|,
+// reading stops its decode_reserve early once a field has been found, and the decode is planned
+// to finish in time: a smaller payload, a reduced JPEG decode or the fast filter stand in for the
+// requested render when it would not, and the cheapest of them runs when none would. Degraded
+// renders are not cached.
+ThumbnailStatus RenderThumbnail(ByteSource& source, uint32_t cx, ImageDecoder& decoder,
+                                const ThumbnailAllocator& allocate,
+                                const DecodeLimits& limits = DecodeLimits(),
+                                ThumbnailCache* cache = nullptr,
+                                const ParallelOptions& parallel = ParallelOptions(),
+                                const JsonScanBudget& budget = JsonScanBudget(),
+                                const RenderDeadline& deadline = RenderDeadline());
+
+}  // namespace vibe
@@ -1,22 +1,33 @@
 #include "ThumbnailProvider.h"
 
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "RenderDeadline.h"
+#include "Scaler.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailPipeline.h"
+#include "ThumbnailStore.h"
+#include "WicImageDecoder.h"
+#include "WorkStealingPool.h"
+
+#include <KnownFolders.h>
 #include <Objbase.h>
+#include <ShlGuid.h>
+#include <ShlObj.h>
 #include <Shlwapi.h>
-#include <Wincodec.h>
-#include <Wincrypt.h>
 #include <Windows.h>
 
 #include <algorithm>
-#include <cctype>
+#include <chrono>
+#include <climits>
 #include <cstdint>
+#include <filesystem>
 #include <memory>
-#include <string>
-#include <string_view>
-#include <vector>
+#include <system_error>
+#include <thread>
+#include <utility>
 
-#pragma comment(lib, "Crypt32.lib")
 #pragma comment(lib, "Shlwapi.lib")
-#pragma comment(lib, "Windowscodecs.lib")
 
 const CLSID CLSID_VibeThumbnailProvider = {0x4d2aa77e,
                                            0xf513,
@@ -25,466 +36,185 @@ const CLSID CLSID_VibeThumbnailProvider = {0x4d2aa77e,
 
 namespace {
 
-template <typename T>
-class ComPtr {
+class StreamByteSource final : public vibe::ByteSource {
  public:
-  ComPtr() : ptr_(nullptr) {}
-  ~ComPtr() {
-    if (ptr_) ptr_->Release();
-  }
-
-  ComPtr(const ComPtr&) = delete;
-  ComPtr& operator=(const ComPtr&) = delete;
+  explicit StreamByteSource(IStream* stream) : stream_(stream) {}
 
-  T** operator&() { return &ptr_; }
-  T* get() const { return ptr_; }
-  T* operator->() const { return ptr_; }
-
-  void Attach(T* value) {
-    if (ptr_) ptr_->Release();
-    ptr_ = value;
+  bool Rewind() {
+    LARGE_INTEGER zero = {};
+    ULARGE_INTEGER pos = {};
+    return SUCCEEDED(stream_->Seek(zero, STREAM_SEEK_SET, &pos));
   }
 
- private:
-  T* ptr_;
-};
+  bool Read(void* buffer, size_t capacity, size_t* bytes_read) override {
+    ULONG read = 0;
+    const ULONG request = static_cast<ULONG>(std::min<size_t>(capacity, ULONG_MAX));
+    if (FAILED(stream_->Read(buffer, request, &read))) return false;
+    *bytes_read = read;
+    return true;
+  }
 
-std::string ReadAllBytes(IStream* stream) {
-  LARGE_INTEGER zero = {};
-  ULARGE_INTEGER pos = {};
-  if (FAILED(stream->Seek(zero, STREAM_SEEK_SET, &pos))) {
-    return {};
+  // One seek, so a binary container's payload is reached without reading what comes before it.
+  bool Skip(uint64_t count) override {
+    LARGE_INTEGER move = {};
+    move.QuadPart = static_cast<LONGLONG>(count);
+    ULARGE_INTEGER pos = {};
+    return SUCCEEDED(stream_->Seek(move, STREAM_SEEK_CUR, &pos));
   }
 
-  std::string data;
-  constexpr size_t kChunk = 8192;
-  std::vector<char> buffer(kChunk);
-  while (true) {
-    ULONG read = 0;
-    if (FAILED(stream->Read(buffer.data(), static_cast<ULONG>(buffer.size()), &read))) {
-      return {};
-    }
-    if (read == 0) break;
-    data.append(buffer.data(), read);
+  bool SizeHint(uint64_t* size) override {
+    STATSTG stat = {};
+    if (FAILED(stream_->Stat(&stat, STATFLAG_NONAME))) return false;
+    *size = stat.cbSize.QuadPart;
+    return true;
   }
-  return data;
-}
 
-std::string StripDataUrlPrefix(const std::string& input) {
-  auto comma = input.find(',');
-  if (comma == std::string::npos) return input;
-  return input.substr(comma + 1);
-}
+ private:
+  IStream* stream_;
+};
 
-size_t SkipJsonWhitespace(std::string_view text, size_t pos) {
-  while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) {
-    ++pos;
-  }
-  return pos;
+// Mapped views of files on removable or network volumes can fault when the media goes away, so
+// only fixed local disks take the zero-copy path.
+bool IsOnFixedLocalDrive(const wchar_t* path) {
+  wchar_t root[MAX_PATH] = {};
+  if (!GetVolumePathNameW(path, root, ARRAYSIZE(root))) return false;
+  return GetDriveTypeW(root) == DRIVE_FIXED;
 }
 
+// Optional REG_DWORD overrides of the decode limits and cache budgets, read once per process.
+constexpr wchar_t kSettingsKey[] = L"Software\\naiv4vibe";
 
-size_t SkipOptionalUtf8Bom(std::string_view text, size_t pos) {
-  if (pos + 3 <= text.size() && static_cast<unsigned char>(text[pos]) == 0xEF &&
-      static_cast<unsigned char>(text[pos + 1]) == 0xBB &&
-      static_cast<unsigned char>(text[pos + 2]) == 0xBF) {
-    return pos + 3;
-  }
-  return pos;
+bool ReadSetting(const wchar_t* name, DWORD* value) {
+  DWORD size = sizeof(*value);
+  return RegGetValueW(HKEY_CURRENT_USER, kSettingsKey, name, RRF_RT_REG_DWORD, nullptr, value,
+                      &size) == ERROR_SUCCESS;
 }
 
-bool ParseHex4(std::string_view text, size_t pos, uint16_t* value) {
-  if (!value || pos + 4 > text.size()) return false;
-
-  uint16_t result = 0;
-  for (size_t i = 0; i < 4; ++i) {
-    const unsigned char ch = static_cast<unsigned char>(text[pos + i]);
-    uint16_t nibble = 0;
-    if (ch >= '0' && ch <= '9') {
-      nibble = static_cast<uint16_t>(ch - '0');
-    } else if (ch >= 'A' && ch <= 'F') {
-      nibble = static_cast<uint16_t>(ch - 'A' + 10);
-    } else if (ch >= 'a' && ch <= 'f') {
-      nibble = static_cast<uint16_t>(ch - 'a' + 10);
-    } else {
-      return false;
+const vibe::DecodeLimits& ConfiguredLimits() {
+  static const vibe::DecodeLimits limits = [] {
+    vibe::DecodeLimits configured;
+    DWORD value = 0;
+    if (ReadSetting(L"MaxImagePixels", &value) && value != 0) configured.max_pixels = value;
+    if (ReadSetting(L"MaxDecodeMegabytes", &value) && value != 0) {
+      configured.max_bytes = uint64_t{value} << 20;
     }
-    result = static_cast<uint16_t>((result << 4) | nibble);
-  }
-
-  *value = result;
-  return true;
+    return configured;
+  }();
+  return limits;
 }
 
-void AppendUtf8Codepoint(uint32_t codepoint, std::string* out) {
-  if (!out) return;
-
-  if (codepoint <= 0x7F) {
-    out->push_back(static_cast<char>(codepoint));
-    return;
-  }
-
-  if (codepoint <= 0x7FF) {
-    out->push_back(static_cast<char>(0xC0 | (codepoint >> 6)));
-    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
-    return;
-  }
-
-  if (codepoint <= 0xFFFF) {
-    out->push_back(static_cast<char>(0xE0 | (codepoint >> 12)));
-    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
-    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
-    return;
-  }
-
-  if (codepoint <= 0x10FFFF) {
-    out->push_back(static_cast<char>(0xF0 | (codepoint >> 18)));
-    out->push_back(static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F)));
-    out->push_back(static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F)));
-    out->push_back(static_cast<char>(0x80 | (codepoint & 0x3F)));
+// Bounds the JSON scan of one GetThumbnail call, so a hostile file cannot hold an Explorer
+// thread: MaxJsonTokens caps the tokens walked and ScanTimeoutMilliseconds (default one second,
+// 0 for none) the time spent.
+vibe::JsonScanBudget ScanBudget() {
+  static const vibe::JsonScanBudget configured = [] {
+    vibe::JsonScanBudget budget;
+    DWORD value = 0;
+    if (ReadSetting(L"MaxJsonTokens", &value) && value != 0) budget.max_tokens = value;
+    return budget;
+  }();
+  static const DWORD timeout_ms = [] {
+    DWORD value = 1000;
+    if (!ReadSetting(L"ScanTimeoutMilliseconds", &value)) value = 1000;
+    return value;
+  }();
+  vibe::JsonScanBudget budget = configured;
+  if (timeout_ms != 0) {
+    budget.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
   }
+  return budget;
 }
 
-bool DecodeJsonString(std::string_view text, size_t quote_pos, std::string* out, size_t* end_pos) {
-  if (!out || !end_pos || quote_pos >= text.size() || text[quote_pos] != '"') return false;
-
-  std::string decoded;
-  size_t i = quote_pos + 1;
-  while (i < text.size()) {
-    char ch = text[i++];
-    if (ch == '"') {
-      *out = std::move(decoded);
-      *end_pos = i;
-      return true;
-    }
-
-    if (ch != '\\') {
-      decoded.push_back(ch);
-      continue;
-    }
-
-    if (i >= text.size()) return false;
-    char escaped = text[i++];
-    switch (escaped) {
-      case '"':
-      case '\\':
-      case '/':
-        decoded.push_back(escaped);
-        break;
-      case 'b':
-        decoded.push_back('\b');
-        break;
-      case 'f':
-        decoded.push_back('\f');
-        break;
-      case 'n':
-        decoded.push_back('\n');
-        break;
-      case 'r':
-        decoded.push_back('\r');
-        break;
-      case 't':
-        decoded.push_back('\t');
-        break;
-      case 'u':
-        {
-          uint16_t code_unit = 0;
-          if (!ParseHex4(text, i, &code_unit)) return false;
-          i += 4;
-
-          uint32_t codepoint = code_unit;
-          if (code_unit >= 0xD800 && code_unit <= 0xDBFF) {
-            if (i + 6 > text.size() || text[i] != '\\' || text[i + 1] != 'u') return false;
-            uint16_t low_surrogate = 0;
-            if (!ParseHex4(text, i + 2, &low_surrogate)) return false;
-            if (low_surrogate < 0xDC00 || low_surrogate > 0xDFFF) return false;
-            i += 6;
-
-            codepoint = 0x10000 +
-                        ((static_cast<uint32_t>(code_unit - 0xD800) << 10) |
-                         static_cast<uint32_t>(low_surrogate - 0xDC00));
-          } else if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
-            return false;
-          }
-
-          AppendUtf8Codepoint(codepoint, &decoded);
-        }
-        break;
-      default:
-        return false;
-    }
+// Bounds a whole GetThumbnail call to LatencyBudgetMilliseconds (default 250, 0 for none), past
+// which a cheaper thumbnail is rendered instead. A quarter of it is kept back for decoding. The
+// cost model is shared so it learns what the decoder in use costs on this machine.
+vibe::RenderDeadline LatencyDeadline() {
+  static const DWORD budget_ms = [] {
+    DWORD value = 250;
+    if (!ReadSetting(L"LatencyBudgetMilliseconds", &value)) value = 250;
+    return value;
+  }();
+  static vibe::DecodeCostModel costs;
+  vibe::RenderDeadline deadline;
+  if (budget_ms != 0) {
+    const std::chrono::milliseconds budget(budget_ms);
+    deadline.deadline = std::chrono::steady_clock::now() + budget;
+    deadline.decode_reserve = budget / 4;
+    deadline.costs = &costs;
   }
-
-  return false;
+  return deadline;
 }
 
-bool TryGetJsonStringField(std::string_view json, std::string_view field_name, std::string* value) {
-  if (!value || field_name.empty()) return false;
-
-  constexpr size_t kMaxJsonNestingDepth = 256;
-
-  const auto skip_json_value =
-      [&](auto&& self, size_t pos, size_t depth, size_t* end_pos) -> bool {
-    if (!end_pos || depth > kMaxJsonNestingDepth) return false;
-
-    pos = SkipJsonWhitespace(json, pos);
-    if (pos >= json.size()) return false;
-
-    if (json[pos] == '"') {
-      std::string ignored;
-      return DecodeJsonString(json, pos, &ignored, end_pos);
-    }
-
-    if (json[pos] == '{') {
-      size_t cursor = pos + 1;
-      cursor = SkipJsonWhitespace(json, cursor);
-      if (cursor < json.size() && json[cursor] == '}') {
-        *end_pos = cursor + 1;
-        return true;
-      }
-
-      while (cursor < json.size()) {
-        if (json[cursor] != '"') return false;
-
-        std::string ignored_key;
-        size_t key_end = cursor;
-        if (!DecodeJsonString(json, cursor, &ignored_key, &key_end)) return false;
-        cursor = SkipJsonWhitespace(json, key_end);
-        if (cursor >= json.size() || json[cursor] != ':') return false;
-
-        size_t value_end = cursor;
-        if (!self(self, cursor + 1, depth + 1, &value_end)) return false;
-        cursor = SkipJsonWhitespace(json, value_end);
-        if (cursor >= json.size()) return false;
-        if (json[cursor] == '}') {
-          *end_pos = cursor + 1;
-          return true;
-        }
-        if (json[cursor] != ',') return false;
-        cursor = SkipJsonWhitespace(json, cursor + 1);
-      }
-
-      return false;
-    }
-
-    if (json[pos] == '[') {
-      size_t cursor = pos + 1;
-      cursor = SkipJsonWhitespace(json, cursor);
-      if (cursor < json.size() && json[cursor] == ']') {
-        *end_pos = cursor + 1;
-        return true;
-      }
-
-      while (cursor < json.size()) {
-        size_t element_end = cursor;
-        if (!self(self, cursor, depth + 1, &element_end)) return false;
-        cursor = SkipJsonWhitespace(json, element_end);
-        if (cursor >= json.size()) return false;
-        if (json[cursor] == ']') {
-          *end_pos = cursor + 1;
-          return true;
-        }
-        if (json[cursor] != ',') return false;
-        cursor = SkipJsonWhitespace(json, cursor + 1);
-      }
+// Shared by every provider instance in the process: Explorer asks for the same file at several
+// sizes, and vibe files often embed the same image. A zero budget turns it off.
+size_t CacheBudget() {
+  DWORD megabytes = 64;
+  if (!ReadSetting(L"CacheMegabytes", &megabytes)) megabytes = 64;
+  return size_t{megabytes} << 20;
+}
 
+// Thumbnails kept in %LOCALAPPDATA%\naiv4vibe across surrogate restarts, shared by every
+// surrogate process of the user. A zero StoreMegabytes turns it off; a store that cannot be
+// opened is skipped.
+vibe::ThumbnailStore* ProcessStore() {
+  static vibe::ThumbnailStore store;
+  static const bool opened = [] {
+    DWORD megabytes = 256;
+    if (!ReadSetting(L"StoreMegabytes", &megabytes)) megabytes = 256;
+    if (megabytes == 0) return false;
+    PWSTR local_app_data = nullptr;
+    if (FAILED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &local_app_data))) {
       return false;
     }
-
-    if (json.compare(pos, 4, "true") == 0) {
-      *end_pos = pos + 4;
-      return true;
-    }
-    if (json.compare(pos, 5, "false") == 0) {
-      *end_pos = pos + 5;
-      return true;
-    }
-    if (json.compare(pos, 4, "null") == 0) {
-      *end_pos = pos + 4;
-      return true;
-    }
-
-    size_t cursor = pos;
-    if (json[cursor] == '-') ++cursor;
-    if (cursor >= json.size()) return false;
-
-    if (json[cursor] == '0') {
-      ++cursor;
-    } else {
-      if (!std::isdigit(static_cast<unsigned char>(json[cursor]))) return false;
-      while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
-        ++cursor;
-      }
-    }
-
-    if (cursor < json.size() && json[cursor] == '.') {
-      ++cursor;
-      if (cursor >= json.size() || !std::isdigit(static_cast<unsigned char>(json[cursor]))) {
-        return false;
-      }
-      while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
-        ++cursor;
-      }
-    }
-
-    if (cursor < json.size() && (json[cursor] == 'e' || json[cursor] == 'E')) {
-      ++cursor;
-      if (cursor < json.size() && (json[cursor] == '+' || json[cursor] == '-')) ++cursor;
-      if (cursor >= json.size() || !std::isdigit(static_cast<unsigned char>(json[cursor]))) {
-        return false;
-      }
-      while (cursor < json.size() && std::isdigit(static_cast<unsigned char>(json[cursor]))) {
-        ++cursor;
-      }
-    }
-
-    *end_pos = cursor;
-    return true;
-  };
-
-  size_t cursor = SkipJsonWhitespace(json, 0);
-  cursor = SkipOptionalUtf8Bom(json, cursor);
-  cursor = SkipJsonWhitespace(json, cursor);
-  if (cursor >= json.size() || json[cursor] != '{') return false;
-
-  cursor = SkipJsonWhitespace(json, cursor + 1);
-  if (cursor < json.size() && json[cursor] == '}') return false;
-
-  while (cursor < json.size()) {
-    if (json[cursor] != '"') return false;
-
-    std::string key;
-    size_t key_end = cursor;
-    if (!DecodeJsonString(json, cursor, &key, &key_end)) return false;
-
-    cursor = SkipJsonWhitespace(json, key_end);
-    if (cursor >= json.size() || json[cursor] != ':') return false;
-
-    size_t value_start = SkipJsonWhitespace(json, cursor + 1);
-    if (value_start >= json.size()) return false;
-
-    if (key == field_name && json[value_start] == '"') {
-      size_t value_end = value_start;
-      return DecodeJsonString(json, value_start, value, &value_end);
-    }
-
-    size_t value_end = value_start;
-    if (!skip_json_value(skip_json_value, value_start, 0, &value_end)) return false;
-
-    cursor = SkipJsonWhitespace(json, value_end);
-    if (cursor >= json.size()) return false;
-    if (json[cursor] == '}') return false;
-    if (json[cursor] != ',') return false;
-    cursor = SkipJsonWhitespace(json, cursor + 1);
-  }
-
-  return false;
+    const std::filesystem::path directory = std::filesystem::path(local_app_data) / L"naiv4vibe";
+    CoTaskMemFree(local_app_data);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    return store.Open(directory / L"thumbnails.store", uint64_t{megabytes} << 20);
+  }();
+  return opened ? &store : nullptr;
 }
 
-std::wstring AsciiToWide(const std::string& value) {
-  if (value.empty()) return {};
-  int needed = MultiByteToWideChar(CP_UTF8, 0, value.data(), static_cast<int>(value.size()), nullptr, 0);
-  if (needed <= 0) return {};
-  std::wstring out(needed, L'\0');
-  MultiByteToWideChar(CP_UTF8, 0, value.data(), static_cast<int>(value.size()), out.data(), needed);
-  return out;
-}
-
-std::vector<BYTE> DecodeBase64(const std::string& value) {
-  std::wstring wide = AsciiToWide(value);
-  if (wide.empty()) return {};
-
-  DWORD out_size = 0;
-  if (!CryptStringToBinaryW(wide.c_str(), 0, CRYPT_STRING_BASE64, nullptr, &out_size, nullptr, nullptr)) {
-    return {};
-  }
-
-  std::vector<BYTE> output(out_size);
-  if (!CryptStringToBinaryW(wide.c_str(), 0, CRYPT_STRING_BASE64, output.data(), &out_size, nullptr, nullptr)) {
-    return {};
-  }
-  output.resize(out_size);
-  return output;
+vibe::ThumbnailCache* ProcessCache() {
+  static vibe::ThumbnailCache* const cache = []() -> vibe::ThumbnailCache* {
+    const size_t budget = CacheBudget();
+    if (budget == 0) return nullptr;
+    static vibe::ThumbnailCache instance(budget);
+    instance.set_store(ProcessStore());
+    return &instance;
+  }();
+  return cache;
 }
 
-HRESULT DecodeImageToBitmap(const std::vector<BYTE>& image_data, UINT cx, HBITMAP* out_bitmap) {
-  if (image_data.empty() || !out_bitmap) return E_INVALIDARG;
-
-  ComPtr<IStream> mem_stream;
-  mem_stream.Attach(SHCreateMemStream(image_data.data(), static_cast<UINT>(image_data.size())));
-  if (!mem_stream.get()) return E_FAIL;
-
-  ComPtr<IWICImagingFactory> factory;
-  HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
-                                IID_PPV_ARGS(&factory));
-  if (FAILED(hr)) return hr;
-
-  ComPtr<IWICBitmapDecoder> decoder;
-  hr = factory->CreateDecoderFromStream(mem_stream.get(), nullptr, WICDecodeMetadataCacheOnLoad,
-                                        &decoder);
-  if (FAILED(hr)) return hr;
-
-  ComPtr<IWICBitmapFrameDecode> frame;
-  hr = decoder->GetFrame(0, &frame);
-  if (FAILED(hr)) return hr;
-
-  UINT width = 0;
-  UINT height = 0;
-  hr = frame->GetSize(&width, &height);
-  if (FAILED(hr) || width == 0 || height == 0) return E_FAIL;
-
-  UINT scaled_width = width;
-  UINT scaled_height = height;
-  if (std::max(width, height) > cx && cx > 0) {
-    if (width >= height) {
-      scaled_width = cx;
-      scaled_height = (height * cx) / width;
-    } else {
-      scaled_height = cx;
-      scaled_width = (width * cx) / height;
+// Helpers for the rare payload of tens of megabytes, started on first use. ParallelThreads of
+// zero keeps every render on the calling thread; ParallelMinMegabytes sets what counts as large.
+const vibe::ParallelOptions& ProcessParallel() {
+  static const vibe::ParallelOptions options = [] {
+    vibe::ParallelOptions configured;
+    const DWORD default_threads = std::min(4u, std::thread::hardware_concurrency() / 2);
+    DWORD threads = default_threads;
+    if (!ReadSetting(L"ParallelThreads", &threads)) threads = default_threads;
+    DWORD megabytes = 8;
+    if (ReadSetting(L"ParallelMinMegabytes", &megabytes)) {
+      configured.min_payload_bytes = uint64_t{megabytes} << 20;
     }
+    if (threads > 1) {
+      // Never destroyed, and the module is pinned for as long as its workers run: joining them
+      // from a static destructor would wait under the loader lock, which exiting threads need.
+      ModuleAddRef();
+      configured.pool = new vibe::WorkStealingPool(threads);
+    }
+    return configured;
+  }();
+  return options;
+}
 
-    scaled_width = std::max(1u, scaled_width);
-    scaled_height = std::max(1u, scaled_height);
-  }
-
-  ComPtr<IWICBitmapScaler> scaler;
-  hr = factory->CreateBitmapScaler(&scaler);
-  if (FAILED(hr)) return hr;
-
-  hr = scaler->Initialize(frame.get(), scaled_width, scaled_height, WICBitmapInterpolationModeFant);
-  if (FAILED(hr)) return hr;
-
-  ComPtr<IWICFormatConverter> converter;
-  hr = factory->CreateFormatConverter(&converter);
-  if (FAILED(hr)) return hr;
-
-  hr = converter->Initialize(scaler.get(), GUID_WICPixelFormat32bppPBGRA, WICBitmapDitherTypeNone,
-                             nullptr, 0.0f, WICBitmapPaletteTypeCustom);
-  if (FAILED(hr)) return hr;
-
-  BITMAPINFO bmi = {};
-  bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-  bmi.bmiHeader.biWidth = static_cast<LONG>(scaled_width);
-  bmi.bmiHeader.biHeight = -static_cast<LONG>(scaled_height);
-  bmi.bmiHeader.biPlanes = 1;
-  bmi.bmiHeader.biBitCount = 32;
-  bmi.bmiHeader.biCompression = BI_RGB;
-
-  void* bits = nullptr;
-  HBITMAP hbmp = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
-  if (!hbmp || !bits) return E_OUTOFMEMORY;
-
-  const UINT stride = scaled_width * 4;
-  const UINT image_size = stride * scaled_height;
-  hr = converter->CopyPixels(nullptr, stride, image_size, static_cast<BYTE*>(bits));
-  if (FAILED(hr)) {
-    DeleteObject(hbmp);
-    return hr;
-  }
-
-  *out_bitmap = hbmp;
-  return S_OK;
+std::unique_ptr<vibe::ImageDecoder> CreateImageDecoder() {
+#if defined(NAIV4VIBE_PORTABLE_DECODER)
+  return vibe::CreatePortableImageDecoder();
+#else
+  return std::make_unique<vibe::WicImageDecoder>();
+#endif
 }
 
 }  // namespace
@@ -494,6 +224,8 @@ VibeThumbnailProvider::VibeThumbnailProvider() : ref_count_(1), stream_(nullptr)
 }
 
 VibeThumbnailProvider::~VibeThumbnailProvider() {
+  // Released here, on a thread of the apartment that used it, and before the module may unload.
+  decoder_.reset();
   if (stream_) stream_->Release();
   ModuleRelease();
 }
@@ -505,6 +237,10 @@ IFACEMETHODIMP VibeThumbnailProvider::QueryInterface(REFIID riid, void** ppv) {
     *ppv = static_cast<IThumbnailProvider*>(this);
   } else if (riid == IID_IInitializeWithStream) {
     *ppv = static_cast<IInitializeWithStream*>(this);
+  } else if (riid == IID_IInitializeWithFile) {
+    *ppv = static_cast<IInitializeWithFile*>(this);
+  } else if (riid == IID_IInitializeWithItem) {
+    *ppv = static_cast<IInitializeWithItem*>(this);
   } else {
     *ppv = nullptr;
     return E_NOINTERFACE;
@@ -526,44 +262,100 @@ IFACEMETHODIMP_(ULONG) VibeThumbnailProvider::Release() {
 
 IFACEMETHODIMP VibeThumbnailProvider::Initialize(IStream* pstream, DWORD) {
   if (!pstream) return E_INVALIDARG;
-  if (stream_) return HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED);
+  if (IsInitialized()) return HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED);
 
   stream_ = pstream;
   stream_->AddRef();
   return S_OK;
 }
 
+IFACEMETHODIMP VibeThumbnailProvider::Initialize(LPCWSTR pszFilePath, DWORD) {
+  if (!pszFilePath) return E_INVALIDARG;
+  if (IsInitialized()) return HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED);
+
+  return InitializeFromPath(pszFilePath);
+}
+
+IFACEMETHODIMP VibeThumbnailProvider::Initialize(IShellItem* psi, DWORD) {
+  if (!psi) return E_INVALIDARG;
+  if (IsInitialized()) return HRESULT_FROM_WIN32(ERROR_ALREADY_INITIALIZED);
+
+  PWSTR path = nullptr;
+  if (SUCCEEDED(psi->GetDisplayName(SIGDN_FILESYSPATH, &path))) {
+    HRESULT hr = InitializeFromPath(path);
+    CoTaskMemFree(path);
+    return hr;
+  }
+
+  return psi->BindToHandler(nullptr, BHID_Stream, IID_PPV_ARGS(&stream_));
+}
+
+HRESULT VibeThumbnailProvider::InitializeFromPath(const wchar_t* path) {
+  if (IsOnFixedLocalDrive(path)) {
+    auto mapped = std::make_unique<vibe::MappedFileByteSource>();
+    if (mapped->Open(path)) {
+      mapped_file_ = std::move(mapped);
+      return S_OK;
+    }
+  }
+
+  return SHCreateStreamOnFileEx(path, STGM_READ | STGM_SHARE_DENY_NONE, FILE_ATTRIBUTE_NORMAL,
+                                FALSE, nullptr, &stream_);
+}
+
 IFACEMETHODIMP VibeThumbnailProvider::GetThumbnail(UINT cx, HBITMAP* phbmp, WTS_ALPHATYPE* pdwAlpha) {
-  if (!phbmp || !pdwAlpha || !stream_) return E_INVALIDARG;
+  if (!phbmp || !pdwAlpha || !IsInitialized()) return E_INVALIDARG;
 
   *phbmp = nullptr;
   *pdwAlpha = WTSAT_UNKNOWN;
 
-  std::string json_content = ReadAllBytes(stream_);
-  if (json_content.empty()) return E_FAIL;
-
-  std::string thumbnail;
-  std::string image;
-  const bool has_thumbnail = TryGetJsonStringField(json_content, "thumbnail", &thumbnail);
-  const bool has_image = TryGetJsonStringField(json_content, "image", &image);
-
-  std::string encoded_image;
-  if (has_thumbnail && cx <= 512) {
-    encoded_image = StripDataUrlPrefix(thumbnail);
-  } else if (has_image) {
-    encoded_image = StripDataUrlPrefix(image);
-  } else if (has_thumbnail) {
-    encoded_image = StripDataUrlPrefix(thumbnail);
+  StreamByteSource stream_source(stream_);
+  vibe::ByteSource* source = &stream_source;
+  if (mapped_file_) {
+    source = mapped_file_.get();
+  } else if (!stream_source.Rewind()) {
+    return E_FAIL;
   }
 
-  if (encoded_image.empty()) return E_FAIL;
-
-  std::vector<BYTE> decoded = DecodeBase64(encoded_image);
-  if (decoded.empty()) return E_FAIL;
+  if (!decoder_) decoder_ = CreateImageDecoder();
+
+  HBITMAP hbmp = nullptr;
+  uint8_t* pixels = nullptr;
+  vibe::ImageSize size;
+  auto allocate = [&](uint32_t width, uint32_t height, size_t* stride) -> uint8_t* {
+    if (hbmp) DeleteObject(hbmp);
+    hbmp = nullptr;
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = static_cast<LONG>(width);
+    bmi.bmiHeader.biHeight = -static_cast<LONG>(height);
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = nullptr;
+    hbmp = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, &bits, nullptr, 0);
+    if (!hbmp || !bits) return nullptr;
+    *stride = static_cast<size_t>(width) * 4;
+    pixels = static_cast<uint8_t*>(bits);
+    size = {width, height};
+    return pixels;
+  };
 
-  HRESULT hr = DecodeImageToBitmap(decoded, cx, phbmp);
-  if (FAILED(hr)) return hr;
+  const vibe::ThumbnailStatus status =
+      vibe::RenderThumbnail(*source, cx, *decoder_, allocate, ConfiguredLimits(),
+                            ProcessCache(), ProcessParallel(), ScanBudget(), LatencyDeadline());
+  if (status != vibe::ThumbnailStatus::kOk) {
+    if (hbmp) DeleteObject(hbmp);
+    return status == vibe::ThumbnailStatus::kOutOfMemory ? E_OUTOFMEMORY : E_FAIL;
+  }
 
-  *pdwAlpha = WTSAT_ARGB;
+  // Opaque thumbnails, which most embedded JPEGs and alpha-less PNGs make, are handed over as
+  // such so the shell draws them without blending.
+  *phbmp = hbmp;
+  *pdwAlpha = vibe::IsOpaqueBgra(pixels, size.width, size.height,
+                                 static_cast<size_t>(size.width) * 4)
+                  ? WTSAT_RGB
+                  : WTSAT_ARGB;
   return S_OK;
 }
@@ -1,9 +1,19 @@
 #pragma once
 
+#include <ShObjIdl.h>
 #include <Unknwn.h>
+#include <propsys.h>
 #include <thumbcache.h>
 
-class VibeThumbnailProvider final : public IThumbnailProvider, public IInitializeWithStream {
+#include <memory>
+
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+
+class VibeThumbnailProvider final : public IThumbnailProvider,
+                                    public IInitializeWithStream,
+                                    public IInitializeWithFile,
+                                    public IInitializeWithItem {
  public:
   VibeThumbnailProvider();
 
@@ -15,14 +25,28 @@ class VibeThumbnailProvider final : public IThumbnailProvider, public IInitializ
   // IInitializeWithStream
   IFACEMETHODIMP Initialize(IStream* pstream, DWORD grfMode) override;
 
+  // IInitializeWithFile
+  IFACEMETHODIMP Initialize(LPCWSTR pszFilePath, DWORD grfMode) override;
+
+  // IInitializeWithItem
+  IFACEMETHODIMP Initialize(IShellItem* psi, DWORD grfMode) override;
+
   // IThumbnailProvider
   IFACEMETHODIMP GetThumbnail(UINT cx, HBITMAP* phbmp, WTS_ALPHATYPE* pdwAlpha) override;
 
  private:
   ~VibeThumbnailProvider();
 
+  bool IsInitialized() const { return stream_ || mapped_file_; }
+  HRESULT InitializeFromPath(const wchar_t* path);
+
   long ref_count_;
   IStream* stream_;
+  // Set instead of |stream_| when the host hands over a path on a local disk.
+  std::unique_ptr<vibe::MappedFileByteSource> mapped_file_;
+  // Created by the first GetThumbnail, so the imaging factory and the per-format codec lookups
+  // it caches are shared by every size the host asks this item for.
+  std::unique_ptr<vibe::ImageDecoder> decoder_;
 };
 
 extern const CLSID CLSID_VibeThumbnailProvider;
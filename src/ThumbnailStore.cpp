@@ -0,0 +1,517 @@
+#include "ThumbnailStore.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vibe {
+namespace {
+
+// "NV4VSTOR". The file never leaves the machine, so fields are in native byte order.
+constexpr uint64_t kMagic = 0x524F545356344E56ull;
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kFlagCompacting = 1;
+
+// Two header copies share the first page; the index starts on the next one.
+constexpr uint64_t kHeaderCopyBytes = 256;
+constexpr uint64_t kIndexOffset = 4096;
+constexpr uint64_t kPageBytes = 4096;
+constexpr uint64_t kRecordAlignment = 64;
+// About one index slot per 32 KB of heap: a 96-pixel thumbnail.
+constexpr uint64_t kHeapBytesPerSlot = 32 * 1024;
+constexpr uint64_t kMinSlots = 64;
+
+constexpr uint32_t kSlotEmpty = 0;
+constexpr uint32_t kSlotLive = 1;
+// Removed; probing continues past it.
+constexpr uint32_t kSlotRetired = 2;
+
+uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+uint64_t Checksum(const void* data, size_t size) {
+  return ThumbnailCacheKey::For(std::string_view(static_cast<const char*>(data), size)).hash;
+}
+
+// Orders the stores before it ahead of the ones after it as a crash would observe them; the
+// mapping is shared, so whatever reached it survives the process.
+void PublishBarrier() { std::atomic_signal_fence(std::memory_order_seq_cst); }
+
+}  // namespace
+
+struct ThumbnailStore::Header {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t flags;
+  // Each write goes to copy |sequence| % 2, so a torn write leaves the previous one intact.
+  uint64_t sequence;
+  uint64_t capacity;
+  uint64_t slot_count;
+  uint64_t heap_offset;
+  // Records end here; anything past it is free.
+  uint64_t heap_end;
+  // Bumped on every lookup and insert; slots remember it as their last use.
+  uint64_t tick;
+  uint64_t live;
+  // Live and retired slots, which both lengthen probe chains.
+  uint64_t used;
+  uint64_t checksum;
+};
+
+struct ThumbnailStore::Slot {
+  uint64_t hash;
+  uint64_t payload_size;
+  uint32_t cx;
+  uint32_t width;
+  uint32_t height;
+  uint32_t source_width;
+  uint32_t source_height;
+  uint32_t state;
+  uint64_t offset;
+  uint64_t pixel_checksum;
+  uint64_t last_used;
+  uint64_t checksum;
+
+  uint64_t bytes() const { return static_cast<uint64_t>(width) * height * 4; }
+};
+
+// The process mutex, then the file lock.
+class ThumbnailStore::Lock {
+ public:
+  explicit Lock(ThumbnailStore& store) : store_(store), guard_(store.mutex_) { store_.LockFile(); }
+  ~Lock() { store_.UnlockFile(); }
+
+  Lock(const Lock&) = delete;
+  Lock& operator=(const Lock&) = delete;
+
+ private:
+  ThumbnailStore& store_;
+  std::lock_guard<std::mutex> guard_;
+};
+
+ThumbnailStore::~ThumbnailStore() {
+  Close();
+}
+
+bool ThumbnailStore::Open(const std::filesystem::path& path, uint64_t capacity) {
+  Close();
+  bool resized = false;
+  if (!Map(path, std::max(capacity, kMinCapacity), &resized)) return false;
+
+  Lock lock(*this);
+  Header header;
+  if (resized || !ReadHeader(&header) || header.capacity != size_ ||
+      (header.flags & kFlagCompacting)) {
+    Reset();
+  } else {
+    Rebuild(&header);
+  }
+  return true;
+}
+
+void ThumbnailStore::Close() {
+  Unmap();
+}
+
+#if defined(_WIN32)
+
+bool ThumbnailStore::Map(const std::filesystem::path& path, uint64_t capacity, bool* resized) {
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  file_ = file;
+
+  // Sized under the lock so two processes creating the store at once agree on it.
+  LockFile();
+  LARGE_INTEGER size = {};
+  bool sized = GetFileSizeEx(file, &size) != 0;
+  if (sized && static_cast<uint64_t>(size.QuadPart) != capacity) {
+    // A file another process has mapped cannot be resized; it is then used at its own size.
+    LARGE_INTEGER wanted = {};
+    wanted.QuadPart = static_cast<LONGLONG>(capacity);
+    if (SetFilePointerEx(file, wanted, nullptr, FILE_BEGIN) && SetEndOfFile(file)) {
+      size = wanted;
+      *resized = true;
+    } else {
+      sized = static_cast<uint64_t>(size.QuadPart) >= kMinCapacity;
+    }
+  }
+  UnlockFile();
+  if (!sized || static_cast<unsigned long long>(size.QuadPart) > SIZE_MAX) {
+    Unmap();
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+  if (!mapping) {
+    Unmap();
+    return false;
+  }
+  mapping_ = mapping;
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+  if (!view) {
+    Unmap();
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(view);
+  size_ = static_cast<uint64_t>(size.QuadPart);
+  return true;
+}
+
+void ThumbnailStore::Unmap() {
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(mapping_);
+  if (file_) CloseHandle(file_);
+  data_ = nullptr;
+  mapping_ = nullptr;
+  file_ = nullptr;
+  size_ = 0;
+}
+
+void ThumbnailStore::LockFile() {
+  OVERLAPPED overlapped = {};
+  LockFileEx(file_, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &overlapped);
+}
+
+void ThumbnailStore::UnlockFile() {
+  OVERLAPPED overlapped = {};
+  UnlockFileEx(file_, 0, 1, 0, &overlapped);
+}
+
+#else
+
+bool ThumbnailStore::Map(const std::filesystem::path& path, uint64_t capacity, bool* resized) {
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (fd_ < 0) return false;
+  // Every process with the store mapped holds a shared lock on the companion file, so an
+  // exclusive one means nobody else would see the file shrink under them.
+  std::filesystem::path open_path = path;
+  open_path += ".open";
+  open_fd_ = open(open_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  if (open_fd_ < 0) {
+    Unmap();
+    return false;
+  }
+
+  // Sized under the lock so two processes creating the store at once agree on it.
+  LockFile();
+  struct stat info = {};
+  bool sized = fstat(fd_, &info) == 0 && S_ISREG(info.st_mode);
+  if (sized && static_cast<uint64_t>(info.st_size) != capacity) {
+    // A file another process has mapped is used at its own size, as on Windows.
+    if (flock(open_fd_, LOCK_EX | LOCK_NB) == 0) {
+      sized = ftruncate(fd_, static_cast<off_t>(capacity)) == 0;
+      info.st_size = static_cast<off_t>(capacity);
+      *resized = true;
+    } else {
+      sized = static_cast<uint64_t>(info.st_size) >= kMinCapacity;
+    }
+  }
+  while (flock(open_fd_, LOCK_SH) != 0 && errno == EINTR) {
+  }
+  UnlockFile();
+  if (!sized || static_cast<uint64_t>(info.st_size) > SIZE_MAX) {
+    Unmap();
+    return false;
+  }
+
+  const size_t size = static_cast<size_t>(info.st_size);
+  void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (view == MAP_FAILED) {
+    Unmap();
+    return false;
+  }
+  data_ = static_cast<uint8_t*>(view);
+  size_ = size;
+  return true;
+}
+
+void ThumbnailStore::Unmap() {
+  if (data_) munmap(data_, static_cast<size_t>(size_));
+  if (fd_ >= 0) close(fd_);
+  if (open_fd_ >= 0) close(open_fd_);
+  data_ = nullptr;
+  fd_ = -1;
+  open_fd_ = -1;
+  size_ = 0;
+}
+
+void ThumbnailStore::LockFile() {
+  while (flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+  }
+}
+
+void ThumbnailStore::UnlockFile() {
+  flock(fd_, LOCK_UN);
+}
+
+#endif
+
+bool ThumbnailStore::ReadHeader(Header* header) const {
+  bool found = false;
+  for (uint64_t copy = 0; copy < 2; ++copy) {
+    Header candidate;
+    std::memcpy(&candidate, data_ + copy * kHeaderCopyBytes, sizeof(candidate));
+    if (candidate.magic != kMagic || candidate.version != kVersion ||
+        candidate.checksum != Checksum(&candidate, offsetof(Header, checksum)) ||
+        candidate.sequence % 2 != copy) {
+      continue;
+    }
+    if (!found || candidate.sequence > header->sequence) *header = candidate;
+    found = true;
+  }
+  if (!found) return false;
+
+  // Fields a valid checksum vouches for, but that must also fit this mapping.
+  const uint64_t index_end = kIndexOffset + header->slot_count * sizeof(Slot);
+  return header->capacity <= size_ && header->slot_count >= kMinSlots &&
+         (header->slot_count & (header->slot_count - 1)) == 0 && index_end <= header->heap_offset &&
+         header->heap_offset <= header->heap_end && header->heap_end <= header->capacity;
+}
+
+void ThumbnailStore::WriteHeader(Header* header) {
+  ++header->sequence;
+  header->checksum = Checksum(header, offsetof(Header, checksum));
+  PublishBarrier();
+  std::memcpy(data_ + header->sequence % 2 * kHeaderCopyBytes, header, sizeof(*header));
+  PublishBarrier();
+}
+
+void ThumbnailStore::Reset() {
+  static_assert(sizeof(Header) <= kHeaderCopyBytes);
+  static_assert(sizeof(Slot) == 72, "slots are part of the file format");
+
+  uint64_t slot_count = kMinSlots;
+  while (slot_count * 2 <= size_ / kHeapBytesPerSlot) slot_count *= 2;
+
+  Header header = {};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.capacity = size_;
+  header.slot_count = slot_count;
+  header.heap_offset = AlignUp(kIndexOffset + slot_count * sizeof(Slot), kPageBytes);
+  header.heap_end = header.heap_offset;
+  std::memset(data_, 0, static_cast<size_t>(header.heap_offset));
+  WriteHeader(&header);
+}
+
+void ThumbnailStore::Rebuild(Header* header) {
+  std::vector<Slot> live;
+  Slot* const all = slots();
+  for (uint64_t i = 0; i < header->slot_count; ++i) {
+    if (ValidSlot(*header, all[i])) live.push_back(all[i]);
+  }
+  std::memset(all, 0, static_cast<size_t>(header->slot_count * sizeof(Slot)));
+  header->live = 0;
+  header->used = 0;
+  for (const Slot& slot : live) {
+    header->tick = std::max(header->tick, slot.last_used);
+    PutSlot(header, slot);
+  }
+  WriteHeader(header);
+}
+
+ThumbnailStore::Slot* ThumbnailStore::slots() const {
+  return reinterpret_cast<Slot*>(data_ + kIndexOffset);
+}
+
+ThumbnailStore::Slot* ThumbnailStore::FindSlot(const Header& header, const ThumbnailCacheKey& key,
+                                               uint32_t cx) const {
+  const uint64_t mask = header.slot_count - 1;
+  Slot* const all = slots();
+  for (uint64_t probe = 0, i = (key.hash ^ cx * 0x9E3779B97F4A7C15ull) & mask;
+       probe < header.slot_count; ++probe, i = (i + 1) & mask) {
+    Slot& slot = all[i];
+    if (slot.state == kSlotEmpty) return nullptr;
+    if (slot.state == kSlotLive && slot.hash == key.hash && slot.payload_size == key.size &&
+        slot.cx == cx) {
+      return &slot;
+    }
+  }
+  return nullptr;
+}
+
+bool ThumbnailStore::ValidSlot(const Header& header, const Slot& slot) const {
+  return slot.state == kSlotLive && slot.checksum == Checksum(&slot, offsetof(Slot, checksum)) &&
+         slot.width != 0 && slot.height != 0 && slot.width <= slot.cx && slot.height <= slot.cx &&
+         slot.offset >= header.heap_offset && slot.offset % kRecordAlignment == 0 &&
+         slot.offset <= header.heap_end && slot.bytes() <= header.heap_end - slot.offset;
+}
+
+void ThumbnailStore::PutSlot(Header* header, const Slot& slot) {
+  const uint64_t mask = header->slot_count - 1;
+  Slot* const all = slots();
+  uint64_t i = (slot.hash ^ slot.cx * 0x9E3779B97F4A7C15ull) & mask;
+  while (all[i].state == kSlotLive) i = (i + 1) & mask;
+  if (all[i].state == kSlotEmpty) ++header->used;
+  ++header->live;
+
+  Slot& placed = all[i];
+  placed = slot;
+  placed.state = kSlotLive;
+  placed.checksum = Checksum(&placed, offsetof(Slot, checksum));
+}
+
+void ThumbnailStore::Retire(Header* header, Slot* slot) {
+  slot->state = kSlotRetired;
+  slot->checksum = Checksum(slot, offsetof(Slot, checksum));
+  header->live -= std::min<uint64_t>(header->live, 1);
+  WriteHeader(header);
+}
+
+void ThumbnailStore::Compact(Header* header) {
+  // Slots and heap are rewritten in place; a crash before the flag clears starts the store over.
+  header->flags |= kFlagCompacting;
+  WriteHeader(header);
+
+  std::vector<Slot> kept;
+  Slot* const all = slots();
+  for (uint64_t i = 0; i < header->slot_count; ++i) {
+    if (ValidSlot(*header, all[i])) kept.push_back(all[i]);
+  }
+  std::sort(kept.begin(), kept.end(),
+            [](const Slot& a, const Slot& b) { return a.last_used > b.last_used; });
+  const uint64_t heap_budget = (header->capacity - header->heap_offset) / 2;
+  uint64_t heap_bytes = 0;
+  size_t count = 0;
+  for (; count < kept.size() && count < header->slot_count / 2; ++count) {
+    const uint64_t record = AlignUp(kept[count].bytes(), kRecordAlignment);
+    if (heap_bytes + record > heap_budget) break;
+    heap_bytes += record;
+  }
+  kept.resize(count);
+
+  // Records only move towards the front, so sliding them in heap order never overwrites one that
+  // has yet to move.
+  std::sort(kept.begin(), kept.end(),
+            [](const Slot& a, const Slot& b) { return a.offset < b.offset; });
+  uint64_t cursor = header->heap_offset;
+  for (Slot& slot : kept) {
+    if (slot.offset != cursor) {
+      std::memmove(data_ + cursor, data_ + slot.offset, static_cast<size_t>(slot.bytes()));
+    }
+    slot.offset = cursor;
+    cursor += AlignUp(slot.bytes(), kRecordAlignment);
+  }
+
+  std::memset(all, 0, static_cast<size_t>(header->slot_count * sizeof(Slot)));
+  header->live = 0;
+  header->used = 0;
+  for (const Slot& slot : kept) PutSlot(header, slot);
+  header->heap_end = cursor;
+  header->flags &= ~kFlagCompacting;
+  WriteHeader(header);
+  compactions_.fetch_add(1, std::memory_order_relaxed);
+}
+
+CacheLookup ThumbnailStore::Lookup(const ThumbnailCacheKey& key, uint32_t cx,
+                                   const ThumbnailAllocator& allocate, StoredThumbnail* found) {
+  if (!data_) return CacheLookup::kMiss;
+  Lock lock(*this);
+  Header header;
+  Slot* slot = ReadHeader(&header) ? FindSlot(header, key, cx) : nullptr;
+  if (slot && (!ValidSlot(header, *slot) ||
+               Checksum(data_ + slot->offset, static_cast<size_t>(slot->bytes())) !=
+                   slot->pixel_checksum)) {
+    // Damaged, or left behind by a crash and written over since.
+    Retire(&header, slot);
+    slot = nullptr;
+  }
+  if (!slot) {
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return CacheLookup::kMiss;
+  }
+
+  size_t stride = 0;
+  uint8_t* dest = allocate(slot->width, slot->height, &stride);
+  if (!dest) return CacheLookup::kOutOfMemory;
+  const size_t row_bytes = static_cast<size_t>(slot->width) * 4;
+  const uint8_t* pixels = data_ + slot->offset;
+  for (uint32_t y = 0; y < slot->height; ++y) {
+    std::memcpy(dest + y * stride, pixels + y * row_bytes, row_bytes);
+  }
+  *found = {slot->source_width, slot->source_height, slot->width, slot->height, dest, stride};
+
+  slot->last_used = ++header.tick;
+  slot->checksum = Checksum(slot, offsetof(Slot, checksum));
+  WriteHeader(&header);
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return CacheLookup::kHit;
+}
+
+bool ThumbnailStore::Insert(const ThumbnailCacheKey& key, uint32_t cx, uint32_t source_width,
+                            uint32_t source_height, const uint8_t* pixels, uint32_t width,
+                            uint32_t height, size_t stride) {
+  if (!data_ || width == 0 || height == 0 || width > cx || height > cx) return false;
+  Lock lock(*this);
+  Header header;
+  if (!ReadHeader(&header)) return false;
+  if (FindSlot(header, key, cx)) return true;
+
+  const size_t row_bytes = static_cast<size_t>(width) * 4;
+  const uint64_t record = AlignUp(static_cast<uint64_t>(row_bytes) * height, kRecordAlignment);
+  // Compaction keeps up to half the heap, so anything larger could never be placed.
+  if (record > (header.capacity - header.heap_offset) / 2) return false;
+  if (record > header.capacity - header.heap_end ||
+      (header.used + 1) * 4 > header.slot_count * 3) {
+    Compact(&header);
+  }
+
+  Slot slot = {};
+  slot.hash = key.hash;
+  slot.payload_size = key.size;
+  slot.cx = cx;
+  slot.width = width;
+  slot.height = height;
+  slot.source_width = source_width;
+  slot.source_height = source_height;
+  slot.offset = header.heap_end;
+  uint8_t* const record_start = data_ + slot.offset;
+  for (uint32_t y = 0; y < height; ++y) {
+    std::memcpy(record_start + y * row_bytes, pixels + y * stride, row_bytes);
+  }
+  slot.pixel_checksum = Checksum(record_start, row_bytes * height);
+  slot.last_used = ++header.tick;
+
+  // Pixels, then the slot, then the header that takes them into the heap.
+  PublishBarrier();
+  PutSlot(&header, slot);
+  PublishBarrier();
+  header.heap_end += record;
+  WriteHeader(&header);
+  insertions_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+ThumbnailStoreStats ThumbnailStore::stats() {
+  ThumbnailStoreStats stats;
+  stats.hits = hits_.load(std::memory_order_relaxed);
+  stats.misses = misses_.load(std::memory_order_relaxed);
+  stats.insertions = insertions_.load(std::memory_order_relaxed);
+  stats.compactions = compactions_.load(std::memory_order_relaxed);
+  if (!data_) return stats;
+  Lock lock(*this);
+  Header header;
+  if (ReadHeader(&header)) {
+    stats.entries = header.live;
+    stats.heap_bytes = header.heap_end - header.heap_offset;
+  }
+  return stats;
+}
+
+}  // namespace vibe
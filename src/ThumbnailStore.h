@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ThumbnailCache.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+namespace vibe {
+
+struct ThumbnailStoreStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t insertions = 0;
+  uint64_t compactions = 0;
+  // Read from the file, so they include what other processes stored.
+  uint64_t entries = 0;
+  uint64_t heap_bytes = 0;
+};
+
+// A thumbnail found in the store, already copied into storage from the caller's allocator.
+struct StoredThumbnail {
+  uint32_t source_width = 0;
+  uint32_t source_height = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t* pixels = nullptr;
+  size_t stride = 0;
+};
+
+// Rendered thumbnails kept across process restarts in one memory-mapped file of fixed size: two
+// checksummed header copies, an open-addressed index of checksummed slots keyed by payload and
+// |cx|, and an append-only heap of premultiplied pixels. Lookups copy straight from the mapping
+// into the caller's buffer.
+//
+// A crash at any point leaves the file usable: pixels are written before the slot that points to
+// them and the slot before the header that covers them, every slot carries a checksum of its
+// pixels, and a compaction interrupted halfway empties the store on the next open. When the heap
+// or the index fills up, the most recently used half is kept and slid down to the front.
+//
+// Calls are serialized by a mutex within the process and by a lock on the file across processes,
+// so several surrogate processes can share one store.
+class ThumbnailStore {
+ public:
+  static constexpr uint64_t kMinCapacity = uint64_t{1} << 20;
+
+  ThumbnailStore() = default;
+  ~ThumbnailStore();
+
+  ThumbnailStore(const ThumbnailStore&) = delete;
+  ThumbnailStore& operator=(const ThumbnailStore&) = delete;
+
+  // Opens |path|, or creates it at |capacity| bytes. A file of another size is resized to
+  // |capacity| and starts over empty, as does a damaged one. A file another process has mapped
+  // keeps its size and contents, so processes sharing the store should open it at the same
+  // capacity. On POSIX the lock file "<path>.open" is left next to it.
+  bool Open(const std::filesystem::path& path, uint64_t capacity);
+  void Close();
+  bool is_open() const { return data_ != nullptr; }
+
+  // Copies the |cx| thumbnail of |key| into storage from |allocate|.
+  CacheLookup Lookup(const ThumbnailCacheKey& key, uint32_t cx, const ThumbnailAllocator& allocate,
+                     StoredThumbnail* found);
+
+  // Appends a thumbnail unless the same payload and |cx| is already stored. Returns false when
+  // it does not fit even after compacting.
+  bool Insert(const ThumbnailCacheKey& key, uint32_t cx, uint32_t source_width,
+              uint32_t source_height, const uint8_t* pixels, uint32_t width, uint32_t height,
+              size_t stride);
+
+  ThumbnailStoreStats stats();
+
+ private:
+  struct Header;
+  struct Slot;
+  class Lock;
+
+  // Maps |path| at |capacity| bytes, setting |*resized| when the file had another size.
+  bool Map(const std::filesystem::path& path, uint64_t capacity, bool* resized);
+  void Unmap();
+  void LockFile();
+  void UnlockFile();
+
+  // The newer of the two header copies whose checksum holds, if it fits the mapping.
+  bool ReadHeader(Header* header) const;
+  // Writes |header| over the older copy under the next sequence number.
+  void WriteHeader(Header* header);
+  // Empties the store.
+  void Reset();
+  // Drops slots that fail their checks and rehashes the rest.
+  void Rebuild(Header* header);
+  Slot* slots() const;
+  Slot* FindSlot(const Header& header, const ThumbnailCacheKey& key, uint32_t cx) const;
+  bool ValidSlot(const Header& header, const Slot& slot) const;
+  void PutSlot(Header* header, const Slot& slot);
+  void Retire(Header* header, Slot* slot);
+  // Keeps the most recently used entries that fit half the heap and half the index, slid down
+  // to the front of the heap.
+  void Compact(Header* header);
+
+  uint8_t* data_ = nullptr;
+  uint64_t size_ = 0;
+#if defined(_WIN32)
+  void* file_ = nullptr;
+  void* mapping_ = nullptr;
+#else
+  int fd_ = -1;
+  // "<path>.open", share-locked for as long as the store is mapped.
+  int open_fd_ = -1;
+#endif
+
+  std::mutex mutex_;
+  std::atomic<uint64_t> hits_{0};
+  std::atomic<uint64_t> misses_{0};
+  std::atomic<uint64_t> insertions_{0};
+  std::atomic<uint64_t> compactions_{0};
+};
+
+}  // namespace vibe
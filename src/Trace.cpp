@@ -0,0 +1,307 @@
+#include "Trace.h"
+
+#if defined(NAIV4VIBE_TRACING)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <TraceLoggingProvider.h>
+#pragma comment(lib, "advapi32.lib")
+
+// Name-derived GUID, so sessions can enable the provider as "*Naiv4Vibe.ThumbnailProvider".
+TRACELOGGING_DEFINE_PROVIDER(g_etw_provider, "Naiv4Vibe.ThumbnailProvider",
+                             (0xef882276, 0x5d63, 0x50e9, 0x3f, 0xfd, 0xef, 0x2d, 0x67, 0x13,
+                              0x0e, 0x17));
+#else
+#include <unistd.h>
+#endif
+
+#endif
+
+namespace vibe {
+
+const char* TraceStageName(TraceStage stage) {
+  switch (stage) {
+    case TraceStage::kThumbnail:
+      return "thumbnail";
+    case TraceStage::kRead:
+      return "read";
+    case TraceStage::kLocate:
+      return "locate";
+    case TraceStage::kBase64:
+      return "base64";
+    case TraceStage::kDecode:
+      return "decode";
+    case TraceStage::kAllocate:
+      return "allocate";
+    case TraceStage::kScale:
+      return "scale";
+    case TraceStage::kCount:
+      break;
+  }
+  return "unknown";
+}
+
+#if defined(NAIV4VIBE_TRACING)
+
+namespace {
+
+constexpr size_t kRingCapacity = 1024;
+constexpr uint64_t kDumpIntervalNs = 1'000'000'000;
+
+// One event, published seqlock style: |sequence| is 0 while the owner rewrites the slot and
+// the event's 1-based index once it is complete, so readers can drop torn copies.
+struct TraceSlot {
+  std::atomic<uint64_t> sequence{0};
+  std::atomic<uint64_t> start_ns{0};
+  std::atomic<uint64_t> duration_ns{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<const char*> detail{nullptr};
+  std::atomic<const char*> failure{nullptr};
+  std::atomic<uint8_t> stage{0};
+};
+
+struct StageCounters {
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> failures{0};
+  std::atomic<uint64_t> nanoseconds{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+// Single-writer ring owned by one thread at a time. Rings are never freed: a thread that exits
+// hands its ring back, with its history, to the next thread that needs one.
+struct TraceRing {
+  std::atomic<bool> in_use{true};
+  uint32_t thread_index = 0;
+  TraceRing* next = nullptr;
+  uint64_t written = 0;
+  StageCounters counters[kTraceStageCount];
+  TraceSlot slots[kRingCapacity];
+};
+
+std::atomic<TraceRing*> g_rings{nullptr};
+std::atomic<uint32_t> g_ring_count{0};
+
+TraceRing* AcquireRing() {
+  for (TraceRing* ring = g_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+    bool expected = false;
+    if (ring->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+      return ring;
+    }
+  }
+
+  TraceRing* ring = new (std::nothrow) TraceRing();
+  if (!ring) return nullptr;
+  ring->thread_index = g_ring_count.fetch_add(1, std::memory_order_relaxed) + 1;
+  ring->next = g_rings.load(std::memory_order_relaxed);
+  while (!g_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+  }
+  return ring;
+}
+
+struct ThreadRing {
+  TraceRing* ring = AcquireRing();
+  ~ThreadRing() {
+    if (ring) ring->in_use.store(false, std::memory_order_release);
+  }
+};
+
+thread_local ThreadRing t_ring;
+
+// Only the owning thread writes, so plain load + store is enough to keep the totals exact.
+void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void Append(TraceRing& ring, const TraceRecord& record) {
+  TraceSlot& slot = ring.slots[ring.written % kRingCapacity];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start_ns.store(record.start_ns, std::memory_order_relaxed);
+  slot.duration_ns.store(record.duration_ns, std::memory_order_relaxed);
+  slot.bytes.store(record.bytes, std::memory_order_relaxed);
+  slot.detail.store(record.detail, std::memory_order_relaxed);
+  slot.failure.store(record.failure, std::memory_order_relaxed);
+  slot.stage.store(static_cast<uint8_t>(record.stage), std::memory_order_relaxed);
+  slot.sequence.store(++ring.written, std::memory_order_release);
+
+  StageCounters& counters = ring.counters[static_cast<size_t>(record.stage)];
+  Add(counters.calls, 1);
+  if (record.failure) Add(counters.failures, 1);
+  Add(counters.nanoseconds, record.duration_ns);
+  Add(counters.bytes, record.bytes);
+}
+
+struct Event {
+  TraceRecord record;
+  uint32_t thread_index = 0;
+};
+
+void CollectEvents(std::vector<Event>* events) {
+  for (TraceRing* ring = g_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+    for (TraceSlot& slot : ring->slots) {
+      const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+      if (sequence == 0) continue;
+      Event event;
+      event.thread_index = ring->thread_index;
+      event.record.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+      event.record.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+      event.record.bytes = slot.bytes.load(std::memory_order_relaxed);
+      event.record.detail = slot.detail.load(std::memory_order_relaxed);
+      event.record.failure = slot.failure.load(std::memory_order_relaxed);
+      event.record.stage = static_cast<TraceStage>(slot.stage.load(std::memory_order_relaxed));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+      events->push_back(event);
+    }
+  }
+}
+
+unsigned long ProcessId() {
+#if defined(_WIN32)
+  return GetCurrentProcessId();
+#else
+  return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// NAIV4VIBE_TRACE names the Chrome trace file; "%p" in it becomes the process id, so the
+// several surrogate processes Explorer starts do not overwrite each other.
+std::filesystem::path ChromeTracePathFromEnvironment() {
+#if defined(_WIN32)
+  wchar_t buffer[MAX_PATH];
+  const DWORD length = GetEnvironmentVariableW(L"NAIV4VIBE_TRACE", buffer, MAX_PATH);
+  if (length == 0 || length >= MAX_PATH) return {};
+  std::wstring value(buffer, length);
+  const std::wstring pid = std::to_wstring(ProcessId());
+  for (size_t pos; (pos = value.find(L"%p")) != std::wstring::npos;) value.replace(pos, 2, pid);
+#else
+  const char* variable = std::getenv("NAIV4VIBE_TRACE");
+  if (!variable || !*variable) return {};
+  std::string value = variable;
+  const std::string pid = std::to_string(ProcessId());
+  for (size_t pos; (pos = value.find("%p")) != std::string::npos;) value.replace(pos, 2, pid);
+#endif
+  return value;
+}
+
+struct ChromeTraceDump {
+  std::filesystem::path path = ChromeTracePathFromEnvironment();
+  std::mutex mutex;
+  uint64_t last_dump_ns = 0;
+
+  ~ChromeTraceDump() {
+    if (!path.empty()) WriteChromeTrace(path);
+  }
+
+  void MaybeWrite(uint64_t now_ns) {
+    if (path.empty()) return;
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock() || now_ns - last_dump_ns < kDumpIntervalNs) return;
+    last_dump_ns = now_ns;
+    WriteChromeTrace(path);
+  }
+};
+
+ChromeTraceDump& Dump() {
+  static ChromeTraceDump dump;
+  return dump;
+}
+
+#if defined(_WIN32)
+
+struct EtwRegistration {
+  EtwRegistration() { TraceLoggingRegister(g_etw_provider); }
+  ~EtwRegistration() { TraceLoggingUnregister(g_etw_provider); }
+};
+
+EtwRegistration g_etw_registration;
+
+void WriteEtwEvent(const TraceRecord& record) {
+  if (!TraceLoggingProviderEnabled(g_etw_provider, 0, 0)) return;
+  TraceLoggingWrite(g_etw_provider, "Stage",
+                    TraceLoggingString(TraceStageName(record.stage), "Stage"),
+                    TraceLoggingUInt64(record.duration_ns, "DurationNs"),
+                    TraceLoggingUInt64(record.bytes, "Bytes"),
+                    TraceLoggingString(record.detail ? record.detail : "", "Detail"),
+                    TraceLoggingString(record.failure ? record.failure : "", "Failure"));
+}
+
+#endif
+
+}  // namespace
+
+uint64_t TraceNowNs() {
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                   std::chrono::steady_clock::now().time_since_epoch())
+                                   .count());
+}
+
+void RecordTrace(const TraceRecord& record) {
+  if (TraceRing* ring = t_ring.ring) Append(*ring, record);
+#if defined(_WIN32)
+  WriteEtwEvent(record);
+#endif
+  if (record.stage == TraceStage::kThumbnail) {
+    Dump().MaybeWrite(record.start_ns + record.duration_ns);
+  }
+}
+
+void SnapshotTraceCounters(TraceStageCounters (&counters)[kTraceStageCount]) {
+  for (TraceStageCounters& stage : counters) stage = {};
+  for (TraceRing* ring = g_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+    for (size_t i = 0; i < kTraceStageCount; ++i) {
+      const StageCounters& source = ring->counters[i];
+      counters[i].calls += source.calls.load(std::memory_order_relaxed);
+      counters[i].failures += source.failures.load(std::memory_order_relaxed);
+      counters[i].nanoseconds += source.nanoseconds.load(std::memory_order_relaxed);
+      counters[i].bytes += source.bytes.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool WriteChromeTrace(const std::filesystem::path& path) {
+  std::vector<Event> events;
+  CollectEvents(&events);
+  std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+    return a.record.start_ns < b.record.start_ns;
+  });
+
+#if defined(_WIN32)
+  std::FILE* file = _wfopen(path.c_str(), L"wb");
+#else
+  std::FILE* file = std::fopen(path.c_str(), "wb");
+#endif
+  if (!file) return false;
+
+  const unsigned long pid = ProcessId();
+  std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceRecord& record = events[i].record;
+    std::fprintf(file,
+                 "%s\n{\"name\":\"%s\",\"cat\":\"naiv4vibe\",\"ph\":\"X\",\"ts\":%.3f,"
+                 "\"dur\":%.3f,\"pid\":%lu,\"tid\":%u,\"args\":{\"bytes\":%llu",
+                 i ? "," : "", TraceStageName(record.stage), record.start_ns / 1000.0,
+                 record.duration_ns / 1000.0, pid, events[i].thread_index,
+                 static_cast<unsigned long long>(record.bytes));
+    if (record.detail) std::fprintf(file, ",\"detail\":\"%s\"", record.detail);
+    if (record.failure) std::fprintf(file, ",\"failure\":\"%s\"", record.failure);
+    std::fprintf(file, "}}");
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+#endif
+
+}  // namespace vibe
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace vibe {
+
+// Spans recorded around each stage of RenderThumbnail. Built with NAIV4VIBE_TRACING, every span
+// costs two clock reads and a store into the calling thread's ring; without it TraceSpan is an
+// empty class and the calls compile away.
+enum class TraceStage : uint8_t {
+  kThumbnail,  // A whole RenderThumbnail call.
+  kRead,
+  kLocate,
+  kBase64,
+  kDecode,
+  kAllocate,
+  kScale,
+  kCount,
+};
+
+constexpr size_t kTraceStageCount = static_cast<size_t>(TraceStage::kCount);
+
+const char* TraceStageName(TraceStage stage);
+
+struct TraceStageCounters {
+  uint64_t calls = 0;
+  uint64_t failures = 0;
+  uint64_t nanoseconds = 0;
+  uint64_t bytes = 0;
+};
+
+#if defined(NAIV4VIBE_TRACING)
+
+constexpr bool kTracingEnabled = true;
+
+struct TraceRecord {
+  TraceStage stage = TraceStage::kThumbnail;
+  uint64_t start_ns = 0;
+  uint64_t duration_ns = 0;
+  uint64_t bytes = 0;
+  // Static strings: what the stage worked on (the chosen field, the decoder) and why it failed.
+  const char* detail = nullptr;
+  const char* failure = nullptr;
+};
+
+uint64_t TraceNowNs();
+
+// Appends |record| to the calling thread's ring, forwards it to ETW when a session listens and,
+// for whole-thumbnail records, refreshes the NAIV4VIBE_TRACE dump at most once a second.
+void RecordTrace(const TraceRecord& record);
+
+class TraceSpan {
+ public:
+  explicit TraceSpan(TraceStage stage) {
+    record_.stage = stage;
+    record_.start_ns = TraceNowNs();
+  }
+  ~TraceSpan() {
+    record_.duration_ns = TraceNowNs() - record_.start_ns;
+    RecordTrace(record_);
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  void set_bytes(uint64_t bytes) { record_.bytes = bytes; }
+  void set_detail(const char* detail) { record_.detail = detail; }
+  void Fail(const char* reason) { record_.failure = reason; }
+
+ private:
+  TraceRecord record_;
+};
+
+// Per-stage totals over every thread since the process started.
+void SnapshotTraceCounters(TraceStageCounters (&counters)[kTraceStageCount]);
+
+// Writes the events still held in the rings as Chrome trace JSON (chrome://tracing, Perfetto).
+bool WriteChromeTrace(const std::filesystem::path& path);
+
+#else
+
+constexpr bool kTracingEnabled = false;
+
+class TraceSpan {
+ public:
+  explicit TraceSpan(TraceStage) {}
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+  void set_bytes(uint64_t) {}
+  void set_detail(const char*) {}
+  void Fail(const char*) {}
+};
+
+inline void SnapshotTraceCounters(TraceStageCounters (&counters)[kTraceStageCount]) {
+  for (TraceStageCounters& stage : counters) stage = {};
+}
+
+inline bool WriteChromeTrace(const std::filesystem::path&) { return false; }
+
+#endif
+
+}  // namespace vibe
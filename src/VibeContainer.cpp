@@ -0,0 +1,255 @@
+#include "VibeContainer.h"
+
+#include "Base64.h"
+#include "ImageProbe.h"
+#include "JsonFieldLocator.h"
+#include "ThumbnailPipeline.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace vibe {
+namespace {
+
+constexpr std::string_view kBlobNames[] = {"thumbnail", "image"};
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t blob_count;
+  uint64_t metadata_offset;
+  uint64_t metadata_length;
+};
+
+struct Entry {
+  uint32_t kind;
+  uint32_t width;
+  uint32_t height;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t length;
+  uint64_t splice;
+};
+
+static_assert(sizeof(Header) == kVibeContainerHeaderSize, "the header is part of the file format");
+static_assert(sizeof(Entry) == kVibeContainerEntrySize, "entries are part of the file format");
+
+// Whether [offset, offset + length) lies within |size|.
+bool InRange(uint64_t offset, uint64_t length, uint64_t size) {
+  return offset <= size && length <= size - offset;
+}
+
+struct Extracted {
+  ContainerBlob kind;
+  // The base64 text in the JSON, after any data URL prefix.
+  size_t begin = 0;
+  size_t end = 0;
+  std::vector<uint8_t> bytes;
+  ImageSize size;
+};
+
+// The payload of |span| as raw bytes, if encoding them again gives back exactly its text.
+bool Extract(std::string_view json, const JsonStringSpan& span, ContainerBlob kind,
+             Extracted* out) {
+  if (span.has_escapes) return false;
+  const std::string_view text = StripDataUrlPrefix(span.raw);
+  if (text.empty()) return false;
+
+  std::vector<uint8_t> bytes(Base64DecodedSizeUpperBound(text.size()));
+  const Base64Result decoded = DecodeBase64(text, bytes.data(), bytes.size());
+  if (decoded.status != Base64Status::kOk || Base64EncodedSize(decoded.written) != text.size()) {
+    return false;
+  }
+  bytes.resize(decoded.written);
+  std::string encoded(text.size(), '\0');
+  EncodeBase64(bytes, encoded.data());
+  if (encoded != text) return false;
+
+  out->kind = kind;
+  out->begin = static_cast<size_t>(text.data() - json.data());
+  out->end = out->begin + text.size();
+  size_t needed = 0;
+  if (ProbeImageSize(bytes, &out->size, &needed) != ProbeStatus::kOk) out->size = {};
+  out->bytes = std::move(bytes);
+  return true;
+}
+
+}  // namespace
+
+const ContainerEntry* ContainerLayout::find(ContainerBlob kind) const {
+  for (uint32_t i = 0; i < blob_count; ++i) {
+    if (entries[i].kind == kind) return &entries[i];
+  }
+  return nullptr;
+}
+
+bool IsVibeContainer(std::string_view prefix) {
+  return prefix.size() >= sizeof(kVibeContainerMagic) &&
+         std::memcmp(prefix.data(), kVibeContainerMagic, sizeof(kVibeContainerMagic)) == 0;
+}
+
+ContainerStatus ParseVibeContainer(std::string_view bytes, uint64_t file_size,
+                                   ContainerLayout* layout, size_t* needed) {
+  if (!layout || !needed) return ContainerStatus::kInvalid;
+  if (bytes.size() < kVibeContainerHeaderSize) {
+    *needed = kVibeContainerHeaderSize;
+    return ContainerStatus::kNeedMore;
+  }
+  Header header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (!IsVibeContainer(bytes) || header.version != kVibeContainerVersion ||
+      header.blob_count > kMaxContainerBlobs) {
+    return ContainerStatus::kInvalid;
+  }
+  const size_t table_end =
+      kVibeContainerHeaderSize + size_t{header.blob_count} * kVibeContainerEntrySize;
+  if (bytes.size() < table_end) {
+    *needed = table_end;
+    return ContainerStatus::kNeedMore;
+  }
+  if (!InRange(header.metadata_offset, header.metadata_length, file_size) ||
+      header.metadata_offset < table_end) {
+    return ContainerStatus::kInvalid;
+  }
+
+  ContainerLayout parsed;
+  parsed.blob_count = header.blob_count;
+  parsed.metadata_offset = header.metadata_offset;
+  parsed.metadata_length = header.metadata_length;
+  for (uint32_t i = 0; i < header.blob_count; ++i) {
+    Entry entry;
+    std::memcpy(&entry, bytes.data() + kVibeContainerHeaderSize + i * kVibeContainerEntrySize,
+                sizeof(entry));
+    if (entry.kind >= std::size(kBlobNames) || entry.length == 0 ||
+        !InRange(entry.offset, entry.length, file_size) || entry.offset < table_end ||
+        entry.splice > header.metadata_length) {
+      return ContainerStatus::kInvalid;
+    }
+    ContainerEntry& out = parsed.entries[i];
+    out.kind = static_cast<ContainerBlob>(entry.kind);
+    if (parsed.find(out.kind) != &out) return ContainerStatus::kInvalid;
+    out.width = entry.width;
+    out.height = entry.height;
+    out.offset = entry.offset;
+    out.length = entry.length;
+    out.splice = entry.splice;
+  }
+  *layout = parsed;
+  return ContainerStatus::kOk;
+}
+
+bool ConvertJsonToContainer(std::string_view json, std::string* out) {
+  if (!out) return false;
+  // A converter reads whole files on purpose; only the provider needs a bound.
+  JsonScanBudget budget;
+  budget.max_tokens = std::numeric_limits<uint64_t>::max();
+  JsonFieldScanner scanner(kBlobNames, budget);
+  JsonFieldScanner::Status status;
+  while ((status = scanner.Feed(json, true)) == JsonFieldScanner::Status::kFieldFound) {
+  }
+  if (status != JsonFieldScanner::Status::kDone) return false;
+
+  std::vector<Extracted> blobs;
+  for (size_t i = 0; i < std::size(kBlobNames); ++i) {
+    const JsonStringSpan span = scanner.field(i, json);
+    if (!span.found) continue;
+    Extracted extracted;
+    if (!Extract(json, span, static_cast<ContainerBlob>(i), &extracted)) return false;
+    blobs.push_back(std::move(extracted));
+  }
+
+  // Cut the payloads out of the JSON in document order, noting where each one goes back.
+  std::sort(blobs.begin(), blobs.end(),
+            [](const Extracted& a, const Extracted& b) { return a.begin < b.begin; });
+  std::string metadata;
+  std::vector<uint64_t> splices;
+  size_t copied = 0;
+  for (const Extracted& blob : blobs) {
+    metadata.append(json.substr(copied, blob.begin - copied));
+    splices.push_back(metadata.size());
+    copied = blob.end;
+  }
+  metadata.append(json.substr(copied));
+
+  std::vector<size_t> order(blobs.size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return blobs[a].bytes.size() < blobs[b].bytes.size(); });
+
+  const size_t table_end = kVibeContainerHeaderSize + blobs.size() * kVibeContainerEntrySize;
+  Header header = {};
+  std::memcpy(header.magic, kVibeContainerMagic, sizeof(header.magic));
+  header.version = kVibeContainerVersion;
+  header.blob_count = static_cast<uint32_t>(blobs.size());
+  uint64_t offset = table_end;
+  std::vector<Entry> entries;
+  for (const size_t i : order) {
+    const Extracted& blob = blobs[i];
+    Entry entry = {};
+    entry.kind = static_cast<uint32_t>(blob.kind);
+    entry.width = blob.size.width;
+    entry.height = blob.size.height;
+    entry.offset = offset;
+    entry.length = blob.bytes.size();
+    entry.splice = splices[i];
+    entries.push_back(entry);
+    offset += blob.bytes.size();
+  }
+  header.metadata_offset = offset;
+  header.metadata_length = metadata.size();
+
+  out->clear();
+  out->reserve(static_cast<size_t>(offset) + metadata.size());
+  out->append(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (const Entry& entry : entries) {
+    out->append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+  }
+  for (const size_t i : order) {
+    out->append(reinterpret_cast<const char*>(blobs[i].bytes.data()), blobs[i].bytes.size());
+  }
+  out->append(metadata);
+  return true;
+}
+
+bool ConvertContainerToJson(std::string_view container, std::string* out) {
+  if (!out) return false;
+  ContainerLayout layout;
+  size_t needed = 0;
+  if (ParseVibeContainer(container, container.size(), &layout, &needed) != ContainerStatus::kOk) {
+    return false;
+  }
+
+  std::vector<const ContainerEntry*> entries;
+  uint64_t encoded_size = 0;
+  for (uint32_t i = 0; i < layout.blob_count; ++i) {
+    entries.push_back(&layout.entries[i]);
+    encoded_size += Base64EncodedSize(static_cast<size_t>(layout.entries[i].length));
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const ContainerEntry* a, const ContainerEntry* b) { return a->splice < b->splice; });
+
+  const std::string_view metadata = container.substr(
+      static_cast<size_t>(layout.metadata_offset), static_cast<size_t>(layout.metadata_length));
+  out->clear();
+  out->reserve(metadata.size() + static_cast<size_t>(encoded_size));
+  size_t copied = 0;
+  for (const ContainerEntry* entry : entries) {
+    const size_t splice = static_cast<size_t>(entry->splice);
+    out->append(metadata.substr(copied, splice - copied));
+    const size_t length = static_cast<size_t>(entry->length);
+    const size_t at = out->size();
+    out->resize(at + Base64EncodedSize(length));
+    EncodeBase64(std::span<const uint8_t>(
+                     reinterpret_cast<const uint8_t*>(container.data() + entry->offset), length),
+                 out->data() + at);
+    copied = splice;
+  }
+  out->append(metadata.substr(copied));
+  return true;
+}
+
+}  // namespace vibe
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace vibe {
+
+// Binary form of a vibe file: the "thumbnail" and "image" payloads stored as raw image bytes
+// behind a small offset table, followed by the original JSON with those two values cut out.
+// Thumbnails then need no JSON scan and no base64 decode, and the file is about a quarter
+// smaller. Conversion is lossless both ways.
+//
+//   header   32 bytes   magic, version, blob count, metadata offset and length
+//   table    40 bytes   per blob: kind, probed width and height, offset, length, splice point
+//   blobs               raw image bytes, smallest first, so streams reach the thumbnail soonest
+//   metadata            the JSON text; each blob's base64 goes back in at its splice point
+//
+// Integers are little-endian.
+constexpr char kVibeContainerMagic[8] = {'\x89', 'N', 'V', '4', 'B', '\r', '\n', '\x1A'};
+constexpr uint32_t kVibeContainerVersion = 1;
+constexpr size_t kVibeContainerHeaderSize = 32;
+constexpr size_t kVibeContainerEntrySize = 40;
+constexpr uint32_t kMaxContainerBlobs = 2;
+
+// Matches the order the pipeline keeps its fields in.
+enum class ContainerBlob : uint32_t {
+  kThumbnail = 0,
+  kImage = 1,
+};
+
+struct ContainerEntry {
+  ContainerBlob kind = ContainerBlob::kThumbnail;
+  // Probed from the image header when converting; 0 x 0 when it could not be.
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint64_t offset = 0;
+  uint64_t length = 0;
+  // Offset into the metadata where the blob's base64 text was taken out.
+  uint64_t splice = 0;
+};
+
+struct ContainerLayout {
+  uint32_t blob_count = 0;
+  ContainerEntry entries[kMaxContainerBlobs];
+  uint64_t metadata_offset = 0;
+  uint64_t metadata_length = 0;
+
+  // The first |blob_count| entries of |kind|, or null.
+  const ContainerEntry* find(ContainerBlob kind) const;
+};
+
+enum class ContainerStatus {
+  kOk,
+  // |bytes| ends inside the header or table; |needed| says how much to supply.
+  kNeedMore,
+  kInvalid,
+};
+
+// True when |prefix| starts with the container magic.
+bool IsVibeContainer(std::string_view prefix);
+
+// Reads the header and table from the start of |bytes|, checking every range against
+// |file_size|. Returns kNeedMore with |needed| set while |bytes| is too short.
+ContainerStatus ParseVibeContainer(std::string_view bytes, uint64_t file_size,
+                                   ContainerLayout* layout, size_t* needed);
+
+// Moves the "thumbnail" and "image" payloads of |json| into a container. Fails when |json| is not
+// a well-formed object as far as the scan for the payloads goes, or when a payload would not come
+// back byte for byte (escaped, wrapped or non-canonical base64); such files stay JSON.
+bool ConvertJsonToContainer(std::string_view json, std::string* out);
+
+// The original JSON of a container.
+bool ConvertContainerToJson(std::string_view container, std::string* out);
+
+}  // namespace vibe
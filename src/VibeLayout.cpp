@@ -0,0 +1,214 @@
+#include "VibeLayout.h"
+
+#include "Base64.h"
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "ImageFormat.h"
+#include "ImageProbe.h"
+#include "JsonFieldLocator.h"
+#include "PngEncoder.h"
+#include "Scaler.h"
+#include "ThumbnailPipeline.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace vibe {
+namespace {
+
+constexpr std::string_view kThumbnailKey = "thumbnail";
+// Decoded from the start of the thumbnail to read its header, growing for JPEGs with large APPn
+// segments ahead of the frame.
+constexpr size_t kHeaderChars = 512;
+constexpr size_t kMaxHeaderChars = 256 * 1024;
+constexpr size_t kMaxEscapeLength = 12;
+
+bool KeyIs(const JsonMember& member, std::string_view key, std::string* storage) {
+  if (!member.key_has_escapes) return member.key == key;
+  return UnescapeJsonString(member.key, storage) && *storage == key;
+}
+
+// The "thumbnailInfo" member for the thumbnail string |field|. Only the start of the payload is
+// unescaped and decoded.
+bool DescribeThumbnail(const JsonStringSpan& field, std::string* info) {
+  ImageSize size;
+  const char* mime = nullptr;
+  std::string unescaped;
+  for (size_t chars = kHeaderChars;;) {
+    std::string_view prefix = field.raw.substr(0, chars);
+    const bool whole = prefix.size() == field.raw.size();
+    if (field.has_escapes) {
+      // A prefix may end inside an escape; "\uD83D\uDE00" is the longest.
+      for (size_t trimmed = 0; !UnescapeJsonString(prefix, &unescaped); ++trimmed) {
+        if (whole || trimmed == kMaxEscapeLength) return false;
+        prefix.remove_suffix(1);
+      }
+      prefix = unescaped;
+    }
+    const std::string_view encoded = StripDataUrlPrefix(prefix);
+    std::vector<uint8_t> header(Base64DecodedSizeUpperBound(encoded.size()));
+    // A prefix cut inside a quantum fails the decode, but everything before it is still good.
+    const Base64Result decoded = DecodeBase64(encoded, header.data(), header.size());
+    const std::span<const uint8_t> bytes(header.data(), decoded.written);
+    size_t needed = 0;
+    const ProbeStatus status = ProbeImageSize(bytes, &size, &needed);
+    if (status == ProbeStatus::kOk) {
+      mime = ImageFormatMimeType(SniffImageFormat(bytes));
+      break;
+    }
+    if (status != ProbeStatus::kNeedMore || whole || chars >= kMaxHeaderChars) return false;
+    chars = std::min(kMaxHeaderChars, std::max(chars * 4, needed / 3 * 4 + kHeaderChars));
+  }
+  if (!mime) return false;
+
+  char text[128];
+  const int length =
+      std::snprintf(text, sizeof(text), "\"%.*s\":{\"width\":%u,\"height\":%u,\"mime\":\"%s\"}",
+                    static_cast<int>(kThumbnailInfoKey.size()), kThumbnailInfoKey.data(),
+                    size.width, size.height, mime);
+  info->assign(text, static_cast<size_t>(length));
+  return true;
+}
+
+// A "thumbnail" member holding a |cx| PNG rendered from |json|'s "image".
+bool GenerateThumbnail(std::string_view json, uint32_t cx, ImageDecoder& decoder,
+                       std::string* member) {
+  std::vector<uint8_t> pixels;
+  ImageSize size;
+  const ThumbnailAllocator allocate = [&](uint32_t width, uint32_t height, size_t* stride) {
+    size = {width, height};
+    *stride = static_cast<size_t>(width) * 4;
+    pixels.assign(*stride * height, 0);
+    return pixels.data();
+  };
+  MemoryByteSource source(json);
+  if (RenderThumbnail(source, cx, decoder, allocate) != ThumbnailStatus::kOk) return false;
+  const size_t stride = static_cast<size_t>(size.width) * 4;
+  const bool opaque = IsOpaqueBgra(pixels.data(), size.width, size.height, stride);
+  for (uint32_t y = 0; y < size.height && !opaque; ++y) {
+    uint8_t* row = pixels.data() + y * stride;
+    UnpremultiplyBgraRow(row, size.width, row);
+  }
+  const std::vector<uint8_t> png =
+      EncodePng(pixels.data(), size.width, size.height, stride, !opaque);
+
+  member->assign("\"");
+  member->append(kThumbnailKey);
+  member->append("\":\"");
+  const size_t at = member->size();
+  member->resize(at + Base64EncodedSize(png.size()));
+  EncodeBase64(png, member->data() + at);
+  member->push_back('"');
+  return true;
+}
+
+}  // namespace
+
+LayoutStatus RewriteVibeLayout(std::string_view json, const LayoutOptions& options,
+                               const LayoutWriter& write) {
+  // The whole file is rewritten, so only its well-formedness bounds the walk.
+  JsonScanBudget budget;
+  budget.max_tokens = std::numeric_limits<uint64_t>::max();
+  std::vector<JsonMember> members;
+  if (!ListJsonMembers(json, &members, budget)) return LayoutStatus::kNotAnObject;
+
+  // The first string "thumbnail" is the one the provider reads; every "thumbnailInfo" is
+  // replaced by the one written here.
+  std::string key;
+  const JsonMember* thumbnail = nullptr;
+  std::vector<bool> moved(members.size(), false);
+  for (size_t i = 0; i < members.size(); ++i) {
+    const JsonMember& member = members[i];
+    if (KeyIs(member, kThumbnailInfoKey, &key)) {
+      moved[i] = true;
+    } else if (!thumbnail && json[member.value_begin] == '"' &&
+               KeyIs(member, kThumbnailKey, &key)) {
+      thumbnail = &member;
+      moved[i] = true;
+    }
+  }
+
+  std::string generated;
+  std::string_view thumbnail_text;
+  JsonStringSpan field;
+  field.found = true;
+  if (thumbnail) {
+    thumbnail_text = json.substr(thumbnail->begin, thumbnail->end - thumbnail->begin);
+    field.raw =
+        json.substr(thumbnail->value_begin + 1, thumbnail->end - thumbnail->value_begin - 2);
+    field.has_escapes = field.raw.find('\\') != std::string_view::npos;
+  } else {
+    if (options.generate_cx == 0 || !options.decoder) return LayoutStatus::kNoThumbnail;
+    if (!GenerateThumbnail(json, options.generate_cx, *options.decoder, &generated)) {
+      return LayoutStatus::kBadThumbnail;
+    }
+    thumbnail_text = generated;
+    // Between the quotes after "thumbnail":
+    field.raw = thumbnail_text.substr(kThumbnailKey.size() + 4);
+    field.raw.remove_suffix(1);
+  }
+  std::string info;
+  if (!DescribeThumbnail(field, &info)) return LayoutStatus::kBadThumbnail;
+
+  // The object's opening and the first separator are reused for the members put in front, and
+  // every member that stays keeps the separator it had unless what preceded it moved.
+  const size_t first = members.empty() ? json.rfind('}') : members.front().begin;
+  const std::string_view separator =
+      members.size() > 1 ? json.substr(members[0].end, members[1].begin - members[0].end) : ",";
+  if (!write(json.substr(0, first)) || !write(info) || !write(separator) ||
+      !write(thumbnail_text)) {
+    return LayoutStatus::kWriteFailed;
+  }
+  for (size_t i = 0; i < members.size(); ++i) {
+    if (moved[i]) continue;
+    const bool kept_neighbour = i > 0 && !moved[i - 1];
+    const std::string_view gap =
+        kept_neighbour ? json.substr(members[i - 1].end, members[i].begin - members[i - 1].end)
+                       : separator;
+    if (!write(gap) || !write(json.substr(members[i].begin, members[i].end - members[i].begin))) {
+      return LayoutStatus::kWriteFailed;
+    }
+  }
+  const size_t tail = members.empty() ? first : members.back().end;
+  return write(json.substr(tail)) ? LayoutStatus::kOk : LayoutStatus::kWriteFailed;
+}
+
+bool HasThumbnailFirstLayout(std::string_view prefix) {
+  size_t pos = 0;
+  constexpr std::string_view kBom = "\xEF\xBB\xBF";
+  const auto skip_whitespace = [&] {
+    while (pos < prefix.size() && (prefix[pos] == ' ' || prefix[pos] == '\t' ||
+                                   prefix[pos] == '\r' || prefix[pos] == '\n')) {
+      ++pos;
+    }
+  };
+  skip_whitespace();
+  if (prefix.substr(pos).starts_with(kBom)) pos += kBom.size();
+  skip_whitespace();
+  if (pos >= prefix.size() || prefix[pos] != '{') return false;
+  ++pos;
+  skip_whitespace();
+  return prefix.substr(pos).starts_with("\"thumbnailInfo\"");
+}
+
+const char* LayoutStatusName(LayoutStatus status) {
+  switch (status) {
+    case LayoutStatus::kOk:
+      return "ok";
+    case LayoutStatus::kNotAnObject:
+      return "not a JSON object";
+    case LayoutStatus::kNoThumbnail:
+      return "no thumbnail";
+    case LayoutStatus::kBadThumbnail:
+      return "bad thumbnail";
+    case LayoutStatus::kWriteFailed:
+      return "write failed";
+  }
+  return "unknown";
+}
+
+}  // namespace vibe
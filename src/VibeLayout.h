@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace vibe {
+
+class ImageDecoder;
+
+// A vibe file rewritten so a thumbnail can be read from its first few tens of KB: the top-level
+// object opens with "thumbnailInfo", {"width", "height", "mime"} of the thumbnail, and then
+// "thumbnail" itself. Every other member follows in its original order, byte for byte; only the
+// separators next to the moved members may change.
+constexpr std::string_view kThumbnailInfoKey = "thumbnailInfo";
+// Enough of the start of a file to tell whether it has this layout.
+constexpr size_t kLayoutPeekBytes = 64;
+
+struct LayoutOptions {
+  // Renders a thumbnail this size from "image" for files that have none; 0 leaves them failing
+  // with kNoThumbnail.
+  uint32_t generate_cx = 0;
+  // Decodes "image" when a thumbnail is generated.
+  ImageDecoder* decoder = nullptr;
+};
+
+enum class LayoutStatus {
+  kOk,
+  kNotAnObject,
+  kNoThumbnail,
+  // The thumbnail's size or format could not be read from its header, or generating one failed.
+  kBadThumbnail,
+  kWriteFailed,
+};
+
+const char* LayoutStatusName(LayoutStatus status);
+
+// Takes the output in pieces; returns false to stop.
+using LayoutWriter = std::function<bool(std::string_view)>;
+
+// Writes |json| in the thumbnail-first layout through |write|. The output is assembled from
+// slices of |json| and a few small generated pieces, so heap use does not grow with the file;
+// a generated thumbnail additionally needs what rendering "image" takes. Rewriting a file that
+// already has the layout gives it back unchanged.
+LayoutStatus RewriteVibeLayout(std::string_view json, const LayoutOptions& options,
+                               const LayoutWriter& write);
+
+// True when |prefix|, the start of a file, opens its top-level object with "thumbnailInfo".
+bool HasThumbnailFirstLayout(std::string_view prefix);
+
+}  // namespace vibe
@@ -0,0 +1,232 @@
+#include "WicImageDecoder.h"
+
+#include "Base64Stream.h"
+#include "ScratchArena.h"
+
+#include <Objbase.h>
+#include <Shlwapi.h>
+#include <Windows.h>
+
+#include <algorithm>
+#include <climits>
+
+#pragma comment(lib, "Shlwapi.lib")
+#pragma comment(lib, "Windowscodecs.lib")
+
+namespace vibe {
+namespace {
+
+// Rows converted to BGRA per CopyPixels call.
+constexpr UINT kBandRows = 16;
+
+DecodeStatus StatusFromHresult(HRESULT hr) {
+  if (hr == E_OUTOFMEMORY) return DecodeStatus::kOutOfMemory;
+  if (hr == WINCODEC_ERR_COMPONENTNOTFOUND) return DecodeStatus::kUnsupported;
+  return DecodeStatus::kCorrupt;
+}
+
+const GUID* ContainerFormat(ImageFormat format) {
+  switch (format) {
+    case ImageFormat::kPng:
+      return &GUID_ContainerFormatPng;
+    case ImageFormat::kJpeg:
+      return &GUID_ContainerFormatJpeg;
+    case ImageFormat::kWebp:
+      return &GUID_ContainerFormatWebp;
+    case ImageFormat::kGif:
+      return &GUID_ContainerFormatGif;
+    case ImageFormat::kBmp:
+      return &GUID_ContainerFormatBmp;
+    case ImageFormat::kUnknown:
+      break;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+DecodeStatus WicImageDecoder::DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                                         uint32_t min_long_edge, ImageRowSink* sink) {
+  if (data.empty() || data.size() > UINT_MAX) return DecodeStatus::kCorrupt;
+
+  ComPtr<IStream> mem_stream;
+  mem_stream.Attach(SHCreateMemStream(data.data(), static_cast<UINT>(data.size())));
+  if (!mem_stream.get()) return DecodeStatus::kOutOfMemory;
+  return DecodeStream(mem_stream.get(), format, min_long_edge, sink);
+}
+
+DecodeStatus WicImageDecoder::DecodeBase64Rows(std::string_view encoded, ImageFormat format,
+                                               uint32_t min_long_edge, ImageRowSink* sink) {
+  if (encoded.empty()) return DecodeStatus::kCorrupt;
+
+  ComPtr<IStream> stream;
+  if (FAILED(Base64Stream::Create(encoded, &stream))) return DecodeStatus::kOutOfMemory;
+  return DecodeStream(stream.get(), format, min_long_edge, sink);
+}
+
+HRESULT WicImageDecoder::CreateDecoder(IStream* stream, ImageFormat format,
+                                       IWICBitmapDecoder** decoder) {
+  const GUID* container = ContainerFormat(format);
+  if (container) {
+    ComPtr<IWICBitmapDecoderInfo>& info = decoder_info_[static_cast<size_t>(format)];
+    ComPtr<IWICBitmapDecoder> direct;
+    HRESULT hr = S_OK;
+    if (info.get()) {
+      hr = info->CreateInstance(&direct);
+    } else {
+      hr = factory_->CreateDecoder(*container, nullptr, &direct);
+      if (SUCCEEDED(hr)) direct->GetDecoderInfo(&info);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = direct->Initialize(stream, WICDecodeMetadataCacheOnLoad);
+      if (SUCCEEDED(hr)) {
+        *decoder = direct.get();
+        (*decoder)->AddRef();
+        return S_OK;
+      }
+      if (hr == E_OUTOFMEMORY) return hr;
+    }
+    // The codec may be missing or the signature wrong; let WIC look at the stream from the start.
+    const LARGE_INTEGER start = {};
+    if (FAILED(stream->Seek(start, STREAM_SEEK_SET, nullptr))) return hr;
+  }
+  return factory_->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnLoad,
+                                           decoder);
+}
+
+bool WicImageDecoder::ReducedSize(IWICBitmapFrameDecode* frame, uint32_t min_long_edge,
+                                  IWICBitmapSourceTransform** transform, UINT* width,
+                                  UINT* height) {
+  const uint32_t scale = SelectDecodeScale(*width, *height, min_long_edge);
+  if (scale == 1) return false;
+
+  ComPtr<IWICBitmapSourceTransform> source_transform;
+  if (FAILED(frame->QueryInterface(IID_PPV_ARGS(&source_transform)))) return false;
+  UINT target_width = (*width + scale - 1) / scale;
+  UINT target_height = (*height + scale - 1) / scale;
+  if (FAILED(source_transform->GetClosestSize(&target_width, &target_height)) ||
+      target_width >= *width || std::max(target_width, target_height) < min_long_edge) {
+    return false;
+  }
+  *width = target_width;
+  *height = target_height;
+  *transform = source_transform.get();
+  (*transform)->AddRef();
+  return true;
+}
+
+bool WicImageDecoder::IsOpaqueFormat(IWICBitmapFrameDecode* frame) {
+  WICPixelFormatGUID format = {};
+  ComPtr<IWICComponentInfo> info;
+  ComPtr<IWICPixelFormatInfo2> pixel_format;
+  BOOL transparency = TRUE;
+  return SUCCEEDED(frame->GetPixelFormat(&format)) &&
+         SUCCEEDED(factory_->CreateComponentInfo(format, &info)) &&
+         SUCCEEDED(info->QueryInterface(IID_PPV_ARGS(&pixel_format))) &&
+         SUCCEEDED(pixel_format->SupportsTransparency(&transparency)) && !transparency;
+}
+
+bool WicImageDecoder::DecodeReduced(IWICBitmapSourceTransform* transform, UINT width,
+                                    UINT height, IWICBitmap** reduced) {
+  // The transform hands out pixels in a format of the codec's choosing; they land in a memory
+  // bitmap that is then converted to BGRA like a full frame.
+  WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+  if (FAILED(transform->GetClosestPixelFormat(&format))) return false;
+  ComPtr<IWICBitmap> bitmap;
+  if (FAILED(factory_->CreateBitmap(width, height, format, WICBitmapCacheOnLoad, &bitmap))) {
+    return false;
+  }
+  {
+    ComPtr<IWICBitmapLock> lock;
+    const WICRect all = {0, 0, static_cast<INT>(width), static_cast<INT>(height)};
+    UINT stride = 0;
+    UINT size = 0;
+    BYTE* pixels = nullptr;
+    if (FAILED(bitmap->Lock(&all, WICBitmapLockWrite, &lock)) ||
+        FAILED(lock->GetStride(&stride)) || FAILED(lock->GetDataPointer(&size, &pixels)) ||
+        FAILED(transform->CopyPixels(nullptr, width, height, &format, WICBitmapTransformRotate0,
+                                     stride, size, pixels))) {
+      return false;
+    }
+  }
+  *reduced = bitmap.get();
+  (*reduced)->AddRef();
+  return true;
+}
+
+DecodeStatus WicImageDecoder::DecodeStream(IStream* stream, ImageFormat format,
+                                           uint32_t min_long_edge, ImageRowSink* sink) {
+  HRESULT hr = S_OK;
+  if (!factory_.get()) {
+    hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                          IID_PPV_ARGS(&factory_));
+    if (FAILED(hr)) return DecodeStatus::kUnsupported;
+  }
+
+  ComPtr<IWICBitmapDecoder> decoder;
+  hr = CreateDecoder(stream, format, &decoder);
+  if (FAILED(hr)) return StatusFromHresult(hr);
+
+  ComPtr<IWICBitmapFrameDecode> frame;
+  hr = decoder->GetFrame(0, &frame);
+  if (FAILED(hr)) return StatusFromHresult(hr);
+
+  UINT width = 0;
+  UINT height = 0;
+  hr = frame->GetSize(&width, &height);
+  if (FAILED(hr)) return StatusFromHresult(hr);
+  if (width == 0 || height == 0) return DecodeStatus::kCorrupt;
+  if (width > kMaxImageDimension || height > kMaxImageDimension ||
+      static_cast<uint64_t>(width) * height > kMaxImagePixels) {
+    return DecodeStatus::kTooLarge;
+  }
+
+  // The reduced decode runs before the sink hears the size, so a transform that fails leaves the
+  // full frame to fall back to.
+  ComPtr<IWICBitmapSourceTransform> transform;
+  ComPtr<IWICBitmap> reduced;
+  IWICBitmapSource* source = frame.get();
+  UINT out_width = width;
+  UINT out_height = height;
+  if (ReducedSize(frame.get(), min_long_edge, &transform, &out_width, &out_height)) {
+    if (DecodeReduced(transform.get(), out_width, out_height, &reduced)) {
+      source = reduced.get();
+    } else {
+      out_width = width;
+      out_height = height;
+    }
+  }
+  const size_t stride = static_cast<size_t>(out_width) * 4;
+  ImageLayout layout = {out_width, out_height, width, height, stride * kBandRows,
+                        IsOpaqueFormat(frame.get())};
+  if (reduced.get()) layout.working_bytes += stride * out_height;
+  const DecodeStatus status = sink->Begin(layout);
+  if (status != DecodeStatus::kOk) return status;
+
+  // WIC only unpacks to straight BGRA here; premultiplying happens while scaling.
+  ComPtr<IWICFormatConverter> converter;
+  hr = factory_->CreateFormatConverter(&converter);
+  if (FAILED(hr)) return StatusFromHresult(hr);
+
+  hr = converter->Initialize(source, GUID_WICPixelFormat32bppBGRA, WICBitmapDitherTypeNone,
+                             nullptr, 0.0f, WICBitmapPaletteTypeCustom);
+  if (FAILED(hr)) return StatusFromHresult(hr);
+
+  if (stride * kBandRows > UINT_MAX) return DecodeStatus::kTooLarge;
+  ScratchArena& arena = ScratchArena::ForCurrentThread();
+  ScratchArena::Scope scope(arena);
+  uint8_t* band = arena.AllocateArray<uint8_t>(stride * kBandRows);
+  if (!band) return DecodeStatus::kOutOfMemory;
+  for (UINT y = 0; y < out_height; y += kBandRows) {
+    const UINT rows = std::min(kBandRows, out_height - y);
+    const WICRect rect = {0, static_cast<INT>(y), static_cast<INT>(out_width),
+                          static_cast<INT>(rows)};
+    hr = converter->CopyPixels(&rect, static_cast<UINT>(stride), static_cast<UINT>(stride * rows),
+                               band);
+    if (FAILED(hr)) return StatusFromHresult(hr);
+    for (UINT row = 0; row < rows; ++row) sink->PushRow(band + row * stride);
+  }
+  return DecodeStatus::kOk;
+}
+
+}  // namespace vibe
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ComPtr.h"
+#include "ImageDecoder.h"
+
+#include <Wincodec.h>
+
+namespace vibe {
+
+// Decodes through the Windows Imaging Component, so every codec installed on the system works.
+// The imaging factory is created on first use and kept for the decoder's lifetime, as is the
+// decoder info of each format once it has been used, so a payload of known format gets its codec
+// without WIC trying every installed one against the stream.
+class WicImageDecoder final : public ImageDecoder {
+ public:
+  const char* name() const override { return "wic"; }
+  DecodeStatus DecodeRows(std::span<const uint8_t> data, ImageFormat format,
+                          uint32_t min_long_edge, ImageRowSink* sink) override;
+
+  // WIC reads from an IStream, so the payload is handed over as a Base64Stream.
+  bool decodes_base64() const override { return true; }
+  DecodeStatus DecodeBase64Rows(std::string_view encoded, ImageFormat format,
+                                uint32_t min_long_edge, ImageRowSink* sink) override;
+
+ private:
+  // Converts the frame to BGRA a band of rows at a time. The codec may still buffer the whole
+  // frame internally; only the conversion is bounded here.
+  DecodeStatus DecodeStream(IStream* stream, ImageFormat format, uint32_t min_long_edge,
+                            ImageRowSink* sink);
+  // A decoder for |stream| from the codec of |format|, falling back to WIC's own detection when
+  // the format is unknown or its codec refuses the stream.
+  HRESULT CreateDecoder(IStream* stream, ImageFormat format, IWICBitmapDecoder** decoder);
+  // Asks the codec itself for a reduced frame through IWICBitmapSourceTransform, which the JPEG
+  // codec serves by DCT scaling. Returns false, leaving |*width| x |*height| alone, when the
+  // codec cannot.
+  bool ReducedSize(IWICBitmapFrameDecode* frame, uint32_t min_long_edge,
+                   IWICBitmapSourceTransform** transform, UINT* width, UINT* height);
+  // True when |frame|'s pixel format cannot carry transparency at all.
+  bool IsOpaqueFormat(IWICBitmapFrameDecode* frame);
+  bool DecodeReduced(IWICBitmapSourceTransform* transform, UINT width, UINT height,
+                     IWICBitmap** reduced);
+
+  ComPtr<IWICImagingFactory> factory_;
+  ComPtr<IWICBitmapDecoderInfo> decoder_info_[kImageFormatCount];
+};
+
+}  // namespace vibe
@@ -0,0 +1,132 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+namespace vibe {
+namespace {
+
+// Which pool and worker the current thread belongs to, so nested submissions stay local.
+thread_local const WorkStealingPool* current_pool = nullptr;
+thread_local size_t current_worker = 0;
+
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < threads; ++i) workers_.push_back(std::make_unique<Worker>());
+  for (unsigned i = 0; i < threads; ++i) threads_.emplace_back([this, i] { Run(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  for (std::thread& thread : threads_) thread.join();
+}
+
+void WorkStealingPool::Submit(Task task) {
+  size_t target = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    target = current_pool == this ? current_worker : next_worker_++ % workers_.size();
+    ++pending_;
+    ++queued_;
+  }
+  {
+    Worker& worker = *workers_[target];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+  work_available_.notify_one();
+}
+
+void WorkStealingPool::ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+  if (count <= 1 || workers_.empty()) {
+    for (size_t i = 0; i < count; ++i) body(i);
+    return;
+  }
+
+  // Helpers claim indices from a shared counter. One that starts after every index is claimed
+  // finds nothing left and never touches |body|, so it may outlive this call.
+  struct Group {
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> finished{0};
+  };
+  const auto group = std::make_shared<Group>();
+  const auto run = [group, &body, count] {
+    for (size_t i = group->next.fetch_add(1); i < count; i = group->next.fetch_add(1)) {
+      body(i);
+      group->finished.fetch_add(1, std::memory_order_release);
+    }
+  };
+  const size_t helpers = std::min(count - 1, workers_.size());
+  for (size_t i = 0; i < helpers; ++i) Submit(run);
+  run();
+  // What is left is already running on other threads.
+  while (group->finished.load(std::memory_order_acquire) < count) std::this_thread::yield();
+}
+
+void WorkStealingPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  all_done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+uint64_t WorkStealingPool::steals() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return steals_;
+}
+
+bool WorkStealingPool::TakeTask(size_t self, Task* task) {
+  {
+    Worker& own = *workers_[self];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t offset = 1; offset < workers_.size(); ++offset) {
+    Worker& victim = *workers_[(self + offset) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      *task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      std::lock_guard<std::mutex> count_lock(mutex_);
+      ++steals_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::Run(size_t self) {
+  current_pool = this;
+  current_worker = self;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this] { return queued_ != 0 || stopping_; });
+      if (queued_ == 0) return;
+      // Claimed before the deques are searched, so another idle worker does not go looking for
+      // the same task.
+      --queued_;
+    }
+    // The claimed task sits in some deque; a racing thief may move it between searches, but it
+    // cannot leave the deques until someone claims it.
+    Task task;
+    while (!TakeTask(self, &task)) std::this_thread::yield();
+    task();
+    task = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) all_done_.notify_all();
+  }
+}
+
+}  // namespace vibe
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vibe {
+
+// A fixed set of threads, each with its own deque of tasks. A worker runs the newest task of its
+// own deque first and, once that is empty, steals the oldest task of another worker, so tasks
+// submitted from inside a task stay on the thread that made them while idle threads take work
+// off the busy ones. Tasks submitted from outside the pool are dealt round-robin.
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  // Zero picks std::thread::hardware_concurrency().
+  explicit WorkStealingPool(unsigned threads = 0);
+  // Runs what is still queued, then joins the threads.
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  void Submit(Task task);
+  // Runs |body| for every index below |count|, on the calling thread and on as many workers as
+  // are free, and returns once all have finished. The caller only ever runs indices of this call,
+  // never unrelated tasks, so it may hold per-thread state (a decoder, an arena scope) that other
+  // tasks would use too. Safe to call from inside a task.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& body);
+  // Blocks until every task submitted so far, and every task those submitted, has finished. Not
+  // for use from inside a task.
+  void Wait();
+
+  unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+  uint64_t steals() const;
+
+ private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  bool TakeTask(size_t self, Task* task);
+  void Run(size_t self);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable all_done_;
+  // Tasks queued plus tasks running.
+  size_t pending_ = 0;
+  // Tasks queued, which is what idle workers wait for.
+  size_t queued_ = 0;
+  size_t next_worker_ = 0;
+  uint64_t steals_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace vibe
@@ -0,0 +1,104 @@
+#include "MappedFile.h"
+#include "VibeContainer.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+enum class Direction {
+  // The opposite of what the input is.
+  kAuto,
+  kJson,
+  kBinary,
+};
+
+struct Options {
+  Direction direction = Direction::kAuto;
+  fs::path input;
+  fs::path output;
+};
+
+void PrintUsage() {
+  std::printf(
+      "usage: naiv4vibe_convert [--to json|binary] <input> <output>\n"
+      "Converts a vibe file between JSON and the binary container, losslessly: converting the\n"
+      "result back gives the input byte for byte. By default the output is the other form.\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--to" && i + 1 < argc) {
+      const std::string_view to = argv[++i];
+      if (to != "json" && to != "binary") return false;
+      options->direction = to == "json" ? Direction::kJson : Direction::kBinary;
+    } else if (arg.starts_with("--")) {
+      return false;
+    } else if (positional == 0) {
+      options->input = arg;
+      ++positional;
+    } else if (positional == 1) {
+      options->output = arg;
+      ++positional;
+    } else {
+      return false;
+    }
+  }
+  return positional == 2;
+}
+
+bool WriteFile(const fs::path& path, std::string_view data) {
+  std::FILE* file = std::fopen(path.string().c_str(), "wb");
+  if (!file) return false;
+  const bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+  return std::fclose(file) == 0 && written;
+}
+
+int Fail(const Options& options, const char* what) {
+  std::fprintf(stderr, "%s: %s\n", options.input.string().c_str(), what);
+  return 1;
+}
+
+}  // namespace
+
+// Converts one file between the JSON form NovelAI writes and the binary container the provider
+// reads without a scan or a base64 decode. Nothing is written unless the conversion round-trips.
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+
+  vibe::MappedFileByteSource input;
+  if (!input.Open(options.input)) return Fail(options, "cannot open");
+  const std::string_view contents = input.View();
+  const bool binary = vibe::IsVibeContainer(contents);
+  Direction direction = options.direction;
+  if (direction == Direction::kAuto) direction = binary ? Direction::kJson : Direction::kBinary;
+  if ((direction == Direction::kBinary) == binary) return Fail(options, "already in that form");
+
+  std::string converted;
+  std::string restored;
+  const bool to_binary = direction == Direction::kBinary;
+  const bool ok = to_binary ? vibe::ConvertJsonToContainer(contents, &converted)
+                            : vibe::ConvertContainerToJson(contents, &converted);
+  if (!ok) return Fail(options, to_binary ? "not a vibe file" : "bad container");
+  const bool restored_ok = to_binary ? vibe::ConvertContainerToJson(converted, &restored)
+                                     : vibe::ConvertJsonToContainer(converted, &restored);
+  if (!restored_ok) return Fail(options, "round trip failed");
+  if (restored != contents) return Fail(options, "round trip differs");
+
+  if (!WriteFile(options.output, converted)) return Fail(options, "cannot write the output");
+  std::printf("%s: %llu -> %llu bytes (%.1f%%)\n", options.output.string().c_str(),
+              static_cast<unsigned long long>(contents.size()),
+              static_cast<unsigned long long>(converted.size()),
+              contents.empty() ? 0.0 : 100.0 * converted.size() / contents.size());
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "VibeContainer.h"
+#include "VibeLayout.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+struct Options {
+  uint32_t generate_cx = 0;
+  fs::path input;
+  fs::path output;
+};
+
+void PrintUsage() {
+  std::printf(
+      "usage: naiv4vibe_layout [--generate-thumbnail N] <input> <output>\n"
+      "Rewrites a vibe file so \"thumbnailInfo\" and \"thumbnail\" open its top-level object and\n"
+      "a thumbnail can be read from the first few tens of KB. Every other member is kept byte\n"
+      "for byte. Files without a thumbnail fail unless --generate-thumbnail renders an N px one\n"
+      "from \"image\". <output> may be <input>.\n");
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  int positional = 0;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--generate-thumbnail" && i + 1 < argc) {
+      const long cx = std::atol(argv[++i]);
+      if (cx <= 0 || cx > 4096) return false;
+      options->generate_cx = static_cast<uint32_t>(cx);
+    } else if (arg.starts_with("--")) {
+      return false;
+    } else if (positional == 0) {
+      options->input = arg;
+      ++positional;
+    } else if (positional == 1) {
+      options->output = arg;
+      ++positional;
+    } else {
+      return false;
+    }
+  }
+  return positional == 2;
+}
+
+int Fail(const Options& options, const char* what) {
+  std::fprintf(stderr, "%s: %s\n", options.input.string().c_str(), what);
+  return 1;
+}
+
+}  // namespace
+
+// Rewrites one file into the thumbnail-first layout. The input is mapped and the output written
+// slice by slice to a temporary file next to it, which replaces <output> once complete, so a
+// 30 MB file takes no more heap than a small one.
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+
+  vibe::MappedFileByteSource input;
+  if (!input.Open(options.input)) return Fail(options, "cannot open");
+  if (vibe::IsVibeContainer(input.View())) return Fail(options, "binary container, not JSON");
+
+  fs::path temporary = options.output;
+  temporary += ".tmp";
+  std::FILE* file = std::fopen(temporary.string().c_str(), "wb");
+  if (!file) return Fail(options, "cannot create the output");
+
+  std::unique_ptr<vibe::ImageDecoder> decoder = vibe::CreatePortableImageDecoder();
+  vibe::LayoutOptions layout;
+  layout.generate_cx = options.generate_cx;
+  layout.decoder = decoder.get();
+  uint64_t written = 0;
+  const vibe::LayoutStatus status =
+      vibe::RewriteVibeLayout(input.View(), layout, [&](std::string_view piece) {
+        written += piece.size();
+        return std::fwrite(piece.data(), 1, piece.size(), file) == piece.size();
+      });
+  const bool closed = std::fclose(file) == 0;
+  input.Close();
+
+  std::error_code error;
+  if (status != vibe::LayoutStatus::kOk || !closed) {
+    fs::remove(temporary, error);
+    return Fail(options, closed ? vibe::LayoutStatusName(status) : "cannot write the output");
+  }
+  fs::rename(temporary, options.output, error);
+  if (error) {
+    fs::remove(temporary, error);
+    return Fail(options, "cannot replace the output");
+  }
+  std::printf("%s: %llu bytes\n", options.output.string().c_str(),
+              static_cast<unsigned long long>(written));
+  return 0;
+}
@@ -0,0 +1,303 @@
+#include "ByteSource.h"
+#include "ImageDecoder.h"
+#include "MappedFile.h"
+#include "PngEncoder.h"
+#include "Scaler.h"
+#include "ThumbnailCache.h"
+#include "ThumbnailPipeline.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr std::string_view kExtension = ".naiv4vibe";
+
+enum class OutputFormat {
+  kPng,
+  // Premultiplied BGRA rows, width * 4 bytes each, as GetThumbnail hands them to Explorer.
+  kRaw,
+};
+
+struct Options {
+  fs::path output;
+  std::vector<fs::path> inputs;
+  // Largest first, so the smaller sizes come out of the cache.
+  std::vector<uint32_t> sizes;
+  OutputFormat format = OutputFormat::kPng;
+  unsigned threads = 0;
+  uint64_t memory_budget = uint64_t{512} << 20;
+};
+
+struct Job {
+  fs::path path;
+  // Where the outputs go under the output directory, without the extension.
+  fs::path relative;
+  uint64_t size = 0;
+};
+
+void PrintUsage() {
+  std::printf(
+      "usage: naiv4vibe_thumbs [--size N]... [--format png|raw] [--threads N] [--memory-mb N]\n"
+      "                        <output-dir> <file-or-dir>...\n"
+      "Renders every %.*s file under the inputs at each size (default 256) into\n"
+      "<output-dir>/<relative path>.<size>.png, or .<size>.<w>x<h>.bgra for raw premultiplied "
+      "BGRA.\n",
+      static_cast<int>(kExtension.size()), kExtension.data());
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  std::vector<fs::path> positional;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--size" && has_value) {
+      const long size = std::atol(argv[++i]);
+      if (size <= 0 || size > 4096) return false;
+      options->sizes.push_back(static_cast<uint32_t>(size));
+    } else if (arg == "--format" && has_value) {
+      const std::string_view format = argv[++i];
+      if (format != "png" && format != "raw") return false;
+      options->format = format == "png" ? OutputFormat::kPng : OutputFormat::kRaw;
+    } else if (arg == "--threads" && has_value) {
+      options->threads = static_cast<unsigned>(std::max(0, std::atoi(argv[++i])));
+    } else if (arg == "--memory-mb" && has_value) {
+      options->memory_budget = static_cast<uint64_t>(std::max(1, std::atoi(argv[++i]))) << 20;
+    } else if (arg.starts_with("--")) {
+      return false;
+    } else {
+      positional.emplace_back(arg);
+    }
+  }
+  if (positional.size() < 2) return false;
+  options->output = positional[0];
+  options->inputs.assign(positional.begin() + 1, positional.end());
+  if (options->sizes.empty()) options->sizes.push_back(256);
+  std::sort(options->sizes.begin(), options->sizes.end(), std::greater<>());
+  options->sizes.erase(std::unique(options->sizes.begin(), options->sizes.end()),
+                       options->sizes.end());
+  return true;
+}
+
+// Every matching file under the inputs. Unreadable files and directories are reported and
+// skipped.
+std::vector<Job> CollectJobs(const std::vector<fs::path>& inputs) {
+  std::vector<Job> jobs;
+  const auto add = [&](const fs::path& path, const fs::path& relative) {
+    std::error_code error;
+    const uint64_t size = fs::file_size(path, error);
+    if (error) {
+      std::fprintf(stderr, "%s: %s\n", path.string().c_str(), error.message().c_str());
+      return;
+    }
+    jobs.push_back({path, fs::path(relative).replace_extension(), size});
+  };
+  for (const fs::path& input : inputs) {
+    std::error_code error;
+    if (!fs::is_directory(input, error)) {
+      add(input, input.filename());
+      continue;
+    }
+    for (auto it = fs::recursive_directory_iterator(
+             input, fs::directory_options::skip_permission_denied, error);
+         !error && it != fs::recursive_directory_iterator(); it.increment(error)) {
+      std::error_code file_error;
+      if (it->is_regular_file(file_error) && it->path().extension() == kExtension) {
+        add(it->path(), it->path().lexically_relative(input));
+      } else if (file_error) {
+        std::fprintf(stderr, "%s: %s\n", it->path().string().c_str(),
+                     file_error.message().c_str());
+      }
+    }
+    if (error) std::fprintf(stderr, "%s: %s\n", input.string().c_str(), error.message().c_str());
+  }
+  return jobs;
+}
+
+// Admits jobs while the memory they are expected to hold stays within a budget. A job larger
+// than the whole budget still runs, once it has the budget to itself.
+class MemoryGate {
+ public:
+  explicit MemoryGate(uint64_t budget) : budget_(budget) {}
+
+  uint64_t Acquire(uint64_t bytes) {
+    bytes = std::min(bytes, budget_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [&] { return in_use_ + bytes <= budget_; });
+    in_use_ += bytes;
+    peak_ = std::max(peak_, in_use_);
+    return bytes;
+  }
+
+  void Release(uint64_t bytes) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_use_ -= bytes;
+    }
+    released_.notify_all();
+  }
+
+  uint64_t peak() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return peak_;
+  }
+
+ private:
+  const uint64_t budget_;
+  mutable std::mutex mutex_;
+  std::condition_variable released_;
+  uint64_t in_use_ = 0;
+  uint64_t peak_ = 0;
+};
+
+// What rendering |job| holds at most: the mapped file, the decoded payload and decoder
+// temporaries (bounded by the file size again), and a thumbnail with its encoded copy per size.
+uint64_t EstimateJobBytes(const Job& job, const Options& options) {
+  uint64_t bytes = job.size * 2;
+  for (const uint32_t cx : options.sizes) bytes += uint64_t{cx} * cx * 4 * 2;
+  return bytes;
+}
+
+struct Totals {
+  std::atomic<uint64_t> files{0};
+  std::atomic<uint64_t> failed{0};
+  std::atomic<uint64_t> bytes_in{0};
+  std::atomic<uint64_t> outputs{0};
+  std::atomic<uint64_t> bytes_out{0};
+};
+
+bool WriteFile(const fs::path& path, const uint8_t* data, size_t size) {
+  std::FILE* file = std::fopen(path.string().c_str(), "wb");
+  if (!file) return false;
+  const bool written = std::fwrite(data, 1, size, file) == size;
+  return std::fclose(file) == 0 && written;
+}
+
+vibe::ImageDecoder& ThreadDecoder() {
+  thread_local std::unique_ptr<vibe::ImageDecoder> decoder = vibe::CreatePortableImageDecoder();
+  return *decoder;
+}
+
+void Fail(const Job& job, const char* what, Totals* totals) {
+  std::fprintf(stderr, "%s: %s\n", job.path.string().c_str(), what);
+  totals->failed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RenderJob(const Job& job, const Options& options, vibe::ThumbnailCache& cache,
+               vibe::WorkStealingPool& pool, Totals* totals) {
+  vibe::MappedFileByteSource file;
+  if (!file.Open(job.path)) return Fail(job, "cannot open", totals);
+  std::error_code error;
+  const fs::path base = options.output / job.relative;
+  fs::create_directories(base.parent_path(), error);
+
+  std::vector<uint8_t> pixels;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const vibe::ThumbnailAllocator allocate = [&](uint32_t w, uint32_t h, size_t* stride) {
+    width = w;
+    height = h;
+    *stride = static_cast<size_t>(w) * 4;
+    pixels.resize(*stride * h);
+    return pixels.data();
+  };
+
+  for (const uint32_t cx : options.sizes) {
+    vibe::MemoryByteSource source(file.View());
+    const vibe::ThumbnailStatus status =
+        vibe::RenderThumbnail(source, cx, ThreadDecoder(), allocate, vibe::DecodeLimits(), &cache,
+                              vibe::ParallelOptions{&pool});
+    if (status != vibe::ThumbnailStatus::kOk) {
+      return Fail(job, vibe::ThumbnailStatusName(status), totals);
+    }
+
+    std::string name = base.filename().string() + "." + std::to_string(cx);
+    std::vector<uint8_t> encoded;
+    const uint8_t* data = pixels.data();
+    size_t size = pixels.size();
+    if (options.format == OutputFormat::kPng) {
+      // Opaque thumbnails need no unpremultiplying and are written without an alpha channel.
+      const size_t stride = static_cast<size_t>(width) * 4;
+      const bool opaque = vibe::IsOpaqueBgra(pixels.data(), width, height, stride);
+      for (uint32_t y = 0; y < height && !opaque; ++y) {
+        uint8_t* row = pixels.data() + y * stride;
+        vibe::UnpremultiplyBgraRow(row, width, row);
+      }
+      encoded = vibe::EncodePng(pixels.data(), width, height, stride, !opaque);
+      data = encoded.data();
+      size = encoded.size();
+      name += ".png";
+    } else {
+      name += "." + std::to_string(width) + "x" + std::to_string(height) + ".bgra";
+    }
+    if (!WriteFile(base.parent_path() / name, data, size)) return Fail(job, "cannot write", totals);
+    totals->outputs.fetch_add(1, std::memory_order_relaxed);
+    totals->bytes_out.fetch_add(size, std::memory_order_relaxed);
+  }
+  totals->files.fetch_add(1, std::memory_order_relaxed);
+  totals->bytes_in.fetch_add(job.size, std::memory_order_relaxed);
+}
+}  // namespace
+
+// Renders thumbnails of many files at once on the same core the shell extension uses, for
+// galleries and cache warming on machines without Explorer.
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage();
+    return 2;
+  }
+
+  std::vector<Job> jobs = CollectJobs(options.inputs);
+  if (jobs.empty()) {
+    std::fprintf(stderr, "no %.*s files found\n", static_cast<int>(kExtension.size()),
+                 kExtension.data());
+    return 1;
+  }
+  // Dealt round-robin smallest first, so each worker's newest task, which it runs first, is its
+  // largest: the big files start early instead of ending the run on one thread.
+  std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.size < b.size; });
+
+  const auto start = std::chrono::steady_clock::now();
+  Totals totals;
+  vibe::ThumbnailCache cache(size_t{64} << 20);
+  MemoryGate gate(options.memory_budget);
+  vibe::WorkStealingPool pool(options.threads);
+  for (const Job& job : jobs) {
+    pool.Submit([&, job = &job] {
+      const uint64_t reserved = gate.Acquire(EstimateJobBytes(*job, options));
+      RenderJob(*job, options, cache, pool, &totals);
+      gate.Release(reserved);
+    });
+  }
+  pool.Wait();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  const uint64_t files = totals.files.load();
+  const double megabytes = totals.bytes_in.load() / (1024.0 * 1024.0);
+  std::printf("%llu files (%llu failed), %.1f MB in %.2f s: %.1f files/s, %.1f MB/s\n",
+              static_cast<unsigned long long>(files),
+              static_cast<unsigned long long>(totals.failed.load()), megabytes, seconds,
+              files / seconds, megabytes / seconds);
+  std::printf("%llu outputs, %.1f MB written; %u threads, %llu steals, peak in flight %.1f MB\n",
+              static_cast<unsigned long long>(totals.outputs.load()),
+              totals.bytes_out.load() / (1024.0 * 1024.0), pool.size(),
+              static_cast<unsigned long long>(pool.steals()), gate.peak() / (1024.0 * 1024.0));
+  return totals.failed.load() == 0 ? 0 : 1;
+}